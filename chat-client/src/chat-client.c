@@ -8,87 +8,775 @@
 *      It connects to the chat-server via TCP/IP, registers the user with their
 *      username and IP address, and provides a terminal-based UI using ncurses.
 *      The client sends and receives chat messages, formats and parses them, and
-*      handles special commands like >>bye<< and >>history<<.
+*      handles special commands like >>bye<<, >>history<< and >>search ...<<.
+*      A line written as "@name text" is a direct message to that user alone.
+*      Everything runs on one thread: a poll() loop waits on the keyboard and the
+*      socket, keys are handled one at a time, and outgoing messages go through a
+*      queue that is written only when the socket can take more, so neither
+*      typing nor the display ever waits on the network.
+*      If the connection drops, the client reconnects on its own after a
+*      jittered, growing delay and tells the server the sequence number of the
+*      last message it received, so the server sends only what was missed.
+*      Received lines are kept in a memory-mapped history file per user, with
+*      an index of where each line starts, so the last screen shows up at once
+*      on startup and paging back reads only the lines it displays.
+*      The client asks for presence and shows, above the input line, how many
+*      users are online and who is typing. It tells the server when the user
+*      starts or stops typing a chat line, but not about every key: the state
+*      is only sent when it changes, or again every TYPING_REFRESH_MS while it lasts.
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
-#include <pthread.h>
 #include <ncurses.h>
 #include <netinet/in.h>
 
 #define PORT 13000
 #define BUFFER_SIZE 1024
+#define SEND_QUEUE_SIZE 65536
 #define MAX_MESSAGE_LENGTH 80
 #define MAX_USERNAME_LENGTH 5
-#define MAX_HISTORY 50
+#define MAX_HISTORY 50               // Lines shown by >>history<<
+#define HISTORY_MAGIC 0x3148545743ULL       // "CWTH1"
+#define HISTORY_HEADER_SIZE 4096
+#define HISTORY_INDEX_SLOTS 262144          // Lines kept in the history file; a power of two
+#define HISTORY_DATA_SIZE (32u << 20)       // Bytes of lines kept in the history file
+#define BYE_FLUSH_TIMEOUT_MS 1000   // How long >>bye<< waits for queued messages to reach the server
+#define RECONNECT_BASE_MS 250        // First reconnect delay; doubles with every failed attempt
+#define RECONNECT_MAX_MS 30000       // Longest reconnect delay
+#define TYPING_REFRESH_MS 3000       // How often "still typing" is said again; the server forgets it after 6s
 
-int sockfd;                          // Socket file descriptor
+int sockfd = -1;                     // Socket file descriptor, -1 while disconnected
+bool connecting = false;             // A non-blocking connect() is in progress on sockfd
+struct sockaddr_in server_addr;      // Where to (re)connect
+unsigned long long last_seq = 0;     // Sequence number of the last message received ("Seq|<n>")
+int reconnect_attempt = 0;           // Failed attempts since the connection was last up
+long long reconnect_at_ms = 0;       // When to try again while sockfd is -1
+bool typing_sent = false;            // The server was last told the user is typing
+long long typing_sent_ms = 0;        // When it was told
 char username[MAX_USERNAME_LENGTH + 1];  // Username with null terminator
 char client_ip[INET_ADDRSTRLEN];         // To store client's IP address
 
-// Store message history
-char message_history[MAX_HISTORY][BUFFER_SIZE];   // Array to store history messages
-int message_count = 0;                            // Track the number of saved messages
+// Message history, kept in a memory-mapped file per user:
+// [header][line start offsets, a ring of HISTORY_INDEX_SLOTS][line bytes, a ring of HISTORY_DATA_SIZE]
+// Offsets count every byte ever written, so a line is still there while its start is within the
+// last HISTORY_DATA_SIZE bytes. Only the pages that are read are ever loaded.
+typedef struct history_header {
+    uint64_t magic;
+    uint32_t index_slots;
+    uint32_t data_size;
+    uint64_t line_count;             // Lines ever written; line n starts at history_index[n % slots]
+    uint64_t data_written;           // Bytes ever written; the next line goes at data_written % size
+} history_header;
+
+history_header *history = NULL;      // Mapped history file, or plain memory if it cannot be used
+uint64_t *history_index = NULL;
+char *history_data = NULL;
+size_t history_map_size = 0;
+int history_fd = -1;
+const char *history_problem = NULL;  // Why the history is not being saved, shown once the UI is up
+uint64_t history_scroll = 0;         // Lines scrolled back from the newest; 0 follows new lines
+
+// Messages waiting for the socket; only the main loop touches them
+char send_queue[SEND_QUEUE_SIZE];
+size_t send_queued = 0;
+bool send_mid_message = false;       // The head of the queue is the rest of a partly sent message
+
+// Bytes received that do not yet end in '\n'
+char receive_buffer[BUFFER_SIZE];
+size_t receive_buffered = 0;
+
+// The line being typed
+char input_line[MAX_MESSAGE_LENGTH + 1];
+size_t input_length = 0;
+
+// The last presence summary from the server ("Presence|<online>|<typing>|<names>")
+int presence_online = -1;            // -1 until the server has sent one
+int presence_typing = 0;
+char presence_names[BUFFER_SIZE];    // Comma-separated; at most a few of the users typing
+
+WINDOW *output_win;                  // Chat lines, scrolling
+WINDOW *status_win;                  // Who is online and who is typing
+WINDOW *input_win;                   // The prompt and the line being typed
 
 /*
- *  Function  : receive_messages()
- *  Summary   : Runs in a separate thread to receive messages from the server continuously.
- *              Saves them in history and prints them to the screen.
- *  Params    : void* arg
- *  Return    : void*
+ *  Function  : open_history()
+ *  Summary   : Maps the user's history file (~/.chat-history-<user>), creating it if needed.
+ *              Nothing is read up front: the index says where each line is. If the file is
+ *              missing, damaged, from another layout, or in use by another client of the same
+ *              user, the history is kept in memory for this run only.
+ *  Params    : void
+ *  Return    : void
  */
-void *receive_messages(void *arg) {
-    char buffer[BUFFER_SIZE];
+void open_history() {
+    history_map_size = HISTORY_HEADER_SIZE + (size_t)HISTORY_INDEX_SLOTS * sizeof(uint64_t) + HISTORY_DATA_SIZE;
+    const char *home = getenv("HOME");
+    char path[BUFFER_SIZE];
+    snprintf(path, sizeof(path), "%s/.chat-history-%s", home != NULL ? home : "/tmp", username);
 
-    while (1) {
-        memset(buffer, 0, BUFFER_SIZE);   // Clear buffer for new data
-        ssize_t bytes_received = recv(sockfd, buffer, BUFFER_SIZE, 0);
+    void *map = MAP_FAILED;
+    history_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    struct stat file_stat;
+    if (history_fd < 0) {
+        history_problem = "(history cannot be opened; it will not be saved)";
+    } else if (flock(history_fd, LOCK_EX | LOCK_NB) < 0) {
+        history_problem = "(history is in use by another client; it will not be saved)";
+    } else if (fstat(history_fd, &file_stat) < 0 ||
+               ((size_t)file_stat.st_size < history_map_size && ftruncate(history_fd, history_map_size) < 0)) {
+        history_problem = "(history file cannot be grown; it will not be saved)";
+    } else {
+        map = mmap(NULL, history_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, history_fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        if (history_fd >= 0) {
+            close(history_fd);
+            history_fd = -1;
+        }
+        map = mmap(NULL, history_map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) {
+            perror("History mmap failed");
+            exit(EXIT_FAILURE);
+        }
+    }
 
-        if (bytes_received <= 0) {        // Check if server closed the connection
-            printw("\nDisconnected from server.\n");
-            refresh();
-            break;
+    history = map;
+    history_index = (uint64_t *)((char *)map + HISTORY_HEADER_SIZE);
+    history_data = (char *)(history_index + HISTORY_INDEX_SLOTS);
+
+    // Start over if the file is new or does not hold a history in this layout
+    if (history->magic != HISTORY_MAGIC || history->index_slots != HISTORY_INDEX_SLOTS ||
+        history->data_size != HISTORY_DATA_SIZE || history->line_count > history->data_written) {
+        history->line_count = 0;
+        history->data_written = 0;
+        history->index_slots = HISTORY_INDEX_SLOTS;
+        history->data_size = HISTORY_DATA_SIZE;
+        history->magic = HISTORY_MAGIC;
+    }
+
+    // A client that died while saving may have counted the bytes of a line but not the line;
+    // the newest counted line ends at its own '\n', so cut the data back to there
+    if (history->line_count > 0) {
+        uint64_t start = history_index[(history->line_count - 1) % HISTORY_INDEX_SLOTS];
+        uint64_t end = start;
+        while (end < start + BUFFER_SIZE && end < history->data_written &&
+               history_data[end % HISTORY_DATA_SIZE] != '\n') {
+            end++;
         }
+        if (end < history->data_written && history_data[end % HISTORY_DATA_SIZE] == '\n') {
+            history->data_written = end + 1;
+        } else {
+            history->line_count--;
+            history->data_written = start;
+        }
+    }
+}
+
+/*
+ *  Function  : close_history()
+ *  Summary   : Asks the kernel to write the history back and unmaps it.
+ *  Params    : void
+ *  Return    : void
+ */
+void close_history() {
+    if (history_fd >= 0) {
+        msync(history, history_map_size, MS_ASYNC);
+        close(history_fd);
+    }
+    munmap(history, history_map_size);
+}
 
-        // Add received message to history
-        if (message_count < MAX_HISTORY) {
-            strncpy(message_history[message_count], buffer, BUFFER_SIZE);
-            message_count++;
+/*
+ *  Function  : history_oldest()
+ *  Summary   : Finds the oldest line still in the history: within the last HISTORY_INDEX_SLOTS
+ *              lines and starting within the last HISTORY_DATA_SIZE bytes. Line starts only
+ *              grow, so this is a binary search over the index.
+ *  Params    : void
+ *  Return    : uint64_t - equal to line_count when the history is empty
+ */
+uint64_t history_oldest() {
+    uint64_t low = history->line_count > HISTORY_INDEX_SLOTS ? history->line_count - HISTORY_INDEX_SLOTS : 0;
+    uint64_t high = history->line_count;
+    uint64_t limit = history->data_written > HISTORY_DATA_SIZE ? history->data_written - HISTORY_DATA_SIZE : 0;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (history_index[middle % HISTORY_INDEX_SLOTS] < limit) {
+            low = middle + 1;
         } else {
-            // If history is full, shift older messages to make room for new ones
-            for (int i = 1; i < MAX_HISTORY; i++) {
-                strncpy(message_history[i - 1], message_history[i], BUFFER_SIZE);
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/*
+ *  Function  : history_line()
+ *  Summary   : Copies one line out of the history, joining it if it wraps around the end of
+ *              the data ring.
+ *  Params    : uint64_t number - from history_oldest() up to line_count - 1
+ *              char *line - receives the line, NUL-terminated
+ *              size_t size
+ *  Return    : size_t - the length of the line
+ */
+size_t history_line(uint64_t number, char *line, size_t size) {
+    uint64_t start = history_index[number % HISTORY_INDEX_SLOTS];
+    uint64_t end = (number + 1 < history->line_count) ? history_index[(number + 1) % HISTORY_INDEX_SLOTS]
+                                                      : history->data_written;
+    size_t length = (size_t)(end - start - 1);       // Without its '\n'
+    if (length > size - 1) {
+        length = size - 1;
+    }
+    size_t at = (size_t)(start % HISTORY_DATA_SIZE);
+    size_t first = (length < HISTORY_DATA_SIZE - at) ? length : HISTORY_DATA_SIZE - at;
+    memcpy(line, history_data + at, first);
+    memcpy(line + first, history_data, length - first);
+    line[length] = '\0';
+    return length;
+}
+
+/*
+ *  Function  : save_to_history()
+ *  Summary   : Appends one received line to the history. The line goes into the data ring
+ *              first, then its offset into the index, and only then is it counted, so a
+ *              client that dies half way leaves at most stray bytes after the newest line,
+ *              which open_history() trims. While the user is scrolled back, the view is kept
+ *              where it is.
+ *  Params    : const char *line
+ *  Return    : void
+ */
+void save_to_history(const char *line) {
+    size_t length = strlen(line);
+    if (length > BUFFER_SIZE - 1) {
+        length = BUFFER_SIZE - 1;
+    }
+    uint64_t start = history->data_written;
+    size_t at = (size_t)(start % HISTORY_DATA_SIZE);
+    size_t first = (length < HISTORY_DATA_SIZE - at) ? length : HISTORY_DATA_SIZE - at;
+    memcpy(history_data + at, line, first);
+    memcpy(history_data, line + first, length - first);
+    history_data[(start + length) % HISTORY_DATA_SIZE] = '\n';
+
+    history_index[history->line_count % HISTORY_INDEX_SLOTS] = start;
+    history->data_written = start + length + 1;
+    history->line_count++;
+    if (history_scroll > 0) {
+        history_scroll++;
+    }
+}
+
+/*
+ *  Function  : render_history()
+ *  Summary   : Redraws the chat window from the history: the screenful of lines ending
+ *              history_scroll lines before the newest. Only those lines are read. The caller
+ *              refreshes the screen.
+ *  Params    : void
+ *  Return    : void
+ */
+void render_history() {
+    int height, width;
+    getmaxyx(output_win, height, width);
+    uint64_t oldest = history_oldest();
+    uint64_t end = history->line_count - history_scroll;
+
+    // Walk back until the lines, wrapped to the window width, fill it
+    uint64_t first = end;
+    int rows = 0;
+    while (first > oldest && rows < height) {
+        char line[BUFFER_SIZE];
+        size_t length = history_line(first - 1, line, sizeof(line));
+        rows += (length == 0) ? 1 : (int)((length + width - 1) / width);
+        first--;
+    }
+
+    werase(output_win);
+    for (uint64_t number = first; number < end; number++) {
+        char line[BUFFER_SIZE];
+        history_line(number, line, sizeof(line));
+        wprintw(output_win, "%s%s", number > first ? "\n" : "", line);
+    }
+    if (end > first) {
+        waddch(output_win, '\n');
+    }
+    wnoutrefresh(output_win);
+}
+
+/*
+ *  Function  : scroll_history()
+ *  Summary   : Pages the chat window back (negative pages) or forward through the history,
+ *              never past the oldest line or beyond the newest.
+ *  Params    : int pages
+ *  Return    : void
+ */
+void scroll_history(int pages) {
+    int height = getmaxy(output_win);
+    uint64_t available = history->line_count - history_oldest();
+    uint64_t step = (uint64_t)(height > 1 ? height - 1 : 1);
+    if (pages < 0) {
+        history_scroll += step * (uint64_t)-pages;
+        if (history_scroll > (available > (uint64_t)height ? available - height : 0)) {
+            history_scroll = available > (uint64_t)height ? available - height : 0;
+        }
+    } else {
+        history_scroll = (history_scroll > step * (uint64_t)pages) ? history_scroll - step * (uint64_t)pages : 0;
+    }
+    render_history();
+}
+
+/*
+ *  Function  : queue_send()
+ *  Summary   : Appends a message to the send queue. Nothing is written here; the main loop
+ *              writes the queue whenever the socket is writable.
+ *  Params    : const char *message
+ *  Return    : bool - false when the queue is full and the message was dropped
+ */
+bool queue_send(const char *message) {
+    size_t length = strlen(message);
+    if (length > SEND_QUEUE_SIZE - send_queued) {
+        return false;
+    }
+    memcpy(send_queue + send_queued, message, length);
+    send_queued += length;
+    return true;
+}
+
+/*
+ *  Function  : queue_send_front()
+ *  Summary   : Puts a message at the front of the send queue, ahead of anything typed while
+ *              the connection was down. Used for the Hello that opens every connection.
+ *  Params    : const char *message
+ *  Return    : bool - false when the queue is full and the message was dropped
+ */
+bool queue_send_front(const char *message) {
+    size_t length = strlen(message);
+    if (length > SEND_QUEUE_SIZE - send_queued) {
+        return false;
+    }
+    memmove(send_queue + length, send_queue, send_queued);
+    memcpy(send_queue, message, length);
+    send_queued += length;
+    return true;
+}
+
+/*
+ *  Function  : flush_send_queue()
+ *  Summary   : Writes as much of the send queue as the socket takes without blocking.
+ *  Params    : void
+ *  Return    : int - 0 on success (even if some bytes are still queued), -1 if the connection failed
+ */
+int flush_send_queue() {
+    size_t sent = 0;
+    while (sent < send_queued) {
+        ssize_t written = send(sockfd, send_queue + sent, send_queued - sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        sent += written;
+    }
+    if (sent > 0) {
+        send_mid_message = (send_queue[sent - 1] != '\n');
+    }
+    memmove(send_queue, send_queue + sent, send_queued - sent);
+    send_queued -= sent;
+    return 0;
+}
+
+/*
+ *  Function  : draw_input()
+ *  Summary   : Redraws the prompt and the line being typed, leaving the cursor after it.
+ *              The caller refreshes the screen.
+ *  Params    : void
+ *  Return    : void
+ */
+void draw_input() {
+    werase(input_win);
+    if (history_scroll > 0) {
+        mvwprintw(input_win, 0, 0, "[%s] (%llu back, End to return): %s", username,
+                  (unsigned long long)history_scroll, input_line);
+    } else {
+        mvwprintw(input_win, 0, 0, "[%s]: %s", username, input_line);
+    }
+    wnoutrefresh(input_win);
+}
+
+/*
+ *  Function  : draw_status()
+ *  Summary   : Redraws the status line from the last presence summary, leaving the user out of
+ *              the users typing. The caller refreshes the screen.
+ *  Params    : void
+ *  Return    : void
+ */
+void draw_status() {
+    werase(status_win);
+    if (presence_online >= 0) {
+        // Name the others; count the ones the summary had no room to name
+        char others[BUFFER_SIZE] = "";
+        int named = 0;
+        int listed = 0;
+        char names[BUFFER_SIZE];
+        strcpy(names, presence_names);
+        for (char *name = strtok(names, ","); name != NULL; name = strtok(NULL, ",")) {
+            listed++;
+            if (strcmp(name, username) != 0) {
+                size_t used = strlen(others);
+                snprintf(others + used, sizeof(others) - used, "%s%s", named > 0 ? ", " : "", name);
+                named++;
             }
-            strncpy(message_history[MAX_HISTORY - 1], buffer, BUFFER_SIZE);
         }
+        int unnamed = presence_typing - listed;
+        mvwprintw(status_win, 0, 0, "-- %d online", presence_online);
+        if (named > 0 && unnamed > 0) {
+            wprintw(status_win, " -- %s and %d more typing...", others, unnamed);
+        } else if (named > 0) {
+            wprintw(status_win, " -- %s %s typing...", others, named > 1 ? "are" : "is");
+        } else if (unnamed > 0) {
+            wprintw(status_win, " -- %d typing...", unnamed);
+        }
+    }
+    wnoutrefresh(status_win);
+}
 
-        printw("%s\n", buffer);   // Display the message in the chat
-        refresh();
+/*
+ *  Function  : update_presence()
+ *  Summary   : Takes in a presence summary, "<online>|<typing>|<names>", and redraws the status line.
+ *  Params    : const char *summary - the line after "Presence|"
+ *  Return    : void
+ */
+void update_presence(const char *summary) {
+    const char *names = strchr(summary, '|');
+    names = (names != NULL) ? strchr(names + 1, '|') : NULL;
+    if (sscanf(summary, "%d|%d|", &presence_online, &presence_typing) != 2 || names == NULL) {
+        return;
     }
-    return NULL;
+    snprintf(presence_names, sizeof(presence_names), "%s", names + 1);
+    draw_status();
+}
+
+/*
+ *  Function  : show_line()
+ *  Summary   : Adds one line to the chat window. The caller refreshes the screen.
+ *  Params    : const char *line
+ *  Return    : void
+ */
+void show_line(const char *line) {
+    wprintw(output_win, "%s\n", line);
+    wnoutrefresh(output_win);
+}
+
+/*
+ *  Function  : receive_messages()
+ *  Summary   : Reads whatever the server has sent without blocking. The server ends every line
+ *              with '\n', so one recv() may hold several lines or only part of one. Complete
+ *              lines are saved in history and shown (unless the user has scrolled back); a
+ *              heartbeat is answered instead, and a presence summary updates the status line.
+ *  Params    : void
+ *  Return    : int - 0 while connected, -1 once the server has closed the connection
+ */
+int receive_messages() {
+    while (1) {
+        ssize_t bytes_received = recv(sockfd, receive_buffer + receive_buffered,
+                                      BUFFER_SIZE - 1 - receive_buffered, 0);
+        if (bytes_received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        if (bytes_received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_received <= 0) {        // Check if server closed the connection
+            return -1;
+        }
+        receive_buffered += bytes_received;
+        receive_buffer[receive_buffered] = '\0';
+
+        // Display every complete line in the chat
+        char *line = receive_buffer;
+        char *newline;
+        while ((newline = strchr(line, '\n')) != NULL) {
+            *newline = '\0';
+
+            // Answer the server's heartbeat instead of displaying it
+            if (strcmp(line, ">>ping<<") == 0) {
+                queue_send("Pong\n");
+                line = newline + 1;
+                continue;
+            }
+
+            // Presence goes to the status line, not the chat
+            if (strncmp(line, "Presence|", 9) == 0) {
+                update_presence(line + 9);
+                line = newline + 1;
+                continue;
+            }
+
+            // Remember how far the stream got; sent on reconnect so nothing is shown twice
+            if (strncmp(line, "Seq|", 4) == 0) {
+                last_seq = strtoull(line + 4, NULL, 10);
+                line = newline + 1;
+                continue;
+            }
+
+            save_to_history(line);
+            if (history_scroll == 0) {
+                show_line(line);
+            }
+            line = newline + 1;
+        }
+
+        // Keep the unfinished tail; a line that fills the whole buffer is shown as is
+        receive_buffered = strlen(line);
+        if (receive_buffered == BUFFER_SIZE - 1) {
+            save_to_history(line);
+            if (history_scroll == 0) {
+                show_line(line);
+            }
+            receive_buffered = 0;
+        }
+        memmove(receive_buffer, line, receive_buffered);
+    }
+}
+
+/*
+ *  Function  : now_ms()
+ *  Summary   : Reads the monotonic clock in milliseconds.
+ *  Params    : void
+ *  Return    : long long
+ */
+long long now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ *  Function  : update_typing()
+ *  Summary   : Tells the server whether the user is typing a chat line, after a key changed the
+ *              line. Commands and direct messages do not count. Nothing is queued while the state
+ *              is unchanged, except "still typing" once every TYPING_REFRESH_MS.
+ *  Params    : void
+ *  Return    : void
+ */
+void update_typing() {
+    bool typing = input_length > 0 && input_line[0] != '>' && input_line[0] != '@';
+    if (sockfd < 0 || connecting ||
+        (typing == typing_sent && (!typing || now_ms() - typing_sent_ms < TYPING_REFRESH_MS))) {
+        return;
+    }
+    if (queue_send(typing ? "Typing|1\n" : "Typing|0\n")) {
+        typing_sent = typing;
+        typing_sent_ms = now_ms();
+    }
+}
+
+/*
+ *  Function  : start_connect()
+ *  Summary   : Opens a non-blocking socket and starts connecting to the server. The main loop
+ *              waits for the socket to become writable and then calls finish_connect().
+ *  Params    : void
+ *  Return    : int - 0 when the attempt is under way (or already done), -1 when it failed at once
+ */
+int start_connect() {
+    sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sockfd < 0) {
+        return -1;
+    }
+    if (connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS) {
+        close(sockfd);
+        sockfd = -1;
+        return -1;
+    }
+    connecting = true;
+    return 0;
+}
+
+/*
+ *  Function  : finish_connect()
+ *  Summary   : Completes a connection once the socket is writable: checks that connect() worked,
+ *              looks up the local IP address and queues the Hello in front of anything typed
+ *              while offline. The Hello uses the format "Hello|<username>|<client_ip>|<last_seq>\n";
+ *              last_seq is 0 on the first connection and asks the server to replay the gap after it.
+ *              It is followed by "Presence\n", which asks for presence summaries.
+ *  Params    : void
+ *  Return    : int - 0 when connected, -1 when the attempt failed
+ */
+int finish_connect() {
+    int error = 0;
+    socklen_t error_len = sizeof(error);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &error_len) < 0 || error != 0) {
+        return -1;
+    }
+    connecting = false;
+
+    struct sockaddr_in client_addr;
+    socklen_t addr_len = sizeof(client_addr);
+    getsockname(sockfd, (struct sockaddr *)&client_addr, &addr_len);
+    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
+
+    char hello_msg[BUFFER_SIZE];
+    snprintf(hello_msg, sizeof(hello_msg), "Hello|%s|%s|%llu\nPresence\n", username, client_ip, last_seq);
+    queue_send_front(hello_msg);
+    return 0;
+}
+
+/*
+ *  Function  : connection_lost()
+ *  Summary   : Closes the socket and schedules the next attempt after an exponentially growing
+ *              delay with jitter, so clients dropped together do not all come back at once.
+ *              A message cut off halfway is dropped; whole messages stay queued for later.
+ *  Params    : void
+ *  Return    : void
+ */
+void connection_lost() {
+    if (sockfd >= 0) {
+        close(sockfd);
+    }
+    sockfd = -1;
+    connecting = false;
+    receive_buffered = 0;
+    typing_sent = false;                 // A new session starts out not typing
+    presence_online = -1;                // Until the new session sends a summary
+    draw_status();
+
+    if (send_mid_message) {
+        char *end = memchr(send_queue, '\n', send_queued);
+        size_t dropped = (end != NULL) ? (size_t)(end - send_queue) + 1 : send_queued;
+        memmove(send_queue, send_queue + dropped, send_queued - dropped);
+        send_queued -= dropped;
+        send_mid_message = false;
+    }
+
+    long long delay_ms = RECONNECT_BASE_MS;
+    for (int i = 0; i < reconnect_attempt && delay_ms < RECONNECT_MAX_MS; i++) {
+        delay_ms *= 2;
+    }
+    if (delay_ms > RECONNECT_MAX_MS) {
+        delay_ms = RECONNECT_MAX_MS;
+    }
+    delay_ms = delay_ms / 2 + rand() % (delay_ms / 2 + 1);   // Somewhere in [delay/2, delay]
+    reconnect_attempt++;
+    reconnect_at_ms = now_ms() + delay_ms;
+
+    char notice[BUFFER_SIZE];
+    snprintf(notice, sizeof(notice), "(disconnected from server; reconnecting in %.1fs)", delay_ms / 1000.0);
+    show_line(notice);
 }
 
 /*
  *  Function  : show_message_history()
- *  Summary   : Displays the last 50 received messages stored in message_history.
+ *  Summary   : Displays the last MAX_HISTORY received messages from the history.
  *  Params    : void
  *  Return    : void
  */
 void show_message_history() {
-    for (int i = 0; i < message_count; i++) {
-        printw("%s\n", message_history[i]);
+    uint64_t oldest = history_oldest();
+    uint64_t first = (history->line_count - oldest > MAX_HISTORY) ? history->line_count - MAX_HISTORY : oldest;
+    for (uint64_t number = first; number < history->line_count; number++) {
+        char line[BUFFER_SIZE];
+        history_line(number, line, sizeof(line));
+        show_line(line);
+    }
+}
+
+/*
+ *  Function  : submit_input()
+ *  Summary   : Acts on a finished input line: a command, or a chat message queued for the server.
+ *  Params    : void
+ *  Return    : bool - true when the user asked to leave (>>bye<<)
+ */
+bool submit_input() {
+    bool leaving = false;
+
+    // Handle disconnection command
+    if (strcmp(input_line, ">>bye<<") == 0) {
+        queue_send(">>bye<<\n");
+        leaving = true;
+    } else if (strcmp(input_line, ">>history<<") == 0) {
+        // Handle message history command
+        show_message_history();
+    } else if (strncmp(input_line, ">>search ", 9) == 0 && input_length > 11 &&
+               strcmp(input_line + input_length - 2, "<<") == 0) {
+        // Search the server's chat history; the results come back like any other lines
+        char formatted_msg[BUFFER_SIZE];
+        snprintf(formatted_msg, sizeof(formatted_msg), "Search|%.*s\n", (int)(input_length - 11), input_line + 9);
+        if (!queue_send(formatted_msg)) {
+            show_line("(server is not keeping up; search not sent)");
+        }
+    } else if (input_length > 0) {
+        // Format and queue the message in the required protocol format;
+        // "@name text" goes only to that user, even if they are offline
+        char formatted_msg[BUFFER_SIZE];
+        const char *text_start = strchr(input_line, ' ');
+        if (input_line[0] == '@' && input_line[1] != ' ' && text_start != NULL) {
+            snprintf(formatted_msg, sizeof(formatted_msg), "Direct|%.*s|%s\n",
+                     (int)(text_start - input_line - 1), input_line + 1, text_start + 1);
+        } else {
+            snprintf(formatted_msg, sizeof(formatted_msg), "Message|%s\n", input_line);
+        }
+        if (!queue_send(formatted_msg)) {
+            show_line("(server is not keeping up; message not sent)");
+        }
     }
-    refresh();
+
+    input_length = 0;
+    input_line[0] = '\0';
+    typing_sent = false;                 // Only a chat line counts as typing, and sending it ends that
+    return leaving;
+}
+
+/*
+ *  Function  : handle_key()
+ *  Summary   : Applies one key press to the line being typed. Enter submits the line,
+ *              Backspace deletes the last character, Ctrl-U clears the line. Page Up and
+ *              Page Down page through the history; End goes back to the newest lines.
+ *  Params    : int key
+ *  Return    : bool - true when the user asked to leave (>>bye<<)
+ */
+bool handle_key(int key) {
+    if (key == '\n' || key == '\r' || key == KEY_ENTER) {
+        return submit_input();
+    }
+    if (key == KEY_BACKSPACE || key == 127 || key == '\b') {
+        if (input_length > 0) {
+            input_line[--input_length] = '\0';
+        }
+    } else if (key == KEY_PPAGE) {
+        scroll_history(-1);
+    } else if (key == KEY_NPAGE) {
+        scroll_history(1);
+    } else if (key == KEY_END && history_scroll > 0) {
+        history_scroll = 0;
+        render_history();
+    } else if (key == 21) {             // Ctrl-U
+        input_length = 0;
+        input_line[0] = '\0';
+    } else if (key >= ' ' && key < 127 && input_length < MAX_MESSAGE_LENGTH) {
+        input_line[input_length++] = (char)key;
+        input_line[input_length] = '\0';
+    }
+    update_typing();
+    return false;
 }
 
 /*
  *  Function  : init_ncurses()
  *  Summary   : Initializes the ncurses UI for text-based chat display.
- *              It enables line buffering, disables echoing, and supports scrolling.
+ *              The chat scrolls in the top window, above a status line; the bottom line is the
+ *              input window, read one key at a time without blocking.
  *  Params    : void
  *  Return    : void
  */
@@ -96,8 +784,12 @@ void init_ncurses() {
     initscr();               // Start ncurses mode
     cbreak();                 // Disable line buffering
     noecho();                 // Don't display typed characters
-    scrollok(stdscr, TRUE);   // Enable scrolling
-    keypad(stdscr, TRUE);     // Enable keypad input
+    output_win = newwin(LINES - 2, COLS, 0, 0);
+    status_win = newwin(1, COLS, LINES - 2, 0);
+    input_win = newwin(1, COLS, LINES - 1, 0);
+    scrollok(output_win, TRUE);   // Enable scrolling
+    keypad(input_win, TRUE);      // Enable keypad input
+    nodelay(input_win, TRUE);     // wgetch() returns ERR instead of waiting
 }
 
 /*
@@ -108,20 +800,29 @@ void init_ncurses() {
  *  Return    : void
  */
 void cleanup() {
+    delwin(input_win);
+    delwin(status_win);
+    delwin(output_win);
     endwin();
-    close(sockfd);
+    if (sockfd >= 0) {
+        close(sockfd);
+    }
+    close_history();
 }
 
 int main(int argc, char *argv[]) {
     // Validate command-line arguments
-    // The program expects exactly 4 arguments:
+    // The program expects 4 arguments, plus an optional port:
     // - `-user` followed by the username
     // - `-server` followed by the server IP
+    // - `-port` followed by the server port (e.g. to reach another cluster node)
     // If the arguments are incorrect, it prints usage instructions and exits.
-    if (argc != 5 || strcmp(argv[1], "-user") != 0 || strcmp(argv[3], "-server") != 0) {
-        fprintf(stderr, "Usage: %s -user <username> -server <server_ip>\n", argv[0]);
+    if ((argc != 5 && argc != 7) || strcmp(argv[1], "-user") != 0 || strcmp(argv[3], "-server") != 0 ||
+        (argc == 7 && strcmp(argv[5], "-port") != 0)) {
+        fprintf(stderr, "Usage: %s -user <username> -server <server_ip> [-port <port>]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
+    int server_port = (argc == 7) ? atoi(argv[6]) : PORT;
 
     // Copy the username into the global variable
     strncpy(username, argv[2], MAX_USERNAME_LENGTH);
@@ -129,87 +830,113 @@ int main(int argc, char *argv[]) {
 
     char *server_ip = argv[4];    // Store the server IP address
 
-    // Create the client socket
-    // This socket allows the client to establish a connection with the server.
-    // If the socket creation fails, the program exits with an error.
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        perror("Socket creation failed");
-        exit(EXIT_FAILURE);
-    }
-
-    // Define server and client socket addresses
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t addr_len = sizeof(client_addr);
+    // Map this user's history; nothing is read until it is shown
+    open_history();
 
     // Configure the server address structure
     server_addr.sin_family = AF_INET;             // IPv4 protocol
-    server_addr.sin_port = htons(PORT);           // Use defined port (8080)
+    server_addr.sin_port = htons(server_port);    // Use defined port (13000) unless overridden
     inet_pton(AF_INET, server_ip, &server_addr.sin_addr);  // Convert IP string to binary
 
     // Attempt to connect to the server
-    if (connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    // The first attempt waits for the answer, so a wrong address or a server
+    // that is not running is reported right away. Later attempts never block.
+    if (start_connect() < 0) {
         perror("Connection failed");
         exit(EXIT_FAILURE);
     }
+    struct pollfd connect_poll = {sockfd, POLLOUT, 0};
+    poll(&connect_poll, 1, -1);
+    if (finish_connect() < 0) {
+        fprintf(stderr, "Connection failed\n");
+        exit(EXIT_FAILURE);
+    }
+    srand((unsigned)(now_ms() ^ getpid()));      // Jitter differs between clients
 
-    // Retrieve the local IP address
-    // After connecting, the program retrieves and displays the client's IP address.
-    // This is included in the initial "Hello" message sent to the server.
-    getsockname(sockfd, (struct sockaddr *)&client_addr, &addr_len);
-    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
-
-    // Send the initial "Hello" message to the server
-    // This message uses the format: "Hello|<username>|<client_ip>"
-    // It lets the server identify the client and store the IP address.
-    char hello_msg[BUFFER_SIZE];
-    snprintf(hello_msg, sizeof(hello_msg), "Hello|%s|%s", username, client_ip);
-    send(sockfd, hello_msg, strlen(hello_msg), 0);
-
-    // Initialize ncurses UI
+    // Initialize ncurses UI, showing the last screenful of history straight away
     init_ncurses();
+    render_history();
+    if (history_problem != NULL) {
+        show_line(history_problem);
+    }
+    draw_input();
+    doupdate();
 
-    // Create the receiving thread
-    // This thread continuously listens for incoming messages
-    // from the server and displays them in real-time.
-    pthread_t recv_thread;
-    pthread_create(&recv_thread, NULL, receive_messages, NULL);
-
-    char message[MAX_MESSAGE_LENGTH + 1];
-
-    // Main message loop
-    // This loop lets the user type and send messages continuously.
-    // It handles special commands:
-    // - `>>bye<<`: Disconnects from the server
-    // - `>>history<<`: Shows message history
-    while (1) {
-        memset(message, 0, sizeof(message));
-        printw("[%s]: ", username);
-        getnstr(message, MAX_MESSAGE_LENGTH);
-
-        // Handle disconnection command
-        if (strcmp(message, ">>bye<<") == 0) {
-            send(sockfd, message, strlen(message), 0);
+    // Main event loop
+    // One poll() waits for a key press, for data from the server, and (while
+    // messages are queued) for room in the socket. Typed keys build the line
+    // one character at a time; Enter handles the special commands:
+    // - `>>bye<<`: Disconnects from the server once the queue is sent
+    // - `>>history<<`: Shows the last MAX_HISTORY lines of history
+    // Page Up / Page Down page through the whole history, End returns to the newest line.
+    // - `>>search words<<`: Asks the server for the best matching past messages
+    // - `@name text`: Sends text to that user only
+    // While the connection is down the loop also wakes up for the next
+    // reconnect attempt; anything typed meanwhile is sent once it is back.
+    bool leaving = false;
+    int leave_wait_ms = 0;
+    while (!(leaving && (send_queued == 0 || sockfd < 0 || connecting || leave_wait_ms >= BYE_FLUSH_TIMEOUT_MS))) {
+        short socket_events = connecting ? POLLOUT : (POLLIN | (send_queued > 0 ? POLLOUT : 0));
+        struct pollfd fds[2] = {
+            {STDIN_FILENO, POLLIN, 0},
+            {sockfd, socket_events, 0},
+        };
+        int timeout_ms = -1;
+        if (leaving) {
+            timeout_ms = 50;
+        } else if (sockfd < 0) {
+            long long wait_ms = reconnect_at_ms - now_ms();
+            timeout_ms = wait_ms > 0 ? (int)wait_ms : 0;
+        }
+        if (poll(fds, sockfd >= 0 ? 2 : 1, timeout_ms) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
             break;
         }
+        if (leaving) {
+            leave_wait_ms += 50;
+        }
 
-        // Handle message history command
-        if (strcmp(message, ">>history<<") == 0) {
-            show_message_history();
-            continue;
+        // Keyboard: handle every key that is waiting
+        if (fds[0].revents & POLLIN) {
+            int key;
+            while (!leaving && (key = wgetch(input_win)) != ERR) {
+                leaving = handle_key(key);
+            }
         }
 
-        // Format and send the message in the required protocol format
-        char formatted_msg[BUFFER_SIZE];
-        snprintf(formatted_msg, sizeof(formatted_msg), "Message|%s", message);
-        send(sockfd, formatted_msg, strlen(formatted_msg), 0);
+        // Reconnect: start the next attempt when its delay is up, finish it once writable
+        if (sockfd < 0 && now_ms() >= reconnect_at_ms && start_connect() < 0) {
+            connection_lost();
+        } else if (sockfd >= 0 && connecting && (fds[1].revents & (POLLOUT | POLLERR | POLLHUP))) {
+            if (finish_connect() < 0) {
+                connection_lost();
+            } else {
+                reconnect_attempt = 0;
+                show_line("(reconnected)");
+            }
+        } else if (sockfd >= 0 && !connecting) {
+            // Server: show what arrived, then send what is queued (including any Pong)
+            bool lost = false;
+            if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                lost = (receive_messages() < 0);
+            }
+            if (!lost && send_queued > 0) {
+                lost = (flush_send_queue() < 0);
+            }
+            if (lost) {
+                connection_lost();
+            }
+        }
+
+        // Repaint once per pass: chat window first, then the input line so the cursor stays there
+        draw_input();
+        doupdate();
     }
 
     // Clean up and close the program
-    // This terminates the receiving thread and closes the socket properly.
     cleanup();
-    pthread_cancel(recv_thread);
-    pthread_join(recv_thread, NULL);
 
     return 0;
-}
\ No newline at end of file
+}
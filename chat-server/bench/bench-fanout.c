@@ -0,0 +1,120 @@
+/*
+*   FILE          : bench-fanout.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      Benchmark for parallel fan-out. Each of a large audience of recipients
+*      is a mutex and a counter, standing in for an outbound queue; a round
+*      appends the next sequence number to every recipient, as a broadcast
+*      does. Rounds are timed with no helpers, then with more and more, up to
+*      one per spare core or "./bin/bench-fanout <helpers>". Every recipient
+*      checks that each round arrives exactly once and in order, so a run also
+*      tests the stealing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <time.h>
+#include <unistd.h>
+#include "../inc/fanout.h"
+
+#define kRecipients 100000
+#define kRounds 200
+
+typedef struct Recipient
+{
+  alignas(kFanoutCacheLineSize) pthread_mutex_t mutex;
+  uint64_t lastSequence;
+  uint64_t outOfOrder;
+} Recipient;
+
+static Recipient recipients[kRecipients];
+
+static void appendRange(void* context, int begin, int end);
+static uint64_t nowNs(void);
+
+int main(int argc, char* argv[])
+{
+  /* One helper per spare core, unless told otherwise; more than that still checks the stealing */
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int most = (argc > 1) ? atoi(argv[1]) : (int)cores - 1;
+  if (most > kMaxFanoutThreads)
+  {
+    most = kMaxFanoutThreads;
+  }
+  printf("%d recipients, %d rounds per run, %ld core(s)\n", kRecipients, kRounds, cores);
+  printf("%-8s %14s %14s %10s %8s\n", "helpers", "us per round", "ns/recipient", "steals", "order");
+
+  for (int helpers = 0; helpers <= most; helpers = (helpers == 0) ? 1 : helpers * 2)
+  {
+    for (int i = 0; i < kRecipients; i++)
+    {
+      pthread_mutex_init(&recipients[i].mutex, NULL);
+      recipients[i].lastSequence = 0;
+      recipients[i].outOfOrder = 0;
+    }
+
+    static FanoutPool pool;
+    fanoutPoolInit(&pool, helpers);
+    uint64_t start = nowNs();
+    for (uint64_t sequence = 1; sequence <= kRounds; sequence++)
+    {
+      fanoutRun(&pool, kRecipients, appendRange, &sequence);
+    }
+    uint64_t elapsed = nowNs() - start;
+    uint64_t steals = atomic_load(&pool.steals);
+    fanoutPoolShutdown(&pool);
+
+    /* Every recipient must have seen every round, each right after the one before */
+    uint64_t wrong = 0;
+    for (int i = 0; i < kRecipients; i++)
+    {
+      wrong += recipients[i].outOfOrder + (recipients[i].lastSequence != kRounds);
+      pthread_mutex_destroy(&recipients[i].mutex);
+    }
+    printf("%-8d %14.1f %14.2f %10llu %8s\n", helpers, elapsed / 1e3 / kRounds,
+           (double)elapsed / kRounds / kRecipients, (unsigned long long)steals, wrong == 0 ? "ok" : "BROKEN");
+    if (wrong != 0)
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  return 0;
+}
+
+/*
+ *  Function  : appendRange()
+ *  Summary   : This function delivers one round to a range of recipients, checking the order as it goes.
+ *  Params    : void* context - the round's sequence number
+ *              int begin
+ *              int end
+ *  Return    : void
+ */
+static void appendRange(void* context, int begin, int end)
+{
+  uint64_t sequence = *(const uint64_t*)context;
+  for (int i = begin; i < end; i++)
+  {
+    Recipient* recipient = &recipients[i];
+    pthread_mutex_lock(&recipient->mutex);
+    recipient->outOfOrder += (recipient->lastSequence + 1 != sequence);
+    recipient->lastSequence = sequence;
+    pthread_mutex_unlock(&recipient->mutex);
+  }
+}
+
+/*
+ *  Function  : nowNs()
+ *  Summary   : This function reads the monotonic clock in nanoseconds.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+static uint64_t nowNs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
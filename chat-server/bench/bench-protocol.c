@@ -0,0 +1,334 @@
+/*
+*   FILE          : bench-protocol.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      Microbenchmarks for the protocol hot path: parsing a client message,
+*      chunking chat text, assembling a line behind the sender's prefix, and the
+*      whole per-message job (parse, chunk, assemble every line into one
+*      buffer). Building the prefix happens once per session and is measured
+*      separately. Inputs are a fixed,
+*      seeded mix of what clients really send: mostly short chat lines, some
+*      long ones that need two lines, text containing pipes, and the control
+*      messages. Each benchmark reports ns/op and input bytes/op. The "frames"
+*      benchmark splits the whole mix as one newline-framed batch, the way a
+*      large read is handled. Scanning benchmarks run once per delimiter
+*      scanner the CPU supports.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../inc/protocol.h"
+#include "../inc/scan.h"
+
+#define kMixSize 1024
+#define kMaxMsgLength 90              // same as the server's read size
+#define kRunNs 300000000ULL           // time spent in each benchmark
+#define kClientIp "192.168.100.123"
+#define kClientUser "alice"
+
+typedef struct BenchResult
+{
+  const char* name;
+  uint64_t ops;
+  uint64_t bytes;
+  uint64_t elapsedNs;
+} BenchResult;
+
+typedef uint64_t (*BenchFunction)(int index);
+
+static char messageMix[kMixSize][kMaxMsgLength];
+static size_t messageLengths[kMixSize];
+static char frameBatch[kMixSize * kMaxMsgLength];
+static size_t frameBatchLength;
+static char linePrefix[kLinePrefixSize];
+static size_t linePrefixLength;
+static volatile size_t sink;
+
+static void buildMix(void);
+static uint64_t nowNs(void);
+static BenchResult runBench(const char* name, BenchFunction function);
+static uint64_t benchCopy(int index);
+static uint64_t benchParse(int index);
+static uint64_t benchChunk(int index);
+static uint64_t benchPrefix(int index);
+static uint64_t benchAssemble(int index);
+static uint64_t benchMessageJob(int index);
+static uint64_t benchFrames(int index);
+static void printResults(const char* implementation, BenchResult results[], size_t count);
+
+int main(void)
+{
+  buildMix();
+  linePrefixLength = formatLinePrefix(linePrefix, sizeof(linePrefix), kClientIp, kClientUser);
+
+  BenchResult common[] = {
+    runBench("copy (baseline)", benchCopy),
+    runBench("chunk", benchChunk),
+    runBench("prefix (per session)", benchPrefix),
+    runBench("assemble", benchAssemble),
+  };
+  printResults("any", common, sizeof(common) / sizeof(common[0]));
+
+  static const char* scanners[] = {"scalar", "sse2", "avx2"};
+  for (size_t i = 0; i < sizeof(scanners) / sizeof(scanners[0]); i++)
+  {
+    if (!scanUseImplementation(scanners[i]))
+    {
+      printf("\n%s: not supported on this CPU\n", scanners[i]);
+      continue;
+    }
+    BenchResult scanning[] = {
+      runBench("parse", benchParse),
+      runBench("parse+chunk+assemble", benchMessageJob),
+      runBench("frames (batched)", benchFrames),
+    };
+    printResults(scanImplementationName(), scanning, sizeof(scanning) / sizeof(scanning[0]));
+  }
+  return 0;
+}
+
+/*
+ *  Function  : printResults()
+ *  Summary   : This function prints one table of results under the name of the scanner they used.
+ *  Params    : const char* implementation
+ *              BenchResult results[]
+ *              size_t count
+ *  Return    : void
+ */
+static void printResults(const char* implementation, BenchResult results[], size_t count)
+{
+  printf("\nscanner: %s\n", implementation);
+  printf("%-20s %12s %10s %10s %10s\n", "benchmark", "ops", "ns/op", "bytes/op", "MB/s");
+  for (size_t i = 0; i < count; i++)
+  {
+    double nsPerOp = (double)results[i].elapsedNs / results[i].ops;
+    double bytesPerOp = (double)results[i].bytes / results[i].ops;
+    printf("%-20s %12llu %10.1f %10.1f %10.1f\n", results[i].name, (unsigned long long)results[i].ops, nsPerOp,
+           bytesPerOp, results[i].bytes * 1000.0 / results[i].elapsedNs);
+  }
+}
+
+/*
+ *  Function  : buildMix()
+ *  Summary   : This function fills the input mix from a fixed seed: 55% short chat (1-20 chars), 25% medium
+ *              (21-40), 10% long (41-80, two lines), 5% chat containing '|', 5% Hello / Pong / >>bye<<.
+ *  Params    : void
+ *  Return    : void
+ */
+static void buildMix(void)
+{
+  static const char* words[] = {"hi", "hello", "ok", "see", "you", "at", "the", "meeting", "lol", "what",
+                                "time", "is", "it", "now", "pizza", "tonight", "server", "down", "again", "yes"};
+  uint32_t seed = 12345;
+  for (int i = 0; i < kMixSize; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    int kind = (seed >> 16) % 100;
+    seed = seed * 1103515245 + 12345;
+    size_t target = kind < 55 ? 1 + (seed >> 16) % 20 : kind < 80 ? 21 + (seed >> 16) % 20 : 41 + (seed >> 16) % 40;
+
+    char* message = messageMix[i];
+    if (kind >= 95)
+    {
+      static const char* controls[] = {"Hello|alice|192.168.100.123", "Pong", ">>bye<<"};
+      strcpy(message, controls[(seed >> 16) % 3]);
+    }
+    else
+    {
+      char text[kMaxMsgLength] = "";
+      size_t length = 0;
+      while (length < target)
+      {
+        seed = seed * 1103515245 + 12345;
+        const char* word = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+        length += snprintf(text + length, sizeof(text) - length, "%s%s", length > 0 ? " " : "", word);
+      }
+      text[target] = '\0';
+      if (kind >= 90)
+      {
+        text[target / 2] = '|';
+      }
+      snprintf(message, kMaxMsgLength, "Message|%.*s", (int)(kMaxMsgLength - sizeof("Message|")), text);
+    }
+    messageLengths[i] = strlen(message);
+    memcpy(frameBatch + frameBatchLength, message, messageLengths[i]);
+    frameBatchLength += messageLengths[i];
+    frameBatch[frameBatchLength++] = '\n';
+  }
+}
+
+/*
+ *  Function  : nowNs()
+ *  Summary   : This function reads the monotonic clock in nanoseconds.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+static uint64_t nowNs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/*
+ *  Function  : runBench()
+ *  Summary   : This function runs one benchmark over the mix, round after round, for about kRunNs.
+ *  Params    : const char* name
+ *              BenchFunction function - processes message index and returns the input bytes it consumed
+ *  Return    : BenchResult
+ */
+static BenchResult runBench(const char* name, BenchFunction function)
+{
+  BenchResult result = {name, 0, 0, 0};
+
+  /* One untimed round to warm the caches */
+  for (int i = 0; i < kMixSize; i++)
+  {
+    function(i);
+  }
+
+  uint64_t start = nowNs();
+  do
+  {
+    for (int i = 0; i < kMixSize; i++)
+    {
+      result.bytes += function(i);
+    }
+    result.ops += kMixSize;
+    result.elapsedNs = nowNs() - start;
+  } while (result.elapsedNs < kRunNs);
+  return result;
+}
+
+/*
+ *  Function  : benchCopy()
+ *  Summary   : This function copies the message into a read buffer, as the server does on every read.
+ *  Params    : int index
+ *  Return    : uint64_t
+ */
+static uint64_t benchCopy(int index)
+{
+  char buffer[kMaxMsgLength];
+  memcpy(buffer, messageMix[index], messageLengths[index] + 1);
+  sink += buffer[messageLengths[index] / 2];
+  return messageLengths[index];
+}
+
+/*
+ *  Function  : benchParse()
+ *  Summary   : This function splits the message into fields, in place.
+ *  Params    : int index
+ *  Return    : uint64_t
+ */
+static uint64_t benchParse(int index)
+{
+  MessageSlice messageParts[kMaxMessageParts];
+  sink += parseMessage(messageMix[index], messageLengths[index], messageParts, kMaxMessageParts);
+  return messageLengths[index];
+}
+
+/*
+ *  Function  : benchChunk()
+ *  Summary   : This function chunks the text after the "Message|" prefix.
+ *  Params    : int index
+ *  Return    : uint64_t
+ */
+static uint64_t benchChunk(int index)
+{
+  const char* text = strchr(messageMix[index], '|');
+  text = (text != NULL) ? text + 1 : messageMix[index];
+  size_t textLength = messageLengths[index] - (text - messageMix[index]);
+  MessageSlice chunks[kMaxChunks];
+  sink += chunkMessage(text, textLength, chunks, kMaxChunks);
+  return textLength;
+}
+
+/*
+ *  Function  : benchPrefix()
+ *  Summary   : This function builds a sender's line prefix, which the server does once per Hello.
+ *  Params    : int index
+ *  Return    : uint64_t
+ */
+static uint64_t benchPrefix(int index)
+{
+  char prefix[kLinePrefixSize];
+  sink += formatLinePrefix(prefix, sizeof(prefix), kClientIp, kClientUser) + index;
+  return 0;
+}
+
+/*
+ *  Function  : benchAssemble()
+ *  Summary   : This function assembles the first chunk's worth of the message as one line.
+ *  Params    : int index
+ *  Return    : uint64_t
+ */
+static uint64_t benchAssemble(int index)
+{
+  char line[kMaxLineLength];
+  size_t textLength = messageLengths[index] < kChunkTextLength ? messageLengths[index] : kChunkTextLength;
+  sink += assembleChatLine(line, sizeof(line), (MessageSlice){linePrefix, linePrefixLength},
+                           (MessageSlice){messageMix[index], textLength}, lineTimestamp());
+  return textLength;
+}
+
+/*
+ *  Function  : benchMessageJob()
+ *  Summary   : This function does what the server does per chat message: parse, chunk, and assemble every
+ *              chunk into one output buffer, newline-terminated.
+ *  Params    : int index
+ *  Return    : uint64_t
+ */
+static uint64_t benchMessageJob(int index)
+{
+  MessageSlice messageParts[kMaxMessageParts];
+  parseMessage(messageMix[index], messageLengths[index], messageParts, 2);
+  if (messageParts[1].text == NULL || !sliceEquals(messageParts[0], "Message"))
+  {
+    return messageLengths[index];
+  }
+
+  MessageSlice chunks[kMaxChunks];
+  int chunkCount = chunkMessage(messageParts[1].text, messageParts[1].length, chunks, kMaxChunks);
+  char output[kMaxChunks * kMaxLineLength];
+  size_t outputLength = 0;
+  MessageSlice timestamp = lineTimestamp();
+  for (int i = 0; i < chunkCount; i++)
+  {
+    MessageSlice prefix = {linePrefix, linePrefixLength};
+    outputLength += assembleChatLine(output + outputLength, kMaxLineLength, prefix, chunks[i], timestamp);
+    output[outputLength++] = '\n';
+  }
+  sink += outputLength;
+  return messageLengths[index];
+}
+
+/*
+ *  Function  : benchFrames()
+ *  Summary   : This function splits the whole mix, sent as one newline-framed batch, into frames and parses
+ *              each one's command. It does the work of kMixSize messages, so it only runs for index 0.
+ *  Params    : int index
+ *  Return    : uint64_t
+ */
+static uint64_t benchFrames(int index)
+{
+  if (index != 0)
+  {
+    return 0;
+  }
+
+  size_t offset = 0;
+  size_t consumed;
+  MessageSlice frame;
+  MessageSlice messageParts[kMaxMessageParts];
+  while ((consumed = nextFrame(frameBatch + offset, frameBatchLength - offset, &frame)) > 0)
+  {
+    sink += parseMessage(frame.text, frame.length, messageParts, 2);
+    offset += consumed;
+  }
+  return frameBatchLength;
+}
@@ -0,0 +1,149 @@
+/*
+*   FILE          : bench-search.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      Benchmark for the history search index. A fixed, seeded stream of chat
+*      messages (words drawn from a skewed vocabulary, so a few are very common
+*      and most are rare) is formatted into lines the way the server does and
+*      indexed; the run reports the cost per message and the index size. Then a
+*      set of queries, from a single rare word to several very common ones,
+*      is run against the full index, each reporting its own time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../inc/search.h"
+
+#define kMessageCount 2000000
+#define kVocabularySize 50000
+#define kQueryRounds 20
+#define kClientIp "192.168.100.123"
+#define kClientUser "alice"
+
+static char vocabulary[kVocabularySize][12];
+static uint32_t seed = 12345;
+
+static uint32_t nextRandom(void);
+static const char* randomWord(void);
+static uint64_t nowNs(void);
+
+int main(void)
+{
+  messageBufferPoolsInit();
+  static const char* common[] = {"the", "you", "see", "meeting", "lol", "what", "time", "is", "it", "now",
+                                 "pizza", "tonight", "server", "down", "again", "yes", "ok", "hello"};
+  for (int i = 0; i < kVocabularySize; i++)
+  {
+    if (i < (int)(sizeof(common) / sizeof(common[0])))
+    {
+      strcpy(vocabulary[i], common[i]);
+    }
+    else
+    {
+      snprintf(vocabulary[i], sizeof(vocabulary[i]), "w%05x", i * 2654435761u >> 12);
+    }
+  }
+
+  static SearchIndex index;
+  searchIndexInit(&index);
+  char prefixText[kLinePrefixSize];
+  MessageSlice prefix = {prefixText, formatLinePrefix(prefixText, sizeof(prefixText), kClientIp, kClientUser)};
+
+  /* Index the whole stream, formatted as the server would broadcast it; only the indexing is timed */
+  uint64_t elapsed = 0;
+  for (int i = 0; i < kMessageCount; i++)
+  {
+    char text[96];
+    size_t textLength = 0;
+    size_t target = 5 + nextRandom() % 75;
+    while (textLength < target)
+    {
+      textLength += snprintf(text + textLength, sizeof(text) - textLength, "%s%s", textLength > 0 ? " " : "",
+                             randomWord());
+    }
+    if (textLength > 89)
+    {
+      textLength = 89;
+    }
+
+    MessageSlice chunks[kMaxChunks];
+    int chunkCount = chunkMessage(text, textLength, chunks, kMaxChunks);
+    char lines[kMaxChunks * kMaxLineLength];
+    size_t linesLength = 0;
+    for (int c = 0; c < chunkCount; c++)
+    {
+      linesLength += assembleChatLine(lines + linesLength, kMaxLineLength, prefix, chunks[c], lineTimestamp());
+      lines[linesLength++] = '\n';
+    }
+    uint64_t start = nowNs();
+    searchIndexAdd(&index, lines, linesLength);
+    elapsed += nowNs() - start;
+  }
+  printf("indexed %d messages: %.0f ns/message\n", kMessageCount, (double)elapsed / kMessageCount);
+  printf("%u words, %.2f posting bytes/message, %.1f MB of postings, %.1f MB of lines\n", index.termCount,
+         (double)index.postingBytes / kMessageCount, index.postingBytes / 1e6, index.textBytes / 1e6);
+
+  static const char* queries[] = {vocabulary[40000], vocabulary[2000], "pizza", "pizza tonight",
+                                  "the meeting is now", "see you at the meeting tonight ok"};
+  printf("\n%-36s %s\n", "query", "result (last of the timed rounds)");
+  for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++)
+  {
+    MessageSlice query = {queries[q], strlen(queries[q])};
+    char summary[128] = "";
+    for (int round = 0; round < kQueryRounds; round++)
+    {
+      MessageBuffer* results = searchIndexQuery(&index, query);
+      snprintf(summary, sizeof(summary), "%.*s", (int)strcspn(results->data, "\n"), results->data);
+      messageBufferRelease(results);
+    }
+    printf("%-36s %s\n", queries[q], summary);
+  }
+  return 0;
+}
+
+/*
+ *  Function  : nextRandom()
+ *  Summary   : This function steps the fixed-seed generator.
+ *  Params    : void
+ *  Return    : uint32_t
+ */
+static uint32_t nextRandom(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+/*
+ *  Function  : randomWord()
+ *  Summary   : This function picks a word with a roughly Zipfian skew: the word at rank r is chosen about
+ *              1/r as often as the most common one.
+ *  Params    : void
+ *  Return    : const char*
+ */
+static const char* randomWord(void)
+{
+  double u = (nextRandom() & 0xffffff) / (double)0x1000000;
+  int rank = (int)exp(u * log((double)kVocabularySize)) - 1;
+  return vocabulary[rank < kVocabularySize ? rank : kVocabularySize - 1];
+}
+
+/*
+ *  Function  : nowNs()
+ *  Summary   : This function reads the monotonic clock in nanoseconds.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+static uint64_t nowNs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
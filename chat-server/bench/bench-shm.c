@@ -0,0 +1,313 @@
+/*
+*   FILE          : bench-shm.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      Benchmark for the shared-memory transport against the sockets, run
+*      against a chat server on this host ("./bin/bench-shm [port]", 13000 by
+*      default). For each of TCP on 127.0.0.1, the server's Unix socket, and
+*      the shared-memory rings (attached over that Unix socket), one client
+*      registers, then times kRoundTrips messages sent one at a time until its
+*      own broadcast comes back, and kBurstMessages sent with up to kWindow in
+*      flight. Any other clients on the server get the broadcasts too, so run
+*      it against an otherwise idle one.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../inc/shm-transport.h"
+
+#define kDefaultPort 13000
+#define kRoundTrips 2000
+#define kBurstMessages 20000
+#define kWindow 64
+#define kWaitMs 5000                    // a reply slower than this ends the run
+#define kPendingSize (2 * kShmRingCapacity)
+
+typedef enum BenchTransport
+{
+  kBenchTcp,
+  kBenchUnix,
+  kBenchShm
+} BenchTransport;
+
+typedef struct BenchConnection
+{
+  int socket;
+  ShmTransport* shm;                  // NULL on the plain sockets
+  char pending[kPendingSize];         // received bytes not yet split into lines
+  size_t pendingLength;
+  uint64_t chatBytes;                 // of whole chat lines received
+} BenchConnection;
+
+static int serverPort = kDefaultPort;
+
+static bool openConnection(BenchConnection* connection, BenchTransport transport);
+static bool sendLine(BenchConnection* connection, const char* line);
+static int receiveChatLines(BenchConnection* connection);
+static void closeConnection(BenchConnection* connection);
+static int compareTimes(const void* left, const void* right);
+static uint64_t nowNs(void);
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && (serverPort = atoi(argv[1])) <= 0)
+  {
+    fprintf(stderr, "Usage: %s [port]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  static const char* names[] = {"tcp", "unix", "shm"};
+  static BenchConnection connection;
+  static uint64_t roundTripNs[kRoundTrips];
+  printf("server port %d, %d round trips, %d messages with %d in flight\n", serverPort, kRoundTrips,
+         kBurstMessages, kWindow);
+  printf("%-6s %10s %10s %10s %12s %10s\n", "", "rtt p50 us", "rtt p99 us", "rtt max us", "messages/s", "MB/s");
+  for (BenchTransport transport = kBenchTcp; transport <= kBenchShm; transport++)
+  {
+    if (!openConnection(&connection, transport))
+    {
+      fprintf(stderr, "%s: cannot connect to the server on port %d\n", names[transport], serverPort);
+      return EXIT_FAILURE;
+    }
+
+    /* One message at a time: the time until its broadcast is back */
+    char line[64];
+    for (int i = 0; i < kRoundTrips; i++)
+    {
+      snprintf(line, sizeof(line), "Message|rtt-%06d-payload-text\n", i);
+      uint64_t start = nowNs();
+      int received = 0;
+      if (!sendLine(&connection, line))
+      {
+        received = -1;
+      }
+      while (received == 0)
+      {
+        received = receiveChatLines(&connection);
+      }
+      if (received < 0)
+      {
+        fprintf(stderr, "%s: round trip %d failed\n", names[transport], i);
+        return EXIT_FAILURE;
+      }
+      roundTripNs[i] = nowNs() - start;
+    }
+    qsort(roundTripNs, kRoundTrips, sizeof(roundTripNs[0]), compareTimes);
+
+    /* Many at once, up to kWindow not yet back */
+    connection.chatBytes = 0;
+    int sent = 0;
+    int received = 0;
+    uint64_t start = nowNs();
+    while (received < kBurstMessages)
+    {
+      while (sent < kBurstMessages && sent - received < kWindow)
+      {
+        snprintf(line, sizeof(line), "Message|burst-%06d-payload-text\n", sent);
+        if (!sendLine(&connection, line))
+        {
+          break;
+        }
+        sent++;
+      }
+      int lines = receiveChatLines(&connection);
+      if (lines < 0)
+      {
+        fprintf(stderr, "%s: burst failed after %d of %d\n", names[transport], received, kBurstMessages);
+        return EXIT_FAILURE;
+      }
+      received += lines;
+    }
+    double seconds = (nowNs() - start) / 1e9;
+    printf("%-6s %10.1f %10.1f %10.1f %12.0f %10.2f\n", names[transport], roundTripNs[kRoundTrips / 2] / 1e3,
+           roundTripNs[kRoundTrips * 99 / 100] / 1e3, roundTripNs[kRoundTrips - 1] / 1e3, kBurstMessages / seconds,
+           connection.chatBytes / seconds / 1e6);
+    closeConnection(&connection);
+  }
+  return 0;
+}
+
+/*
+ *  Function  : openConnection()
+ *  Summary   : This function connects to the server over one transport and registers. For shared memory it
+ *              attaches before "Hello", as a same-host client would.
+ *  Params    : BenchConnection* connection
+ *              BenchTransport transport
+ *  Return    : bool - false when the server cannot be reached or refuses shared memory
+ */
+static bool openConnection(BenchConnection* connection, BenchTransport transport)
+{
+  memset(connection, 0, sizeof(*connection));
+  if (transport == kBenchTcp)
+  {
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(serverPort),
+                                  .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    int on = 1;
+    connection->socket = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(connection->socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (connect(connection->socket, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+      return false;
+    }
+  }
+  else
+  {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    snprintf(address.sun_path, sizeof(address.sun_path), "/tmp/chat-server-%d.sock", serverPort);
+    connection->socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(connection->socket, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+      return false;
+    }
+    if (transport == kBenchShm && (connection->shm = shmTransportAttach(connection->socket)) == NULL)
+    {
+      return false;
+    }
+  }
+  return sendLine(connection, "Hello|bench-shm|127.0.0.1\n");
+}
+
+/*
+ *  Function  : sendLine()
+ *  Summary   : This function sends one protocol line, waiting while the socket or ring is full.
+ *  Params    : BenchConnection* connection
+ *              const char* line
+ *  Return    : bool - false when the connection failed
+ */
+static bool sendLine(BenchConnection* connection, const char* line)
+{
+  size_t length = strlen(line);
+  if (connection->shm == NULL)
+  {
+    return send(connection->socket, line, length, MSG_NOSIGNAL) == (ssize_t)length;
+  }
+
+  ssize_t written;
+  while ((written = shmTransportSend(connection->shm, line, length)) == 0)
+  {
+    if (!shmTransportArmWait(connection->shm, true))
+    {
+      struct pollfd wakeup = {.fd = connection->shm->ownEventFd, .events = POLLIN};
+      if (poll(&wakeup, 1, kWaitMs) <= 0)
+      {
+        return false;
+      }
+    }
+    shmTransportClearWakeup(connection->shm);
+  }
+  return written == (ssize_t)length;
+}
+
+/*
+ *  Function  : receiveChatLines()
+ *  Summary   : This function waits for whatever the server sends next and counts the whole chat lines in it;
+ *              anything else the server sends, and a line cut by the end of a read, are not counted.
+ *  Params    : BenchConnection* connection
+ *  Return    : int - chat lines received (possibly 0), -1 when the connection failed or timed out
+ */
+static int receiveChatLines(BenchConnection* connection)
+{
+  char* space = connection->pending + connection->pendingLength;
+  size_t capacity = kPendingSize - connection->pendingLength;
+  ssize_t bytesRead;
+  if (connection->shm == NULL)
+  {
+    struct pollfd readable = {.fd = connection->socket, .events = POLLIN};
+    if (poll(&readable, 1, kWaitMs) <= 0 || (bytesRead = recv(connection->socket, space, capacity, 0)) <= 0)
+    {
+      return -1;
+    }
+  }
+  else if ((bytesRead = shmTransportReceive(connection->shm, space, capacity)) == 0)
+  {
+    if (!shmTransportArmWait(connection->shm, false))
+    {
+      struct pollfd wakeup = {.fd = connection->shm->ownEventFd, .events = POLLIN};
+      if (poll(&wakeup, 1, kWaitMs) <= 0)
+      {
+        return -1;
+      }
+    }
+    shmTransportClearWakeup(connection->shm);
+    return 0;
+  }
+  else if (bytesRead < 0)
+  {
+    return -1;
+  }
+  connection->pendingLength += bytesRead;
+
+  int lines = 0;
+  char* lineStart = connection->pending;
+  char* lineEnd;
+  while ((lineEnd = memchr(lineStart, '\n', connection->pending + connection->pendingLength - lineStart)) != NULL)
+  {
+    if (memmem(lineStart, lineEnd - lineStart, " << ", 4) != NULL)
+    {
+      lines++;
+      connection->chatBytes += lineEnd + 1 - lineStart;
+    }
+    lineStart = lineEnd + 1;
+  }
+  connection->pendingLength -= lineStart - connection->pending;
+  memmove(connection->pending, lineStart, connection->pendingLength);
+  return lines;
+}
+
+/*
+ *  Function  : closeConnection()
+ *  Summary   : This function says goodbye and releases the socket and, for shared memory, the rings.
+ *  Params    : BenchConnection* connection
+ *  Return    : void
+ */
+static void closeConnection(BenchConnection* connection)
+{
+  sendLine(connection, ">>bye<<\n");
+  if (connection->shm != NULL)
+  {
+    shmTransportDestroy(connection->shm);
+  }
+  close(connection->socket);
+}
+
+/*
+ *  Function  : compareTimes()
+ *  Summary   : This function orders two round-trip times for qsort().
+ *  Params    : const void* left
+ *              const void* right
+ *  Return    : int
+ */
+static int compareTimes(const void* left, const void* right)
+{
+  uint64_t a = *(const uint64_t*)left;
+  uint64_t b = *(const uint64_t*)right;
+  return (a > b) - (a < b);
+}
+
+/*
+ *  Function  : nowNs()
+ *  Summary   : This function reads the monotonic clock in nanoseconds.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+static uint64_t nowNs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
@@ -0,0 +1,272 @@
+/*
+*   FILE          : bench-zerocopy.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      Benchmark for MSG_ZEROCOPY against ordinary sends, to find the write
+*      size above which the server's -zerocopy threshold pays off. For each
+*      size the same buffer is sent over a TCP connection until kTotalBytes
+*      have gone, once copied and once zero-copy (reaping completions as the
+*      server does); the run reports throughput and the sending thread's CPU
+*      time per MiB. By default the data goes to a reader thread over loopback,
+*      where the kernel has to copy zero-copy data on delivery anyway (the
+*      last column says so), so the zero-copy numbers there are its overhead
+*      alone; give "host:port" of a sink such as "nc -l <port> > /dev/null"
+*      on another machine to measure across a real NIC.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#define kTotalBytes (256ULL << 20)    // sent per size and mode
+#define kMaxWriteSize (1 << 20)
+
+typedef struct SendResult
+{
+  double megabytesPerSecond;
+  double cpuUsPerMebibyte;            // the sending thread, user and system
+  bool copied;                        // the kernel reported copying zero-copy data
+} SendResult;
+
+static const char* sinkHost = NULL;
+static const char* sinkPort = NULL;
+static int loopbackListener = -1;
+
+static int connectSink(void);
+static void* drainConnections(void* arg);
+static SendResult runSends(const char* data, size_t size, bool zeroCopy);
+static uint32_t reapCompletions(int socket, bool* copied);
+static uint64_t clockNs(clockid_t clock);
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1)
+  {
+    char* colon = strrchr(argv[1], ':');
+    if (colon == NULL)
+    {
+      fprintf(stderr, "Usage: %s [host:port]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+    *colon = '\0';
+    sinkHost = argv[1];
+    sinkPort = colon + 1;
+  }
+  else
+  {
+    /* Loopback sink: one thread that accepts and discards everything */
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t addressLength = sizeof(address);
+    loopbackListener = socket(AF_INET, SOCK_STREAM, 0);
+    if (bind(loopbackListener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(loopbackListener, 4) < 0 ||
+        getsockname(loopbackListener, (struct sockaddr*)&address, &addressLength) < 0)
+    {
+      perror("loopback sink");
+      return EXIT_FAILURE;
+    }
+    static char port[8];
+    snprintf(port, sizeof(port), "%d", ntohs(address.sin_port));
+    sinkHost = "127.0.0.1";
+    sinkPort = port;
+    pthread_t drainer;
+    pthread_create(&drainer, NULL, drainConnections, NULL);
+    pthread_detach(drainer);
+  }
+
+  char* data = malloc(kMaxWriteSize);
+  for (size_t i = 0; i < kMaxWriteSize; i++)
+  {
+    data[i] = 'a' + i % 26;
+  }
+
+  printf("sink %s:%s, %llu MiB per run\n", sinkHost, sinkPort, kTotalBytes >> 20);
+  printf("%10s %12s %12s %14s %14s %8s\n", "write", "copy MB/s", "zc MB/s", "copy cpu us/MiB", "zc cpu us/MiB",
+         "copied");
+  static const size_t sizes[] = {256, 1024, 4096, 16384, 65536, 262144, 1048576};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    SendResult copy = runSends(data, sizes[i], false);
+    SendResult zeroCopy = runSends(data, sizes[i], true);
+    printf("%10zu %12.0f %12.0f %14.0f %14.0f %8s\n", sizes[i], copy.megabytesPerSecond,
+           zeroCopy.megabytesPerSecond, copy.cpuUsPerMebibyte, zeroCopy.cpuUsPerMebibyte,
+           zeroCopy.copied ? "yes" : "no");
+  }
+  free(data);
+  return 0;
+}
+
+/*
+ *  Function  : runSends()
+ *  Summary   : This function opens a connection to the sink and sends kTotalBytes in writes of one size,
+ *              then, for zero-copy, waits for the last completion; the buffer is never changed, so it may be
+ *              sent again before earlier sends of it complete.
+ *  Params    : const char* data
+ *              size_t size
+ *              bool zeroCopy
+ *  Return    : SendResult
+ */
+static SendResult runSends(const char* data, size_t size, bool zeroCopy)
+{
+  SendResult result = {0};
+  int connection = connectSink();
+  int on = 1;
+  if (zeroCopy && setsockopt(connection, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0)
+  {
+    perror("SO_ZEROCOPY");
+    exit(EXIT_FAILURE);
+  }
+
+  uint32_t started = 0;
+  uint32_t completed = 0;
+  uint64_t sent = 0;
+  uint64_t wallStart = clockNs(CLOCK_MONOTONIC);
+  uint64_t cpuStart = clockNs(CLOCK_THREAD_CPUTIME_ID);
+  while (sent < kTotalBytes)
+  {
+    ssize_t written = send(connection, data, size, zeroCopy ? MSG_ZEROCOPY : 0);
+    if (written < 0 && errno == ENOBUFS)
+    {
+      /* Too many pages pinned; wait for completions to release some */
+      struct pollfd errorPoll = {connection, 0, 0};
+      poll(&errorPoll, 1, 10);
+      completed += reapCompletions(connection, &result.copied);
+      continue;
+    }
+    if (written <= 0)
+    {
+      perror("send");
+      exit(EXIT_FAILURE);
+    }
+    sent += written;
+    if (zeroCopy)
+    {
+      started++;
+      completed += reapCompletions(connection, &result.copied);
+    }
+  }
+  while (completed < started)
+  {
+    struct pollfd errorPoll = {connection, 0, 0};
+    poll(&errorPoll, 1, 100);
+    completed += reapCompletions(connection, &result.copied);
+  }
+  uint64_t cpuNs = clockNs(CLOCK_THREAD_CPUTIME_ID) - cpuStart;
+  uint64_t wallNs = clockNs(CLOCK_MONOTONIC) - wallStart;
+  close(connection);
+
+  result.megabytesPerSecond = sent / (wallNs / 1e9) / 1e6;
+  result.cpuUsPerMebibyte = cpuNs / 1e3 / (sent / (double)(1 << 20));
+  return result;
+}
+
+/*
+ *  Function  : reapCompletions()
+ *  Summary   : This function reads every zero-copy completion waiting on the socket's error queue.
+ *  Params    : int socket
+ *              bool* copied - set when a completion says the kernel copied the data
+ *  Return    : uint32_t - the number of sends completed
+ */
+static uint32_t reapCompletions(int socket, bool* copied)
+{
+  uint32_t completed = 0;
+  while (true)
+  {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+    struct msghdr message = {.msg_control = control, .msg_controllen = sizeof(control)};
+    if (recvmsg(socket, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+    {
+      return completed;
+    }
+    for (struct cmsghdr* header = CMSG_FIRSTHDR(&message); header != NULL; header = CMSG_NXTHDR(&message, header))
+    {
+      struct sock_extended_err error;
+      memcpy(&error, CMSG_DATA(header), sizeof(error));
+      if (error.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+      {
+        completed += error.ee_data - error.ee_info + 1;
+        *copied = *copied || (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+      }
+    }
+  }
+}
+
+/*
+ *  Function  : connectSink()
+ *  Summary   : This function opens a blocking TCP connection to the sink.
+ *  Params    : void
+ *  Return    : int
+ */
+static int connectSink(void)
+{
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  struct addrinfo* addresses;
+  if (getaddrinfo(sinkHost, sinkPort, &hints, &addresses) != 0)
+  {
+    fprintf(stderr, "cannot resolve %s\n", sinkHost);
+    exit(EXIT_FAILURE);
+  }
+  int connection = socket(addresses->ai_family, SOCK_STREAM, 0);
+  if (connect(connection, addresses->ai_addr, addresses->ai_addrlen) < 0)
+  {
+    perror("connect");
+    exit(EXIT_FAILURE);
+  }
+  freeaddrinfo(addresses);
+  return connection;
+}
+
+/*
+ *  Function  : drainConnections()
+ *  Summary   : This function is the loopback sink: it reads and discards one connection at a time.
+ *  Params    : void* arg - unused
+ *  Return    : void*
+ */
+static void* drainConnections(void* arg)
+{
+  (void)arg;
+  static char discard[1 << 18];
+  while (true)
+  {
+    int connection = accept(loopbackListener, NULL, NULL);
+    while (read(connection, discard, sizeof(discard)) > 0)
+    {
+    }
+    close(connection);
+  }
+  return NULL;
+}
+
+/*
+ *  Function  : clockNs()
+ *  Summary   : This function reads a clock in nanoseconds.
+ *  Params    : clockid_t clock
+ *  Return    : uint64_t
+ */
+static uint64_t clockNs(clockid_t clock)
+{
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
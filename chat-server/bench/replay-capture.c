@@ -0,0 +1,628 @@
+/*
+*   FILE          : replay-capture.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      Replays a capture taken with the server's -capture option against a
+*      fresh server, to regression-test performance on real traffic shapes.
+*      Every captured session becomes a TCP connection, opened when its first
+*      frame is due and closed when it ended; every frame is sent at its
+*      captured time divided by the speed (1 for real time, 10, ...), or as
+*      fast as possible with "max". At max speed the whole capture goes out in
+*      milliseconds, and closing sessions on schedule would cut off nearly all
+*      of their output, so sessions are only closed at the end: the run then
+*      measures the message load without the churn. One thread does it all
+*      with epoll, reading what the server sends back the whole time. Each
+*      chat line received is matched, by sender and text, to the replayed
+*      message it came from, and the time from sending that message to
+*      receiving the line goes into the delivery latency figures. Pings are
+*      answered here, so captured Pong frames are skipped. The report also
+*      says how far behind schedule the sending fell, which, at 1x, should
+*      stay near zero for the figures to describe the captured load.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "../inc/protocol.h"
+#include "../inc/capture.h"
+
+#define kServerTextLength 89          // chat text the server keeps (kMaxMsgLength - 1)
+#define kReceiveBufferSize 8192
+#define kLatencyBucketUs 10           // histogram resolution
+#define kLatencyBuckets 1000000       // up to 10 s; later deliveries count in the last bucket
+#define kDefaultDrainMs 2000
+#define kPingText ">>ping<<"           // the server's kPingLine, without its newline
+
+// Data structures
+typedef struct ReplaySession
+{
+  int socket;                         // -1 before its first frame and after it ended
+  bool ended;
+  char user[kLineUserLength + 1];     // as it shows in lines, from the session's Hello
+  char input[kReceiveBufferSize];
+  size_t inputLength;
+} ReplaySession;
+
+typedef struct SentChunk
+{
+  uint64_t key;                       // hash of the sender and the chunk's text; 0 marks an empty slot
+  uint64_t sentNs;
+} SentChunk;
+
+static const char* serverHost = "127.0.0.1";
+static const char* serverPort = "13000";
+static double speed = 1.0;            // 0 for as fast as possible
+static int drainMs = kDefaultDrainMs;
+static ReplaySession* sessions;
+static uint32_t sessionCount;
+static int epollFd;
+static SentChunk* sentChunks;
+static size_t sentCapacity;
+static size_t sentCount;
+static uint64_t latencyCounts[kLatencyBuckets];
+static uint64_t latencyMaxUs;
+static uint64_t linesMatched;
+static uint64_t linesOther;
+static uint64_t connectionsLost;
+static uint64_t framesSent;
+
+static uint8_t* loadCapture(const char* path, size_t* length);
+static void openSession(uint32_t id);
+static void closeSession(uint32_t id);
+static void sendFrame(uint32_t id, const char* data, size_t length);
+static void sendAll(uint32_t id, const char* data, size_t length);
+static void noteSent(uint32_t id, const char* data, size_t length);
+static bool pollResponses(int timeoutMs);
+static void readSession(uint32_t id);
+static void handleLine(uint32_t id, const char* line, size_t length);
+static uint64_t chunkKey(const char* user, size_t userLength, const char* text, size_t textLength);
+static void rememberChunk(uint64_t key, uint64_t sentNs);
+static SentChunk* findChunk(uint64_t key);
+static uint64_t percentileUs(double fraction, uint64_t total);
+static uint64_t clockNs(void);
+
+int main(int argc, char* argv[])
+{
+  const char* capturePath = NULL;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-server") == 0 && i + 1 < argc && strrchr(argv[i + 1], ':') != NULL)
+    {
+      char* colon = strrchr(argv[++i], ':');
+      *colon = '\0';
+      serverHost = argv[i];
+      serverPort = colon + 1;
+    }
+    else if (strcmp(argv[i], "-speed") == 0 && i + 1 < argc)
+    {
+      i++;
+      speed = (strcmp(argv[i], "max") == 0) ? 0 : atof(argv[i]);
+    }
+    else if (strcmp(argv[i], "-drain") == 0 && i + 1 < argc)
+    {
+      drainMs = atoi(argv[++i]);
+    }
+    else if (capturePath == NULL && argv[i][0] != '-')
+    {
+      capturePath = argv[i];
+    }
+    else
+    {
+      capturePath = NULL;
+      break;
+    }
+  }
+  if (capturePath == NULL || speed < 0)
+  {
+    fprintf(stderr, "Usage: %s <capture file> [-server <host:port>] [-speed <factor>|max] [-drain <ms>]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  /* Read the whole capture and number its sessions before starting, so replaying does no file I/O */
+  size_t captureLength;
+  uint8_t* capture = loadCapture(capturePath, &captureLength);
+  const uint8_t* cursor = capture;
+  const uint8_t* end = capture + captureLength;
+  uint64_t capturedAtUs;
+  if (!captureReadHeader(&cursor, end, &capturedAtUs))
+  {
+    fprintf(stderr, "%s is not a capture file\n", capturePath);
+    return EXIT_FAILURE;
+  }
+  const uint8_t* firstRecord = cursor;
+  CaptureRecord record = {0};
+  uint64_t frameCount = 0;
+  while (captureReadRecord(&cursor, end, &record))
+  {
+    sessionCount = (record.session + 1 > sessionCount) ? record.session + 1 : sessionCount;
+    frameCount += (record.type == kCaptureFrame);
+  }
+  uint64_t spanUs = record.timeUs;
+  sessions = calloc(sessionCount, sizeof(*sessions));
+  for (uint32_t i = 0; i < sessionCount; i++)
+  {
+    sessions[i].socket = -1;
+  }
+
+  /* One connection per session may be far more than the default descriptor limit */
+  struct rlimit files;
+  getrlimit(RLIMIT_NOFILE, &files);
+  files.rlim_cur = files.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &files);
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+  time_t capturedAt = (time_t)(capturedAtUs / 1000000);
+  printf("capture from %s: %llu frames from %u sessions over %.3f s\n", strtok(ctime(&capturedAt), "\n"),
+         (unsigned long long)frameCount, sessionCount > 0 ? sessionCount - 1 : 0, spanUs / 1e6);
+
+  uint64_t startNs = clockNs();
+  uint64_t maxLagNs = 0;
+  cursor = firstRecord;
+  record = (CaptureRecord){0};
+  while (captureReadRecord(&cursor, end, &record))
+  {
+    /* Wait for the record's time, reading responses meanwhile */
+    if (speed > 0)
+    {
+      uint64_t dueNs = startNs + (uint64_t)(record.timeUs * 1000 / speed);
+      uint64_t nowNs;
+      while ((nowNs = clockNs()) < dueNs)
+      {
+        pollResponses((int)((dueNs - nowNs + 999999) / 1000000));
+      }
+      maxLagNs = (nowNs - dueNs > maxLagNs) ? nowNs - dueNs : maxLagNs;
+    }
+    else if (framesSent % 64 == 0)
+    {
+      pollResponses(0);
+    }
+
+    if (record.type == kCaptureFrame)
+    {
+      sendFrame(record.session, record.data, record.length);
+    }
+    else if (speed > 0)
+    {
+      closeSession(record.session);
+    }
+  }
+  uint64_t sendingNs = clockNs() - startNs;
+
+  /* Collect what is still on its way, until the server has been quiet for drainMs */
+  while (pollResponses(drainMs))
+  {
+  }
+
+  char pace[32] = "max speed";
+  if (speed > 0)
+  {
+    snprintf(pace, sizeof(pace), "%gx", speed);
+  }
+  printf("replayed at %s: %llu frames sent in %.3f s, at most %.1f ms behind schedule\n", pace,
+         (unsigned long long)framesSent, sendingNs / 1e9, maxLagNs / 1e6);
+  printf("received %llu chat lines from replayed messages, %llu other lines; %llu connections lost\n",
+         (unsigned long long)linesMatched, (unsigned long long)linesOther, (unsigned long long)connectionsLost);
+  if (linesMatched > 0)
+  {
+    printf("delivery latency (us): p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, max %llu\n",
+           (unsigned long long)percentileUs(0.50, linesMatched), (unsigned long long)percentileUs(0.90, linesMatched),
+           (unsigned long long)percentileUs(0.99, linesMatched), (unsigned long long)percentileUs(0.999, linesMatched),
+           (unsigned long long)latencyMaxUs);
+  }
+  free(capture);
+  return 0;
+}
+
+/*
+ *  Function  : loadCapture()
+ *  Summary   : This function reads a whole file into memory.
+ *  Params    : const char* path
+ *              size_t* length
+ *  Return    : uint8_t* - exits on failure
+ */
+static uint8_t* loadCapture(const char* path, size_t* length)
+{
+  FILE* file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  fseek(file, 0, SEEK_END);
+  *length = (size_t)ftell(file);
+  rewind(file);
+  uint8_t* data = malloc(*length + 1);
+  if (data == NULL || fread(data, 1, *length, file) != *length)
+  {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  fclose(file);
+  return data;
+}
+
+/*
+ *  Function  : openSession()
+ *  Summary   : This function connects a session to the server, without Nagle's delay, and watches it for input.
+ *  Params    : uint32_t id
+ *  Return    : void
+ */
+static void openSession(uint32_t id)
+{
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  struct addrinfo* addresses;
+  if (getaddrinfo(serverHost, serverPort, &hints, &addresses) != 0)
+  {
+    fprintf(stderr, "cannot resolve %s\n", serverHost);
+    exit(EXIT_FAILURE);
+  }
+  int connection = socket(addresses->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (connection < 0 || connect(connection, addresses->ai_addr, addresses->ai_addrlen) < 0)
+  {
+    perror("connect");
+    exit(EXIT_FAILURE);
+  }
+  freeaddrinfo(addresses);
+
+  int on = 1;
+  setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  struct epoll_event event = {.events = EPOLLIN, .data.u32 = id};
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, connection, &event);
+  sessions[id].socket = connection;
+}
+
+/*
+ *  Function  : closeSession()
+ *  Summary   : This function ends a session the way it ended in the capture, by closing its connection.
+ *  Params    : uint32_t id
+ *  Return    : void
+ */
+static void closeSession(uint32_t id)
+{
+  if (sessions[id].socket >= 0)
+  {
+    close(sessions[id].socket);
+    sessions[id].socket = -1;
+  }
+  sessions[id].ended = true;
+}
+
+/*
+ *  Function  : sendFrame()
+ *  Summary   : This function sends one captured frame, connecting its session first if this is its first.
+ *              A Hello names the session; chat text is remembered so the lines it becomes can be timed.
+ *  Params    : uint32_t id
+ *              const char* data
+ *              size_t length
+ *  Return    : void
+ */
+static void sendFrame(uint32_t id, const char* data, size_t length)
+{
+  MessageSlice parts[kMaxMessageParts];
+  int partCount = parseMessage(data, length, parts, 2);
+  if (partCount > 0 && sliceEquals(parts[0], "Pong"))
+  {
+    return;
+  }
+  if (sessions[id].ended)
+  {
+    return;
+  }
+  if (sessions[id].socket < 0)
+  {
+    openSession(id);
+  }
+  if (partCount == 2 && sliceEquals(parts[0], "Hello"))
+  {
+    parseMessage(parts[1].text, parts[1].length, parts + 1, kMaxMessageParts - 1);
+    sliceCopy(parts[1], sessions[id].user, sizeof(sessions[id].user));
+  }
+  noteSent(id, data, length);
+
+  char frame[kCaptureMaxFrame + 1];
+  memcpy(frame, data, length);
+  frame[length] = kFrameDelimiter;
+  sendAll(id, frame, length + 1);
+  framesSent++;
+}
+
+/*
+ *  Function  : noteSent()
+ *  Summary   : This function remembers when each chunk of a Message or Direct text was sent, keyed the way
+ *              a recipient can rebuild it from a line: the sender's shown name and the chunk's text.
+ *  Params    : uint32_t id
+ *              const char* data
+ *              size_t length
+ *  Return    : void
+ */
+static void noteSent(uint32_t id, const char* data, size_t length)
+{
+  MessageSlice parts[kMaxMessageParts];
+  if (parseMessage(data, length, parts, 2) != 2)
+  {
+    return;
+  }
+  MessageSlice text = parts[1];
+  if (sliceEquals(parts[0], "Direct"))
+  {
+    if (parseMessage(parts[1].text, parts[1].length, parts + 1, 2) != 2)
+    {
+      return;
+    }
+    text = parts[2];
+  }
+  else if (!sliceEquals(parts[0], "Message"))
+  {
+    return;
+  }
+
+  MessageSlice chunks[kMaxChunks];
+  int chunkCount = chunkMessage(text.text, text.length < kServerTextLength ? text.length : kServerTextLength,
+                                chunks, kMaxChunks);
+  uint64_t nowNs = clockNs();
+  for (int i = 0; i < chunkCount; i++)
+  {
+    rememberChunk(chunkKey(sessions[id].user, strlen(sessions[id].user), chunks[i].text, chunks[i].length), nowNs);
+  }
+}
+
+/*
+ *  Function  : sendAll()
+ *  Summary   : This function writes all of a frame, reading responses while the socket is full so the server
+ *              is never stuck writing to a replay connection that is not read.
+ *  Params    : uint32_t id
+ *              const char* data
+ *              size_t length
+ *  Return    : void
+ */
+static void sendAll(uint32_t id, const char* data, size_t length)
+{
+  size_t sent = 0;
+  while (sent < length && sessions[id].socket >= 0)
+  {
+    ssize_t written = send(sessions[id].socket, data + sent, length - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (written > 0)
+    {
+      sent += written;
+    }
+    else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+      pollResponses(1);
+    }
+    else
+    {
+      connectionsLost++;
+      closeSession(id);
+    }
+  }
+}
+
+/*
+ *  Function  : pollResponses()
+ *  Summary   : This function waits up to timeoutMs for output from the server and reads all that arrived.
+ *  Params    : int timeoutMs
+ *  Return    : bool - true if anything was read
+ */
+static bool pollResponses(int timeoutMs)
+{
+  struct epoll_event events[256];
+  int count = epoll_wait(epollFd, events, 256, timeoutMs);
+  for (int i = 0; i < count; i++)
+  {
+    readSession(events[i].data.u32);
+  }
+  return count > 0;
+}
+
+/*
+ *  Function  : readSession()
+ *  Summary   : This function reads what the server sent one session and handles each complete line.
+ *  Params    : uint32_t id
+ *  Return    : void
+ */
+static void readSession(uint32_t id)
+{
+  ReplaySession* session = &sessions[id];
+  if (session->socket < 0)
+  {
+    return;
+  }
+  ssize_t bytesRead = recv(session->socket, session->input + session->inputLength,
+                           sizeof(session->input) - session->inputLength, MSG_DONTWAIT);
+  if (bytesRead <= 0)
+  {
+    if (bytesRead == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+      /* A session that said >>bye<< is closed by the server before its end record comes up */
+      close(session->socket);
+      session->socket = -1;
+      session->ended = true;
+    }
+    return;
+  }
+  session->inputLength += bytesRead;
+
+  size_t offset = 0;
+  size_t consumed;
+  MessageSlice line;
+  while ((consumed = nextFrame(session->input + offset, session->inputLength - offset, &line)) > 0)
+  {
+    handleLine(id, line.text, line.length);
+    offset += consumed;
+  }
+  if (offset == 0 && session->inputLength == sizeof(session->input))
+  {
+    offset = session->inputLength;    // a line longer than the buffer; not one the server writes
+  }
+  memmove(session->input, session->input + offset, session->inputLength - offset);
+  session->inputLength -= offset;
+}
+
+/*
+ *  Function  : handleLine()
+ *  Summary   : This function answers a ping, or times a chat line against the message it came from.
+ *  Params    : uint32_t id
+ *              const char* line - without its newline
+ *              size_t length
+ *  Return    : void
+ */
+static void handleLine(uint32_t id, const char* line, size_t length)
+{
+  if (length == strlen(kPingText) && memcmp(line, kPingText, length) == 0)
+  {
+    sendAll(id, "Pong\n", 5);
+    return;
+  }
+
+  MessageSlice body = lineBody(line, length);
+  SentChunk* sent = NULL;
+  if (body.length > 0)
+  {
+    const char* user = memchr(line, '[', length) + 1;
+    sent = findChunk(chunkKey(user, (size_t)(body.text - 5 - user), body.text, body.length));
+  }
+  if (sent == NULL)
+  {
+    linesOther++;
+    return;
+  }
+  uint64_t latencyUs = (clockNs() - sent->sentNs) / 1000;
+  uint64_t bucket = latencyUs / kLatencyBucketUs;
+  latencyCounts[bucket < kLatencyBuckets ? bucket : kLatencyBuckets - 1]++;
+  latencyMaxUs = (latencyUs > latencyMaxUs) ? latencyUs : latencyMaxUs;
+  linesMatched++;
+}
+
+/*
+ *  Function  : chunkKey()
+ *  Summary   : This function hashes a sender's shown name and a chunk of text (FNV-1a).
+ *  Params    : const char* user
+ *              size_t userLength
+ *              const char* text
+ *              size_t textLength
+ *  Return    : uint64_t - never 0
+ */
+static uint64_t chunkKey(const char* user, size_t userLength, const char* text, size_t textLength)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < userLength; i++)
+  {
+    hash = (hash ^ (uint8_t)user[i]) * 1099511628211ULL;
+  }
+  hash = (hash ^ 0xFF) * 1099511628211ULL;
+  for (size_t i = 0; i < textLength; i++)
+  {
+    hash = (hash ^ (uint8_t)text[i]) * 1099511628211ULL;
+  }
+  return hash | 1;
+}
+
+/*
+ *  Function  : rememberChunk()
+ *  Summary   : This function records a chunk's send time in the open-addressed table, growing it at half full.
+ *              The same text sent again by the same sender replaces the older time.
+ *  Params    : uint64_t key
+ *              uint64_t sentNs
+ *  Return    : void
+ */
+static void rememberChunk(uint64_t key, uint64_t sentNs)
+{
+  if (sentCount * 2 >= sentCapacity)
+  {
+    SentChunk* old = sentChunks;
+    size_t oldCapacity = sentCapacity;
+    sentCapacity = sentCapacity ? sentCapacity * 2 : 4096;
+    sentChunks = calloc(sentCapacity, sizeof(*sentChunks));
+    sentCount = 0;
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+      if (old[i].key != 0)
+      {
+        rememberChunk(old[i].key, old[i].sentNs);
+      }
+    }
+    free(old);
+  }
+
+  size_t slot = key & (sentCapacity - 1);
+  while (sentChunks[slot].key != 0 && sentChunks[slot].key != key)
+  {
+    slot = (slot + 1) & (sentCapacity - 1);
+  }
+  sentCount += (sentChunks[slot].key == 0);
+  sentChunks[slot] = (SentChunk){key, sentNs};
+}
+
+/*
+ *  Function  : findChunk()
+ *  Summary   : This function looks a chunk up.
+ *  Params    : uint64_t key
+ *  Return    : SentChunk* - NULL if it was never sent
+ */
+static SentChunk* findChunk(uint64_t key)
+{
+  if (sentCapacity == 0)
+  {
+    return NULL;
+  }
+  size_t slot = key & (sentCapacity - 1);
+  while (sentChunks[slot].key != 0)
+  {
+    if (sentChunks[slot].key == key)
+    {
+      return &sentChunks[slot];
+    }
+    slot = (slot + 1) & (sentCapacity - 1);
+  }
+  return NULL;
+}
+
+/*
+ *  Function  : percentileUs()
+ *  Summary   : This function finds the latency below which the given fraction of matched lines arrived.
+ *  Params    : double fraction
+ *              uint64_t total
+ *  Return    : uint64_t - the top of the bucket, in microseconds
+ */
+static uint64_t percentileUs(double fraction, uint64_t total)
+{
+  uint64_t wanted = (uint64_t)(total * fraction);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kLatencyBuckets; i++)
+  {
+    seen += latencyCounts[i];
+    if (seen > wanted || seen == total)
+    {
+      return (i + 1) * kLatencyBucketUs;
+    }
+  }
+  return latencyMaxUs;
+}
+
+/*
+ *  Function  : clockNs()
+ *  Summary   : This function reads the monotonic clock in nanoseconds.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+static uint64_t clockNs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
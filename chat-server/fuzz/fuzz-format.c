@@ -0,0 +1,71 @@
+/*
+*   FILE          : fuzz-format.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      libFuzzer target for the line builders. The first three input bytes give
+*      the IP length, the username length and the size of the line buffer; the
+*      IP, the username and the chat text follow. The prefix is built from the
+*      IP and username, then the line is assembled from the prefix, the text and
+*      the timestamp. Both buffers are allocated at exactly their size so the
+*      sanitizers flag any write past them.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../inc/protocol.h"
+
+#define kHeaderBytes 3
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  if (size < kHeaderBytes)
+  {
+    return 0;
+  }
+  size_t ipLength = data[0] % 46;               // at most INET6_ADDRSTRLEN - 1
+  size_t userLength = data[1] % 100;            // at most kGenericStringLength - 1
+  size_t lineSize = data[2];
+  data += kHeaderBytes;
+  size -= kHeaderBytes;
+  if (ipLength + userLength > size)
+  {
+    return 0;
+  }
+
+  /* The server's strings are NUL-terminated; the text is a slice and is not */
+  char ipAddress[46];
+  char userName[100];
+  memcpy(ipAddress, data, ipLength);
+  ipAddress[ipLength] = '\0';
+  memcpy(userName, data + ipLength, userLength);
+  userName[userLength] = '\0';
+  size_t textLength = size - ipLength - userLength;
+  char* text = malloc(textLength > 0 ? textLength : 1);
+  memcpy(text, data + ipLength + userLength, textLength);
+
+  char* prefix = malloc(kLinePrefixSize);
+  size_t prefixLength = formatLinePrefix(prefix, kLinePrefixSize, ipAddress, userName);
+  if (prefixLength >= kLinePrefixSize || strlen(prefix) != prefixLength)
+  {
+    abort();
+  }
+
+  char* line = malloc(lineSize > 0 ? lineSize : 1);
+  MessageSlice timestamp = lineTimestamp();
+  size_t lineLength = assembleChatLine(line, lineSize, (MessageSlice){prefix, prefixLength},
+                                       (MessageSlice){text, textLength}, timestamp);
+  size_t expected = prefixLength + (textLength < kChunkTextLength ? textLength : kChunkTextLength) + timestamp.length;
+  if (lineSize == 0 ? lineLength != 0
+                    : (line[lineLength] != '\0' || lineLength != (expected < lineSize ? expected : lineSize - 1)))
+  {
+    abort();
+  }
+
+  free(line);
+  free(prefix);
+  free(text);
+  return 0;
+}
@@ -0,0 +1,182 @@
+/*
+*   FILE          : fuzz-parse.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      libFuzzer target for the message decoder. The input is treated like one
+*      batched read from a client (at most kInputBufferSize bytes) and is split
+*      the way the server splits it: into newline-terminated frames, each frame
+*      into the command and then the Hello fields, the Direct recipient and
+*      text, or the chat text, which is chunked and formatted. Besides the
+*      sanitizers catching any stray access, the frame, field and chunk
+*      invariants are checked explicitly, and every delimiter scanner the CPU
+*      supports must agree with the scalar one on the same input.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../inc/protocol.h"
+#include "../inc/scan.h"
+
+#define kInputBufferSize 4096         // same as the server's input buffer
+
+static void checkScanners(const char* data, size_t size);
+static void checkMessage(const char* message, size_t length);
+static bool sliceInside(MessageSlice slice, const char* start, size_t length);
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  if (size > kInputBufferSize)
+  {
+    size = kInputBufferSize;
+  }
+
+  /* An exactly-sized copy, so the sanitizers flag any scan past the end */
+  char* buffer = malloc(size > 0 ? size : 1);
+  memcpy(buffer, data, size);
+  checkScanners(buffer, size);
+
+  size_t offset = 0;
+  size_t consumed;
+  MessageSlice frame;
+  while ((consumed = nextFrame(buffer + offset, size - offset, &frame)) > 0)
+  {
+    if (!sliceInside(frame, buffer + offset, consumed - 1) ||
+        memchr(frame.text, kFrameDelimiter, frame.length) != NULL)
+    {
+      abort();
+    }
+    checkMessage(frame.text, frame.length);
+    offset += consumed;
+  }
+  if (memchr(buffer + offset, kFrameDelimiter, size - offset) != NULL)
+  {
+    abort();
+  }
+
+  /* What is left over is handled as one message, as it is for clients that do not frame */
+  checkMessage(buffer + offset, size - offset);
+  free(buffer);
+  return 0;
+}
+
+/*
+ *  Function  : checkScanners()
+ *  Summary   : This function scans for a few bytes with each supported implementation and aborts if any of
+ *              them disagrees with the scalar loop. The scanner is left on the CPU's default choice.
+ *  Params    : const char* data
+ *              size_t size
+ *  Return    : void
+ */
+static void checkScanners(const char* data, size_t size)
+{
+  static const char* scanners[] = {"scalar", "sse2", "avx2"};
+  char targets[] = {kFrameDelimiter, kMessageDelimiter, size > 0 ? data[size - 1] : 0};
+  const char* defaultName = scanImplementationName();
+
+  for (size_t t = 0; t < sizeof(targets); t++)
+  {
+    scanUseImplementation("scalar");
+    size_t expected = scanForByte(data, size, targets[t]);
+    for (size_t i = 1; i < sizeof(scanners) / sizeof(scanners[0]); i++)
+    {
+      if (scanUseImplementation(scanners[i]) && scanForByte(data, size, targets[t]) != expected)
+      {
+        abort();
+      }
+    }
+  }
+  scanUseImplementation(defaultName);
+}
+
+/*
+ *  Function  : checkMessage()
+ *  Summary   : This function decodes one frame as processClientMessage() does and checks the fields, chunks
+ *              and formatted lines.
+ *  Params    : const char* message
+ *              size_t length
+ *  Return    : void
+ */
+static void checkMessage(const char* message, size_t length)
+{
+  /* Command first, then the Hello fields */
+  MessageSlice messageParts[kMaxMessageParts] = {};
+  int partCount = parseMessage(message, length, messageParts, 2);
+  if ((partCount == 0) != (length == 0))
+  {
+    abort();
+  }
+  if (partCount == 2 && sliceEquals(messageParts[0], "Hello"))
+  {
+    parseMessage(messageParts[1].text, messageParts[1].length, messageParts + 1, kMaxMessageParts - 1);
+  }
+  else if (partCount == 2 && sliceEquals(messageParts[0], "Direct"))
+  {
+    parseMessage(messageParts[1].text, messageParts[1].length, messageParts + 1, 2);
+  }
+
+  /* Fields must lie inside the message, in order; only the last one may contain a pipe */
+  for (int i = 0; i < kMaxMessageParts; i++)
+  {
+    if (messageParts[i].text == NULL)
+    {
+      continue;
+    }
+    bool last = (i == kMaxMessageParts - 1 || messageParts[i + 1].text == NULL);
+    if (!sliceInside(messageParts[i], message, length) ||
+        (i > 0 && (messageParts[i - 1].text == NULL || messageParts[i].text <= messageParts[i - 1].text)) ||
+        (!last && memchr(messageParts[i].text, kMessageDelimiter, messageParts[i].length) != NULL))
+    {
+      abort();
+    }
+  }
+
+  if (messageParts[1].text == NULL || !sliceEquals(messageParts[0], "Message"))
+  {
+    return;
+  }
+
+  /* Chunks must tile the text and each formatted line must fit its buffer */
+  const char* text = messageParts[1].text;
+  size_t textLength = messageParts[1].length;
+  MessageSlice chunks[kMaxChunks];
+  int chunkCount = chunkMessage(text, textLength, chunks, kMaxChunks);
+  char prefixText[kLinePrefixSize];
+  MessageSlice prefix = {prefixText, formatLinePrefix(prefixText, sizeof(prefixText), "255.255.255.255", "alice")};
+  size_t covered = 0;
+  for (int i = 0; i < chunkCount; i++)
+  {
+    if (chunks[i].text != text + covered || chunks[i].length == 0 || chunks[i].length > kChunkTextLength)
+    {
+      abort();
+    }
+    covered += chunks[i].length;
+
+    char line[kMaxLineLength];
+    size_t lineLength = assembleChatLine(line, sizeof(line), prefix, chunks[i], lineTimestamp());
+    if (lineLength >= sizeof(line) || line[lineLength] != '\0')
+    {
+      abort();
+    }
+  }
+  if (covered != textLength && covered != (size_t)kMaxChunks * kChunkTextLength)
+  {
+    abort();
+  }
+}
+
+/*
+ *  Function  : sliceInside()
+ *  Summary   : This function checks that a slice lies within [start, start + length).
+ *  Params    : MessageSlice slice
+ *              const char* start
+ *              size_t length
+ *  Return    : bool
+ */
+static bool sliceInside(MessageSlice slice, const char* start, size_t length)
+{
+  return slice.text >= start && slice.length <= length && (size_t)(slice.text - start) <= length - slice.length;
+}
@@ -0,0 +1,82 @@
+/*
+*   FILE          : replay-main.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      Stand-in for the libFuzzer driver on compilers without -fsanitize=fuzzer.
+*      It runs a fuzz target once on every file named on the command line (or
+*      every file in a named directory), so a corpus or crash reproducer can be
+*      replayed under ASan/UBSan with plain gcc.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define kMaxInputBytes 65536
+#define kPathLength 4096
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static int replayFile(const char* path);
+
+int main(int argc, char* argv[])
+{
+  int replayed = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    struct stat info;
+    if (stat(argv[i], &info) < 0)
+    {
+      perror(argv[i]);
+      return EXIT_FAILURE;
+    }
+    if (!S_ISDIR(info.st_mode))
+    {
+      replayed += replayFile(argv[i]);
+      continue;
+    }
+
+    DIR* directory = opendir(argv[i]);
+    struct dirent* entry;
+    while (directory != NULL && (entry = readdir(directory)) != NULL)
+    {
+      if (entry->d_name[0] != '.')
+      {
+        char path[kPathLength];
+        snprintf(path, sizeof(path), "%s/%s", argv[i], entry->d_name);
+        replayed += replayFile(path);
+      }
+    }
+    if (directory != NULL)
+    {
+      closedir(directory);
+    }
+  }
+  printf("replayed %d input(s)\n", replayed);
+  return 0;
+}
+
+/*
+ *  Function  : replayFile()
+ *  Summary   : This function feeds one file to the fuzz target.
+ *  Params    : const char* path
+ *  Return    : int - 1 if the file was replayed, 0 if it could not be read
+ */
+static int replayFile(const char* path)
+{
+  static uint8_t data[kMaxInputBytes];
+  FILE* file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    perror(path);
+    return 0;
+  }
+  size_t size = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  LLVMFuzzerTestOneInput(data, size);
+  return 1;
+}
@@ -0,0 +1,45 @@
+/*
+*   FILE          : affinity.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for CPU and NUMA placement of the server's threads.
+*      Network threads (the accept loop and client threads) and worker threads
+*      can each be pinned to a list of cores, optionally the cores that service a
+*      NIC's receive-queue interrupts, and pinned threads prefer memory from the
+*      NUMA node they run on.
+*/
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+// Include statements
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// Constants
+#define kMaxCpus 1024
+#define kMaxNumaNodes 64
+#define kMaxNicIrqs 256
+#define kNicNameLength 32
+
+// Data structures
+typedef struct CpuList
+{
+  int count;
+  int cpus[kMaxCpus];
+} CpuList;
+
+
+//Function prototypes
+bool affinityParseCpuList(const char* text, CpuList* list);
+void affinityInit(const char* networkCpus, const char* workerCpus, const char* nicName);
+void affinityPrepareSessionThread(pthread_attr_t* attributes);
+void affinityPinCurrentThread(void);
+void affinityPrepareWorkerThread(pthread_attr_t* attributes, int workerIndex);
+void affinityBindLocalMemory(void);
+void affinityPrintReport(FILE* stream);
+
+#endif //AFFINITY_H
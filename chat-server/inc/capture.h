@@ -0,0 +1,59 @@
+/*
+*   FILE          : capture.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for traffic capture. With -capture <file> the
+*      server records every frame a client sends, as received, with the time
+*      and a number for the session it came from, plus a record when each
+*      session ends. bench/replay-capture.c plays a capture back against a
+*      fresh server. A capture file is a 16-byte header (magic, then the wall
+*      clock at the start in microseconds, little-endian) followed by records:
+*      a type byte, then LEB128 varints for the microseconds since the previous
+*      record and the session number, then, for a frame, its length and bytes.
+*      Session numbers start at 1 in each file.
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+// Include statements
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Constants
+#define kCaptureMagic "CWTCAP01"
+#define kCaptureHeaderSize 16
+#define kCaptureMaxFrame 4096             // longer frames are recorded cut to this length
+#define kCaptureBufferSize (1 << 20)      // stdio buffer; the main loop flushes it every second
+
+// Data structures
+typedef enum CaptureRecordType
+{
+  kCaptureFrame = 1,
+  kCaptureSessionEnd = 2,
+} CaptureRecordType;
+
+typedef struct CaptureRecord
+{
+  CaptureRecordType type;
+  uint64_t timeUs;                    // since the capture started; reading adds to the previous record's
+  uint32_t session;
+  const char* data;                   // a frame's bytes, in the caller's copy of the file
+  size_t length;
+} CaptureRecord;
+
+
+//Function prototypes
+bool captureOpen(const char* path);
+void captureFrame(uint32_t* session, const char* data, size_t length);
+void captureSessionEnd(uint32_t session);
+void captureFlush(void);
+void captureClose(FILE* stream);
+bool captureReadHeader(const uint8_t** cursor, const uint8_t* end, uint64_t* startUs);
+bool captureReadRecord(const uint8_t** cursor, const uint8_t* end, CaptureRecord* record);
+
+#endif //CAPTURE_H
@@ -18,45 +18,218 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include "pool.h"
+#include "worker-pool.h"
+#include "cluster.h"
+#include "shm-transport.h"
+#include "timing-wheel.h"
+#include "hot-restart.h"
+#include "affinity.h"
+#include "trace.h"
+#include "protocol.h"
+#include "replay.h"
+#include "mailbox.h"
+#include "search.h"
+#include "session-stats.h"
+#include "history-log.h"
+#include "zero-copy.h"
+#include "capture.h"
+#include "transport.h"
+#include "presence.h"
+#include "fanout.h"
 
 // Constants
 #define kServerPort 13000
-#define kMaxClients 10
+#define kClusterPort 14000
+#define kUnixSocketPathFormat "/tmp/chat-server-%d.sock"
+#define kAdminSocketPathFormat "/tmp/chat-server-%d.admin"
+#define kAdminTimeoutMs 1000      // an admin connection that is slower than this to ask or to read is dropped
+#define kMaxClients 4096           // registered clients; further Hellos are ignored (the simulator sets its own)
 #define kMaxMsgLength 90
-#define kChunkSize 41
 #define kUserNameLength 6
 #define kGenericStringLength 100
+#define kSessionNameLength 32      // longer user names are cut to this many characters - 1
+#define kInputBufferSize 4096       // bytes of client input buffered while looking for frame boundaries
+#define kIdleTimeoutMs 30000        // silence before the server pings a client
+#define kPongTimeoutMs 10000        // time a pinged client has to answer before it is dropped
+#define kPingLine ">>ping<<\n"
+#define kHistoryCopySize 16384     // history is copied into a shared-memory ring in pieces this large
+#define kEphemeralMaxNodes 32       // ephemeral events queued for one client at most
+#define kEphemeralMaxBacklog 16384  // output waiting for a client past which new ephemeral events are dropped
+#define kOutboundMaxBuffered (1u << 20)  // control and chat bytes held for a client past which it is disconnected
 
 // Data structures
+// A client's output lanes, in the order they are written: a lane is only written while the ones above it are
+// empty, except that a node already partly written is always finished first
+typedef enum OutboundLane
+{
+    kLaneControl,               // heartbeats; never wait behind chat
+    kLaneChat,                  // chat lines, history, replies; in order
+    kLaneEphemeral,             // typing and presence; coalesced by key, dropped under pressure
+    kLaneCount
+} OutboundLane;
+
+typedef struct OutboundNode
+{
+    struct OutboundNode* next;
+    MessageBuffer* buffer;      // NULL when the node sends history from disk instead
+    size_t offset;              // bytes of the buffer (or history range) already written to the socket
+    uint64_t enqueuedNs;        // when it was queued
+    HistoryRange history;       // only used when buffer is NULL
+    uint32_t coalesceKey;       // ephemeral lane only: a newer event with the same key replaces this one
+} OutboundNode;
+
+// Everything a broadcast touches for one recipient; allocated from its own pool so the queues sit densely
+typedef struct OutboundQueue
+{
+    pthread_mutex_t mutex;
+    OutboundNode* head[kLaneCount];
+    OutboundNode* tail[kLaneCount];
+    int writingLane;            // the lane whose head the client's thread is writing, or -1
+    int ephemeralCount;         // nodes in the ephemeral lane
+    size_t queuedBytes;         // all lanes
+    size_t bufferedBytes;       // control and chat nodes that hold a buffer; disk history is not counted
+    bool overflowed;            // a node would have passed kOutboundMaxBuffered; the client is disconnected
+    int wakeupFd;               // eventfd signalled when output is queued for this client
+    SessionStats* stats;        // shown by the admin socket; NULL when the table was full
+} OutboundQueue;
+
 typedef struct ClientInfo
 {
     int clientSocket;
-    char ipAddress[INET_ADDRSTRLEN];
-    char userName[kGenericStringLength];
+    OutboundQueue* queue;
+    bool isLocal;               // connected over the Unix socket
+    uint64_t readNs;            // when the input being processed was read
+    char* inputBuffer;          // input not yet handled, from inputBufferPool; NULL while there is none
+    size_t inputLength;
+    bool framedInput;           // the client ends its messages with '\n'
+    bool resumes;               // the client's Hello carried its last sequence; it is sent "Seq|<n>" lines
+    ShmTransport* shm;          // set once a local client switches to shared memory
+    struct in_addr ipAddress;   // as sent in the client's Hello
+    char userName[kSessionNameLength];
+    char linePrefix[kLinePrefixSize];  // "<ip> [<user>] << ", built once the client says Hello
+    size_t linePrefixLength;    // 0 until then
+    WorkItem* pendingHead;      // work submitted by this client's thread, oldest first
+    WorkItem* pendingTail;
+    atomic_int signalsInFlight;
+    TimerEntry idleTimer;       // idle / heartbeat deadline, owned by idleWheel
+    bool pingOutstanding;       // guarded by idleWheel's lock
+    struct ClientInfo* nextSession;  // every live session, registered or not (guarded by clients_mutex)
+    struct ClientInfo* prevSession;
+    uint64_t bytesIn;           // owned by the client's thread, published to stats
+    uint64_t bytesOut;
+    ZeroCopyState* zeroCopy;    // set when large writes to this socket skip the kernel copy (see -zerocopy)
+    uint32_t captureId;         // the session's number in the -capture file; 0 until it sends a frame
+    int presenceSlot;           // the session's slot in chatPresence; -1 until it is registered
+    bool typing;                // the client last said "Typing|1"
+    bool wantsPresence;         // the client asked for presence summaries (guarded by clients_mutex)
 } ClientInfo;
 
+typedef struct BroadcastJob
+{
+    WorkItem work;
+    int senderSocket;
+    char linePrefix[kLinePrefixSize];  // copied from the sender, so formatting needs no lookup
+    size_t linePrefixLength;
+    char message[kMaxMsgLength];
+    MessageBuffer* lines;       // formatted output, filled in by the worker
+    MessageStamps stamps;
+} BroadcastJob;
+
+// Registered clients as parallel arrays, so fan-out reads only the queue pointers and removal scans
+// only the sockets; a removed client's place is taken by the last one
 typedef struct ClientsList
 {
     int numberOfClients;
-    ClientInfo clients[kMaxClients];
+    int capacity;
+    int* sockets;
+    OutboundQueue** queues;
+    ClientInfo** clients;
 } ClientsList;
 
-ClientsList activeClients;
-pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+extern ClientsList activeClients;
+extern pthread_mutex_t clients_mutex;
+extern ReplayRing chatReplay;
+extern MailboxStore offlineMail;
+extern HistoryLog chatHistory;
+extern size_t zeroCopyThreshold;
+extern SearchIndex chatSearch;
+extern PresenceTable chatPresence;
+extern ClientInfo* allSessions;
+extern int liveSessionCount;
+extern SlabPool sessionPool;
+extern SlabPool outboundQueuePool;
+extern SlabPool inputBufferPool;
+extern SlabPool outboundNodePool;
+extern SlabPool broadcastJobPool;
+extern WorkerPool messageWorkers;
+extern FanoutPool broadcastFanout;
+extern TimingWheel idleWheel;
 
 
 //Function prototypes
-int setUpConnection(void);
+int setUpConnection(int serverPort);
+int setUpLocalConnection(const char* socketPath);
 void spawnClientThread(int clientSocket);
-void handleRequest(void* arg);
-void parseMessage(char* message, char* messageParts[]);
-void addClient(int clientSocket, char* messageParts[]);
+void startSessionThread(ClientInfo* client);
+void* handleRequest(void* arg);
+bool receiveInput(ClientInfo* client);
+bool processInput(ClientInfo* client);
+void holdInputBuffer(ClientInfo* client);
+void releaseInputBuffer(ClientInfo* client);
+bool processClientMessage(ClientInfo* client, const char* message, size_t length);
+ClientInfo* createSession(int clientSocket);
+void destroySession(ClientInfo* client);
+void addClient(ClientInfo* client, MessageSlice messageParts[]);
+void resumeClient(ClientInfo* client, uint64_t lastSeen);
+void sendHistory(ClientInfo* client, MessageSlice count);
+void clientsListInit(ClientsList* list, int capacity);
+bool registerClient(ClientInfo* client);
 void removeClient(int userId);
-void broadcastMessage(char* message, int senderUserId);
-void formatMessage(int clientSocket, char* message);
+void sendDirect(ClientInfo* client, MessageSlice recipient, MessageSlice text);
+void submitBroadcast(ClientInfo* client, MessageSlice message);
+void runBroadcastJob(WorkItem* item);
+void completeBroadcastJob(WorkItem* item);
+void drainCompletions(ClientInfo* client);
+void waitForCompletions(ClientInfo* client);
+MessageBuffer* formatBroadcast(const char* message, MessageSlice linePrefix);
+void broadcastMessage(MessageBuffer* lines);
+void fanoutBroadcastRange(void* context, int begin, int end);
+void broadcastPresence(MessageBuffer* summary);
+void subscribePresence(ClientInfo* client);
+void enqueueOutbound(ClientInfo* client, MessageBuffer* buffer);
+void queueOutbound(OutboundQueue* queue, MessageBuffer* buffer);
+void queueOutboundLane(OutboundQueue* queue, OutboundLane lane, MessageBuffer* buffer);
+bool queueEphemeral(OutboundQueue* queue, MessageBuffer* buffer, uint32_t coalesceKey);
+void enqueueHistory(ClientInfo* client, HistoryRange range);
+void appendOutboundNode(OutboundQueue* queue, OutboundLane lane, OutboundNode* node, size_t length);
+int outboundWriteOrder(const OutboundQueue* queue, OutboundLane order[kLaneCount]);
+void outboundPrintStats(FILE* stream);
+size_t outboundNodeLength(const OutboundNode* node);
+void releaseOutboundNode(OutboundNode* node);
+int flushOutbound(ClientInfo* client);
+int outboundRemaining(const ClientInfo* client, const OutboundNode* node, struct iovec parts[2]);
+void touchSession(ClientInfo* client);
+void publishSessionStats(ClientInfo* client);
+void noteQueueChange(OutboundQueue* queue);
+void serveAdminRequest(int adminSocket);
+uint64_t onSessionTimeout(TimerEntry* entry);
 void displayFatalError(char* errorMessage);
 
 #endif //CHAT_SERVER_H
\ No newline at end of file
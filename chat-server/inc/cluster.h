@@ -0,0 +1,70 @@
+/*
+*   FILE          : cluster.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for cluster mode. Several chat-server nodes dial
+*      each other over TCP; every message a node's own clients send is forwarded
+*      once to each peer, and each peer broadcasts it to its own clients.
+*/
+
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+// Include statements
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "pool.h"
+
+// Constants
+#define kMaxClusterPeers 16
+#define kMaxClusterNodes 64
+#define kClusterFrameMagic 0x43575431     // "CWT1"
+#define kClusterMaxBatch 64               // frames written with a single sendmsg()
+#define kClusterMaxQueuedFrames 65536     // frames kept for a peer that is down
+#define kClusterRetrySeconds 1
+#define kClusterHostLength 256
+
+// Data structures
+typedef struct ClusterFrameHeader
+{
+  uint32_t magic;
+  uint16_t originNode;
+  uint16_t length;            // payload bytes that follow the header
+  uint64_t originEpoch;       // start time of the origin process; resets sequence tracking on restart
+  uint64_t sequence;          // per-origin, increasing by one for every forwarded message
+} __attribute__((packed)) ClusterFrameHeader;
+
+typedef struct ClusterFrame
+{
+  struct ClusterFrame* next;
+  MessageBuffer* buffer;      // header + payload, shared by every peer queue
+} ClusterFrame;
+
+typedef struct ClusterPeer
+{
+  char host[kClusterHostLength];
+  int port;
+  int peerSocket;
+  pthread_t senderThread;
+  pthread_mutex_t lock;
+  pthread_cond_t framesReady;
+  ClusterFrame* queueHead;
+  ClusterFrame* queueTail;
+  size_t queuedFrames;
+  uint64_t framesSent;
+  uint64_t batchesSent;
+  uint64_t framesDropped;
+} ClusterPeer;
+
+
+//Function prototypes
+bool clusterAddPeer(const char* peerSpec);
+void clusterStart(int nodeId, int listenPort);
+bool clusterEnabled(void);
+void clusterForward(MessageBuffer* lines);
+void clusterPrintStats(FILE* stream);
+
+#endif //CLUSTER_H
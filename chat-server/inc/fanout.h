@@ -0,0 +1,72 @@
+/*
+*   FILE          : fanout.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for parallel fan-out. A round runs one function
+*      over every index of a recipient range, [0, count), in pieces of at most
+*      kFanoutChunk. The calling thread and the pool's helper threads each
+*      start with an equal share and take pieces from the front of it; one that
+*      runs out steals the back half of whatever share is largest, so a thread
+*      held up by a contended recipient, or one that woke late, is simply left
+*      less to do. Every index is handled exactly once and fanoutRun() returns
+*      only when all of them are. Rounds do not overlap, so recipients see the
+*      rounds in the order they were run. Small ranges, and pools without
+*      helpers, run on the calling thread alone.
+*/
+
+#ifndef FANOUT_H
+#define FANOUT_H
+
+// Include statements
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdalign.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+// Constants
+#define kMaxFanoutThreads 16              // helpers, besides the calling thread
+#define kFanoutChunk 128                  // recipients handled between looks at the shared state
+#define kFanoutParallelMin 1024           // smaller ranges are not worth waking the helpers for
+#define kFanoutMaxRange (1 << 24)         // a share's bounds are packed in 24 bits each
+#define kFanoutCacheLineSize 64
+
+// Data structures
+typedef void (*FanoutFunction)(void* context, int begin, int end);
+
+// One participant's share of the round, packed as generation:16 | begin:24 | end:24 so that taking from
+// the front and stealing from the back are each a single compare-and-swap, and a stale one fails
+typedef struct FanoutShare
+{
+  alignas(kFanoutCacheLineSize) atomic_uint_fast64_t range;
+} FanoutShare;
+
+typedef struct FanoutPool
+{
+  int helperCount;                    // 0 until fanoutPoolInit(), or when there is one core
+  pthread_t helpers[kMaxFanoutThreads];
+  sem_t wakeups[kMaxFanoutThreads];
+  FanoutShare shares[kMaxFanoutThreads + 1];  // share 0 is the calling thread's
+  FanoutFunction function;            // the round's work; valid while it has indexes left
+  void* context;
+  uint64_t generation;                // of the current round, in the low 16 bits of each share
+  alignas(kFanoutCacheLineSize) atomic_int remaining;  // indexes of the round not yet handled
+  atomic_bool stopping;
+  atomic_uint_fast64_t rounds;        // run in parallel
+  atomic_uint_fast64_t inlineRounds;  // run on the calling thread alone
+  atomic_uint_fast64_t steals;
+} FanoutPool;
+
+
+//Function prototypes
+void fanoutPoolInit(FanoutPool* pool, int helperCount);
+void fanoutRun(FanoutPool* pool, int count, FanoutFunction function, void* context);
+void fanoutPoolShutdown(FanoutPool* pool);
+int fanoutDefaultHelpers(void);
+void fanoutPrintStats(FanoutPool* pool, FILE* stream);
+
+#endif //FANOUT_H
@@ -0,0 +1,86 @@
+/*
+*   FILE          : history-log.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the on-disk history. Every numbered
+*      broadcast is appended, as the lines clients saw, to the newest of a few
+*      segment files; the start of each message in its segment is kept in
+*      memory, so any run of messages maps to one byte range per segment.
+*      Those ranges are queued for clients like any other output and written
+*      with sendfile(), straight from the page cache into the socket. A
+*      broadcast is only put in line under clients_mutex, which fixes its place
+*      in the log; the write happens after the lock is released, so no sender
+*      waits for the disk while holding it. Looking ranges up writes whatever
+*      is still in line first. A queued range holds a reference on its segment,
+*      so a segment that is deleted to make room stays readable until the last
+*      client using it has been sent it.
+*/
+
+#ifndef HISTORY_LOG_H
+#define HISTORY_LOG_H
+
+// Include statements
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "pool.h"
+
+// Constants
+#define kHistorySegmentSize (16u << 20)   // a segment takes no more messages once it holds this many bytes
+#define kHistorySegments 8                // segments kept; the oldest is deleted to make room for a new one
+#define kHistoryMaxMessages 100000        // most messages one History request is sent
+#define kHistoryPathLength 256
+#define kHistoryDirectoryFormat "/tmp/chat-server-%d.history"
+#define kHistoryTag "History"             // "History|<n>" asks for the last n broadcasts
+#define kHistoryPendingMax 1024           // broadcasts in line to be written; a sender finding no room writes them
+
+// Data structures
+typedef struct HistorySegment
+{
+  int fd;
+  atomic_int references;              // the log's own while it is kept, plus one per queued range
+  uint64_t firstSequence;
+  uint32_t messageCount;
+  uint32_t length;                    // bytes written
+  uint32_t* offsets;                  // where message firstSequence + i starts
+  uint32_t offsetCapacity;
+} HistorySegment;
+
+typedef struct HistoryRange
+{
+  HistorySegment* segment;            // holds a reference for whoever sends the range
+  uint64_t offset;
+  uint64_t length;
+  uint64_t lastSequence;              // of the range's last message
+} HistoryRange;
+
+typedef struct HistoryLog
+{
+  char directory[kHistoryPathLength];
+  pthread_mutex_t lock;               // held to write, and to look ranges up; guards the segments
+  HistorySegment* segments[kHistorySegments];  // oldest first
+  int segmentCount;
+  atomic_bool failed;                 // set when the directory is unusable or a write failed; nothing is logged
+  pthread_mutex_t pendingLock;        // guards the line only, never held across a write
+  MessageBuffer* pending[kHistoryPendingMax];  // numbered broadcasts not yet written, a ring from pendingHead
+  int pendingHead;
+  int pendingCount;
+} HistoryLog;
+
+
+//Function prototypes
+bool historyLogInit(HistoryLog* log, const char* directory);
+void historyLogAppend(HistoryLog* log, MessageBuffer* lines);
+void historyLogFlush(HistoryLog* log);
+uint64_t historyLogOldest(HistoryLog* log);
+int historyLogRanges(HistoryLog* log, uint64_t first, uint64_t last, HistoryRange ranges[], int maxRanges);
+ssize_t historyRangeSend(int socket, const HistoryRange* range, uint64_t sent);
+size_t historyRangeRead(const HistoryRange* range, uint64_t offset, char* buffer, size_t capacity);
+void historySegmentRelease(HistorySegment* segment);
+
+#endif //HISTORY_LOG_H
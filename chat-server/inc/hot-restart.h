@@ -0,0 +1,68 @@
+/*
+*   FILE          : hot-restart.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for zero-downtime hot restart. A running server
+*      listens on an upgrade socket; a new binary started with -takeover connects
+*      to it and receives the listening sockets, every client socket and the
+*      session table, so clients stay connected across the upgrade. Offline
+*      mailboxes are handed over after the sessions.
+*/
+
+#ifndef HOT_RESTART_H
+#define HOT_RESTART_H
+
+// Include statements
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+// Constants
+#define kHandoffMagic 0x43575448          // "CWTH"
+#define kHandoffVersion 4
+#define kUpgradeSocketPathFormat "/tmp/chat-server-%d.upgrade"
+#define kHandoffRegistered 0x1            // the session had sent Hello
+#define kHandoffFramedInput 0x2           // the client ends its messages with '\n'
+#define kHandoffResumes 0x4               // the client is sent "Seq|<n>" lines
+#define kHandoffPresence 0x8              // the client asked for presence summaries
+#define kHandoffNameLength 100            // at least kSessionNameLength
+
+// Data structures
+typedef struct HandoffHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t sessionCount;
+  uint64_t lastSequence;            // the new server numbers broadcasts from here on
+  uint32_t mailboxCount;            // offline mailboxes that follow the sessions
+} HandoffHeader;
+
+typedef struct HandoffSessionRecord
+{
+  uint32_t flags;
+  char userName[kHandoffNameLength];
+  char ipAddress[INET_ADDRSTRLEN];
+  uint32_t pendingBytes;            // queued output that follows the record
+  uint32_t pendingInputBytes;       // partial input frame that follows the queued output
+} HandoffSessionRecord;
+
+typedef struct HandoffMailboxRecord
+{
+  char userName[kHandoffNameLength];
+  uint32_t bytes;                   // waiting messages that follow the record
+} HandoffMailboxRecord;
+
+struct ClientInfo;
+
+
+//Function prototypes
+int setUpUpgradeSocket(const char* socketPath);
+void performHandoff(int upgradeSocket, int serverSocket, int localSocket);
+bool receiveHandoff(const char* socketPath, int* serverSocket, int* localSocket);
+bool handoffRequested(void);
+void parkForHandoff(struct ClientInfo* client);
+void handoffSessionEnded(void);
+
+#endif //HOT_RESTART_H
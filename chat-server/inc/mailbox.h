@@ -0,0 +1,65 @@
+/*
+*   FILE          : mailbox.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the offline mailboxes. A direct message for
+*      a user who is not connected is kept, already formatted, in one shared
+*      append-only arena; each user's messages are linked in arrival order. When
+*      the user says Hello again, the whole mailbox is copied into one buffer
+*      and handed to the session in a single write. Each user may hold at most
+*      kMailboxUserBytes (the oldest messages make way for new ones) and all
+*      users together at most kMailboxArenaSize.
+*/
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+// Include statements
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pool.h"
+
+// Constants
+#define kMailboxArenaSize (1u << 20)      // bytes of undelivered mail for everyone together
+#define kMailboxUserBytes 16384           // bytes of undelivered mail per user
+#define kMaxMailboxes 256                 // users with undelivered mail; must be a power of two
+#define kMailboxNameLength 32             // longer user names are cut to this many characters - 1
+#define kMailboxNone UINT32_MAX           // offset of "no record"
+
+// Data structures
+typedef struct Mailbox
+{
+  char userName[kMailboxNameLength];  // empty when the slot is free
+  uint32_t head;                      // arena offset of the oldest record, kMailboxNone when empty
+  uint32_t tail;
+  uint32_t bytes;                     // message bytes waiting, excluding record headers
+  uint32_t count;
+} Mailbox;
+
+typedef struct MailboxStore
+{
+  char* arena;
+  uint32_t used;                      // records are appended here
+  uint32_t liveBytes;                 // arena bytes in records still waiting; the rest is reclaimed by compaction
+  uint32_t boxCount;
+  Mailbox boxes[kMaxMailboxes];       // open addressing on the user name
+} MailboxStore;
+
+typedef enum DepositResult
+{
+  kDepositKept,
+  kDepositTrimmed,                    // kept, but the user's oldest messages were dropped to make room
+  kDepositRefused                     // too large, or the arena or the table is full
+} DepositResult;
+
+
+//Function prototypes
+void mailboxInit(MailboxStore* store);
+DepositResult mailboxDeposit(MailboxStore* store, const char* userName, const char* data, size_t length);
+MessageBuffer* mailboxTake(MailboxStore* store, const char* userName);
+MessageBuffer* mailboxCopy(const MailboxStore* store, int slot, const char** userName);
+
+#endif //MAILBOX_H
@@ -0,0 +1,95 @@
+/*
+*   FILE          : pool.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the slab pool allocator. Sessions, outbound queue
+*      nodes and message buffers are carved out of fixed-size slabs that are never
+*      returned to the OS, so a server in steady state does not touch the heap.
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+// Include statements
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// Constants
+#define kMaxPools 16
+#define kPoolSlabBytes 65536        // memory requested from malloc() each time a pool grows
+#define kPoolCacheSize 32           // objects kept in each thread's private cache
+#define kPoolCacheBatch 16          // objects moved between a cache and the shared free list at once
+#define kMessageBufferClasses 5
+
+// Data structures
+typedef struct PoolObject
+{
+  struct PoolObject* next;
+} PoolObject;
+
+typedef struct PoolSlab
+{
+  struct PoolSlab* next;
+} PoolSlab;
+
+typedef struct SlabPool
+{
+  const char* name;
+  int poolId;
+  size_t objectSize;
+  size_t objectsPerSlab;
+  pthread_mutex_t lock;
+  PoolObject* freeList;
+  PoolSlab* slabs;
+  size_t slabCount;
+  atomic_size_t inUse;
+  atomic_size_t highWater;
+  atomic_size_t cacheHits;
+  atomic_size_t cacheRefills;
+} SlabPool;
+
+typedef struct PoolStats
+{
+  const char* name;
+  size_t objectSize;
+  size_t slabCount;
+  size_t capacity;
+  size_t inUse;
+  size_t highWater;
+  size_t cacheHits;
+  size_t cacheRefills;
+} PoolStats;
+
+// Reference counted byte buffer shared by every recipient of a broadcast
+typedef struct MessageBuffer
+{
+  atomic_int refCount;
+  int sizeClass;              // index into the buffer pools, -1 when it came straight from malloc()
+  size_t length;
+  size_t capacity;
+  uint64_t readNs;            // when the message was read from its sender, 0 when it is not timed
+  uint64_t traceId;           // sampled trace the recipients' writes belong to, 0 for none
+  uint64_t sequence;          // broadcast sequence number, 0 for lines outside the chat (pings, notices)
+  uint8_t sequenceLineLength;
+  char sequenceLine[24];      // "Seq|<sequence>\n", written after the data to clients that resume
+  char data[];
+} MessageBuffer;
+
+
+//Function prototypes
+void poolInit(SlabPool* pool, const char* name, size_t objectSize);
+void* poolAlloc(SlabPool* pool);
+void poolFree(SlabPool* pool, void* object);
+void poolGetStats(SlabPool* pool, PoolStats* stats);
+void poolPrintStats(FILE* stream);
+void messageBufferPoolsInit(void);
+MessageBuffer* messageBufferAcquire(size_t capacity);
+void messageBufferRetain(MessageBuffer* buffer);
+void messageBufferRelease(MessageBuffer* buffer);
+
+#endif //POOL_H
@@ -0,0 +1,68 @@
+/*
+*   FILE          : presence.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for presence: who is online and who is typing.
+*      Every registered session holds a slot, and the table keeps one bit per
+*      slot for each state. Clients that ask for presence ("Presence") are sent
+*      one summary line, "Presence|<online>|<typing>|<name>,<name>...", naming
+*      at most kPresenceShownTypers of the users typing. Changes only mark the
+*      table; the main loop builds a new summary at most once per
+*      kPresenceIntervalMs, and only if it differs from the last one, however
+*      often clients say "Typing|1" and "Typing|0". Each summary replaces the
+*      whole state, so a newer one may replace an unsent older one.
+*/
+
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+// Include statements
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "pool.h"
+
+// Constants
+#define kPresenceTag "Presence"
+#define kTypingTag "Typing"
+#define kPresenceIntervalMs 500           // subscribers are sent at most one summary this often
+#define kPresenceTypingMs 6000            // typing that is not said again within this long ends by itself
+#define kPresenceShownTypers 4            // users typing that a summary names; the rest are only counted
+#define kPresenceNameLength 32            // longer user names are cut to this many characters - 1
+#define kPresenceLineSize (32 + kPresenceShownTypers * kPresenceNameLength)
+#define kPresenceCoalesceKey 1            // the ephemeral-lane key every summary is queued under
+
+// Data structures
+typedef struct PresenceTable
+{
+  pthread_mutex_t lock;
+  int capacity;                       // slots; 0 until presenceInit()
+  int wordCount;
+  uint64_t* online;                   // one bit per slot
+  uint64_t* typing;
+  uint64_t* typingUntilMs;            // per slot: when its typing ends unless it is said again
+  char (*names)[kPresenceNameLength];
+  int freeHint;                       // no free slot is in a word below this one
+  int onlineCount;
+  int typingCount;
+  bool changed;                       // since the last summary was built
+  uint64_t lastSummaryMs;
+  MessageBuffer* current;             // the last summary built; a new subscriber is sent it first
+  uint64_t summariesBuilt;
+  uint64_t typingChanges;
+} PresenceTable;
+
+
+//Function prototypes
+void presenceInit(PresenceTable* table, int capacity);
+int presenceJoin(PresenceTable* table, const char* userName);
+void presenceLeave(PresenceTable* table, int slot);
+void presenceSetTyping(PresenceTable* table, int slot, bool typing);
+MessageBuffer* presenceTakeSummary(PresenceTable* table);
+MessageBuffer* presenceCurrent(PresenceTable* table);
+void presencePrintStats(PresenceTable* table, FILE* stream);
+
+#endif //PRESENCE_H
@@ -0,0 +1,56 @@
+/*
+*   FILE          : protocol.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the wire protocol helpers: finding the next
+*      newline-terminated frame in a batch of input, splitting a message into its
+*      fields, cutting chat text into display-sized chunks and assembling output
+*      lines. Frames, fields and chunks are slices of the caller's buffer, which
+*      is never modified. An output line is the sender's prefix (built once per
+*      session), the text and a timestamp that is formatted at most once a
+*      second per thread, all joined with memcpy. The helpers touch no server
+*      state, so the benchmarks and fuzz targets link this file (and scan.c) on
+*      their own.
+*/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+// Include statements
+#include <stddef.h>
+#include <stdbool.h>
+
+// Constants
+#define kMessageDelimiter '|'
+#define kFrameDelimiter '\n'
+#define kMaxMessageParts 4            // command, then up to three fields; the last field keeps any further '|'
+#define kChunkTextLength 40           // characters of chat text per output line
+#define kMaxChunks 3                  // enough for the longest chat text the server keeps (kMaxMsgLength)
+#define kLineUserLength 5             // characters of the username shown in a line
+#define kLinePrefixSize 64            // "<ip> [<user>] << " for the longest IPv6 address, plus the NUL
+#define kTimestampLength 11           // " (HH:MM:SS)"
+#define kMaxLineLength (kLinePrefixSize + kChunkTextLength + kTimestampLength + 1)  // with the newline
+
+// Data structures
+typedef struct MessageSlice
+{
+  const char* text;                   // points into the caller's buffer, not NUL-terminated
+  size_t length;
+} MessageSlice;
+
+
+//Function prototypes
+size_t nextFrame(const char* data, size_t length, MessageSlice* frame);
+int parseMessage(const char* message, size_t length, MessageSlice messageParts[], int maxParts);
+int chunkMessage(const char* text, size_t textLength, MessageSlice chunks[], int maxChunks);
+bool sliceEquals(MessageSlice slice, const char* text);
+size_t sliceCopy(MessageSlice slice, char* destination, size_t destinationSize);
+size_t formatLinePrefix(char* prefix, size_t prefixSize, const char* ipAddress, const char* userName);
+size_t formatDirectPrefix(char* prefix, size_t prefixSize, const char* ipAddress, const char* userName);
+size_t assembleChatLine(char* line, size_t lineSize, MessageSlice prefix, MessageSlice text, MessageSlice timestamp);
+MessageSlice lineBody(const char* line, size_t length);
+MessageSlice lineTimestamp(void);
+
+#endif //PROTOCOL_H
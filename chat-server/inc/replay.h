@@ -0,0 +1,40 @@
+/*
+*   FILE          : replay.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the replay ring. Every broadcast gets the
+*      next sequence number and a reference in the ring, so a client that
+*      reconnects and says which sequence it saw last can be sent just the
+*      messages it missed. The ring keeps the last kReplayCapacity broadcasts;
+*      anything older has to be fetched some other way.
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// Include statements
+#include <stdint.h>
+#include "pool.h"
+
+// Constants
+#define kReplayCapacity 4096          // must be a power of two
+#define kSequenceTag "Seq"            // "Seq|<n>\n" follows each message sent to a resuming client
+
+// Data structures
+typedef struct ReplayRing
+{
+  MessageBuffer* entries[kReplayCapacity];  // entry for sequence n is at n & (kReplayCapacity - 1)
+  uint64_t lastSequence;                    // 0 before the first broadcast
+} ReplayRing;
+
+
+//Function prototypes
+void replayRingInit(ReplayRing* ring, uint64_t lastSequence);
+uint64_t replayRingAppend(ReplayRing* ring, MessageBuffer* lines);
+uint64_t replayRingOldest(const ReplayRing* ring);
+MessageBuffer* replayRingGet(const ReplayRing* ring, uint64_t sequence);
+MessageBuffer* makeSequenceLine(uint64_t sequence);
+
+#endif //REPLAY_H
@@ -0,0 +1,26 @@
+/*
+*   FILE          : scan.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the byte scanner used to find field
+*      delimiters and frame boundaries. On x86 it compares 32 (AVX2) or 16
+*      (SSE2) bytes per step; elsewhere it falls back to a plain loop. The
+*      implementation is picked once, at the first call, from what the CPU
+*      supports.
+*/
+
+#ifndef SCAN_H
+#define SCAN_H
+
+// Include statements
+#include <stddef.h>
+#include <stdbool.h>
+
+//Function prototypes
+size_t scanForByte(const char* data, size_t length, char target);
+const char* scanImplementationName(void);
+bool scanUseImplementation(const char* name);
+
+#endif //SCAN_H
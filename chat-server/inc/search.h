@@ -0,0 +1,105 @@
+/*
+*   FILE          : search.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for chat history search. Every broadcast is
+*      added to an inverted index as it goes out: its words map to posting
+*      lists of message numbers, stored as varint deltas with the word's count
+*      in the message, and the message's lines are kept so hits can be shown
+*      as they were first seen. A query scores each message that has any of
+*      its words (rarer words weigh more, newer messages win ties) and returns
+*      the best kSearchMaxHits. Adding takes the index's write lock and
+*      searching its read lock, so searches run alongside each other.
+*/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+// Include statements
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "pool.h"
+#include "protocol.h"
+
+// Constants
+#define kSearchMaxTerms 8                 // query words used; any after these are ignored
+#define kSearchMaxHits 10                 // messages returned per search
+#define kSearchTermLength 32              // longer words are indexed by their first kSearchTermLength bytes
+#define kSearchMinTermLength 2            // shorter words are not indexed
+#define kSearchTextSize 512               // message text indexed per broadcast
+#define kSearchBlockSize (1u << 20)       // the lines of indexed messages are stored in blocks this large
+#define kSearchMaxDocuments (1u << 24)    // indexing stops after this many messages
+#define kSearchSkipInterval 64            // postings between skip entries
+
+// Data structures
+typedef struct PostingSkip
+{
+  uint32_t document;                  // the last message before offset; decoding may resume from here
+  uint32_t offset;
+} PostingSkip;
+
+typedef struct PostingList
+{
+  uint8_t* data;                      // (message delta, count) varint pairs, messages in ascending order
+  uint32_t length;
+  uint32_t capacity;
+  uint32_t lastDocument;
+  uint32_t documentCount;
+  uint32_t maxCount;                  // the highest count in the list, which bounds the word's score
+  PostingSkip* skips;
+  uint32_t skipCount;
+  uint32_t skipCapacity;
+} PostingList;
+
+typedef struct SearchTerm
+{
+  uint32_t hash;                      // 0 when the slot is free
+  uint32_t nameOffset;                // into termNames
+  uint32_t nameLength;
+  PostingList postings;
+} SearchTerm;
+
+typedef struct SearchDocument
+{
+  const char* lines;                  // the broadcast's lines, in a text block
+  uint32_t length;
+} SearchDocument;
+
+typedef struct SearchBlock
+{
+  struct SearchBlock* next;
+  size_t used;
+  size_t capacity;
+  char data[];
+} SearchBlock;
+
+typedef struct SearchIndex
+{
+  pthread_rwlock_t lock;
+  SearchTerm* terms;                  // open addressing on the word's hash, at most 70% full
+  uint32_t termCapacity;              // a power of two
+  uint32_t termCount;
+  char* termNames;
+  size_t termNamesLength;
+  size_t termNamesCapacity;
+  SearchDocument* documents;          // message n is documents[n]; documents[0] is unused
+  uint32_t documentCount;
+  uint32_t documentCapacity;
+  SearchBlock* blocks;                // newest first
+  size_t postingBytes;
+  size_t textBytes;
+} SearchIndex;
+
+
+//Function prototypes
+void searchIndexInit(SearchIndex* index);
+bool searchIndexAdd(SearchIndex* index, const char* lines, size_t length);
+MessageBuffer* searchIndexQuery(SearchIndex* index, MessageSlice query);
+void searchIndexPrintStats(SearchIndex* index, FILE* stream);
+
+#endif //SEARCH_H
@@ -0,0 +1,63 @@
+/*
+*   FILE          : session-stats.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the per-session statistics shown by the
+*      admin socket. Every session owns one slot in a fixed table and keeps its
+*      counters there (bytes in and out, what is queued for it and since when,
+*      its last read). Writers of a slot are serialized by the session's queue
+*      lock and bump the slot's sequence number around each update; the admin
+*      dump reads the table without taking any lock and retries a slot whose
+*      sequence changed while it was being copied, so the broadcast path never
+*      waits for it.
+*/
+
+#ifndef SESSION_STATS_H
+#define SESSION_STATS_H
+
+// Include statements
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+
+// Constants
+#define kMaxSessionStats 4096             // sessions listed by the dump; later ones are only counted
+#define kSessionStatsNameLength 32        // longer user names are cut to this many characters - 1
+
+// Data structures
+typedef struct SessionSnapshot
+{
+  bool live;                          // false when the slot is free
+  int socket;
+  pid_t thread;                       // kernel id of the thread serving the session, 0 until it starts
+  char userName[kSessionStatsNameLength];
+  struct in_addr ipAddress;
+  uint64_t connectedNs;               // monotonic clock, like every time here
+  uint64_t lastReadNs;                // 0 before the first read
+  uint64_t bytesIn;
+  uint64_t bytesOut;
+  uint64_t queuedBytes;
+  uint64_t oldestQueuedNs;            // when the head of the queue was queued, 0 when nothing is queued
+} SessionSnapshot;
+
+typedef struct SessionStats
+{
+  _Alignas(64) atomic_uint sequence;  // odd while the slot is being written
+  atomic_bool claimed;
+  SessionSnapshot values;
+} SessionStats;
+
+
+//Function prototypes
+SessionStats* sessionStatsClaim(int socket, uint64_t connectedNs);
+void sessionStatsRelease(SessionStats* slot);
+void sessionStatsBeginWrite(SessionStats* slot);
+void sessionStatsEndWrite(SessionStats* slot);
+void sessionStatsPrint(FILE* stream, uint64_t nowNs);
+
+#endif //SESSION_STATS_H
@@ -0,0 +1,76 @@
+/*
+*   FILE          : shm-transport.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the shared-memory transport offered to clients
+*      on the same host. A client connected over the server's Unix socket sends
+*      "Shm" instead of "Hello"; the server replies with a memfd holding two
+*      single-producer/single-consumer rings and the two eventfds used to wake
+*      each side. After that, messages travel through the rings and the Unix
+*      socket is only kept open to notice when the client goes away. The reply
+*      is written to the socket directly, so the server only switches while
+*      nothing is queued for the client; otherwise it queues "ShmRefused" and
+*      the client stays on the socket. Asking before "Hello" always works.
+*/
+
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+// Include statements
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdalign.h>
+#include <sys/types.h>
+
+// Constants
+#define kShmMagic 0x43575453              // "CWTS"
+#define kShmRingCapacity (256 * 1024)     // bytes per direction, must be a power of two
+#define kShmRequest "Shm"
+#define kShmReply "ShmReady"
+#define kShmRefused "ShmRefused"
+
+// Data structures
+typedef struct ShmRing
+{
+  alignas(64) atomic_uint_fast64_t readPosition;
+  alignas(64) atomic_uint_fast64_t writePosition;
+  alignas(64) atomic_bool readerWaiting;   // reader is about to sleep on its eventfd
+  atomic_bool writerWaiting;               // writer found the ring full and sleeps on its eventfd
+} ShmRing;
+
+typedef struct ShmRegion
+{
+  uint32_t magic;
+  uint32_t ringCapacity;
+  ShmRing toServer;
+  ShmRing toClient;
+  // ring data follows: toServer bytes, then toClient bytes
+} ShmRegion;
+
+typedef struct ShmTransport
+{
+  ShmRegion* region;
+  size_t mappedBytes;
+  ShmRing* inbound;           // ring this side reads
+  ShmRing* outbound;          // ring this side writes
+  char* inboundData;
+  char* outboundData;
+  int ownEventFd;             // this side sleeps on it
+  int peerEventFd;            // signalled to wake the other side
+} ShmTransport;
+
+
+//Function prototypes
+ShmTransport* shmTransportCreate(int unixSocket);
+ShmTransport* shmTransportAttach(int unixSocket);
+ssize_t shmTransportSend(ShmTransport* transport, const void* data, size_t length);
+ssize_t shmTransportReceive(ShmTransport* transport, void* data, size_t capacity);
+bool shmTransportArmWait(ShmTransport* transport, bool wantToWrite);
+void shmTransportClearWakeup(ShmTransport* transport);
+void shmTransportDestroy(ShmTransport* transport);
+
+#endif //SHM_TRANSPORT_H
@@ -0,0 +1,53 @@
+/*
+*   FILE          : timing-wheel.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the hashed timing wheel that tracks per-session
+*      deadlines. Arming, re-arming and cancelling a timer are O(1), and the whole
+*      wheel is driven by a single timerfd no matter how many sessions exist.
+*/
+
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+// Include statements
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// Constants
+#define kWheelSlots 1024            // must be a power of two
+#define kWheelTickMs 100
+
+// Data structures
+typedef struct TimerEntry
+{
+  struct TimerEntry* next;
+  struct TimerEntry* prev;
+  uint64_t expiryTick;
+  bool armed;
+} TimerEntry;
+
+// Called for each expired entry with the wheel locked; returns the delay to re-arm with, or 0 to stay disarmed
+typedef uint64_t (*TimerCallback)(TimerEntry* entry);
+
+typedef struct TimingWheel
+{
+  TimerEntry slots[kWheelSlots];    // each slot is the sentinel of a circular list
+  uint64_t currentTick;
+  size_t armedCount;
+  int timerFd;
+  TimerCallback onExpiry;
+  pthread_mutex_t lock;
+} TimingWheel;
+
+
+//Function prototypes
+void timingWheelInit(TimingWheel* wheel, TimerCallback onExpiry);
+void timingWheelSchedule(TimingWheel* wheel, TimerEntry* entry, uint64_t delayMs);
+void timingWheelCancel(TimingWheel* wheel, TimerEntry* entry);
+void timingWheelAdvance(TimingWheel* wheel);
+
+#endif //TIMING_WHEEL_H
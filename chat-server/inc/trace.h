@@ -0,0 +1,92 @@
+/*
+*   FILE          : trace.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for per-message latency tracing. Every chat message
+*      is stamped with the monotonic clock as it moves through the server (read,
+*      parse, formatting, fan-out, and the write to each recipient). The time spent
+*      in each stage goes into a log2 histogram, and one message in every N also
+*      keeps its full set of stamps as a sampled trace.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Include statements
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// Constants
+#define kTraceBuckets 64              // bucket b holds durations in [2^(b-1), 2^b) ns; bucket 0 holds 0
+#define kTraceSampleSlots 64          // sampled traces kept, newest overwrite oldest
+#define kTraceMaxWrites 16            // recipient writes kept per sampled trace
+#define kTraceDefaultSampleEvery 64
+#define kTracePrintedSamples 8
+
+// Data structures
+typedef enum TraceStage
+{
+  kStageParse,          // read -> message parsed
+  kStageQueueWait,      // parsed -> a worker starts formatting
+  kStageFormat,         // formatting on the worker
+  kStageLockWait,       // waiting for clients_mutex on the message path
+  kStageHandBack,       // formatted -> the sender's thread picks the result up
+  kStageFanout,         // queueing the lines for every recipient, clients_mutex wait included
+  kStageSocketWait,     // queued for a recipient -> fully written to it
+  kStageEndToEnd,       // read -> fully written to a recipient
+  kTraceStageCount
+} TraceStage;
+
+typedef enum TraceMark
+{
+  kMarkRead,
+  kMarkParsed,
+  kMarkFormatStart,
+  kMarkFormatEnd,
+  kMarkHandedBack,
+  kMarkEnqueued,
+  kTraceMarkCount
+} TraceMark;
+
+// Stamps carried with one message through the pipeline
+typedef struct MessageStamps
+{
+  uint64_t traceId;                   // non-zero when this message is a sampled trace
+  uint64_t at[kTraceMarkCount];       // monotonic ns, indexed by TraceMark
+  uint64_t lockWaitNs;                // waiting for clients_mutex to queue the lines
+} MessageStamps;
+
+typedef struct TraceWrite
+{
+  int recipientSocket;
+  uint64_t atNs;
+} TraceWrite;
+
+typedef struct TraceSample
+{
+  _Atomic uint64_t traceId;
+  int senderSocket;
+  MessageStamps stamps;
+  atomic_int writeCount;
+  TraceWrite writes[kTraceMaxWrites];
+} TraceSample;
+
+
+//Function prototypes
+void traceInit(int sampleEvery);
+uint64_t traceNow(void);
+void traceRecord(TraceStage stage, uint64_t durationNs);
+void traceLockMutex(pthread_mutex_t* mutex);
+uint64_t traceTakeLockWait(void);
+uint64_t traceSampleBegin(void);
+void traceSampleStore(int senderSocket, const MessageStamps* stamps);
+void traceSampleMark(uint64_t traceId, TraceMark mark, uint64_t atNs);
+void traceSampleLockWait(uint64_t traceId, uint64_t waitedNs);
+void traceSampleWrite(uint64_t traceId, int recipientSocket, uint64_t atNs);
+void tracePrintStats(FILE* stream);
+
+#endif //TRACE_H
@@ -0,0 +1,48 @@
+/*
+*   FILE          : transport.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the transport interface: the handful of
+*      calls the session code makes on a client's socket and wakeup descriptor
+*      (read, write, make non-blocking, create, signal and close the wakeup,
+*      close). The server runs on the socket transport, which makes the system
+*      calls. The simulator in sim/ swaps in an in-memory one, so the same
+*      session, registry and broadcast code can serve virtual clients that have
+*      no descriptors at all. Sockets the kernel must handle itself (the
+*      listeners, sendfile(), zero-copy, shared memory, hot restart) do not go
+*      through it. Of those, two write to a session's socket: historyRangeSend()
+*      (sendfile()) and zeroCopySend() (sendmsg() with MSG_ZEROCOPY). So
+*      flushOutbound() uses sendfile() only while serverTransport is
+*      socketTransport, and otherwise copies the history out and sends it
+*      through send(). Zero-copy is set up only for sessions accepted from a
+*      real listener, never for one a replacement transport serves.
+*/
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+// Include statements
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+// Data structures
+typedef struct Transport
+{
+  const char* name;
+  bool (*setNonBlocking)(int socket);
+  ssize_t (*receive)(int socket, void* buffer, size_t length);                // as read()
+  ssize_t (*send)(int socket, const struct msghdr* message, int flags);       // as sendmsg()
+  int (*openWakeup)(void);                                                     // as eventfd(), -1 on failure
+  void (*wake)(int wakeupFd);
+  void (*close)(int fd);                                                       // a socket or a wakeup
+} Transport;
+
+extern const Transport socketTransport;
+extern const Transport* serverTransport;     // the transport sessions use; socketTransport unless replaced
+
+
+#endif //TRANSPORT_H
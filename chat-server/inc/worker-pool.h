@@ -0,0 +1,65 @@
+/*
+*   FILE          : worker-pool.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for the worker pool that runs CPU-heavy message
+*      processing off the client threads. Work is submitted through a bounded
+*      lock-free queue, and each finished item is handed back to the thread that
+*      submitted it through that thread's eventfd.
+*/
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+// Include statements
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdalign.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+// Constants
+#define kWorkerQueueCapacity 1024   // must be a power of two
+#define kMaxWorkerThreads 16
+#define kCacheLineSize 64
+
+// Data structures
+typedef struct WorkItem
+{
+  void (*run)(struct WorkItem* item);       // executed on a worker thread
+  void (*complete)(struct WorkItem* item);  // executed later on the submitting thread
+  struct WorkItem* next;                    // submitter's in-order list of outstanding items
+  atomic_bool done;
+  int ownerWakeupFd;                        // eventfd of the submitting thread
+  atomic_int* ownerSignalsInFlight;         // lets the owner wait until no worker still writes to its eventfd
+} WorkItem;
+
+typedef struct WorkQueueCell
+{
+  atomic_size_t sequence;
+  WorkItem* item;
+} WorkQueueCell;
+
+typedef struct WorkerPool
+{
+  WorkQueueCell cells[kWorkerQueueCapacity];
+  alignas(kCacheLineSize) atomic_size_t enqueuePosition;
+  alignas(kCacheLineSize) atomic_size_t dequeuePosition;
+  alignas(kCacheLineSize) sem_t itemsAvailable;
+  atomic_bool stopping;
+  int threadCount;
+  pthread_t threads[kMaxWorkerThreads];
+} WorkerPool;
+
+
+//Function prototypes
+void workerPoolInit(WorkerPool* pool, int threadCount);
+bool workerPoolSubmit(WorkerPool* pool, WorkItem* item);
+void workerPoolRunInline(WorkItem* item);
+void workerPoolShutdown(WorkerPool* pool);
+int workerPoolDefaultThreads(void);
+
+#endif //WORKER_POOL_H
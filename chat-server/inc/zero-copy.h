@@ -0,0 +1,56 @@
+/*
+*   FILE          : zero-copy.h
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This is the header file for zero-copy sends. With MSG_ZEROCOPY the
+*      kernel sends straight from the shared message buffer instead of copying
+*      it into the socket, so the buffer must stay untouched until the kernel
+*      reports, on the socket's error queue, that it is done with it. Each
+*      socket keeps the buffers of its unfinished sends, oldest first, with a
+*      reference on each; reaping the error queue drops those references. The
+*      pinning and the notifications cost more than a copy for small writes,
+*      so only writes above a threshold go this way.
+*/
+
+#ifndef ZERO_COPY_H
+#define ZERO_COPY_H
+
+// Include statements
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "pool.h"
+
+// Constants
+#define kZeroCopyMaxPending 64            // unfinished sends per socket; past this, writes are copied
+#define kZeroCopyDrainMs 200              // how long a closing session waits for its last completions
+
+// Data structures
+typedef struct ZeroCopyPending
+{
+  uint32_t id;                        // the kernel numbers a socket's zero-copy sends 0, 1, 2...
+  MessageBuffer* buffer;              // holds a reference until the send completes
+} ZeroCopyPending;
+
+typedef struct ZeroCopyState
+{
+  bool enabled;                       // SO_ZEROCOPY is set and the kernel has not fallen back to copying
+  uint32_t nextId;
+  int pendingHead;                    // oldest unfinished send
+  int pendingCount;
+  ZeroCopyPending pending[kZeroCopyMaxPending];
+} ZeroCopyState;
+
+
+//Function prototypes
+ZeroCopyState* zeroCopyCreate(int socket);
+ssize_t zeroCopySend(ZeroCopyState* state, int socket, const struct msghdr* message, MessageBuffer* buffer);
+void zeroCopyReap(ZeroCopyState* state, int socket);
+void zeroCopyDestroy(ZeroCopyState* state, int socket);
+void zeroCopyPrintStats(FILE* stream);
+
+#endif //ZERO_COPY_H
@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+#   FILE          : run-local-cluster.sh
+#   PROJECT       : chat-system - A4
+#   PROGRAMMER    : Valentyn, Juan Jose, Warren, Ahmed
+#   FIRST VERSION : 03/30/2025
+#   DESCRIPTION   :
+#      Starts a full-mesh cluster of chat-server nodes on localhost for testing.
+#      Node N takes clients on port 13000+N and peers on port 14000+N.
+#      Usage: ./scripts/run-local-cluster.sh [number-of-nodes]   (default 3)
+#      Connect with: ./bin/chat-client -user <name> -server 127.0.0.1 -port 1300N
+#
+
+NODES=${1:-3}
+SERVER=${SERVER:-./bin/chat-server}
+
+trap 'kill $(jobs -p) 2>/dev/null' INT TERM EXIT
+
+n=0
+while [ $n -lt $NODES ]; do
+  PEERS=""
+  m=0
+  while [ $m -lt $NODES ]; do
+    if [ $m -ne $n ]; then
+      PEERS="$PEERS -peer 127.0.0.1:$((14000 + m))"
+    fi
+    m=$((m + 1))
+  done
+  $SERVER -port $((13000 + n)) -node $n -cluster-port $((14000 + n)) $PEERS &
+  n=$((n + 1))
+done
+
+wait
@@ -0,0 +1,799 @@
+/*
+*   FILE          : sim-chat.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      Deterministic scale test for the session, registry and broadcast code.
+*      The server's own functions (receiveInput(), flushOutbound(), addClient,
+*      broadcastMessage, removeClient...) serve up to millions of virtual
+*      clients through an in-memory transport, driven by a single-threaded
+*      discrete-event loop on a virtual clock. Every client gets a seeded
+*      link latency and read rate, some are slow readers, and each link holds
+*      only a window of unread bytes, so a slow reader pushes back exactly as
+*      a full socket does. The schedule (who connects when, who talks, sends
+*      direct messages or leaves) comes from the seed alone, and the formatting
+*      workers run inline, so a run is repeatable: the same seed prints the
+*      same digest. The run then checks that every client that stayed got
+*      every broadcast, that the observers (early, fast clients) all saw the
+*      same stream, and that nothing is left queued. The default of 100000
+*      clients takes a few seconds; "-clients 1000000" is the full-scale run
+*      and takes about half a minute.
+*/
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include "../inc/chat-server.h"
+
+#define kSimSocketBase (1 << 24)        // virtual descriptors, far above any real one
+#define kSimWakeupBase (1 << 27)
+#define kSimObservers 64
+#define kSimLatencyBuckets 100000       // 1 ms each; later deliveries land in the last one
+#define kSimConnectSpanUs 1000000ULL    // every client connects within the first virtual second
+
+// Data structures
+typedef enum SimEventType
+{
+  kSimConnect,
+  kSimHello,
+  kSimMessage,
+  kSimDirect,
+  kSimBye,
+  kSimWritable,
+} SimEventType;
+
+typedef struct SimEvent
+{
+  uint64_t timeUs;
+  uint64_t order;                       // breaks ties in the order events were scheduled
+  uint32_t client;
+  uint32_t argument;                    // message number or direct message recipient
+  SimEventType type;
+} SimEvent;
+
+typedef struct VirtualClient
+{
+  ClientInfo* session;                  // NULL before connecting and after leaving
+  uint32_t latencyUs;                   // one way, both directions
+  uint32_t rate;                        // bytes per virtual second the client reads
+  uint64_t busyUntilUs;                 // when the link will have drained everything it accepted so far
+  uint64_t digest;                      // FNV-1a of every byte received outside "(...)" timestamps
+  uint64_t stampUs;                     // send time being parsed from the current line
+  uint32_t broadcastLines;              // lines carrying a send time, i.e. broadcasts
+  uint32_t nextReady;
+  bool ready;
+  bool writableScheduled;
+  bool inTimestamp;
+  bool inStamp;
+  bool haveStamp;
+  bool slow;
+  bool talker;
+  bool leaver;
+} VirtualClient;
+
+typedef struct SimConfig
+{
+  int clients;
+  int messages;
+  int directs;
+  int leavers;
+  double slowFraction;
+  uint32_t latencyMinUs;
+  uint32_t latencyMaxUs;
+  uint32_t fastRate;
+  uint32_t slowRate;
+  uint32_t window;                      // unread bytes a link holds before sends fail with EAGAIN
+  uint64_t seed;
+} SimConfig;
+
+static SimConfig config = {100000, 16, 100, 100, 0.01, 1000, 50000, 10000000, 200, 256, 1};
+static VirtualClient* virtualClients;
+static SimEvent* events;
+static size_t eventCount;
+static size_t eventCapacity;
+static uint64_t eventOrder;
+static uint64_t nowUs;
+static uint64_t randomState;
+static uint32_t readyHead = UINT32_MAX;
+static uint32_t readyTail = UINT32_MAX;
+static uint32_t creatingClient;
+static int inputSocket = -1;            // the client whose line is being delivered, and the line
+static char inputLine[kMaxMsgLength + 64];
+static size_t inputLength;
+static uint64_t latencyCounts[2][kSimLatencyBuckets];
+static uint64_t bytesDelivered;
+static uint64_t sendsRefused;
+static uint64_t sendsCut;
+static uint64_t eventsRun;
+
+static bool simSetNonBlocking(int socket);
+static ssize_t simReceive(int socket, void* buffer, size_t length);
+static ssize_t simSend(int socket, const struct msghdr* message, int flags);
+static int simOpenWakeup(void);
+static void simWake(int wakeupFd);
+static void simClose(int fd);
+
+static const Transport simTransport = {"simulated", simSetNonBlocking, simReceive, simSend, simOpenWakeup, simWake,
+                                       simClose};
+
+static void parseArguments(int argc, char* argv[]);
+static void setUpClients(void);
+static void runEvent(const SimEvent* event);
+static void deliverLine(uint32_t index, const char* format, ...);
+static void endSession(uint32_t index);
+static void flushReadyClients(void);
+static void readBytes(VirtualClient* client, const char* data, size_t length, uint64_t readUs);
+static void schedule(uint64_t timeUs, SimEventType type, uint32_t client, uint32_t argument);
+static SimEvent nextEvent(void);
+static bool eventBefore(const SimEvent* a, const SimEvent* b);
+static uint32_t pickClient(bool (*eligible)(const VirtualClient*));
+static bool isOrdinary(const VirtualClient* client);
+static bool isAnyone(const VirtualClient* client);
+static uint64_t nextRandom(void);
+static uint64_t percentile(const uint64_t counts[], double fraction);
+static uint64_t wallNs(void);
+
+int main(int argc, char* argv[])
+{
+  parseArguments(argc, argv);
+  randomState = config.seed * 0x9E3779B97F4A7C15ULL + 1;
+  uint64_t wallStart = wallNs();
+
+  /* The server's state, set up as main() does, minus threads, listeners and disk */
+  serverTransport = &simTransport;
+  poolInit(&sessionPool, "session", sizeof(ClientInfo));
+  poolInit(&outboundQueuePool, "queue", sizeof(OutboundQueue));
+  poolInit(&inputBufferPool, "input", kInputBufferSize);
+  poolInit(&outboundNodePool, "queue-node", sizeof(OutboundNode));
+  poolInit(&broadcastJobPool, "job", sizeof(BroadcastJob));
+  messageBufferPoolsInit();
+  clientsListInit(&activeClients, config.clients);
+  replayRingInit(&chatReplay, 0);
+  mailboxInit(&offlineMail);
+  chatHistory.failed = true;
+  searchIndexInit(&chatSearch);
+  traceInit(0);
+  timingWheelInit(&idleWheel, onSessionTimeout);
+
+  setUpClients();
+  while (eventCount > 0)
+  {
+    SimEvent event = nextEvent();
+    nowUs = event.timeUs;
+    runEvent(&event);
+    flushReadyClients();
+    eventsRun++;
+  }
+
+  /* Every client still here must have been sent every broadcast, and the observers the same bytes */
+  int failures = 0;
+  int slowClients = 0;
+  uint64_t digest = 14695981039346656037ULL;
+  uint64_t lastReadUs = 0;
+  for (int i = 0; i < config.clients; i++)
+  {
+    VirtualClient* client = &virtualClients[i];
+    digest = (digest ^ client->digest ^ client->broadcastLines) * 1099511628211ULL;
+    uint64_t readUs = client->busyUntilUs + client->latencyUs;
+    lastReadUs = readUs > lastReadUs ? readUs : lastReadUs;
+    slowClients += client->slow;
+    if (client->leaver)
+    {
+      continue;
+    }
+    if (client->broadcastLines != (uint32_t)config.messages || client->session->queue->queuedBytes != 0)
+    {
+      if (failures++ < 10)
+      {
+        fprintf(stderr, "client %d: %u of %d broadcasts, queue %s\n", i, client->broadcastLines, config.messages,
+                client->session->queue->queuedBytes != 0 ? "not empty" : "empty");
+      }
+    }
+    if (i < kSimObservers && client->digest != virtualClients[0].digest)
+    {
+      if (failures++ < 10)
+      {
+        fprintf(stderr, "observer %d saw a different stream than observer 0\n", i);
+      }
+    }
+  }
+
+  printf("%d clients (%d slow), %d broadcasts, %d direct messages, %d leavers, seed %llu\n", config.clients,
+         slowClients, config.messages, config.directs, config.leavers,
+         (unsigned long long)config.seed);
+  printf("%llu events, %llu bytes delivered, %llu sends cut short and %llu refused by a full window, "
+         "last read at %.3f s\n", (unsigned long long)eventsRun, (unsigned long long)bytesDelivered,
+         (unsigned long long)sendsCut, (unsigned long long)sendsRefused, lastReadUs / 1e6);
+  for (int slow = 0; slow < 2; slow++)
+  {
+    printf("%s readers: broadcast delivery p50 %llu ms, p99 %llu ms, max %llu ms\n", slow ? "slow" : "fast",
+           (unsigned long long)percentile(latencyCounts[slow], 0.50),
+           (unsigned long long)percentile(latencyCounts[slow], 0.99),
+           (unsigned long long)percentile(latencyCounts[slow], 1.0));
+  }
+  printf("digest %016llx\n", (unsigned long long)digest);
+  printf("%s (%.2f s wall)\n", failures == 0 ? "PASS" : "FAIL", (wallNs() - wallStart) / 1e9);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *  Function  : parseArguments()
+ *  Summary   : This function reads the command-line options into the configuration.
+ *  Params    : int argc
+ *              char* argv[]
+ *  Return    : void
+ */
+static void parseArguments(int argc, char* argv[])
+{
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-clients") == 0 && i + 1 < argc)
+    {
+      config.clients = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-messages") == 0 && i + 1 < argc)
+    {
+      config.messages = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-directs") == 0 && i + 1 < argc)
+    {
+      config.directs = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-leavers") == 0 && i + 1 < argc)
+    {
+      config.leavers = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-slow") == 0 && i + 1 < argc)
+    {
+      config.slowFraction = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-latency") == 0 && i + 1 < argc &&
+             sscanf(argv[i + 1], "%u:%u", &config.latencyMinUs, &config.latencyMaxUs) == 2)
+    {
+      config.latencyMinUs *= 1000;
+      config.latencyMaxUs *= 1000;
+      i++;
+    }
+    else if (strcmp(argv[i], "-window") == 0 && i + 1 < argc)
+    {
+      config.window = strtoul(argv[++i], NULL, 10);
+    }
+    else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+    {
+      config.seed = strtoull(argv[++i], NULL, 10);
+    }
+    else
+    {
+      fprintf(stderr, "Usage: %s [-clients <n>] [-messages <n>] [-directs <n>] [-leavers <n>] [-slow <fraction>] "
+              "[-latency <min ms>:<max ms>] [-window <bytes>] [-seed <n>]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (config.clients < kSimObservers + config.leavers + config.messages + 1 || config.window == 0 ||
+      config.latencyMaxUs < config.latencyMinUs)
+  {
+    fprintf(stderr, "need more clients than observers, leavers and talkers, a window, and min <= max latency\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*
+ *  Function  : setUpClients()
+ *  Summary   : This function draws every client's link and role and schedules the whole run: connections
+ *              in the first virtual second, then broadcasts, direct messages and departures spread over the
+ *              next one. Observers connect first and only listen.
+ *  Params    : void
+ *  Return    : void
+ */
+static void setUpClients(void)
+{
+  virtualClients = calloc(config.clients, sizeof(*virtualClients));
+  if (virtualClients == NULL)
+  {
+    displayFatalError("calloc() FAILED");
+  }
+  for (int i = 0; i < config.clients; i++)
+  {
+    VirtualClient* client = &virtualClients[i];
+    client->latencyUs = config.latencyMinUs + nextRandom() % (config.latencyMaxUs - config.latencyMinUs + 1);
+    client->slow = (i >= kSimObservers) && (nextRandom() % 1000000) < config.slowFraction * 1000000;
+    client->rate = client->slow ? config.slowRate : config.fastRate;
+    client->digest = 14695981039346656037ULL;
+    schedule(i < kSimObservers ? 0 : nextRandom() % kSimConnectSpanUs, kSimConnect, i, 0);
+  }
+
+  /* Talk only once everyone has said Hello, so every broadcast has the same audience minus leavers */
+  uint64_t talkStartUs = kSimConnectSpanUs + 2 * config.latencyMaxUs;
+  for (int i = 0; i < config.leavers; i++)
+  {
+    uint32_t leaver = pickClient(isOrdinary);
+    virtualClients[leaver].leaver = true;
+    schedule(talkStartUs + nextRandom() % kSimConnectSpanUs, kSimBye, leaver, 0);
+  }
+  for (int i = 0; i < config.messages; i++)
+  {
+    uint32_t talker = pickClient(isOrdinary);
+    virtualClients[talker].talker = true;
+    schedule(talkStartUs + nextRandom() % kSimConnectSpanUs, kSimMessage, talker, i);
+  }
+  for (int i = 0; i < config.directs; i++)
+  {
+    uint32_t sender = pickClient(isOrdinary);
+    schedule(talkStartUs + nextRandom() % kSimConnectSpanUs, kSimDirect, sender, pickClient(isAnyone));
+  }
+}
+
+/*
+ *  Function  : runEvent()
+ *  Summary   : This function carries out one event. Lines a client sends reach the server one link latency
+ *              later, through receiveInput(), as they would from a socket.
+ *  Params    : const SimEvent* event
+ *  Return    : void
+ */
+static void runEvent(const SimEvent* event)
+{
+  uint32_t index = event->client;
+  VirtualClient* client = &virtualClients[index];
+  switch (event->type)
+  {
+    case kSimConnect:
+      creatingClient = index;
+      if ((client->session = createSession(kSimSocketBase + index)) == NULL)
+      {
+        displayFatalError("createSession() FAILED");
+      }
+      schedule(nowUs + client->latencyUs, kSimHello, index, 0);
+      break;
+    case kSimHello:
+      deliverLine(index, "Hello|c%u|10.%u.%u.%u\n", index, index >> 16 & 255, index >> 8 & 255, index & 255);
+      break;
+    case kSimMessage:
+      /* The send time rides in the text, so each reader can tell how long delivery took */
+      deliverLine(index, "Message|s%u#%u@%llu\n", index, event->argument,
+                  (unsigned long long)(nowUs - client->latencyUs));
+      break;
+    case kSimDirect:
+      deliverLine(index, "Direct|c%u|hi from c%u\n", event->argument, index);
+      break;
+    case kSimBye:
+      deliverLine(index, ">>bye<<\n");
+      break;
+    case kSimWritable:
+      client->writableScheduled = false;
+      simWake(kSimWakeupBase + index);
+      break;
+  }
+}
+
+/*
+ *  Function  : deliverLine()
+ *  Summary   : This function hands one line from a client to the server's input path. A client whose line
+ *              ends its session is torn down the way a session thread does it.
+ *  Params    : uint32_t index
+ *              const char* format - printf-style
+ *  Return    : void
+ */
+static void deliverLine(uint32_t index, const char* format, ...)
+{
+  VirtualClient* client = &virtualClients[index];
+  if (client->session == NULL)
+  {
+    return;
+  }
+  va_list arguments;
+  va_start(arguments, format);
+  inputLength = vsnprintf(inputLine, sizeof(inputLine), format, arguments);
+  va_end(arguments);
+
+  inputSocket = kSimSocketBase + index;
+  bool connected = receiveInput(client->session);
+  inputSocket = -1;
+  if (!connected)
+  {
+    endSession(index);
+  }
+}
+
+/*
+ *  Function  : endSession()
+ *  Summary   : This function drops a leaving client: what is still queued for it is discarded.
+ *  Params    : uint32_t index
+ *  Return    : void
+ */
+static void endSession(uint32_t index)
+{
+  VirtualClient* client = &virtualClients[index];
+  waitForCompletions(client->session);
+  removeClient(client->session->clientSocket);
+  destroySession(client->session);
+  client->session = NULL;
+}
+
+/*
+ *  Function  : flushReadyClients()
+ *  Summary   : This function does what each woken session thread would: write out its queue. A client whose
+ *              window is full is retried once its reader has made room for half a window.
+ *  Params    : void
+ *  Return    : void
+ */
+static void flushReadyClients(void)
+{
+  while (readyHead != UINT32_MAX)
+  {
+    uint32_t index = readyHead;
+    VirtualClient* client = &virtualClients[index];
+    readyHead = client->nextReady;
+    if (readyHead == UINT32_MAX)
+    {
+      readyTail = UINT32_MAX;
+    }
+    client->ready = false;
+    if (client->session == NULL)
+    {
+      continue;
+    }
+
+    int result = flushOutbound(client->session);
+    if (result < 0)
+    {
+      endSession(index);
+    }
+    else if (result > 0 && !client->writableScheduled)
+    {
+      uint64_t drainUs = (uint64_t)config.window / 2 * 1000000 / client->rate;
+      uint64_t retryUs = client->busyUntilUs > nowUs + drainUs ? client->busyUntilUs - drainUs : nowUs + 1;
+      client->writableScheduled = true;
+      schedule(retryUs, kSimWritable, index, 0);
+    }
+  }
+}
+
+/*
+ *  Function  : simSend()
+ *  Summary   : This function is the in-memory sendmsg(). The link takes as much as fits in the client's
+ *              window, which counts the bytes accepted that have not yet drained toward the client at its
+ *              read rate; each byte reaches the client one latency after it drains.
+ *  Params    : int socket
+ *              const struct msghdr* message
+ *              int flags - ignored
+ *  Return    : ssize_t - bytes taken, or -1 with errno EAGAIN when the window is full
+ */
+static ssize_t simSend(int socket, const struct msghdr* message, int flags)
+{
+  (void)flags;
+  VirtualClient* client = &virtualClients[socket - kSimSocketBase];
+  uint64_t unread = (client->busyUntilUs > nowUs) ? (client->busyUntilUs - nowUs) * client->rate / 1000000 : 0;
+  if (unread >= config.window)
+  {
+    sendsRefused++;
+    errno = EAGAIN;
+    return -1;
+  }
+
+  size_t room = config.window - unread;
+  size_t offered = 0;
+  for (size_t i = 0; i < message->msg_iovlen; i++)
+  {
+    offered += message->msg_iov[i].iov_len;
+  }
+  size_t taken = (offered < room) ? offered : room;
+  sendsCut += (taken < offered);
+  uint64_t startUs = (nowUs > client->busyUntilUs) ? nowUs : client->busyUntilUs;
+  client->busyUntilUs = startUs + (taken * 1000000 + client->rate - 1) / client->rate;
+
+  size_t left = taken;
+  for (size_t i = 0; i < message->msg_iovlen && left > 0; i++)
+  {
+    size_t length = (message->msg_iov[i].iov_len < left) ? message->msg_iov[i].iov_len : left;
+    readBytes(client, message->msg_iov[i].iov_base, length, client->busyUntilUs + client->latencyUs);
+    left -= length;
+  }
+  bytesDelivered += taken;
+  return taken;
+}
+
+/*
+ *  Function  : readBytes()
+ *  Summary   : This function is the virtual client reading what it was sent: it hashes the bytes, leaving
+ *              out the wall-clock timestamps the server puts in "(...)", and times every broadcast line by
+ *              the send time written in it.
+ *  Params    : VirtualClient* client
+ *              const char* data
+ *              size_t length
+ *              uint64_t readUs - when the client has read these bytes
+ *  Return    : void
+ */
+static void readBytes(VirtualClient* client, const char* data, size_t length, uint64_t readUs)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    char c = data[i];
+    if (client->inStamp && c >= '0' && c <= '9')
+    {
+      client->stampUs = client->stampUs * 10 + (c - '0');
+    }
+    else
+    {
+      client->inStamp = false;
+    }
+    if (c == '@')
+    {
+      client->inStamp = true;
+      client->haveStamp = true;
+      client->stampUs = 0;
+    }
+    else if (c == '(')
+    {
+      client->inTimestamp = true;
+    }
+    else if (c == ')')
+    {
+      client->inTimestamp = false;
+    }
+    else if (c == '\n' && client->haveStamp)
+    {
+      uint64_t latencyMs = (readUs - client->stampUs) / 1000;
+      latencyCounts[client->slow][latencyMs < kSimLatencyBuckets ? latencyMs : kSimLatencyBuckets - 1]++;
+      client->broadcastLines++;
+      client->haveStamp = false;
+    }
+    if (!client->inTimestamp)
+    {
+      client->digest = (client->digest ^ (uint8_t)c) * 1099511628211ULL;
+    }
+  }
+}
+
+/*
+ *  Function  : simReceive()
+ *  Summary   : This function is the in-memory read(): it returns the line being delivered to this client.
+ *  Params    : int socket
+ *              void* buffer
+ *              size_t length
+ *  Return    : ssize_t - bytes copied, or -1 with errno EAGAIN when nothing was sent
+ */
+static ssize_t simReceive(int socket, void* buffer, size_t length)
+{
+  if (socket != inputSocket || inputLength == 0)
+  {
+    errno = EAGAIN;
+    return -1;
+  }
+  size_t copied = (inputLength < length) ? inputLength : length;
+  memcpy(buffer, inputLine, copied);
+  inputLength = 0;
+  return copied;
+}
+
+/*
+ *  Function  : simSetNonBlocking()
+ *  Summary   : This function accepts any virtual socket; they never block.
+ *  Params    : int socket
+ *  Return    : bool
+ */
+static bool simSetNonBlocking(int socket)
+{
+  (void)socket;
+  return true;
+}
+
+/*
+ *  Function  : simOpenWakeup()
+ *  Summary   : This function gives the session being created a virtual wakeup descriptor that names it.
+ *  Params    : void
+ *  Return    : int
+ */
+static int simOpenWakeup(void)
+{
+  return kSimWakeupBase + creatingClient;
+}
+
+/*
+ *  Function  : simWake()
+ *  Summary   : This function puts a client on the ready list, once, in the order it was woken.
+ *  Params    : int wakeupFd
+ *  Return    : void
+ */
+static void simWake(int wakeupFd)
+{
+  uint32_t index = wakeupFd - kSimWakeupBase;
+  VirtualClient* client = &virtualClients[index];
+  if (client->ready)
+  {
+    return;
+  }
+  client->ready = true;
+  client->nextReady = UINT32_MAX;
+  if (readyTail == UINT32_MAX)
+  {
+    readyHead = index;
+  }
+  else
+  {
+    virtualClients[readyTail].nextReady = index;
+  }
+  readyTail = index;
+}
+
+/*
+ *  Function  : simClose()
+ *  Summary   : This function closes a virtual descriptor, which needs nothing.
+ *  Params    : int fd
+ *  Return    : void
+ */
+static void simClose(int fd)
+{
+  (void)fd;
+}
+
+/*
+ *  Function  : schedule()
+ *  Summary   : This function adds an event to the binary heap ordered by time, then scheduling order.
+ *  Params    : uint64_t timeUs
+ *              SimEventType type
+ *              uint32_t client
+ *              uint32_t argument
+ *  Return    : void
+ */
+static void schedule(uint64_t timeUs, SimEventType type, uint32_t client, uint32_t argument)
+{
+  if (eventCount == eventCapacity)
+  {
+    eventCapacity = eventCapacity ? eventCapacity * 2 : 1024;
+    if ((events = realloc(events, eventCapacity * sizeof(*events))) == NULL)
+    {
+      displayFatalError("realloc() FAILED");
+    }
+  }
+  SimEvent event = {timeUs, eventOrder++, client, argument, type};
+  size_t position = eventCount++;
+  while (position > 0 && eventBefore(&event, &events[(position - 1) / 2]))
+  {
+    events[position] = events[(position - 1) / 2];
+    position = (position - 1) / 2;
+  }
+  events[position] = event;
+}
+
+/*
+ *  Function  : nextEvent()
+ *  Summary   : This function removes the earliest event from the heap.
+ *  Params    : void
+ *  Return    : SimEvent
+ */
+static SimEvent nextEvent(void)
+{
+  SimEvent first = events[0];
+  SimEvent last = events[--eventCount];
+  size_t position = 0;
+  while (true)
+  {
+    size_t child = position * 2 + 1;
+    if (child >= eventCount)
+    {
+      break;
+    }
+    if (child + 1 < eventCount && eventBefore(&events[child + 1], &events[child]))
+    {
+      child++;
+    }
+    if (!eventBefore(&events[child], &last))
+    {
+      break;
+    }
+    events[position] = events[child];
+    position = child;
+  }
+  if (eventCount > 0)
+  {
+    events[position] = last;
+  }
+  return first;
+}
+
+/*
+ *  Function  : eventBefore()
+ *  Summary   : This function orders two events.
+ *  Params    : const SimEvent* a
+ *              const SimEvent* b
+ *  Return    : bool
+ */
+static bool eventBefore(const SimEvent* a, const SimEvent* b)
+{
+  return a->timeUs < b->timeUs || (a->timeUs == b->timeUs && a->order < b->order);
+}
+
+/*
+ *  Function  : pickClient()
+ *  Summary   : This function draws a random client, other than an observer, that passes the given test.
+ *  Params    : bool (*eligible)(const VirtualClient*)
+ *  Return    : uint32_t
+ */
+static uint32_t pickClient(bool (*eligible)(const VirtualClient*))
+{
+  while (true)
+  {
+    uint32_t index = nextRandom() % config.clients;
+    if (index >= kSimObservers && eligible(&virtualClients[index]))
+    {
+      return index;
+    }
+  }
+}
+
+/*
+ *  Function  : isOrdinary()
+ *  Summary   : This function accepts a client that has no role yet.
+ *  Params    : const VirtualClient* client
+ *  Return    : bool
+ */
+static bool isOrdinary(const VirtualClient* client)
+{
+  return !client->talker && !client->leaver;
+}
+
+/*
+ *  Function  : isAnyone()
+ *  Summary   : This function accepts every client, for the recipient of a direct message.
+ *  Params    : const VirtualClient* client
+ *  Return    : bool
+ */
+static bool isAnyone(const VirtualClient* client)
+{
+  (void)client;
+  return true;
+}
+
+/*
+ *  Function  : nextRandom()
+ *  Summary   : This function steps the seeded xorshift generator.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+static uint64_t nextRandom(void)
+{
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 7;
+  randomState ^= randomState << 17;
+  return randomState;
+}
+
+/*
+ *  Function  : percentile()
+ *  Summary   : This function finds the bucket (in ms) below which the given fraction of samples fall.
+ *  Params    : const uint64_t counts[]
+ *              double fraction
+ *  Return    : uint64_t
+ */
+static uint64_t percentile(const uint64_t counts[], double fraction)
+{
+  uint64_t total = 0;
+  for (int i = 0; i < kSimLatencyBuckets; i++)
+  {
+    total += counts[i];
+  }
+  uint64_t wanted = (uint64_t)(total * fraction);
+  uint64_t seen = 0;
+  for (int i = 0; i < kSimLatencyBuckets; i++)
+  {
+    seen += counts[i];
+    if (seen >= wanted && counts[i] > 0)
+    {
+      return i;
+    }
+  }
+  return 0;
+}
+
+/*
+ *  Function  : wallNs()
+ *  Summary   : This function reads the monotonic clock, for the run's real duration only.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+static uint64_t wallNs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
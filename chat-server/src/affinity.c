@@ -0,0 +1,512 @@
+/*
+*   FILE          : affinity.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file places the server's threads on cores. The NUMA layout is read
+*      from /sys and the NIC's interrupt placement from /proc, so no extra
+*      library is needed. Client threads are spread round-robin over the network
+*      cores one core each, and a thread whose cores all sit on one node binds its
+*      stack (and everything it allocates afterwards) to that node. With nothing
+*      configured every call here is a no-op and threads float as before.
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "../inc/affinity.h"
+
+#define kNodeMaskWords ((kMaxNumaNodes + 63) / 64)
+#define kCpuListTextLength 4096
+#define kProcPathLength 64
+
+static CpuList networkCpus;
+static CpuList workerCpus;
+static CpuList nicCpus;
+static int cpuNode[kMaxCpus];
+static int nodeCount = 0;
+static int nicIrqCount = 0;
+static char nicName[kNicNameLength] = "";
+static atomic_uint nextNetworkSlot;
+static cpu_set_t allowedCpus;
+
+static int compareCpus(const void* left, const void* right);
+static bool readCpuListFile(const char* path, CpuList* list);
+static void formatCpuList(const CpuList* list, char* text, size_t textSize);
+static void discoverNodes(void);
+static void discoverNicIrqs(const char* name);
+static void dropUnavailableCpus(CpuList* list, const char* role);
+static void describeThreads(FILE* stream, const char* role, const CpuList* list);
+
+/*
+ *  Function  : affinityParseCpuList()
+ *  Summary   : This function parses a list such as "0-3,8,10-11" into sorted, distinct CPU numbers.
+ *  Params    : const char* text
+ *              CpuList* list
+ *  Return    : bool - false when the text is malformed or names a CPU beyond kMaxCpus
+ */
+bool affinityParseCpuList(const char* text, CpuList* list)
+{
+  bool seen[kMaxCpus] = {};
+  list->count = 0;
+
+  const char* cursor = text;
+  while (*cursor != '\0' && *cursor != '\n')
+  {
+    char* end;
+    long first = strtol(cursor, &end, 10);
+    if (end == cursor || first < 0 || first >= kMaxCpus)
+    {
+      return false;
+    }
+    long last = first;
+    cursor = end;
+    if (*cursor == '-')
+    {
+      cursor++;
+      last = strtol(cursor, &end, 10);
+      if (end == cursor || last < first || last >= kMaxCpus)
+      {
+        return false;
+      }
+      cursor = end;
+    }
+    for (long cpu = first; cpu <= last; cpu++)
+    {
+      if (!seen[cpu])
+      {
+        seen[cpu] = true;
+        list->cpus[list->count++] = (int)cpu;
+      }
+    }
+    if (*cursor == ',')
+    {
+      cursor++;
+    }
+    else if (*cursor != '\0' && *cursor != '\n')
+    {
+      return false;
+    }
+  }
+
+  qsort(list->cpus, list->count, sizeof(list->cpus[0]), compareCpus);
+  return true;
+}
+
+/*
+ *  Function  : affinityInit()
+ *  Summary   : This function reads the machine's topology, settles which cores network and worker threads
+ *              run on, and prints the result. Without an explicit network list, the cores that service the
+ *              NIC's interrupts are used, so a client thread runs where its packets arrive.
+ *  Params    : const char* networkList - NULL to leave network threads unpinned
+ *              const char* workerList - NULL to leave worker threads unpinned
+ *              const char* nic - interface name, or NULL
+ *  Return    : void
+ */
+void affinityInit(const char* networkList, const char* workerList, const char* nic)
+{
+  CPU_ZERO(&allowedCpus);
+  if (sched_getaffinity(0, sizeof(allowedCpus), &allowedCpus) < 0)
+  {
+    perror("sched_getaffinity() FAILED");
+    exit(EXIT_FAILURE);
+  }
+  discoverNodes();
+
+  if (networkList != NULL && !affinityParseCpuList(networkList, &networkCpus))
+  {
+    fprintf(stderr, "Invalid CPU list for -cpus: %s\n", networkList);
+    exit(EXIT_FAILURE);
+  }
+  if (workerList != NULL && !affinityParseCpuList(workerList, &workerCpus))
+  {
+    fprintf(stderr, "Invalid CPU list for -worker-cpus: %s\n", workerList);
+    exit(EXIT_FAILURE);
+  }
+  if (nic != NULL)
+  {
+    strncpy(nicName, nic, sizeof(nicName) - 1);
+    discoverNicIrqs(nicName);
+    if (networkList == NULL)
+    {
+      networkCpus = nicCpus;
+    }
+  }
+
+  dropUnavailableCpus(&networkCpus, "network");
+  dropUnavailableCpus(&workerCpus, "worker");
+  atomic_init(&nextNetworkSlot, 0);
+
+  affinityPrintReport(stdout);
+}
+
+/*
+ *  Function  : affinityPrepareSessionThread()
+ *  Summary   : This function pins the next client thread to a single network core, taking the cores in turn.
+ *  Params    : pthread_attr_t* attributes - attributes the thread will be created with
+ *  Return    : void
+ */
+void affinityPrepareSessionThread(pthread_attr_t* attributes)
+{
+  if (networkCpus.count == 0)
+  {
+    return;
+  }
+  unsigned slot = atomic_fetch_add_explicit(&nextNetworkSlot, 1, memory_order_relaxed);
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(networkCpus.cpus[slot % networkCpus.count], &cpuSet);
+  pthread_attr_setaffinity_np(attributes, sizeof(cpuSet), &cpuSet);
+}
+
+/*
+ *  Function  : affinityPrepareWorkerThread()
+ *  Summary   : This function pins a worker thread to one of the worker cores.
+ *  Params    : pthread_attr_t* attributes
+ *              int workerIndex
+ *  Return    : void
+ */
+void affinityPrepareWorkerThread(pthread_attr_t* attributes, int workerIndex)
+{
+  if (workerCpus.count == 0)
+  {
+    return;
+  }
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(workerCpus.cpus[workerIndex % workerCpus.count], &cpuSet);
+  pthread_attr_setaffinity_np(attributes, sizeof(cpuSet), &cpuSet);
+}
+
+/*
+ *  Function  : affinityPinCurrentThread()
+ *  Summary   : This function confines the calling thread (the accept loop) to the network cores as a group.
+ *  Params    : void
+ *  Return    : void
+ */
+void affinityPinCurrentThread(void)
+{
+  if (networkCpus.count == 0)
+  {
+    return;
+  }
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  for (int i = 0; i < networkCpus.count; i++)
+  {
+    CPU_SET(networkCpus.cpus[i], &cpuSet);
+  }
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+  {
+    perror("pthread_setaffinity_np() FAILED");
+    return;
+  }
+  affinityBindLocalMemory();
+}
+
+/*
+ *  Function  : affinityBindLocalMemory()
+ *  Summary   : This function makes the calling thread prefer memory from its NUMA node, and moves the pages
+ *              of its stack and thread-local caches there, since those were first touched by whichever thread
+ *              created it. Threads allowed on more than one node are left alone. Failures are ignored; the
+ *              thread just keeps the kernel's default placement.
+ *  Params    : void
+ *  Return    : void
+ */
+void affinityBindLocalMemory(void)
+{
+  if (nodeCount <= 1)
+  {
+    return;
+  }
+
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+  {
+    return;
+  }
+  int node = -1;
+  for (int cpu = 0; cpu < kMaxCpus; cpu++)
+  {
+    if (CPU_ISSET(cpu, &cpuSet))
+    {
+      if (node >= 0 && cpuNode[cpu] != node)
+      {
+        return;
+      }
+      node = cpuNode[cpu];
+    }
+  }
+  if (node < 0)
+  {
+    return;
+  }
+
+  unsigned long nodeMask[kNodeMaskWords] = {};
+  nodeMask[node / 64] = 1UL << (node % 64);
+  syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodeMask, kMaxNumaNodes + 1);
+
+  pthread_attr_t attributes;
+  void* stackBase;
+  size_t stackSize;
+  if (pthread_getattr_np(pthread_self(), &attributes) == 0)
+  {
+    if (pthread_attr_getstack(&attributes, &stackBase, &stackSize) == 0)
+    {
+      syscall(SYS_mbind, stackBase, stackSize, MPOL_PREFERRED, nodeMask, kMaxNumaNodes + 1, MPOL_MF_MOVE);
+    }
+    pthread_attr_destroy(&attributes);
+  }
+}
+
+/*
+ *  Function  : affinityPrintReport()
+ *  Summary   : This function prints the NUMA nodes, the NIC's interrupt cores and where each kind of thread runs.
+ *  Params    : FILE* stream
+ *  Return    : void
+ */
+void affinityPrintReport(FILE* stream)
+{
+  char text[kCpuListTextLength];
+  fprintf(stream, "Topology: %d NUMA node(s), %d CPU(s) available\n", nodeCount, CPU_COUNT(&allowedCpus));
+  for (int node = 0; node < nodeCount; node++)
+  {
+    CpuList members = {};
+    for (int cpu = 0; cpu < kMaxCpus; cpu++)
+    {
+      if (cpuNode[cpu] == node && CPU_ISSET(cpu, &allowedCpus))
+      {
+        members.cpus[members.count++] = cpu;
+      }
+    }
+    if (members.count > 0)
+    {
+      formatCpuList(&members, text, sizeof(text));
+      fprintf(stream, "  node %d: cpus %s\n", node, text);
+    }
+  }
+  if (nicName[0] != '\0')
+  {
+    formatCpuList(&nicCpus, text, sizeof(text));
+    fprintf(stream, "  NIC %s: %d IRQ(s) on cpus %s\n", nicName, nicIrqCount, nicIrqCount > 0 ? text : "-");
+  }
+  describeThreads(stream, "network", &networkCpus);
+  describeThreads(stream, "worker", &workerCpus);
+  fflush(stream);
+}
+
+/*
+ *  Function  : compareCpus()
+ *  Summary   : This function orders CPU numbers for qsort().
+ *  Params    : const void* left
+ *              const void* right
+ *  Return    : int
+ */
+static int compareCpus(const void* left, const void* right)
+{
+  return *(const int*)left - *(const int*)right;
+}
+
+/*
+ *  Function  : readCpuListFile()
+ *  Summary   : This function reads a kernel cpulist file such as /sys/devices/system/node/node0/cpulist.
+ *  Params    : const char* path
+ *              CpuList* list
+ *  Return    : bool - false when the file is missing or unreadable
+ */
+static bool readCpuListFile(const char* path, CpuList* list)
+{
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+  {
+    return false;
+  }
+  char text[kCpuListTextLength] = "";
+  bool ok = fgets(text, sizeof(text), file) != NULL && affinityParseCpuList(text, list);
+  fclose(file);
+  return ok;
+}
+
+/*
+ *  Function  : formatCpuList()
+ *  Summary   : This function writes a sorted list back in the compact "0-3,8" form.
+ *  Params    : const CpuList* list
+ *              char* text
+ *              size_t textSize
+ *  Return    : void
+ */
+static void formatCpuList(const CpuList* list, char* text, size_t textSize)
+{
+  size_t used = 0;
+  text[0] = '\0';
+  for (int i = 0; i < list->count && used < textSize; )
+  {
+    int first = list->cpus[i];
+    int last = first;
+    while (i + 1 < list->count && list->cpus[i + 1] == last + 1)
+    {
+      last = list->cpus[++i];
+    }
+    i++;
+    if (first == last)
+    {
+      used += snprintf(text + used, textSize - used, "%s%d", used > 0 ? "," : "", first);
+    }
+    else
+    {
+      used += snprintf(text + used, textSize - used, "%s%d-%d", used > 0 ? "," : "", first, last);
+    }
+  }
+}
+
+/*
+ *  Function  : discoverNodes()
+ *  Summary   : This function maps every CPU to its NUMA node. Machines without /sys node entries are
+ *              treated as a single node.
+ *  Params    : void
+ *  Return    : void
+ */
+static void discoverNodes(void)
+{
+  memset(cpuNode, 0, sizeof(cpuNode));
+  nodeCount = 0;
+  for (int node = 0; node < kMaxNumaNodes; node++)
+  {
+    char path[kProcPathLength];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    CpuList members;
+    if (!readCpuListFile(path, &members))
+    {
+      continue;
+    }
+    for (int i = 0; i < members.count; i++)
+    {
+      cpuNode[members.cpus[i]] = node;
+    }
+    nodeCount = node + 1;
+  }
+  if (nodeCount == 0)
+  {
+    nodeCount = 1;
+  }
+}
+
+/*
+ *  Function  : discoverNicIrqs()
+ *  Summary   : This function finds the interrupts named after the interface in /proc/interrupts (its
+ *              per-queue vectors, e.g. "eth0-TxRx-3") and collects the cores they are delivered to.
+ *  Params    : const char* name
+ *  Return    : void
+ */
+static void discoverNicIrqs(const char* name)
+{
+  nicCpus.count = 0;
+  nicIrqCount = 0;
+  FILE* interrupts = fopen("/proc/interrupts", "r");
+  if (interrupts == NULL)
+  {
+    perror("fopen(/proc/interrupts) FAILED");
+    return;
+  }
+
+  bool seen[kMaxCpus] = {};
+  char line[kCpuListTextLength];
+  while (fgets(line, sizeof(line), interrupts) != NULL && nicIrqCount < kMaxNicIrqs)
+  {
+    int irq;
+    if (sscanf(line, " %d:", &irq) != 1 || strstr(line, name) == NULL)
+    {
+      continue;
+    }
+    char path[kProcPathLength];
+    snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", irq);
+    CpuList irqCpus;
+    if (!readCpuListFile(path, &irqCpus))
+    {
+      continue;
+    }
+    nicIrqCount++;
+    for (int i = 0; i < irqCpus.count; i++)
+    {
+      if (!seen[irqCpus.cpus[i]])
+      {
+        seen[irqCpus.cpus[i]] = true;
+        nicCpus.cpus[nicCpus.count++] = irqCpus.cpus[i];
+      }
+    }
+  }
+  fclose(interrupts);
+  qsort(nicCpus.cpus, nicCpus.count, sizeof(nicCpus.cpus[0]), compareCpus);
+
+  if (nicIrqCount == 0)
+  {
+    fprintf(stderr, "No interrupts found for %s; network threads stay unpinned unless -cpus is given\n", name);
+  }
+}
+
+/*
+ *  Function  : dropUnavailableCpus()
+ *  Summary   : This function removes CPUs the process may not run on (offline, or outside a cpuset/taskset),
+ *              since pinning a thread there would make pthread_create() fail.
+ *  Params    : CpuList* list
+ *              const char* role
+ *  Return    : void
+ */
+static void dropUnavailableCpus(CpuList* list, const char* role)
+{
+  int kept = 0;
+  for (int i = 0; i < list->count; i++)
+  {
+    if (CPU_ISSET(list->cpus[i], &allowedCpus))
+    {
+      list->cpus[kept++] = list->cpus[i];
+    }
+    else
+    {
+      fprintf(stderr, "CPU %d is not available; not using it for %s threads\n", list->cpus[i], role);
+    }
+  }
+  list->count = kept;
+}
+
+/*
+ *  Function  : describeThreads()
+ *  Summary   : This function prints one line of the report: the cores a kind of thread runs on and their nodes.
+ *  Params    : FILE* stream
+ *              const char* role
+ *              const CpuList* list
+ *  Return    : void
+ */
+static void describeThreads(FILE* stream, const char* role, const CpuList* list)
+{
+  if (list->count == 0)
+  {
+    fprintf(stream, "  %s threads: unpinned\n", role);
+    return;
+  }
+
+  char text[kCpuListTextLength];
+  formatCpuList(list, text, sizeof(text));
+  fprintf(stream, "  %s threads: cpus %s on node(s)", role, text);
+  bool nodeUsed[kMaxNumaNodes] = {};
+  for (int i = 0; i < list->count; i++)
+  {
+    nodeUsed[cpuNode[list->cpus[i]]] = true;
+  }
+  for (int node = 0; node < nodeCount; node++)
+  {
+    if (nodeUsed[node])
+    {
+      fprintf(stream, " %d", node);
+    }
+  }
+  fprintf(stream, "\n");
+}
@@ -0,0 +1,312 @@
+/*
+*   FILE          : capture.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the capture file: writing records for the server,
+*      reading them back for the replay tool. Session threads append records
+*      under one mutex into a large stdio buffer, so a frame costs a clock read
+*      and a memcpy; the clock is read under the lock, so times never go
+*      backwards in the file. Nothing is written when capture is off.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "../inc/capture.h"
+
+static FILE* captureFile = NULL;
+static char* captureBuffer = NULL;
+static const char* capturePath = NULL;
+static pthread_mutex_t captureMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t captureStartUs;
+static uint64_t lastRecordUs;
+static uint32_t sessionsNumbered;
+static uint64_t framesWritten;
+static bool writeFailed;
+
+static void writeRecord(CaptureRecordType type, uint32_t session, const char* data, size_t length);
+static size_t putVarint(uint8_t* out, uint64_t value);
+static bool getVarint(const uint8_t** cursor, const uint8_t* end, uint64_t* value);
+static uint64_t clockUs(clockid_t clock);
+
+/*
+ *  Function  : captureOpen()
+ *  Summary   : This function creates (or truncates) the capture file and writes its header.
+ *  Params    : const char* path
+ *  Return    : bool - false if the file cannot be written; nothing is captured then
+ */
+bool captureOpen(const char* path)
+{
+  FILE* file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    return false;
+  }
+  captureBuffer = malloc(kCaptureBufferSize);
+  if (captureBuffer != NULL)
+  {
+    setvbuf(file, captureBuffer, _IOFBF, kCaptureBufferSize);
+  }
+
+  uint8_t header[kCaptureHeaderSize];
+  uint64_t wallUs = clockUs(CLOCK_REALTIME);
+  memcpy(header, kCaptureMagic, 8);
+  for (int i = 0; i < 8; i++)
+  {
+    header[8 + i] = (uint8_t)(wallUs >> (8 * i));
+  }
+  if (fwrite(header, sizeof(header), 1, file) != 1)
+  {
+    fclose(file);
+    return false;
+  }
+  captureStartUs = clockUs(CLOCK_MONOTONIC);
+  capturePath = path;
+  captureFile = file;
+  return true;
+}
+
+/*
+ *  Function  : captureFrame()
+ *  Summary   : This function records one frame a client sent, numbering the client's session the first time.
+ *              It does nothing when capture is off.
+ *  Params    : uint32_t* session - the session's number, 0 until it has one; owned by the session's thread
+ *              const char* data - not NUL-terminated
+ *              size_t length
+ *  Return    : void
+ */
+void captureFrame(uint32_t* session, const char* data, size_t length)
+{
+  if (captureFile == NULL)
+  {
+    return;
+  }
+  if (length > kCaptureMaxFrame)
+  {
+    length = kCaptureMaxFrame;
+  }
+
+  pthread_mutex_lock(&captureMutex);
+  if (*session == 0)
+  {
+    *session = ++sessionsNumbered;
+  }
+  writeRecord(kCaptureFrame, *session, data, length);
+  pthread_mutex_unlock(&captureMutex);
+}
+
+/*
+ *  Function  : captureSessionEnd()
+ *  Summary   : This function records that a session ended, however it ended.
+ *  Params    : uint32_t session - 0 (a session that never sent a frame) records nothing
+ *  Return    : void
+ */
+void captureSessionEnd(uint32_t session)
+{
+  if (captureFile == NULL || session == 0)
+  {
+    return;
+  }
+  pthread_mutex_lock(&captureMutex);
+  writeRecord(kCaptureSessionEnd, session, NULL, 0);
+  pthread_mutex_unlock(&captureMutex);
+}
+
+/*
+ *  Function  : captureFlush()
+ *  Summary   : This function writes out what is buffered, so a server that is killed loses at most the
+ *              records since the last call.
+ *  Params    : void
+ *  Return    : void
+ */
+void captureFlush(void)
+{
+  if (captureFile == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock(&captureMutex);
+  writeFailed = writeFailed || (captureFile != NULL && fflush(captureFile) != 0);
+  pthread_mutex_unlock(&captureMutex);
+}
+
+/*
+ *  Function  : captureClose()
+ *  Summary   : This function ends the capture and reports what it holds. Sessions still open simply have no
+ *              end record.
+ *  Params    : FILE* stream - where to report
+ *  Return    : void
+ */
+void captureClose(FILE* stream)
+{
+  if (captureFile == NULL)
+  {
+    return;
+  }
+  pthread_mutex_lock(&captureMutex);
+  if (captureFile == NULL)
+  {
+    pthread_mutex_unlock(&captureMutex);
+    return;
+  }
+  writeFailed = fclose(captureFile) != 0 || writeFailed;
+  captureFile = NULL;
+  free(captureBuffer);
+  captureBuffer = NULL;
+  fprintf(stream, "Capture: %llu frames from %u sessions in %s%s\n", (unsigned long long)framesWritten,
+          sessionsNumbered, capturePath, writeFailed ? " (WRITE FAILED, file is incomplete)" : "");
+  pthread_mutex_unlock(&captureMutex);
+}
+
+/*
+ *  Function  : captureReadHeader()
+ *  Summary   : This function checks a capture file's header and steps past it.
+ *  Params    : const uint8_t** cursor - the start of the file; moved past the header
+ *              const uint8_t* end
+ *              uint64_t* startUs - the wall clock when the capture began, in microseconds
+ *  Return    : bool - false if this is not a capture file
+ */
+bool captureReadHeader(const uint8_t** cursor, const uint8_t* end, uint64_t* startUs)
+{
+  if (end - *cursor < kCaptureHeaderSize || memcmp(*cursor, kCaptureMagic, 8) != 0)
+  {
+    return false;
+  }
+  *startUs = 0;
+  for (int i = 0; i < 8; i++)
+  {
+    *startUs |= (uint64_t)(*cursor)[8 + i] << (8 * i);
+  }
+  *cursor += kCaptureHeaderSize;
+  return true;
+}
+
+/*
+ *  Function  : captureReadRecord()
+ *  Summary   : This function decodes the record at the cursor. A record cut short (the server was killed
+ *              mid-write) ends the file like its real end.
+ *  Params    : const uint8_t** cursor - moved past the record
+ *              const uint8_t* end
+ *              CaptureRecord* record - timeUs must hold the previous record's time (0 before the first)
+ *  Return    : bool - false at the end of the file
+ */
+bool captureReadRecord(const uint8_t** cursor, const uint8_t* end, CaptureRecord* record)
+{
+  const uint8_t* at = *cursor;
+  uint64_t deltaUs;
+  uint64_t session;
+  uint64_t length = 0;
+  if (at >= end)
+  {
+    return false;
+  }
+  uint8_t type = *at++;
+  if ((type != kCaptureFrame && type != kCaptureSessionEnd) || !getVarint(&at, end, &deltaUs) ||
+      !getVarint(&at, end, &session) || (type == kCaptureFrame && !getVarint(&at, end, &length)) ||
+      length > (uint64_t)(end - at))
+  {
+    return false;
+  }
+
+  record->type = type;
+  record->timeUs += deltaUs;
+  record->session = (uint32_t)session;
+  record->data = (const char*)at;
+  record->length = length;
+  *cursor = at + length;
+  return true;
+}
+
+/*
+ *  Function  : writeRecord()
+ *  Summary   : This function encodes one record and hands it to stdio, unless the capture was closed since
+ *              the caller checked. The caller holds captureMutex.
+ *  Params    : CaptureRecordType type
+ *              uint32_t session
+ *              const char* data - NULL for a record with no frame
+ *              size_t length
+ *  Return    : void
+ */
+static void writeRecord(CaptureRecordType type, uint32_t session, const char* data, size_t length)
+{
+  if (captureFile == NULL)
+  {
+    return;
+  }
+  uint64_t nowUs = clockUs(CLOCK_MONOTONIC) - captureStartUs;
+  uint64_t deltaUs = (nowUs > lastRecordUs) ? nowUs - lastRecordUs : 0;
+  lastRecordUs += deltaUs;
+
+  uint8_t head[1 + 3 * 10];
+  size_t used = 0;
+  head[used++] = (uint8_t)type;
+  used += putVarint(head + used, deltaUs);
+  used += putVarint(head + used, session);
+  if (data != NULL)
+  {
+    used += putVarint(head + used, length);
+  }
+  if (fwrite(head, used, 1, captureFile) != 1 || (length > 0 && fwrite(data, length, 1, captureFile) != 1))
+  {
+    writeFailed = true;
+  }
+  framesWritten += (type == kCaptureFrame);
+}
+
+/*
+ *  Function  : putVarint()
+ *  Summary   : This function encodes a value as LEB128: seven bits a byte, low bits first.
+ *  Params    : uint8_t* out - room for 10 bytes
+ *              uint64_t value
+ *  Return    : size_t - bytes written
+ */
+static size_t putVarint(uint8_t* out, uint64_t value)
+{
+  size_t used = 0;
+  while (value >= 0x80)
+  {
+    out[used++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[used++] = (uint8_t)value;
+  return used;
+}
+
+/*
+ *  Function  : getVarint()
+ *  Summary   : This function decodes a LEB128 value.
+ *  Params    : const uint8_t** cursor - moved past the value
+ *              const uint8_t* end
+ *              uint64_t* value
+ *  Return    : bool - false if the value runs past the end or is too long
+ */
+static bool getVarint(const uint8_t** cursor, const uint8_t* end, uint64_t* value)
+{
+  *value = 0;
+  for (int shift = 0; shift < 64 && *cursor < end; shift += 7)
+  {
+    uint8_t byte = *(*cursor)++;
+    *value |= (uint64_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ *  Function  : clockUs()
+ *  Summary   : This function reads a clock in microseconds.
+ *  Params    : clockid_t clock
+ *  Return    : uint64_t
+ */
+static uint64_t clockUs(clockid_t clock)
+{
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000;
+}
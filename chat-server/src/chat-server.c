@@ -5,65 +5,330 @@
 *   FIRST VERSION : 03/23/2025
 *   DESCRIPTION   :
 *      This is the main server-side implementation for the "Can We Talk" system.
-*      The chat server uses TCP/IP sockets and pthreads to handle up to 10 clients.
+*      The chat server uses TCP/IP sockets and pthreads to handle up to 4096 clients.
 *      Each client is handled in a dedicated thread, and messages are broadcast
 *      to all connected users. Messages are split into chunks and include
 *      IP, username, and timestamp for proper formatting and display.
 */
 
+#define _GNU_SOURCE
 #include "../inc/chat-server.h"
 
-int main(void)
+ClientsList activeClients;
+pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+ReplayRing chatReplay;
+MailboxStore offlineMail;
+HistoryLog chatHistory;
+size_t zeroCopyThreshold = 0;   // writes at least this large are sent with MSG_ZEROCOPY; 0 turns it off
+SearchIndex chatSearch;
+PresenceTable chatPresence;
+ClientInfo* allSessions = NULL;
+int liveSessionCount = 0;
+SlabPool sessionPool;
+SlabPool outboundQueuePool;
+SlabPool inputBufferPool;
+SlabPool outboundNodePool;
+SlabPool broadcastJobPool;
+WorkerPool messageWorkers;
+FanoutPool broadcastFanout;
+TimingWheel idleWheel;
+static MessageBuffer* pingBuffer;
+static atomic_uint_fast64_t ephemeralQueued;     // ephemeral events queued as new nodes
+static atomic_uint_fast64_t ephemeralCoalesced;  // ephemeral events that replaced an unsent one
+static atomic_uint_fast64_t ephemeralDropped;    // ephemeral events dropped for a full lane or a backlog
+static atomic_uint_fast64_t slowDisconnects;     // clients dropped for kOutboundMaxBuffered bytes waiting
+
+// The simulator in sim/ builds this file with its own main()
+#ifndef CHAT_SERVER_NO_MAIN
+int main(int argc, char* argv[])
 {
-  // Set up tcp connection
-  int serverSocket = setUpConnection();
+  // Read command-line options
+  int serverPort = kServerPort;
+  int nodeId = -1;
+  int clusterPort = kClusterPort;
+  char unixPath[kGenericStringLength] = "";
+  char historyPath[kHistoryPathLength] = "";
+  char* capturePath = NULL;
+  bool takeover = false;
+  char* networkCpus = NULL;
+  char* workerCpus = NULL;
+  char* nicName = NULL;
+  int traceSampleEvery = kTraceDefaultSampleEvery;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-port") == 0 && i + 1 < argc)
+    {
+      serverPort = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-node") == 0 && i + 1 < argc)
+    {
+      nodeId = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-cluster-port") == 0 && i + 1 < argc)
+    {
+      clusterPort = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-unix") == 0 && i + 1 < argc)
+    {
+      strncpy(unixPath, argv[++i], sizeof(unixPath) - 1);
+    }
+    else if (strcmp(argv[i], "-history") == 0 && i + 1 < argc)
+    {
+      strncpy(historyPath, argv[++i], sizeof(historyPath) - 1);
+    }
+    else if (strcmp(argv[i], "-zerocopy") == 0 && i + 1 < argc)
+    {
+      zeroCopyThreshold = strtoul(argv[++i], NULL, 10);
+    }
+    else if (strcmp(argv[i], "-capture") == 0 && i + 1 < argc)
+    {
+      capturePath = argv[++i];
+    }
+    else if (strcmp(argv[i], "-cpus") == 0 && i + 1 < argc)
+    {
+      networkCpus = argv[++i];
+    }
+    else if (strcmp(argv[i], "-worker-cpus") == 0 && i + 1 < argc)
+    {
+      workerCpus = argv[++i];
+    }
+    else if (strcmp(argv[i], "-nic") == 0 && i + 1 < argc)
+    {
+      nicName = argv[++i];
+    }
+    else if (strcmp(argv[i], "-trace-sample") == 0 && i + 1 < argc)
+    {
+      traceSampleEvery = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-takeover") == 0)
+    {
+      takeover = true;
+    }
+    else if (strcmp(argv[i], "-peer") == 0 && i + 1 < argc && clusterAddPeer(argv[i + 1]))
+    {
+      i++;
+    }
+    else
+    {
+      fprintf(stderr, "Usage: %s [-port <port>] [-unix <path>] [-history <dir>] [-zerocopy <bytes>] [-capture <file>] [-takeover] [-cpus <list>] [-worker-cpus <list>] [-nic <ifname>] [-trace-sample <n>] [-node <id> -cluster-port <port> [-peer <host:port>]...]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Stats are dumped on SIGUSR1; block it in every thread and read it from a signalfd in the main loop
+  sigset_t statsSignal;
+  sigemptyset(&statsSignal);
+  sigaddset(&statsSignal, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &statsSignal, NULL);
+  // sendfile() has no MSG_NOSIGNAL; a client that hung up mid-history must not end the server
+  signal(SIGPIPE, SIG_IGN);
+  int statsSignalFd = signalfd(-1, &statsSignal, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (statsSignalFd < 0)
+  {
+    displayFatalError("signalfd() FAILED");
+  }
+  traceInit(traceSampleEvery);
+  if (capturePath != NULL && !captureOpen(capturePath))
+  {
+    displayFatalError("capture file FAILED");
+  }
+
+  // Place this thread and, later, the client and worker threads on their cores
+  affinityInit(networkCpus, workerCpus, nicName);
+  affinityPinCurrentThread();
+
+  // Set up the allocators used for sessions and queued messages
+  poolInit(&sessionPool, "session", sizeof(ClientInfo));
+  poolInit(&outboundQueuePool, "queue", sizeof(OutboundQueue));
+  poolInit(&inputBufferPool, "input", kInputBufferSize);
+  poolInit(&outboundNodePool, "queue-node", sizeof(OutboundNode));
+  poolInit(&broadcastJobPool, "job", sizeof(BroadcastJob));
+  messageBufferPoolsInit();
+  clientsListInit(&activeClients, kMaxClients);
+  replayRingInit(&chatReplay, 0);
+  mailboxInit(&offlineMail);
+  if (historyPath[0] == '\0')
+  {
+    snprintf(historyPath, sizeof(historyPath), kHistoryDirectoryFormat, serverPort);
+  }
+  historyLogInit(&chatHistory, historyPath);
+  searchIndexInit(&chatSearch);
+  presenceInit(&chatPresence, kMaxClients);
+
+  // Start the workers that format messages for the client threads, and the helpers that share out large fan-outs
+  workerPoolInit(&messageWorkers, workerPoolDefaultThreads());
+  fanoutPoolInit(&broadcastFanout, fanoutDefaultHelpers());
+
+  // Join the cluster, if this node is part of one
+  if (nodeId >= 0)
+  {
+    clusterStart(nodeId, clusterPort);
+  }
+
+  // Start the wheel that tracks every session's idle deadline, and the shared ping line
+  timingWheelInit(&idleWheel, onSessionTimeout);
+  pingBuffer = messageBufferAcquire(sizeof(kPingLine));
+  memcpy(pingBuffer->data, kPingLine, strlen(kPingLine));
+  pingBuffer->length = strlen(kPingLine);
+
+  // Set up tcp connection, plus a Unix socket for clients on this host; on an upgrade,
+  // take both over from the running server together with all of its clients instead
+  int serverSocket;
+  int localSocket;
+  char upgradePath[kGenericStringLength];
+  snprintf(upgradePath, sizeof(upgradePath), kUpgradeSocketPathFormat, serverPort);
+  if (unixPath[0] == '\0')
+  {
+    snprintf(unixPath, sizeof(unixPath), kUnixSocketPathFormat, serverPort);
+  }
+  if (takeover)
+  {
+    if (!receiveHandoff(upgradePath, &serverSocket, &localSocket))
+    {
+      displayFatalError("takeover FAILED");
+    }
+  }
+  else
+  {
+    serverSocket = setUpConnection(serverPort);
+    localSocket = setUpLocalConnection(unixPath);
+  }
+  int upgradeSocket = setUpUpgradeSocket(upgradePath);
+
+  // Admin requests ("sessions", "stats") come in on a socket only this user may open
+  char adminPath[kGenericStringLength];
+  snprintf(adminPath, sizeof(adminPath), kAdminSocketPathFormat, serverPort);
+  int adminSocket = setUpLocalConnection(adminPath);
+  chmod(adminPath, S_IRUSR | S_IWUSR);
 
   // Initialize variables to store clients' details
   int clientSocket;
   struct sockaddr_in clientAddress;
   socklen_t clientAddressLength = sizeof(clientAddress);
-  activeClients.numberOfClients = 0;
-  int attempts = 0;
+  time_t idleSince = time(NULL);
+  time_t capturedUntil = time(NULL);
 
-  /* Enter main listening loop; i.e. accept users' messages */ //NOTE try killing a client while running
+  /* Enter main listening loop; i.e. accept users' connections and drive session timers */
   while (true)
   {
+    struct pollfd pollFds[6] = {};
+    pollFds[0].fd = serverSocket;
+    pollFds[0].events = POLLIN;
+    pollFds[1].fd = localSocket;
+    pollFds[1].events = POLLIN;
+    pollFds[2].fd = idleWheel.timerFd;
+    pollFds[2].events = POLLIN;
+    pollFds[3].fd = upgradeSocket;
+    pollFds[3].events = POLLIN;
+    pollFds[4].fd = statsSignalFd;
+    pollFds[4].events = POLLIN;
+    pollFds[5].fd = adminSocket;
+    pollFds[5].events = POLLIN;
+    if (poll(pollFds, 6, 1000) < 0 && errno != EINTR)
+    {
+      close(serverSocket);
+      displayFatalError("poll() FAILED");
+    }
+
     // Accept a connection
-    if ((clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddress, &clientAddressLength)) >= 0)
+    if ((pollFds[0].revents & POLLIN) &&
+        (clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddress, &clientAddressLength)) >= 0)
     {
       // Spawn a thread to handle it
       spawnClientThread(clientSocket);
 
     } // Handle fatal errors
-    else if (clientSocket < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    else if ((pollFds[0].revents & POLLIN) && clientSocket < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+             errno != ECONNABORTED)
     {
       close(serverSocket);
       displayFatalError("accept() FAILED");
     }
+    if ((pollFds[1].revents & POLLIN) && (clientSocket = accept(localSocket, NULL, NULL)) >= 0)
+    {
+      spawnClientThread(clientSocket);
+    }
 
-    attempts++;
-    /* Check if all clients have disconnected */
-    if (activeClients.numberOfClients <= 0 && attempts >= 15)
+    // Ping quiet clients and drop the ones that never answered; send presence when a summary is due
+    if (pollFds[2].revents & POLLIN)
     {
-      printf("Server shutting");
-      break;
+      timingWheelAdvance(&idleWheel);
+      MessageBuffer* summary = presenceTakeSummary(&chatPresence);
+      if (summary != NULL)
+      {
+        broadcastPresence(summary);
+        messageBufferRelease(summary);
+      }
+    }
+
+    // A new server binary wants to take over; on success this does not return
+    if (pollFds[3].revents & POLLIN)
+    {
+      performHandoff(upgradeSocket, serverSocket, localSocket);
+    }
+
+    // Dump allocator and latency stats on request
+    if (pollFds[4].revents & POLLIN)
+    {
+      struct signalfd_siginfo signalInfo;
+      read(statsSignalFd, &signalInfo, sizeof(signalInfo));
+      poolPrintStats(stdout);
+      searchIndexPrintStats(&chatSearch, stdout);
+      tracePrintStats(stdout);
+      zeroCopyPrintStats(stdout);
+      outboundPrintStats(stdout);
+      presencePrintStats(&chatPresence, stdout);
+      fanoutPrintStats(&broadcastFanout, stdout);
+      clusterPrintStats(stdout);
+    }
+    if (pollFds[5].revents & POLLIN)
+    {
+      serveAdminRequest(adminSocket);
+    }
+
+    // Write captured frames out about once a second
+    if (time(NULL) != capturedUntil)
+    {
+      capturedUntil = time(NULL);
+      captureFlush();
     }
 
-    // Simulate some non-blocking work (e.g., checking timers, other tasks)
-    sleep(1); // Sleep briefly to avoid busy-waiting
+    /* Check if all clients have disconnected (cluster nodes keep running for their peers) */
+    if (activeClients.numberOfClients > 0)
+    {
+      idleSince = time(NULL);
+    }
+    if (!clusterEnabled() && time(NULL) - idleSince >= 15)
+    {
+      printf("Server shutting\n");
+      poolPrintStats(stdout);
+      tracePrintStats(stdout);
+      captureClose(stdout);
+      break;
+    }
   }
 
   close(serverSocket);
+  close(localSocket);
+  close(upgradeSocket);
+  close(statsSignalFd);
+  close(adminSocket);
+  unlink(unixPath);
+  unlink(adminPath);
+  unlink(upgradePath);
+  workerPoolShutdown(&messageWorkers);
+  fanoutPoolShutdown(&broadcastFanout);
   return 0;
 }
+#endif //CHAT_SERVER_NO_MAIN
 
 /*
  *  Function  : setUpConnection()
  *  Summary   : This function sets up the server-side socket, binds to the port, and starts listening.
- *  Params    : void
+ *  Params    : int serverPort
  *  Return    : int
  */
-int setUpConnection(void)
+int setUpConnection(int serverPort)
 {
   int serverSocket;
 
@@ -73,11 +338,16 @@ int setUpConnection(void)
     displayFatalError("socket() FAILED");
   }
 
+  /* A restarted server must be able to listen again while its old connections sit in TIME_WAIT,
+     or reconnecting clients have nothing to come back to */
+  int reuse = 1;
+  setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
   /* Set server's address & port */
   struct sockaddr_in serverAddress;
   serverAddress.sin_family = AF_INET;
   serverAddress.sin_addr.s_addr = htonl(INADDR_ANY);
-  serverAddress.sin_port = htons(kServerPort);
+  serverAddress.sin_port = htons(serverPort);
 
   /* Bind to the socket */
   if (bind(serverSocket, (struct sockaddr*)&serverAddress, sizeof(serverAddress)) < 0)
@@ -94,7 +364,7 @@ int setUpConnection(void)
   }
 
   /* Start listening to the socket */
-  if (listen (serverSocket, 5) < 0) // 5 is the max number of pending connections (UNIX uses 5 by default)
+  if (listen (serverSocket, SOMAXCONN) < 0) // as many pending connections as the kernel allows, for bursts of clients
   {
     close(serverSocket);
     displayFatalError("listen() FAILED");
@@ -103,6 +373,43 @@ int setUpConnection(void)
   return serverSocket;
 }
 
+/*
+ *  Function  : setUpLocalConnection()
+ *  Summary   : This function sets up the Unix domain socket that same-host clients and bots connect to.
+ *  Params    : const char* socketPath
+ *  Return    : int
+ */
+int setUpLocalConnection(const char* socketPath)
+{
+  int localSocket;
+
+  /* Create a socket */
+  if ((localSocket = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+  {
+    displayFatalError("socket(AF_UNIX) FAILED");
+  }
+
+  /* Bind to the path, replacing a socket file left behind by an earlier run */
+  struct sockaddr_un localAddress = {};
+  localAddress.sun_family = AF_UNIX;
+  strncpy(localAddress.sun_path, socketPath, sizeof(localAddress.sun_path) - 1);
+  unlink(socketPath);
+  if (bind(localSocket, (struct sockaddr*)&localAddress, sizeof(localAddress)) < 0)
+  {
+    close(localSocket);
+    displayFatalError("bind(AF_UNIX) FAILED");
+  }
+
+  /* Set the socket to non-blocking mode & start listening */
+  if (fcntl(localSocket, F_SETFL, O_NONBLOCK) < 0 || listen(localSocket, SOMAXCONN) < 0)
+  {
+    close(localSocket);
+    displayFatalError("listen(AF_UNIX) FAILED");
+  }
+
+  return localSocket;
+}
+
 /*
  *  Function  : spawnClientThread()
  *  Summary   : This function creates a new thread to handle an incoming client connection.
@@ -110,206 +417,1679 @@ int setUpConnection(void)
  *  Return    : void
  */
 void spawnClientThread(int clientSocket)
+{
+  ClientInfo* client = createSession(clientSocket);
+  if (client == NULL)
+  {
+    close(clientSocket);
+    return;
+  }
+  /* Only fresh connections: on a taken-over socket the kernel's numbering of zero-copy sends is unknown */
+  if (zeroCopyThreshold > 0 && !client->isLocal)
+  {
+    client->zeroCopy = zeroCopyCreate(clientSocket);
+  }
+  startSessionThread(client);
+}
+
+/*
+ *  Function  : startSessionThread()
+ *  Summary   : This function creates the thread that serves an existing session.
+ *  Params    : ClientInfo* client
+ *  Return    : void
+ */
+void startSessionThread(ClientInfo* client)
 {
   // Fire a thread to handle client request
   pthread_t clientThread;
-  if (pthread_create(&clientThread, NULL, handleRequest, (void*)clientSocket) != 0)
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+  affinityPrepareSessionThread(&attributes);
+  if (pthread_create(&clientThread, &attributes, handleRequest, client) != 0)
   {
     displayFatalError("pthread_create() FAILED");
   }
-  pthread_detach(clientThread);
+  pthread_attr_destroy(&attributes);
 }
 
 /*
  *  Function  : handleRequest()
- *  Summary   : This function is executed by each client-handling thread. Receives and parses messages.
- *  Params    : void* clientSocket
- *  Return    : void
+ *  Summary   : This function is executed by each client-handling thread. It waits on the client's socket and
+ *              wakeup eventfd, receives and parses messages, and writes out whatever is queued for the client.
+ *  Params    : void* arg - the client's ClientInfo
+ *  Return    : void*
  */
-void handleRequest(void* clientSocket)
+void* handleRequest(void* arg)
 {
-  int clientSocketInt = ((int)clientSocket);
-  while (true)
+  ClientInfo* client = arg;
+  int clientSocketInt = client->clientSocket;
+  affinityBindLocalMemory();
+  if (client->queue->stats != NULL)
   {
-    /* Read & parse client's message */
-    char buffer[kMaxMsgLength] = {};
-    char* messageParts[3] = {};
-    read(clientSocketInt, buffer, sizeof(buffer));
-    parseMessage(buffer, messageParts);
+    pthread_mutex_lock(&client->queue->mutex);
+    sessionStatsBeginWrite(client->queue->stats);
+    client->queue->stats->values.thread = gettid();
+    sessionStatsEndWrite(client->queue->stats);
+    pthread_mutex_unlock(&client->queue->mutex);
+  }
 
-    /* Perform appropriate operation based on message */
-    if (messageParts[0] == NULL)
+  int outputPending = 0;
+  bool connected = true;
+  while (connected)
+  {
+    /* Wait for input, queued output, or room in the socket's send buffer */
+    struct pollfd pollFds[3] = {};
+    nfds_t pollCount = 2;
+    int pollTimeout = -1;
+    pollFds[0].fd = clientSocketInt;
+    pollFds[0].events = POLLIN;
+    if (outputPending > 0 && client->shm == NULL)
+    {
+      pollFds[0].events |= POLLOUT;
+    }
+    pollFds[1].fd = client->queue->wakeupFd;
+    pollFds[1].events = POLLIN;
+    if (client->shm != NULL)
+    {
+      pollFds[2].fd = client->shm->ownEventFd;
+      pollFds[2].events = POLLIN;
+      pollCount = 3;
+      if (shmTransportArmWait(client->shm, outputPending > 0))
+      {
+        pollTimeout = 0;
+      }
+    }
+    if (poll(pollFds, pollCount, pollTimeout) < 0)
     {
-      removeClient(clientSocketInt);
+      if (errno == EINTR)
+      {
+        continue;
+      }
       break;
     }
-    if (strcmp(messageParts[0], "Hello") == 0)
+
+    /* Deliver finished work, then write out queued messages */
+    if (pollFds[1].revents & POLLIN)
+    {
+      uint64_t wakeups;
+      read(client->queue->wakeupFd, &wakeups, sizeof(wakeups));
+    }
+    if (handoffRequested())
+    {
+      parkForHandoff(client);
+      continue;
+    }
+    if (pollFds[2].revents & POLLIN)
     {
-      addClient(clientSocketInt, messageParts);
+      shmTransportClearWakeup(client->shm);
     }
-    else if (strcmp(messageParts[0], ">>bye<<") == 0)
+    drainCompletions(client);
+    if ((outputPending = flushOutbound(client)) < 0)
     {
-      removeClient(clientSocketInt);
       break;
     }
-    else if (strcmp(messageParts[0], "Message") == 0)
+
+    /* Read & handle messages from the shared-memory ring */
+    if (client->shm != NULL)
+    {
+      ssize_t bytesRead = 0;
+      while (connected)
+      {
+        holdInputBuffer(client);
+        if ((bytesRead = shmTransportReceive(client->shm, client->inputBuffer + client->inputLength,
+                                             kInputBufferSize - client->inputLength)) <= 0)
+        {
+          break;
+        }
+        client->readNs = traceNow();
+        client->inputLength += bytesRead;
+        client->bytesIn += bytesRead;
+        connected = processInput(client);
+      }
+      releaseInputBuffer(client);
+      if (bytesRead < 0)
+      {
+        connected = false;
+      }
+    }
+
+    /* Zero-copy completions (or ones left by the process this socket was taken over from) raise POLLERR */
+    if (pollFds[0].revents & POLLERR)
+    {
+      zeroCopyReap(client->zeroCopy, clientSocketInt);
+    }
+
+    /* Read & handle a message from the socket; with shared memory only a hang-up arrives here */
+    if (connected && (pollFds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0)
     {
-      if (messageParts[1] != NULL)
+      if (client->shm == NULL)
+      {
+        connected = receiveInput(client);
+      }
+      else
       {
-        broadcastMessage(messageParts[1], clientSocketInt);
+        char discard[kMaxMsgLength];
+        ssize_t bytesRead = read(clientSocketInt, discard, sizeof(discard));
+        if (bytesRead == 0 || (bytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+          connected = false;
+        }
       }
     }
+    publishSessionStats(client);
   }
+
+  /* Let messages the client sent before leaving reach everyone, then drop it */
+  waitForCompletions(client);
+  removeClient(clientSocketInt);
+  destroySession(client);
+  return NULL;
 }
 
 /*
- *  Function  : displayFatalError()
- *  Summary   : This function displays the error message specified and terminates the program.
- *  Params    : char* errorMessage
- *  Return    : void
+ *  Function  : receiveInput()
+ *  Summary   : This function reads what the client sent, through the server's transport, and handles every
+ *              complete message in it. A read that finds nothing yet is not an error.
+ *  Params    : ClientInfo* client
+ *  Return    : bool - false when the client is leaving or the connection is gone
  */
-void displayFatalError(char* errorMessage)
+bool receiveInput(ClientInfo* client)
 {
-  perror(errorMessage);
-  exit(EXIT_FAILURE);
+  holdInputBuffer(client);
+  ssize_t bytesRead = serverTransport->receive(client->clientSocket, client->inputBuffer + client->inputLength,
+                                               kInputBufferSize - client->inputLength);
+  if (bytesRead <= 0)
+  {
+    releaseInputBuffer(client);
+    return bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+  }
+  client->readNs = traceNow();
+  client->inputLength += bytesRead;
+  client->bytesIn += bytesRead;
+  return processInput(client);
 }
 
 /*
- *  Function  : parseMessage()
- *  Summary   : This function takes the message and divides it into parts on pipe (|) delimiter
- *  Params    : char* message
- *              char* messageParts[]
- *  Return    : void
+ *  Function  : processInput()
+ *  Summary   : This function handles every complete newline-terminated frame in the client's input buffer
+ *              and keeps a trailing partial frame for the next read. A client that has never sent a newline
+ *              is treated the old way: whatever one read returned is one message. A framed client that fills
+ *              the whole buffer without a newline has the buffer handled as one message.
+ *  Params    : ClientInfo* client
+ *  Return    : bool - false when the client is leaving or the connection is gone
  */
-void parseMessage(char* message, char* messageParts[])
+bool processInput(ClientInfo* client)
 {
-  /* Divide string into parts */
-  char* token = strtok(message, "|");
-  int i = 0;
-  while (token != NULL )
+  bool connected = true;
+  size_t offset = 0;
+  size_t consumed;
+  MessageSlice frame;
+  while (connected && (consumed = nextFrame(client->inputBuffer + offset, client->inputLength - offset, &frame)) > 0)
+  {
+    client->framedInput = true;
+    connected = processClientMessage(client, frame.text, frame.length);
+    offset += consumed;
+  }
+
+  size_t remaining = client->inputLength - offset;
+  if (connected && remaining > 0 && (!client->framedInput || remaining == kInputBufferSize))
   {
-    messageParts[i] = token;
-    token = strtok(NULL, "|");
-    i++;
+    connected = processClientMessage(client, client->inputBuffer + offset, remaining);
+    remaining = 0;
   }
+
+  memmove(client->inputBuffer, client->inputBuffer + client->inputLength - remaining, remaining);
+  client->inputLength = remaining;
+  releaseInputBuffer(client);
+  return connected;
 }
 
 /*
- *  Function  : addClient()
- *  Summary   : This function adds a client to the global client list.
- *  Params    : int clientSocket
- *              char* messageParts[]
+ *  Function  : holdInputBuffer()
+ *  Summary   : This function gives the client an input buffer to read into, if it does not have one.
+ *  Params    : ClientInfo* client
  *  Return    : void
  */
-void addClient(int clientSocket, char* messageParts[])
+void holdInputBuffer(ClientInfo* client)
 {
-  pthread_mutex_lock(&clients_mutex);
-  for (int i = 0; i < kMaxClients; i++)
+  if (client->inputBuffer == NULL)
   {
-    if (strcmp(activeClients.clients[i].userName, "") == 0)
-    {
-      activeClients.clients[i].clientSocket = clientSocket;
-      strcpy(activeClients.clients[i].userName, messageParts[1]);
-      strcpy(activeClients.clients[i].ipAddress, messageParts[2]);
-      activeClients.numberOfClients++;
-      break;
-    }
+    client->inputBuffer = poolAlloc(&inputBufferPool);
   }
-  pthread_mutex_unlock(&clients_mutex);
 }
 
 /*
- *  Function  : removeClient()
- *  Summary   : This function removes a client from the global list and shifts remaining clients.
- *  Params    : int clientSocket
+ *  Function  : releaseInputBuffer()
+ *  Summary   : This function returns the client's input buffer once nothing is left in it, so an idle session
+ *              holds no buffer; only a client in the middle of a frame keeps one between reads.
+ *  Params    : ClientInfo* client
  *  Return    : void
  */
-void removeClient(int clientSocket)
+void releaseInputBuffer(ClientInfo* client)
 {
-  pthread_mutex_lock(&clients_mutex);
-  for (int i = 0; i < activeClients.numberOfClients; i++)
+  if (client->inputBuffer != NULL && client->inputLength == 0)
   {
-    if (activeClients.clients[i].clientSocket == clientSocket)
-    {
-      /* Update clients list */
-      for(int j = i; j < activeClients.numberOfClients - 1; j++)
-      {
-        activeClients.clients[j] = activeClients.clients[j + 1];
-      }
+    poolFree(&inputBufferPool, client->inputBuffer);
+    client->inputBuffer = NULL;
+  }
+}
 
-      /* Handle special case (client is last in array) */
-      if (i == activeClients.numberOfClients - 1)
-      {
-        ClientInfo emptyClient = {};
-        activeClients.clients[i] = emptyClient;
-      }
+/*
+ *  Function  : processClientMessage()
+ *  Summary   : This function parses one message from a client and performs the matching operation.
+ *  Params    : ClientInfo* client
+ *              const char* message - not NUL-terminated
+ *              size_t length
+ *  Return    : bool - false when the client is leaving
+ */
+bool processClientMessage(ClientInfo* client, const char* message, size_t length)
+{
+  captureFrame(&client->captureId, message, length);
 
-      activeClients.numberOfClients--;
-      close(clientSocket);
-      break;
+  /* Split off the command only; chat text keeps any '|' it contains */
+  MessageSlice messageParts[kMaxMessageParts];
+  if (parseMessage(message, length, messageParts, 2) == 0)
+  {
+    return true;
+  }
+
+  /* Perform appropriate operation based on message */
+  touchSession(client);
+  if (sliceEquals(messageParts[0], "Hello"))
+  {
+    parseMessage(messageParts[1].text, messageParts[1].length, messageParts + 1, kMaxMessageParts - 1);
+    addClient(client, messageParts);
+  }
+  else if (sliceEquals(messageParts[0], ">>bye<<"))
+  {
+    return false;
+  }
+  else if (sliceEquals(messageParts[0], "Message"))
+  {
+    if (messageParts[1].text != NULL)
+    {
+      submitBroadcast(client, messageParts[1]);
+    }
+    if (client->typing)
+    {
+      // Sending the line ends the typing that led to it
+      client->typing = false;
+      presenceSetTyping(&chatPresence, client->presenceSlot, false);
     }
   }
-  pthread_mutex_unlock(&clients_mutex);
+  else if (sliceEquals(messageParts[0], "Direct"))
+  {
+    /* Recipient, then the text, which keeps any '|' */
+    if (messageParts[1].text != NULL &&
+        parseMessage(messageParts[1].text, messageParts[1].length, messageParts + 1, 2) == 2)
+    {
+      sendDirect(client, messageParts[1], messageParts[2]);
+    }
+  }
+  else if (sliceEquals(messageParts[0], "Search"))
+  {
+    /* Only the asking client sees the results */
+    MessageBuffer* results = (messageParts[1].text != NULL) ? searchIndexQuery(&chatSearch, messageParts[1]) : NULL;
+    if (results != NULL)
+    {
+      enqueueOutbound(client, results);
+      messageBufferRelease(results);
+    }
+  }
+  else if (sliceEquals(messageParts[0], kHistoryTag))
+  {
+    if (messageParts[1].text != NULL)
+    {
+      sendHistory(client, messageParts[1]);
+    }
+  }
+  else if (sliceEquals(messageParts[0], kTypingTag))
+  {
+    client->typing = sliceEquals(messageParts[1], "1");
+    presenceSetTyping(&chatPresence, client->presenceSlot, client->typing);
+  }
+  else if (sliceEquals(messageParts[0], kPresenceTag))
+  {
+    subscribePresence(client);
+  }
+  else if (sliceEquals(messageParts[0], "Pong"))
+  {
+    // Heartbeat answer; touchSession() above already pushed the deadline back
+  }
+  else if (sliceEquals(messageParts[0], kShmRequest) && client->isLocal && client->shm == NULL)
+  {
+    /* Same-host client switching to the shared-memory rings. The reply bypasses the queue, so anything queued
+       or half written would reach the client after it; only this thread writes the socket, so whatever is
+       queued once the queue was seen empty goes through the rings */
+    pthread_mutex_lock(&client->queue->mutex);
+    bool idle = (client->queue->queuedBytes == 0);
+    pthread_mutex_unlock(&client->queue->mutex);
+    if (!idle)
+    {
+      MessageBuffer* refusal = messageBufferAcquire(sizeof(kShmRefused "\n"));
+      refusal->length = (size_t)snprintf(refusal->data, sizeof(kShmRefused "\n"), "%s\n", kShmRefused);
+      queueOutboundLane(client->queue, kLaneControl, refusal);
+      messageBufferRelease(refusal);
+    }
+    else if ((client->shm = shmTransportCreate(client->clientSocket)) == NULL)
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
 /*
- *  Function  : broadcastMessage()
- *  Summary   : This function splits a message into 40-character chunks and sends to all clients.
- *  Params    : char* message
- *              int clientSocket
+ *  Function  : touchSession()
+ *  Summary   : This function records that the client is alive by pushing its idle deadline back.
+ *  Params    : ClientInfo* client
  *  Return    : void
  */
+void touchSession(ClientInfo* client)
+{
+  pthread_mutex_lock(&idleWheel.lock);
+  client->pingOutstanding = false;
+  pthread_mutex_unlock(&idleWheel.lock);
+  timingWheelSchedule(&idleWheel, &client->idleTimer, kIdleTimeoutMs);
+}
 
-void broadcastMessage(char* message, int clientSocket)
+/*
+ *  Function  : onSessionTimeout()
+ *  Summary   : This function runs on the main thread, with the wheel locked, when a client's deadline passes.
+ *              A quiet client is pinged and given kPongTimeoutMs to answer; a client that was already pinged
+ *              has its socket shut down, which makes its own thread see the hang-up and clean up.
+ *  Params    : TimerEntry* entry
+ *  Return    : uint64_t - delay to re-arm with, 0 to leave the timer disarmed
+ */
+uint64_t onSessionTimeout(TimerEntry* entry)
 {
-  /* Parcel & format the message */
-  pthread_mutex_lock(&clients_mutex);
-  char messageChunks[2][kMaxMsgLength] = {""};
-  strncpy(messageChunks[0], message, kChunkSize - 1);
-  formatMessage(clientSocket, messageChunks[0]);
-  if (strlen(message) > kChunkSize)
+  ClientInfo* client = (ClientInfo*)((char*)entry - offsetof(ClientInfo, idleTimer));
+  if (!client->pingOutstanding)
   {
-    strncpy(messageChunks[1], message + 40, kChunkSize - 1);
-    formatMessage(clientSocket, messageChunks[1]);
+    client->pingOutstanding = true;
+    queueOutboundLane(client->queue, kLaneControl, pingBuffer);
+    return kPongTimeoutMs;
   }
 
-  /* Broadcast the message to all clients */
-  for (int i = 0; i < activeClients.numberOfClients; i++)
+  shutdown(client->clientSocket, SHUT_RDWR);
+  return 0;
+}
+
+/*
+ *  Function  : publishSessionStats()
+ *  Summary   : This function copies the client's traffic counters, last read time and name into its stats
+ *              slot. The client's own thread calls it once per wakeup.
+ *  Params    : ClientInfo* client
+ *  Return    : void
+ */
+void publishSessionStats(ClientInfo* client)
+{
+  SessionStats* stats = client->queue->stats;
+  if (stats == NULL)
   {
-    if (write(activeClients.clients[i].clientSocket, messageChunks[0], strlen(messageChunks[0])) < 0)
-    {
-      perror("Write error");
-    }
-    if (strlen(messageChunks[1]) > 0)
-    {
-      sleep(1);
-      if (write(activeClients.clients[i].clientSocket, messageChunks[1], strlen(messageChunks[1])) < 0)
-      {
-        perror("Write error");
-      }
-    }
+    return;
   }
-  pthread_mutex_unlock(&clients_mutex);
+
+  /* The queue lock also orders this against noteQueueChange() from other threads */
+  pthread_mutex_lock(&client->queue->mutex);
+  sessionStatsBeginWrite(stats);
+  stats->values.bytesIn = client->bytesIn;
+  stats->values.bytesOut = client->bytesOut;
+  stats->values.lastReadNs = client->readNs;
+  memcpy(stats->values.userName, client->userName, kSessionStatsNameLength);
+  stats->values.ipAddress = client->ipAddress;
+  sessionStatsEndWrite(stats);
+  pthread_mutex_unlock(&client->queue->mutex);
 }
 
 /*
- *  Function  : formatMessage()
- *  Summary   : This function formats a message with IP, username, and content. Updates the passed-in message.
- *  Params    : int clientSocket
- *              char* message
+ *  Function  : noteQueueChange()
+ *  Summary   : This function records the queued bytes and the age of the oldest queued message in the
+ *              queue's stats slot. The caller holds the queue's mutex.
+ *  Params    : OutboundQueue* queue
  *  Return    : void
  */
-void formatMessage(int clientSocket, char* message)
+void noteQueueChange(OutboundQueue* queue)
 {
-  char formattedMessage[kMaxMsgLength] = "";
-  for (int i = 0; i < activeClients.numberOfClients; i++)
+  SessionStats* stats = queue->stats;
+  if (stats == NULL)
+  {
+    return;
+  }
+  sessionStatsBeginWrite(stats);
+  stats->values.queuedBytes = queue->queuedBytes;
+  stats->values.oldestQueuedNs = 0;
+  for (int lane = 0; lane < kLaneCount; lane++)
   {
-    if (activeClients.clients[i].clientSocket == clientSocket)
+    if (queue->head[lane] != NULL &&
+        (stats->values.oldestQueuedNs == 0 || queue->head[lane]->enqueuedNs < stats->values.oldestQueuedNs))
     {
-      sprintf(formattedMessage, "%s [%.5s] << %.40s", activeClients.clients[i].ipAddress, activeClients.clients[i].userName,
-              message);
-      break;
+      stats->values.oldestQueuedNs = queue->head[lane]->enqueuedNs;
     }
   }
-  strcpy(message, formattedMessage);
-}
\ No newline at end of file
+  sessionStatsEndWrite(stats);
+}
+
+/*
+ *  Function  : serveAdminRequest()
+ *  Summary   : This function accepts one connection on the admin socket, reads its command line and writes
+ *              the answer: "sessions" lists every session, "stats" prints the allocator, search, latency,
+ *              zero-copy, output lane, presence, fan-out and cluster link stats that SIGUSR1 prints. The
+ *              connection is closed after the answer. A peer that is slower than kAdminTimeoutMs to ask or to
+ *              read is dropped, so it cannot hold up the main loop.
+ *  Params    : int adminSocket
+ *  Return    : void
+ */
+void serveAdminRequest(int adminSocket)
+{
+  int connection = accept(adminSocket, NULL, NULL);
+  if (connection < 0)
+  {
+    return;
+  }
+  struct timeval timeout = {kAdminTimeoutMs / 1000, (kAdminTimeoutMs % 1000) * 1000};
+  setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  /* Read up to the end of the first line */
+  char command[64];
+  size_t length = 0;
+  ssize_t bytesRead;
+  while (length < sizeof(command) - 1 && memchr(command, '\n', length) == NULL &&
+         (bytesRead = read(connection, command + length, sizeof(command) - 1 - length)) > 0)
+  {
+    length += bytesRead;
+  }
+  command[length] = '\0';
+  command[strcspn(command, "\r\n")] = '\0';
+
+  FILE* stream = fdopen(connection, "w");
+  if (stream == NULL)
+  {
+    close(connection);
+    return;
+  }
+  if (strcmp(command, "sessions") == 0)
+  {
+    sessionStatsPrint(stream, traceNow());
+  }
+  else if (strcmp(command, "stats") == 0)
+  {
+    poolPrintStats(stream);
+    searchIndexPrintStats(&chatSearch, stream);
+    tracePrintStats(stream);
+    zeroCopyPrintStats(stream);
+    outboundPrintStats(stream);
+    presencePrintStats(&chatPresence, stream);
+    fanoutPrintStats(&broadcastFanout, stream);
+    clusterPrintStats(stream);
+  }
+  else
+  {
+    fprintf(stream, "unknown command \"%s\"; try \"sessions\" or \"stats\"\n", command);
+  }
+  fclose(stream);
+}
+
+/*
+ *  Function  : displayFatalError()
+ *  Summary   : This function displays the error message specified and terminates the program.
+ *  Params    : char* errorMessage
+ *  Return    : void
+ */
+void displayFatalError(char* errorMessage)
+{
+  perror(errorMessage);
+  exit(EXIT_FAILURE);
+}
+
+/*
+ *  Function  : createSession()
+ *  Summary   : This function takes a session from the session pool and prepares it for a newly accepted socket.
+ *  Params    : int clientSocket
+ *  Return    : ClientInfo*
+ */
+ClientInfo* createSession(int clientSocket)
+{
+  /* Writes to clients must never block the thread that queued them */
+  if (!serverTransport->setNonBlocking(clientSocket))
+  {
+    perror("fcntl() FAILED");
+    return NULL;
+  }
+
+  ClientInfo* client = poolAlloc(&sessionPool);
+  memset(client, 0, sizeof(*client));
+  client->clientSocket = clientSocket;
+  client->queue = poolAlloc(&outboundQueuePool);
+  memset(client->queue, 0, sizeof(*client->queue));
+  client->queue->writingLane = -1;
+  client->presenceSlot = -1;
+  if ((client->queue->wakeupFd = serverTransport->openWakeup()) < 0)
+  {
+    perror("eventfd() FAILED");
+    poolFree(&outboundQueuePool, client->queue);
+    poolFree(&sessionPool, client);
+    return NULL;
+  }
+  pthread_mutex_init(&client->queue->mutex, NULL);
+  atomic_init(&client->signalsInFlight, 0);
+  client->queue->stats = sessionStatsClaim(clientSocket, traceNow());
+
+  /* Clients on the Unix socket may ask for the shared-memory transport */
+  struct sockaddr_storage localAddress;
+  socklen_t localAddressLength = sizeof(localAddress);
+  if (getsockname(clientSocket, (struct sockaddr*)&localAddress, &localAddressLength) == 0)
+  {
+    client->isLocal = (localAddress.ss_family == AF_UNIX);
+  }
+
+  /* A client that never says anything is pinged and eventually dropped like any other */
+  touchSession(client);
+
+  pthread_mutex_lock(&clients_mutex);
+  client->nextSession = allSessions;
+  if (allSessions != NULL)
+  {
+    allSessions->prevSession = client;
+  }
+  allSessions = client;
+  liveSessionCount++;
+  pthread_mutex_unlock(&clients_mutex);
+  return client;
+}
+
+/*
+ *  Function  : destroySession()
+ *  Summary   : This function drops anything still queued for a client, closes its descriptors and returns
+ *              the session to the pool. Only the client's own thread calls it, after waitForCompletions()
+ *              and removeClient().
+ *  Params    : ClientInfo* client
+ *  Return    : void
+ */
+void destroySession(ClientInfo* client)
+{
+  timingWheelCancel(&idleWheel, &client->idleTimer);
+
+  pthread_mutex_lock(&clients_mutex);
+  if (client->prevSession != NULL)
+  {
+    client->prevSession->nextSession = client->nextSession;
+  }
+  else
+  {
+    allSessions = client->nextSession;
+  }
+  if (client->nextSession != NULL)
+  {
+    client->nextSession->prevSession = client->prevSession;
+  }
+  liveSessionCount--;
+  handoffSessionEnded();
+  pthread_mutex_unlock(&clients_mutex);
+
+  for (int lane = 0; lane < kLaneCount; lane++)
+  {
+    OutboundNode* node = client->queue->head[lane];
+    while (node != NULL)
+    {
+      OutboundNode* next = node->next;
+      releaseOutboundNode(node);
+      node = next;
+    }
+  }
+  sessionStatsRelease(client->queue->stats);
+  captureSessionEnd(client->captureId);
+  if (client->zeroCopy != NULL)
+  {
+    zeroCopyDestroy(client->zeroCopy, client->clientSocket);
+  }
+
+  if (client->shm != NULL)
+  {
+    shmTransportDestroy(client->shm);
+  }
+  if (client->inputBuffer != NULL)
+  {
+    poolFree(&inputBufferPool, client->inputBuffer);
+  }
+  pthread_mutex_destroy(&client->queue->mutex);
+  serverTransport->close(client->queue->wakeupFd);
+  serverTransport->close(client->clientSocket);
+  poolFree(&outboundQueuePool, client->queue);
+  poolFree(&sessionPool, client);
+}
+
+/*
+ *  Function  : addClient()
+ *  Summary   : This function adds a client to the global client list and hands it any direct messages
+ *              waiting in its mailbox. A client that also sends the last sequence number it saw (0 when it
+ *              has seen none) is resumed: sent what it missed, then told where the stream is. A session
+ *              that is already registered (it has a line prefix) ignores any further "Hello".
+ *  Params    : ClientInfo* client
+ *              MessageSlice messageParts[] - "Hello", username, IP address, optionally the last sequence
+ *  Return    : void
+ */
+void addClient(ClientInfo* client, MessageSlice messageParts[])
+{
+  if (messageParts[1].text == NULL || messageParts[2].text == NULL || client->linePrefixLength != 0)
+  {
+    return;
+  }
+
+  uint64_t lastSeen = 0;
+  if (messageParts[3].text != NULL)
+  {
+    char number[24];
+    sliceCopy(messageParts[3], number, sizeof(number));
+    lastSeen = strtoull(number, NULL, 10);
+  }
+
+  char ipAddress[INET_ADDRSTRLEN];
+  sliceCopy(messageParts[1], client->userName, kSessionNameLength);
+  sliceCopy(messageParts[2], ipAddress, sizeof(ipAddress));
+  if (inet_pton(AF_INET, ipAddress, &client->ipAddress) != 1)
+  {
+    client->ipAddress.s_addr = 0;
+  }
+  inet_ntop(AF_INET, &client->ipAddress, ipAddress, sizeof(ipAddress));
+  client->linePrefixLength = formatLinePrefix(client->linePrefix, kLinePrefixSize, ipAddress, client->userName);
+
+  pthread_mutex_lock(&clients_mutex);
+  if (registerClient(client))
+  {
+    /* Everything sent to this user while they were away goes out as one buffer */
+    MessageBuffer* mail = mailboxTake(&offlineMail, client->userName);
+    if (mail != NULL)
+    {
+      enqueueOutbound(client, mail);
+      messageBufferRelease(mail);
+    }
+    if (messageParts[3].text != NULL)
+    {
+      resumeClient(client, lastSeen);
+    }
+  }
+  else
+  {
+    client->linePrefixLength = 0;
+  }
+  pthread_mutex_unlock(&clients_mutex);
+}
+
+/*
+ *  Function  : resumeClient()
+ *  Summary   : This function queues the broadcasts a reconnecting client missed, from the replay ring, each
+ *              followed by its "Seq|<n>" line; with nothing to replay it sends the current sequence alone.
+ *              The part of the gap that has already left the ring is sent from the disk history, one range
+ *              per segment, each followed by a "Seq|<n>" line for its last message, so a client cut off
+ *              partway through is not sent the finished ranges again; if some of the gap is not on disk
+ *              either, the client is told how many messages are lost. A lastSeen of 0 (a first connection),
+ *              or one from before the server's numbering restarted, replays nothing.
+ *              Caller holds clients_mutex, so no broadcast can slip in between the replay and live traffic.
+ *              The disk part needs no flush first: broadcasts not yet written are the newest
+ *              kHistoryPendingMax at most, all still in the replay ring.
+ *  Params    : ClientInfo* client
+ *              uint64_t lastSeen
+ *  Return    : void
+ */
+void resumeClient(ClientInfo* client, uint64_t lastSeen)
+{
+  client->resumes = true;
+  uint64_t last = chatReplay.lastSequence;
+  bool replayed = false;
+  if (lastSeen != 0 && lastSeen < last)
+  {
+    uint64_t first = lastSeen + 1;
+    uint64_t oldest = replayRingOldest(&chatReplay);
+    uint64_t onDisk = historyLogOldest(&chatHistory);
+    uint64_t available = (onDisk != 0 && onDisk < oldest) ? onDisk : oldest;
+    if (first < available)
+    {
+      MessageBuffer* notice = messageBufferAcquire(kMaxMsgLength);
+      notice->length = (size_t)snprintf(notice->data, notice->capacity, "(%llu message(s) could not be replayed)\n",
+                                        (unsigned long long)(available - first));
+      enqueueOutbound(client, notice);
+      messageBufferRelease(notice);
+      first = available;
+    }
+    if (first < oldest)
+    {
+      HistoryRange ranges[kHistorySegments];
+      int rangeCount = historyLogRanges(&chatHistory, first, oldest - 1, ranges, kHistorySegments);
+      for (int i = 0; i < rangeCount; i++)
+      {
+        enqueueHistory(client, ranges[i]);
+        MessageBuffer* position = makeSequenceLine(ranges[i].lastSequence);
+        enqueueOutbound(client, position);
+        messageBufferRelease(position);
+      }
+      first = oldest;
+    }
+    for (uint64_t sequence = first; sequence <= last; sequence++)
+    {
+      enqueueOutbound(client, replayRingGet(&chatReplay, sequence));
+      replayed = true;
+    }
+  }
+
+  /* The last replayed message already ends with the current sequence */
+  if (!replayed)
+  {
+    MessageBuffer* position = makeSequenceLine(last);
+    enqueueOutbound(client, position);
+    messageBufferRelease(position);
+  }
+}
+
+/*
+ *  Function  : sendHistory()
+ *  Summary   : This function queues the last count broadcasts (at most kHistoryMaxMessages) for a client,
+ *              straight from the disk history; messages no longer on disk are left out. They carry no
+ *              "Seq|<n>" lines, so a resuming client's position in the stream does not move. The history is
+ *              written out before clients_mutex is taken; the few broadcasts that get in line meanwhile come
+ *              from the replay ring, and carry "Seq|<n>" lines to a resuming client like live ones do.
+ *  Params    : ClientInfo* client
+ *              MessageSlice count - decimal text
+ *  Return    : void
+ */
+void sendHistory(ClientInfo* client, MessageSlice count)
+{
+  char number[24];
+  sliceCopy(count, number, sizeof(number));
+  uint64_t wanted = strtoull(number, NULL, 10);
+  if (client->linePrefixLength == 0 || wanted == 0)
+  {
+    return;
+  }
+  if (wanted > kHistoryMaxMessages)
+  {
+    wanted = kHistoryMaxMessages;
+  }
+
+  /* Under clients_mutex, so the history ends exactly where the live stream to this client picks up */
+  historyLogFlush(&chatHistory);
+  pthread_mutex_lock(&clients_mutex);
+  uint64_t last = chatReplay.lastSequence;
+  uint64_t first = (last >= wanted) ? last - wanted + 1 : 1;
+  HistoryRange ranges[kHistorySegments];
+  int rangeCount = (last > 0) ? historyLogRanges(&chatHistory, first, last, ranges, kHistorySegments) : 0;
+  for (int i = 0; i < rangeCount; i++)
+  {
+    enqueueHistory(client, ranges[i]);
+  }
+  if (!atomic_load(&chatHistory.failed))
+  {
+    uint64_t unwritten = (rangeCount > 0) ? ranges[rangeCount - 1].lastSequence + 1 : first;
+    uint64_t oldest = replayRingOldest(&chatReplay);
+    for (uint64_t sequence = (unwritten > oldest) ? unwritten : oldest; sequence <= last; sequence++)
+    {
+      enqueueOutbound(client, replayRingGet(&chatReplay, sequence));
+    }
+  }
+  pthread_mutex_unlock(&clients_mutex);
+}
+
+/*
+ *  Function  : clientsListInit()
+ *  Summary   : This function allocates an empty client list with room for capacity clients.
+ *  Params    : ClientsList* list
+ *              int capacity
+ *  Return    : void
+ */
+void clientsListInit(ClientsList* list, int capacity)
+{
+  list->numberOfClients = 0;
+  list->capacity = capacity;
+  list->sockets = calloc(capacity, sizeof(*list->sockets));
+  list->queues = calloc(capacity, sizeof(*list->queues));
+  list->clients = calloc(capacity, sizeof(*list->clients));
+  if (list->sockets == NULL || list->queues == NULL || list->clients == NULL)
+  {
+    displayFatalError("client list calloc() FAILED");
+  }
+}
+
+/*
+ *  Function  : registerClient()
+ *  Summary   : This function appends a client to the global list and marks it online. Caller holds
+ *              clients_mutex.
+ *  Params    : ClientInfo* client
+ *  Return    : bool - false when the list is full
+ */
+bool registerClient(ClientInfo* client)
+{
+  int index = activeClients.numberOfClients;
+  if (index >= activeClients.capacity)
+  {
+    return false;
+  }
+  activeClients.sockets[index] = client->clientSocket;
+  activeClients.queues[index] = client->queue;
+  activeClients.clients[index] = client;
+  activeClients.numberOfClients++;
+  if (client->presenceSlot < 0)
+  {
+    client->presenceSlot = presenceJoin(&chatPresence, client->userName);
+  }
+  return true;
+}
+
+/*
+ *  Function  : removeClient()
+ *  Summary   : This function removes a client from the global list, and from presence; the last client
+ *              takes its place. The socket itself is closed by destroySession(), so no entry for it may be
+ *              left behind: the whole list is searched, and a session that was never registered has none.
+ *  Params    : int clientSocket
+ *  Return    : void
+ */
+void removeClient(int clientSocket)
+{
+  int removed = 0;
+  pthread_mutex_lock(&clients_mutex);
+  for (int i = 0; i < activeClients.numberOfClients; i++)
+  {
+    if (activeClients.sockets[i] == clientSocket)
+    {
+      presenceLeave(&chatPresence, activeClients.clients[i]->presenceSlot);
+      activeClients.clients[i]->presenceSlot = -1;
+      int last = --activeClients.numberOfClients;
+      activeClients.sockets[i] = activeClients.sockets[last];
+      activeClients.queues[i] = activeClients.queues[last];
+      activeClients.clients[i] = activeClients.clients[last];
+      activeClients.clients[last] = NULL;
+      removed++;
+      i--;      // the entry moved here has not been looked at yet
+    }
+  }
+  pthread_mutex_unlock(&clients_mutex);
+  assert(removed <= 1);
+}
+
+/*
+ *  Function  : sendDirect()
+ *  Summary   : This function delivers a direct message to every session logged in under the recipient's name,
+ *              or keeps it in the recipient's mailbox when there is none. The sender gets a copy of the lines,
+ *              plus a note when the message was kept or could not be. Direct messages are not numbered or
+ *              replayed, and stay on this node.
+ *  Params    : ClientInfo* client - the sender
+ *              MessageSlice recipient
+ *              MessageSlice text
+ *  Return    : void
+ */
+void sendDirect(ClientInfo* client, MessageSlice recipient, MessageSlice text)
+{
+  if (client->linePrefixLength == 0 || recipient.length == 0)
+  {
+    return;
+  }
+  char recipientName[kSessionNameLength];
+  sliceCopy(recipient, recipientName, sizeof(recipientName));
+
+  /* Same lines as a broadcast, behind a ">>" prefix */
+  char ipAddress[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &client->ipAddress, ipAddress, sizeof(ipAddress));
+  char prefixText[kLinePrefixSize];
+  MessageSlice prefix = {prefixText, formatDirectPrefix(prefixText, sizeof(prefixText), ipAddress,
+                                                        client->userName)};
+  MessageSlice chunks[kMaxChunks];
+  int chunkCount = chunkMessage(text.text, text.length < kMaxMsgLength ? text.length : kMaxMsgLength - 1, chunks,
+                                kMaxChunks);
+  MessageBuffer* lines = messageBufferAcquire(kMaxChunks * kMaxLineLength);
+  MessageSlice timestamp = lineTimestamp();
+  for (int i = 0; i < chunkCount; i++)
+  {
+    lines->length += assembleChatLine(lines->data + lines->length, kMaxLineLength, prefix, chunks[i], timestamp);
+    lines->data[lines->length++] = '\n';
+  }
+
+  const char* note = NULL;
+  bool senderGotIt = false;
+  pthread_mutex_lock(&clients_mutex);
+  bool online = false;
+  for (int i = 0; i < activeClients.numberOfClients; i++)
+  {
+    ClientInfo* recipientClient = activeClients.clients[i];
+    if (strcmp(recipientClient->userName, recipientName) == 0)
+    {
+      enqueueOutbound(recipientClient, lines);
+      online = true;
+      senderGotIt = senderGotIt || (recipientClient == client);
+    }
+  }
+  if (!online && lines->length > 0)
+  {
+    switch (mailboxDeposit(&offlineMail, recipientName, lines->data, lines->length))
+    {
+      case kDepositKept:
+        note = "is offline; the message will be delivered when they return";
+        break;
+      case kDepositTrimmed:
+        note = "is offline; the message was kept, but older ones were dropped to make room";
+        break;
+      default:
+        note = "is offline and the message could not be kept";
+        break;
+    }
+  }
+  if (!senderGotIt)
+  {
+    enqueueOutbound(client, lines);
+  }
+  pthread_mutex_unlock(&clients_mutex);
+  messageBufferRelease(lines);
+
+  if (note != NULL)
+  {
+    MessageBuffer* notice = messageBufferAcquire(kGenericStringLength + kMaxMsgLength);
+    notice->length = (size_t)snprintf(notice->data, notice->capacity, "(%s %s)\n", recipientName, note);
+    enqueueOutbound(client, notice);
+    messageBufferRelease(notice);
+  }
+}
+
+/*
+ *  Function  : submitBroadcast()
+ *  Summary   : This function hands a received chat message to the worker pool for formatting. The job is
+ *              remembered on the client so results are broadcast in the order the client sent them.
+ *              When the pool's queue is full the job is formatted right here instead.
+ *  Params    : ClientInfo* client
+ *              MessageSlice message
+ *  Return    : void
+ */
+void submitBroadcast(ClientInfo* client, MessageSlice message)
+{
+  BroadcastJob* job = poolAlloc(&broadcastJobPool);
+  job->work.run = runBroadcastJob;
+  job->work.complete = completeBroadcastJob;
+  job->work.next = NULL;
+  job->work.ownerWakeupFd = client->queue->wakeupFd;
+  job->work.ownerSignalsInFlight = &client->signalsInFlight;
+  job->senderSocket = client->clientSocket;
+  memcpy(job->linePrefix, client->linePrefix, client->linePrefixLength);
+  job->linePrefixLength = client->linePrefixLength;
+  job->lines = NULL;
+  sliceCopy(message, job->message, kMaxMsgLength);
+
+  /* Stamp the message; from here on its timings travel with the job and then with its lines */
+  memset(&job->stamps, 0, sizeof(job->stamps));
+  job->stamps.traceId = traceSampleBegin();
+  job->stamps.at[kMarkRead] = client->readNs;
+  job->stamps.at[kMarkParsed] = traceNow();
+  traceRecord(kStageParse, job->stamps.at[kMarkParsed] - client->readNs);
+
+  /* Track the job before the pool can finish it */
+  if (client->pendingTail == NULL)
+  {
+    client->pendingHead = &job->work;
+  }
+  else
+  {
+    client->pendingTail->next = &job->work;
+  }
+  client->pendingTail = &job->work;
+
+  if (!workerPoolSubmit(&messageWorkers, &job->work))
+  {
+    workerPoolRunInline(&job->work);
+    drainCompletions(client);
+  }
+}
+
+/*
+ *  Function  : runBroadcastJob()
+ *  Summary   : This function runs on a worker thread and formats the job's message into output lines.
+ *  Params    : WorkItem* item
+ *  Return    : void
+ */
+void runBroadcastJob(WorkItem* item)
+{
+  BroadcastJob* job = (BroadcastJob*)item;
+  job->stamps.at[kMarkFormatStart] = traceNow();
+  traceRecord(kStageQueueWait, job->stamps.at[kMarkFormatStart] - job->stamps.at[kMarkParsed]);
+
+  job->lines = formatBroadcast(job->message, (MessageSlice){job->linePrefix, job->linePrefixLength});
+
+  job->stamps.at[kMarkFormatEnd] = traceNow();
+  traceRecord(kStageFormat, job->stamps.at[kMarkFormatEnd] - job->stamps.at[kMarkFormatStart]);
+}
+
+/*
+ *  Function  : completeBroadcastJob()
+ *  Summary   : This function runs on the sender's thread once the lines are formatted, broadcasts them,
+ *              and forwards them to the other cluster nodes. The lines carry the read time (and trace id,
+ *              if sampled) so each recipient's write can be measured; the wait for clients_mutex while
+ *              broadcasting is charged to the message.
+ *  Params    : WorkItem* item
+ *  Return    : void
+ */
+void completeBroadcastJob(WorkItem* item)
+{
+  BroadcastJob* job = (BroadcastJob*)item;
+  uint64_t handedBack = traceNow();
+  job->stamps.at[kMarkHandedBack] = handedBack;
+  traceRecord(kStageHandBack, handedBack - job->stamps.at[kMarkFormatEnd]);
+
+  job->lines->readNs = job->stamps.at[kMarkRead];
+  job->lines->traceId = job->stamps.traceId;
+  if (job->stamps.traceId != 0)
+  {
+    traceSampleStore(job->senderSocket, &job->stamps);
+  }
+  traceTakeLockWait();
+  broadcastMessage(job->lines);
+  job->stamps.lockWaitNs = traceTakeLockWait();
+  uint64_t enqueued = traceNow();
+  traceRecord(kStageFanout, enqueued - handedBack);
+  if (job->stamps.traceId != 0)
+  {
+    traceSampleMark(job->stamps.traceId, kMarkEnqueued, enqueued);
+    traceSampleLockWait(job->stamps.traceId, job->stamps.lockWaitNs);
+  }
+
+  clusterForward(job->lines);
+  messageBufferRelease(job->lines);
+  poolFree(&broadcastJobPool, job);
+}
+
+/*
+ *  Function  : drainCompletions()
+ *  Summary   : This function completes finished jobs from the front of the client's list, stopping at the
+ *              first job that is still running so the order of the client's messages is kept.
+ *  Params    : ClientInfo* client
+ *  Return    : void
+ */
+void drainCompletions(ClientInfo* client)
+{
+  while (client->pendingHead != NULL && atomic_load_explicit(&client->pendingHead->done, memory_order_acquire))
+  {
+    WorkItem* item = client->pendingHead;
+    client->pendingHead = item->next;
+    if (client->pendingHead == NULL)
+    {
+      client->pendingTail = NULL;
+    }
+    item->complete(item);
+  }
+}
+
+/*
+ *  Function  : waitForCompletions()
+ *  Summary   : This function blocks until every job the client submitted has completed, and until no
+ *              worker is still signalling the client's eventfd.
+ *  Params    : ClientInfo* client
+ *  Return    : void
+ */
+void waitForCompletions(ClientInfo* client)
+{
+  while (client->pendingHead != NULL)
+  {
+    struct pollfd wakeupPoll = {client->queue->wakeupFd, POLLIN, 0};
+    poll(&wakeupPoll, 1, -1);
+    uint64_t wakeups;
+    read(client->queue->wakeupFd, &wakeups, sizeof(wakeups));
+    drainCompletions(client);
+  }
+  while (atomic_load(&client->signalsInFlight) > 0)
+  {
+    sched_yield();
+  }
+}
+
+/*
+ *  Function  : formatBroadcast()
+ *  Summary   : This function splits a message into 40-character chunks and assembles each chunk into one
+ *              line behind the sender's prefix, packed into a single pooled buffer. A sender that has not
+ *              said Hello has no prefix, and its message produces no lines.
+ *  Params    : const char* message
+ *              MessageSlice linePrefix
+ *  Return    : MessageBuffer*
+ */
+MessageBuffer* formatBroadcast(const char* message, MessageSlice linePrefix)
+{
+  /* Parcel the message; chunks point into it, nothing is copied yet */
+  MessageSlice chunks[kMaxChunks];
+  int chunkCount = (linePrefix.length > 0) ? chunkMessage(message, strlen(message), chunks, kMaxChunks) : 0;
+
+  /* Copy prefix, chunk and timestamp straight into one shared buffer */
+  MessageBuffer* buffer = messageBufferAcquire(kMaxChunks * kMaxLineLength);
+  MessageSlice timestamp = lineTimestamp();
+  for (int i = 0; i < chunkCount; i++)
+  {
+    buffer->length += assembleChatLine(buffer->data + buffer->length, kMaxLineLength, linePrefix, chunks[i],
+                                       timestamp);
+    buffer->data[buffer->length++] = '\n';
+  }
+  return buffer;
+}
+
+/*
+ *  Function  : broadcastMessage()
+ *  Summary   : This function numbers formatted lines, keeps them in the replay ring and the disk history,
+ *              queues them for every client and adds them to the search index. All recipients share the same
+ *              buffer. A large audience is queued by several threads at once (see fanout.h); clients_mutex is
+ *              held until every recipient has it, so each recipient still gets broadcasts in sequence order.
+ *  Params    : MessageBuffer* lines
+ *  Return    : void
+ */
+void broadcastMessage(MessageBuffer* lines)
+{
+  /* Number the message, keep it for replay and put it in line for the disk, then broadcast it to all clients */
+  traceLockMutex(&clients_mutex);
+  if (lines->length > 0)
+  {
+    replayRingAppend(&chatReplay, lines);
+    historyLogAppend(&chatHistory, lines);
+  }
+  fanoutRun(&broadcastFanout, activeClients.numberOfClients, fanoutBroadcastRange, lines);
+  pthread_mutex_unlock(&clients_mutex);
+
+  /* Write it to disk and index it for search outside clients_mutex, so neither holds up the broadcasts */
+  if (lines->length > 0)
+  {
+    historyLogFlush(&chatHistory);
+    searchIndexAdd(&chatSearch, lines->data, lines->length);
+  }
+}
+
+/*
+ *  Function  : fanoutBroadcastRange()
+ *  Summary   : This function queues a broadcast for one range of the registered clients. Fan-out threads
+ *              call it with clients_mutex held by the thread that started the fan-out.
+ *  Params    : void* context - the MessageBuffer being broadcast
+ *              int begin
+ *              int end
+ *  Return    : void
+ */
+void fanoutBroadcastRange(void* context, int begin, int end)
+{
+  MessageBuffer* lines = context;
+  for (int i = begin; i < end; i++)
+  {
+    queueOutbound(activeClients.queues[i], lines);
+  }
+}
+
+/*
+ *  Function  : broadcastPresence()
+ *  Summary   : This function queues a presence summary on the ephemeral lane of every client that asked for
+ *              presence. A summary still unsent to a client is replaced rather than followed, so a slow
+ *              client gets only the newest state.
+ *  Params    : MessageBuffer* summary
+ *  Return    : void
+ */
+void broadcastPresence(MessageBuffer* summary)
+{
+  traceLockMutex(&clients_mutex);
+  for (int i = 0; i < activeClients.numberOfClients; i++)
+  {
+    if (activeClients.clients[i]->wantsPresence)
+    {
+      queueEphemeral(activeClients.queues[i], summary, kPresenceCoalesceKey);
+    }
+  }
+  pthread_mutex_unlock(&clients_mutex);
+}
+
+/*
+ *  Function  : subscribePresence()
+ *  Summary   : This function starts sending presence summaries to a registered client, beginning with the
+ *              current one. Asking again just sends the current summary again.
+ *  Params    : ClientInfo* client
+ *  Return    : void
+ */
+void subscribePresence(ClientInfo* client)
+{
+  if (client->linePrefixLength == 0)
+  {
+    return;
+  }
+
+  /* Under clients_mutex, so a newer summary being broadcast cannot be replaced by this older one */
+  pthread_mutex_lock(&clients_mutex);
+  client->wantsPresence = true;
+  MessageBuffer* summary = presenceCurrent(&chatPresence);
+  if (summary != NULL)
+  {
+    queueEphemeral(client->queue, summary, kPresenceCoalesceKey);
+    messageBufferRelease(summary);
+  }
+  pthread_mutex_unlock(&clients_mutex);
+}
+
+/*
+ *  Function  : enqueueOutbound()
+ *  Summary   : This function appends a shared buffer to a client's outbound queue.
+ *  Params    : ClientInfo* client
+ *              MessageBuffer* buffer
+ *  Return    : void
+ */
+void enqueueOutbound(ClientInfo* client, MessageBuffer* buffer)
+{
+  queueOutbound(client->queue, buffer);
+}
+
+/*
+ *  Function  : queueOutbound()
+ *  Summary   : This function appends a shared buffer to an outbound queue's chat lane. Fan-out calls this
+ *              directly, so broadcasting never touches the rest of a recipient's session.
+ *  Params    : OutboundQueue* queue
+ *              MessageBuffer* buffer
+ *  Return    : void
+ */
+void queueOutbound(OutboundQueue* queue, MessageBuffer* buffer)
+{
+  queueOutboundLane(queue, kLaneChat, buffer);
+}
+
+/*
+ *  Function  : queueOutboundLane()
+ *  Summary   : This function appends a shared buffer to one lane of an outbound queue and wakes the client's
+ *              thread if the queue was empty. The queue takes its own reference on the buffer.
+ *  Params    : OutboundQueue* queue
+ *              OutboundLane lane - kLaneControl or kLaneChat; see queueEphemeral() for the third
+ *              MessageBuffer* buffer
+ *  Return    : void
+ */
+void queueOutboundLane(OutboundQueue* queue, OutboundLane lane, MessageBuffer* buffer)
+{
+  if (buffer->length == 0)
+  {
+    return;
+  }
+
+  OutboundNode* node = poolAlloc(&outboundNodePool);
+  node->buffer = buffer;
+  messageBufferRetain(buffer);
+  appendOutboundNode(queue, lane, node, buffer->length);
+}
+
+/*
+ *  Function  : queueEphemeral()
+ *  Summary   : This function queues an ephemeral event, which only matters until a newer one says otherwise.
+ *              An unsent event with the same key has its buffer swapped for this one and keeps its place;
+ *              otherwise the event is appended, unless the lane is full or the client already has
+ *              kEphemeralMaxBacklog bytes waiting, in which case it is dropped. The lane is written only when
+ *              control and chat are empty, so under load its events coalesce instead of piling up.
+ *  Params    : OutboundQueue* queue
+ *              MessageBuffer* buffer
+ *              uint32_t coalesceKey - events with equal keys supersede each other, e.g. one per user and kind
+ *  Return    : bool - false if the event was dropped
+ */
+bool queueEphemeral(OutboundQueue* queue, MessageBuffer* buffer, uint32_t coalesceKey)
+{
+  if (buffer->length == 0)
+  {
+    return true;
+  }
+
+  pthread_mutex_lock(&queue->mutex);
+  OutboundNode* first = queue->head[kLaneEphemeral];
+  if (first != NULL && queue->writingLane == kLaneEphemeral)
+  {
+    first = first->next;      // the node being written cannot change under the writer
+  }
+  for (OutboundNode* node = first; node != NULL; node = node->next)
+  {
+    if (node->coalesceKey == coalesceKey)
+    {
+      MessageBuffer* replaced = node->buffer;
+      queue->queuedBytes += buffer->length - replaced->length;
+      node->buffer = buffer;
+      messageBufferRetain(buffer);
+      noteQueueChange(queue);
+      pthread_mutex_unlock(&queue->mutex);
+      messageBufferRelease(replaced);
+      atomic_fetch_add_explicit(&ephemeralCoalesced, 1, memory_order_relaxed);
+      return true;
+    }
+  }
+  bool full = queue->ephemeralCount >= kEphemeralMaxNodes || queue->queuedBytes >= kEphemeralMaxBacklog;
+  pthread_mutex_unlock(&queue->mutex);
+  if (full)
+  {
+    atomic_fetch_add_explicit(&ephemeralDropped, 1, memory_order_relaxed);
+    return false;
+  }
+
+  /* Two producers may both get here for one key; the lane then holds both, which is harmless */
+  OutboundNode* node = poolAlloc(&outboundNodePool);
+  node->buffer = buffer;
+  node->coalesceKey = coalesceKey;
+  messageBufferRetain(buffer);
+  appendOutboundNode(queue, kLaneEphemeral, node, buffer->length);
+  atomic_fetch_add_explicit(&ephemeralQueued, 1, memory_order_relaxed);
+  return true;
+}
+
+/*
+ *  Function  : enqueueHistory()
+ *  Summary   : This function appends a range of the disk history to a client's outbound queue. The queue
+ *              takes over the range's reference on its segment.
+ *  Params    : ClientInfo* client
+ *              HistoryRange range
+ *  Return    : void
+ */
+void enqueueHistory(ClientInfo* client, HistoryRange range)
+{
+  if (range.length == 0)
+  {
+    historySegmentRelease(range.segment);
+    return;
+  }
+
+  OutboundNode* node = poolAlloc(&outboundNodePool);
+  node->buffer = NULL;
+  node->history = range;
+  appendOutboundNode(client->queue, kLaneChat, node, range.length);
+}
+
+/*
+ *  Function  : appendOutboundNode()
+ *  Summary   : This function links a filled-in node at the tail of one lane of a queue and wakes the client's
+ *              thread if the whole queue was empty; otherwise the thread is already busy writing it. A
+ *              control or chat buffer that would leave more than kOutboundMaxBuffered bytes in memory for
+ *              the client is not queued; the queue is marked overflowed instead and the client's thread
+ *              woken to disconnect it, since a client that far behind has lost its place in the chat anyway.
+ *  Params    : OutboundQueue* queue
+ *              OutboundLane lane
+ *              OutboundNode* node - buffer (or history) set, and coalesceKey for the ephemeral lane; the rest
+ *                                   is filled in here
+ *              size_t length - bytes the node will send
+ *  Return    : void
+ */
+void appendOutboundNode(OutboundQueue* queue, OutboundLane lane, OutboundNode* node, size_t length)
+{
+  node->next = NULL;
+  node->offset = 0;
+  node->enqueuedNs = traceNow();
+
+  bool buffered = (lane != kLaneEphemeral && node->buffer != NULL);
+  pthread_mutex_lock(&queue->mutex);
+  if (buffered && (queue->overflowed || queue->bufferedBytes + length > kOutboundMaxBuffered))
+  {
+    bool first = !queue->overflowed;
+    queue->overflowed = true;
+    pthread_mutex_unlock(&queue->mutex);
+    releaseOutboundNode(node);
+    if (first)
+    {
+      atomic_fetch_add_explicit(&slowDisconnects, 1, memory_order_relaxed);
+      serverTransport->wake(queue->wakeupFd);
+    }
+    return;
+  }
+  bool wasEmpty = (queue->queuedBytes == 0);
+  if (queue->head[lane] == NULL)
+  {
+    queue->head[lane] = node;
+  }
+  else
+  {
+    queue->tail[lane]->next = node;
+  }
+  queue->tail[lane] = node;
+  queue->queuedBytes += length;
+  queue->bufferedBytes += buffered ? length : 0;
+  queue->ephemeralCount += (lane == kLaneEphemeral);
+  noteQueueChange(queue);
+  pthread_mutex_unlock(&queue->mutex);
+
+  if (wasEmpty)
+  {
+    serverTransport->wake(queue->wakeupFd);
+  }
+}
+
+/*
+ *  Function  : outboundWriteOrder()
+ *  Summary   : This function lists the lanes that hold nodes in the order they will be written: the lane of a
+ *              partly written node first, then by priority. Hot restart hands queues over in this order.
+ *              The caller holds the queue's mutex or is the client's own thread.
+ *  Params    : const OutboundQueue* queue
+ *              OutboundLane order[kLaneCount]
+ *  Return    : int - the number of lanes listed
+ */
+int outboundWriteOrder(const OutboundQueue* queue, OutboundLane order[kLaneCount])
+{
+  int count = 0;
+  if (queue->writingLane >= 0)
+  {
+    order[count++] = queue->writingLane;
+  }
+  for (int lane = 0; lane < kLaneCount; lane++)
+  {
+    if (lane != queue->writingLane && queue->head[lane] != NULL)
+    {
+      order[count++] = lane;
+    }
+  }
+  return count;
+}
+
+/*
+ *  Function  : outboundPrintStats()
+ *  Summary   : This function prints what happened to ephemeral events, and how many clients were dropped for
+ *              falling too far behind.
+ *  Params    : FILE* stream
+ *  Return    : void
+ */
+void outboundPrintStats(FILE* stream)
+{
+  fprintf(stream, "ephemeral events: %llu queued, %llu coalesced into an unsent one, %llu dropped under load\n",
+          (unsigned long long)atomic_load(&ephemeralQueued), (unsigned long long)atomic_load(&ephemeralCoalesced),
+          (unsigned long long)atomic_load(&ephemeralDropped));
+  fprintf(stream, "slow clients: %llu disconnected with more than %u bytes of chat waiting\n",
+          (unsigned long long)atomic_load(&slowDisconnects), kOutboundMaxBuffered);
+}
+
+/*
+ *  Function  : outboundNodeLength()
+ *  Summary   : This function returns the bytes a node was queued with.
+ *  Params    : const OutboundNode* node
+ *  Return    : size_t
+ */
+size_t outboundNodeLength(const OutboundNode* node)
+{
+  return (node->buffer != NULL) ? node->buffer->length : node->history.length;
+}
+
+/*
+ *  Function  : releaseOutboundNode()
+ *  Summary   : This function drops what a node refers to and returns it to its pool.
+ *  Params    : OutboundNode* node
+ *  Return    : void
+ */
+void releaseOutboundNode(OutboundNode* node)
+{
+  if (node->buffer != NULL)
+  {
+    messageBufferRelease(node->buffer);
+  }
+  else
+  {
+    historySegmentRelease(node->history.segment);
+  }
+  poolFree(&outboundNodePool, node);
+}
+
+/*
+ *  Function  : flushOutbound()
+ *  Summary   : This function writes as much of the client's outbound queue as the socket (or shared-memory
+ *              ring) accepts, lane by lane: each node comes from the highest-priority lane that has one, once
+ *              the node in progress is finished. History nodes go to a socket with sendfile(); the ring, and
+ *              a transport other than the socket one, need them copied out. Zero-copy sends bypass the
+ *              transport too, but only sessions accepted from a real listener have them. Only the client's own
+ *              thread removes nodes, so a head can be written outside the lock.
+ *  Params    : ClientInfo* client
+ *  Return    : int - 0 when the queue is empty, 1 when the socket is full, -1 on a write error or when the
+ *              queue overflowed (see appendOutboundNode())
+ */
+int flushOutbound(ClientInfo* client)
+{
+  OutboundQueue* queue = client->queue;
+  while (true)
+  {
+    /* Claim the next node under the lock, so an ephemeral event being written is not swapped meanwhile */
+    OutboundLane order[kLaneCount];
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->writingLane >= 0 && queue->head[queue->writingLane]->offset == 0)
+    {
+      queue->writingLane = -1;    // nothing of it went out yet, so a higher lane may still go first
+    }
+    OutboundLane lane = (outboundWriteOrder(queue, order) > 0) ? order[0] : kLaneCount;
+    OutboundNode* node = (lane < kLaneCount) ? queue->head[lane] : NULL;
+    queue->writingLane = (lane < kLaneCount) ? (int)lane : -1;
+    bool overflowed = queue->overflowed;
+    pthread_mutex_unlock(&queue->mutex);
+    if (overflowed)
+    {
+      return -1;
+    }
+    if (node == NULL)
+    {
+      return 0;
+    }
+
+    ssize_t written;
+    struct iovec parts[2];
+    int partCount = outboundRemaining(client, node, parts);
+    size_t remaining = (node->buffer == NULL) ? node->history.length - node->offset
+                                              : parts[0].iov_len + (partCount > 1 ? parts[1].iov_len : 0);
+    bool pieceTaken = false;
+    if (node->buffer == NULL)
+    {
+      if (client->shm != NULL || serverTransport != &socketTransport)
+      {
+        /* Copied out: one record per piece for the ring, cut after its last whole line; other transports
+           have no descriptor for sendfile() */
+        char piece[kHistoryCopySize];
+        size_t length = historyRangeRead(&node->history, node->offset, piece, sizeof(piece));
+        const char* lineEnd = (length < remaining) ? memrchr(piece, '\n', length) : NULL;
+        if (lineEnd != NULL)
+        {
+          length = lineEnd + 1 - piece;
+        }
+        if (length == 0)
+        {
+          // Unreadable; skip what is left rather than retry it forever
+          written = remaining;
+        }
+        else if (client->shm != NULL)
+        {
+          if ((written = shmTransportSend(client->shm, piece, length)) == 0)
+          {
+            return 1;
+          }
+        }
+        else
+        {
+          struct iovec whole = {.iov_base = piece, .iov_len = length};
+          struct msghdr message = {.msg_iov = &whole, .msg_iovlen = 1};
+          written = serverTransport->send(client->clientSocket, &message, MSG_NOSIGNAL);
+          pieceTaken = (written == (ssize_t)length);
+        }
+      }
+      else
+      {
+        written = historyRangeSend(client->clientSocket, &node->history, node->offset);
+      }
+    }
+    else if (client->shm != NULL)
+    {
+      /* The ring takes whole records only */
+      if ((written = shmTransportSend(client->shm, parts[0].iov_base, parts[0].iov_len)) == 0)
+      {
+        return 1;
+      }
+    }
+    else
+    {
+      struct msghdr message = {.msg_iov = parts, .msg_iovlen = partCount};
+      written = (client->zeroCopy != NULL && remaining >= zeroCopyThreshold)
+                  ? zeroCopySend(client->zeroCopy, client->clientSocket, &message, node->buffer)
+                  : serverTransport->send(client->clientSocket, &message, MSG_NOSIGNAL);
+    }
+    if (written < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        return 1;
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("Write error");
+      return -1;
+    }
+
+    node->offset += written;
+    client->bytesOut += written;
+    if ((size_t)written < remaining)
+    {
+      // The ring or transport took one piece of a history node and may have room for the next
+      if (client->shm != NULL || pieceTaken)
+      {
+        continue;
+      }
+      return 1;
+    }
+
+    /* Node fully written; time how long it waited for this client, then unlink and recycle it */
+    if (node->buffer != NULL && node->buffer->readNs != 0)
+    {
+      uint64_t writtenNs = traceNow();
+      traceRecord(kStageSocketWait, writtenNs - node->enqueuedNs);
+      traceRecord(kStageEndToEnd, writtenNs - node->buffer->readNs);
+      if (node->buffer->traceId != 0)
+      {
+        traceSampleWrite(node->buffer->traceId, client->clientSocket, writtenNs);
+      }
+    }
+    pthread_mutex_lock(&queue->mutex);
+    queue->head[lane] = node->next;
+    if (queue->head[lane] == NULL)
+    {
+      queue->tail[lane] = NULL;
+    }
+    queue->queuedBytes -= outboundNodeLength(node);
+    queue->bufferedBytes -= (lane != kLaneEphemeral && node->buffer != NULL) ? outboundNodeLength(node) : 0;
+    queue->ephemeralCount -= (lane == kLaneEphemeral);
+    queue->writingLane = -1;
+    noteQueueChange(queue);
+    pthread_mutex_unlock(&queue->mutex);
+
+    releaseOutboundNode(node);
+  }
+}
+
+/*
+ *  Function  : outboundRemaining()
+ *  Summary   : This function describes what is left to write of a queued node: the rest of its data and,
+ *              for a resuming client on a socket, the rest of the message's "Seq|<n>" line. node->offset
+ *              counts across both. A history node's bytes are on disk and are not described.
+ *  Params    : const ClientInfo* client
+ *              const OutboundNode* node
+ *              struct iovec parts[2]
+ *  Return    : int - the number of parts filled in (at least 1, possibly empty; 0 for a history node)
+ */
+int outboundRemaining(const ClientInfo* client, const OutboundNode* node, struct iovec parts[2])
+{
+  MessageBuffer* buffer = node->buffer;
+  if (buffer == NULL)
+  {
+    return 0;
+  }
+  size_t dataOffset = node->offset < buffer->length ? node->offset : buffer->length;
+  parts[0] = (struct iovec){buffer->data + dataOffset, buffer->length - dataOffset};
+  if (!client->resumes || client->shm != NULL || buffer->sequenceLineLength == 0)
+  {
+    return 1;
+  }
+
+  size_t lineOffset = node->offset - dataOffset;
+  parts[1] = (struct iovec){buffer->sequenceLine + lineOffset, buffer->sequenceLineLength - lineOffset};
+  return 2;
+}
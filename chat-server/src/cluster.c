@@ -0,0 +1,471 @@
+/*
+*   FILE          : cluster.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements cluster mode. Each node dials every peer it is given
+*      and uses that connection only to send its own clients' messages, so a
+*      full mesh needs every node to list all the others. A sender thread per
+*      peer writes whatever frames are queued in one sendmsg() call, and a reader
+*      thread per inbound link broadcasts received frames to the local clients.
+*      Frames carry the origin node and a per-origin sequence number, which keeps
+*      them in order and drops duplicates resent after a reconnect.
+*/
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <endian.h>
+#include <time.h>
+#include "../inc/chat-server.h"
+#include "../inc/cluster.h"
+
+static int localNodeId = -1;
+static uint64_t localEpoch;
+static pthread_mutex_t forwardMutex = PTHREAD_MUTEX_INITIALIZER;   // numbers frames and queues them, in one step
+static uint64_t localSequence = 0;
+static int peerCount = 0;
+static ClusterPeer peers[kMaxClusterPeers];
+static SlabPool clusterFramePool;
+
+// Last sequence accepted from every origin node
+static pthread_mutex_t originMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t originEpochs[kMaxClusterNodes];
+static uint64_t originSequences[kMaxClusterNodes];
+
+static void* clusterAcceptLoop(void* arg);
+static void* clusterSenderLoop(void* arg);
+static void* clusterReaderLoop(void* arg);
+static int connectToPeer(ClusterPeer* peer);
+static bool readFully(int socket, void* buffer, size_t length);
+
+/*
+ *  Function  : clusterAddPeer()
+ *  Summary   : This function records a peer given as "host:port" on the command line.
+ *  Params    : const char* peerSpec
+ *  Return    : bool - false when the spec is malformed or there are too many peers
+ */
+bool clusterAddPeer(const char* peerSpec)
+{
+  const char* colon = strrchr(peerSpec, ':');
+  if (peerCount >= kMaxClusterPeers || colon == NULL || colon == peerSpec ||
+      (size_t)(colon - peerSpec) >= kClusterHostLength)
+  {
+    return false;
+  }
+
+  ClusterPeer* peer = &peers[peerCount];
+  memset(peer, 0, sizeof(*peer));
+  memcpy(peer->host, peerSpec, colon - peerSpec);
+  peer->port = atoi(colon + 1);
+  if (peer->port <= 0 || peer->port > 65535)
+  {
+    return false;
+  }
+  peer->peerSocket = -1;
+  peerCount++;
+  return true;
+}
+
+/*
+ *  Function  : clusterStart()
+ *  Summary   : This function starts listening for peers on listenPort and starts one sender thread per peer.
+ *  Params    : int nodeId
+ *              int listenPort
+ *  Return    : void
+ */
+void clusterStart(int nodeId, int listenPort)
+{
+  if (nodeId < 0 || nodeId >= kMaxClusterNodes)
+  {
+    displayFatalError("clusterStart(): node id out of range");
+  }
+  localNodeId = nodeId;
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  localEpoch = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+  poolInit(&clusterFramePool, "cluster-frame", sizeof(ClusterFrame));
+
+  /* Listen for peers dialling in */
+  int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenSocket < 0)
+  {
+    displayFatalError("cluster socket() FAILED");
+  }
+  int reuse = 1;
+  setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  struct sockaddr_in listenAddress = {};
+  listenAddress.sin_family = AF_INET;
+  listenAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+  listenAddress.sin_port = htons(listenPort);
+  if (bind(listenSocket, (struct sockaddr*)&listenAddress, sizeof(listenAddress)) < 0 ||
+      listen(listenSocket, kMaxClusterPeers) < 0)
+  {
+    close(listenSocket);
+    displayFatalError("cluster bind()/listen() FAILED");
+  }
+
+  pthread_t acceptThread;
+  if (pthread_create(&acceptThread, NULL, clusterAcceptLoop, (void*)(intptr_t)listenSocket) != 0)
+  {
+    displayFatalError("pthread_create() FAILED");
+  }
+  pthread_detach(acceptThread);
+
+  /* Dial out to every peer */
+  for (int i = 0; i < peerCount; i++)
+  {
+    pthread_mutex_init(&peers[i].lock, NULL);
+    pthread_cond_init(&peers[i].framesReady, NULL);
+    if (pthread_create(&peers[i].senderThread, NULL, clusterSenderLoop, &peers[i]) != 0)
+    {
+      displayFatalError("pthread_create() FAILED");
+    }
+    pthread_detach(peers[i].senderThread);
+  }
+
+  printf("Cluster node %d listening for peers on port %d, %d peer(s) configured\n", nodeId, listenPort, peerCount);
+}
+
+/*
+ *  Function  : clusterEnabled()
+ *  Summary   : This function reports whether the server was started in cluster mode.
+ *  Params    : void
+ *  Return    : bool
+ */
+bool clusterEnabled(void)
+{
+  return localNodeId >= 0;
+}
+
+/*
+ *  Function  : clusterForward()
+ *  Summary   : This function wraps locally formatted lines in a single frame and queues that same frame for
+ *              every peer, no matter how many clients the peers have. The sequence number is taken under
+ *              the same lock that queues the frame, so every peer gets the frames in sequence order; a peer
+ *              drops any frame that arrives after a higher one.
+ *  Params    : MessageBuffer* lines
+ *  Return    : void
+ */
+void clusterForward(MessageBuffer* lines)
+{
+  if (!clusterEnabled() || peerCount == 0 || lines == NULL || lines->length == 0 || lines->length > UINT16_MAX)
+  {
+    return;
+  }
+
+  /* Build the frame once */
+  MessageBuffer* frame = messageBufferAcquire(sizeof(ClusterFrameHeader) + lines->length);
+  ClusterFrameHeader header;
+  header.magic = htonl(kClusterFrameMagic);
+  header.originNode = htons((uint16_t)localNodeId);
+  header.length = htons((uint16_t)lines->length);
+  header.originEpoch = htobe64(localEpoch);
+  memcpy(frame->data + sizeof(header), lines->data, lines->length);
+  frame->length = sizeof(header) + lines->length;
+
+  /* Number it and queue it for every peer */
+  pthread_mutex_lock(&forwardMutex);
+  header.sequence = htobe64(++localSequence);
+  memcpy(frame->data, &header, sizeof(header));
+  for (int i = 0; i < peerCount; i++)
+  {
+    ClusterPeer* peer = &peers[i];
+    pthread_mutex_lock(&peer->lock);
+    if (peer->queuedFrames >= kClusterMaxQueuedFrames)
+    {
+      peer->framesDropped++;
+      pthread_mutex_unlock(&peer->lock);
+      continue;
+    }
+
+    ClusterFrame* node = poolAlloc(&clusterFramePool);
+    node->next = NULL;
+    node->buffer = frame;
+    messageBufferRetain(frame);
+    if (peer->queueTail == NULL)
+    {
+      peer->queueHead = node;
+    }
+    else
+    {
+      peer->queueTail->next = node;
+    }
+    peer->queueTail = node;
+    peer->queuedFrames++;
+    pthread_cond_signal(&peer->framesReady);
+    pthread_mutex_unlock(&peer->lock);
+  }
+  pthread_mutex_unlock(&forwardMutex);
+  messageBufferRelease(frame);
+}
+
+/*
+ *  Function  : clusterPrintStats()
+ *  Summary   : This function prints per-peer forwarding counters.
+ *  Params    : FILE* stream
+ *  Return    : void
+ */
+void clusterPrintStats(FILE* stream)
+{
+  for (int i = 0; i < peerCount; i++)
+  {
+    pthread_mutex_lock(&peers[i].lock);
+    fprintf(stream, "peer %s:%d frames=%llu batches=%llu queued=%zu dropped=%llu\n", peers[i].host, peers[i].port,
+            (unsigned long long)peers[i].framesSent, (unsigned long long)peers[i].batchesSent, peers[i].queuedFrames,
+            (unsigned long long)peers[i].framesDropped);
+    pthread_mutex_unlock(&peers[i].lock);
+  }
+}
+
+/*
+ *  Function  : clusterAcceptLoop()
+ *  Summary   : This function accepts inbound peer links and starts a reader thread for each.
+ *  Params    : void* arg - the listening socket
+ *  Return    : void*
+ */
+static void* clusterAcceptLoop(void* arg)
+{
+  int listenSocket = (int)(intptr_t)arg;
+  while (true)
+  {
+    int peerSocket = accept(listenSocket, NULL, NULL);
+    if (peerSocket < 0)
+    {
+      if (errno != EINTR)
+      {
+        perror("cluster accept() FAILED");
+        sleep(kClusterRetrySeconds);
+      }
+      continue;
+    }
+
+    pthread_t readerThread;
+    if (pthread_create(&readerThread, NULL, clusterReaderLoop, (void*)(intptr_t)peerSocket) != 0)
+    {
+      perror("pthread_create() FAILED");
+      close(peerSocket);
+      continue;
+    }
+    pthread_detach(readerThread);
+  }
+  return NULL;
+}
+
+/*
+ *  Function  : clusterSenderLoop()
+ *  Summary   : This function keeps one peer's link up and writes all queued frames in batches.
+ *              A batch that fails is kept and resent after reconnecting; the peer drops duplicates.
+ *  Params    : void* arg - the ClusterPeer
+ *  Return    : void*
+ */
+static void* clusterSenderLoop(void* arg)
+{
+  ClusterPeer* peer = arg;
+  while (true)
+  {
+    if (peer->peerSocket < 0 && connectToPeer(peer) < 0)
+    {
+      sleep(kClusterRetrySeconds);
+      continue;
+    }
+
+    /* Wait for frames and take up to one batch without unlinking them */
+    pthread_mutex_lock(&peer->lock);
+    while (peer->queueHead == NULL)
+    {
+      pthread_cond_wait(&peer->framesReady, &peer->lock);
+    }
+    struct iovec batch[kClusterMaxBatch];
+    int batchCount = 0;
+    size_t batchBytes = 0;
+    for (ClusterFrame* frame = peer->queueHead; frame != NULL && batchCount < kClusterMaxBatch; frame = frame->next)
+    {
+      batch[batchCount].iov_base = frame->buffer->data;
+      batch[batchCount].iov_len = frame->buffer->length;
+      batchBytes += frame->buffer->length;
+      batchCount++;
+    }
+    pthread_mutex_unlock(&peer->lock);
+
+    /* Write the whole batch, following partial writes */
+    struct msghdr batchMessage = {};
+    batchMessage.msg_iov = batch;
+    batchMessage.msg_iovlen = batchCount;
+    bool failed = false;
+    while (batchBytes > 0)
+    {
+      ssize_t written = sendmsg(peer->peerSocket, &batchMessage, MSG_NOSIGNAL);
+      if (written < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        failed = true;
+        break;
+      }
+      batchBytes -= written;
+      while (written > 0 && batchMessage.msg_iovlen > 0)
+      {
+        if ((size_t)written >= batchMessage.msg_iov->iov_len)
+        {
+          written -= batchMessage.msg_iov->iov_len;
+          batchMessage.msg_iov++;
+          batchMessage.msg_iovlen--;
+        }
+        else
+        {
+          batchMessage.msg_iov->iov_base = (char*)batchMessage.msg_iov->iov_base + written;
+          batchMessage.msg_iov->iov_len -= written;
+          written = 0;
+        }
+      }
+    }
+    if (failed)
+    {
+      fprintf(stderr, "cluster link to %s:%d lost, reconnecting\n", peer->host, peer->port);
+      close(peer->peerSocket);
+      peer->peerSocket = -1;
+      continue;
+    }
+
+    /* Release what was sent */
+    pthread_mutex_lock(&peer->lock);
+    for (int i = 0; i < batchCount; i++)
+    {
+      ClusterFrame* frame = peer->queueHead;
+      peer->queueHead = frame->next;
+      messageBufferRelease(frame->buffer);
+      poolFree(&clusterFramePool, frame);
+    }
+    if (peer->queueHead == NULL)
+    {
+      peer->queueTail = NULL;
+    }
+    peer->queuedFrames -= batchCount;
+    peer->framesSent += batchCount;
+    peer->batchesSent++;
+    pthread_mutex_unlock(&peer->lock);
+  }
+  return NULL;
+}
+
+/*
+ *  Function  : clusterReaderLoop()
+ *  Summary   : This function reads frames from one inbound peer link and broadcasts new ones locally.
+ *  Params    : void* arg - the peer socket
+ *  Return    : void*
+ */
+static void* clusterReaderLoop(void* arg)
+{
+  int peerSocket = (int)(intptr_t)arg;
+  while (true)
+  {
+    ClusterFrameHeader header;
+    if (!readFully(peerSocket, &header, sizeof(header)) || ntohl(header.magic) != kClusterFrameMagic)
+    {
+      break;
+    }
+    uint16_t originNode = ntohs(header.originNode);
+    uint16_t length = ntohs(header.length);
+    uint64_t originEpoch = be64toh(header.originEpoch);
+    uint64_t sequence = be64toh(header.sequence);
+    if (originNode >= kMaxClusterNodes || originNode == localNodeId)
+    {
+      break;
+    }
+
+    MessageBuffer* lines = messageBufferAcquire(length);
+    if (!readFully(peerSocket, lines->data, length))
+    {
+      messageBufferRelease(lines);
+      break;
+    }
+    lines->length = length;
+
+    /* Keep per-origin order; anything at or below the last sequence was already delivered */
+    pthread_mutex_lock(&originMutex);
+    bool isNew = (originEpochs[originNode] != originEpoch || sequence > originSequences[originNode]);
+    if (isNew)
+    {
+      originEpochs[originNode] = originEpoch;
+      originSequences[originNode] = sequence;
+      broadcastMessage(lines);
+    }
+    pthread_mutex_unlock(&originMutex);
+    messageBufferRelease(lines);
+  }
+
+  close(peerSocket);
+  return NULL;
+}
+
+/*
+ *  Function  : connectToPeer()
+ *  Summary   : This function opens the outbound link to a peer.
+ *  Params    : ClusterPeer* peer
+ *  Return    : int - 0 on success, -1 on failure
+ */
+static int connectToPeer(ClusterPeer* peer)
+{
+  char portText[16];
+  snprintf(portText, sizeof(portText), "%d", peer->port);
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = NULL;
+  if (getaddrinfo(peer->host, portText, &hints, &addresses) != 0)
+  {
+    return -1;
+  }
+
+  int peerSocket = socket(AF_INET, SOCK_STREAM, 0);
+  if (peerSocket < 0 || connect(peerSocket, addresses->ai_addr, addresses->ai_addrlen) < 0)
+  {
+    if (peerSocket >= 0)
+    {
+      close(peerSocket);
+    }
+    freeaddrinfo(addresses);
+    return -1;
+  }
+  freeaddrinfo(addresses);
+
+  /* Frames are already batched, so do not let Nagle hold them back */
+  int noDelay = 1;
+  setsockopt(peerSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  peer->peerSocket = peerSocket;
+  printf("Cluster link to %s:%d established\n", peer->host, peer->port);
+  return 0;
+}
+
+/*
+ *  Function  : readFully()
+ *  Summary   : This function reads exactly length bytes from a blocking socket.
+ *  Params    : int socket
+ *              void* buffer
+ *              size_t length
+ *  Return    : bool - false on EOF or error
+ */
+static bool readFully(int socket, void* buffer, size_t length)
+{
+  char* position = buffer;
+  while (length > 0)
+  {
+    ssize_t bytesRead = read(socket, position, length);
+    if (bytesRead < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (bytesRead <= 0)
+    {
+      return false;
+    }
+    position += bytesRead;
+    length -= bytesRead;
+  }
+  return true;
+}
@@ -0,0 +1,299 @@
+/*
+*   FILE          : fanout.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements parallel fan-out with work stealing over index
+*      ranges. Each participant's share is one atomic word: the owner moves its
+*      front forward by a chunk, a thief moves its back down by half, both with
+*      compare-and-swap, so the two never hand out the same index. Shares carry
+*      the round's generation, so a helper that wakes after its round is over
+*      fails every swap instead of taking from the next one. The caller waits
+*      for the count of indexes left, not for the helpers, so a helper that is
+*      slow to wake costs only what it would have taken.
+*/
+
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+#include "../inc/fanout.h"
+#include "../inc/affinity.h"
+
+typedef struct FanoutHelper
+{
+  FanoutPool* pool;
+  int index;
+} FanoutHelper;
+
+static FanoutHelper helperArgs[kMaxFanoutThreads];
+
+static void* helperMain(void* arg);
+static void participate(FanoutPool* pool, int self, uint64_t generation);
+static bool stealInto(FanoutPool* pool, int self, uint64_t generation);
+static uint64_t packShare(uint64_t generation, uint64_t begin, uint64_t end);
+
+/*
+ *  Function  : fanoutPoolInit()
+ *  Summary   : This function starts the helper threads, on the worker cores.
+ *  Params    : FanoutPool* pool
+ *              int helperCount - 0 makes every fan-out run on the calling thread
+ *  Return    : void
+ */
+void fanoutPoolInit(FanoutPool* pool, int helperCount)
+{
+  if (helperCount < 0)
+  {
+    helperCount = 0;
+  }
+  if (helperCount > kMaxFanoutThreads)
+  {
+    helperCount = kMaxFanoutThreads;
+  }
+  for (int i = 0; i <= kMaxFanoutThreads; i++)
+  {
+    atomic_init(&pool->shares[i].range, 0);
+  }
+  atomic_init(&pool->remaining, 0);
+  atomic_init(&pool->stopping, false);
+  atomic_init(&pool->rounds, 0);
+  atomic_init(&pool->inlineRounds, 0);
+  atomic_init(&pool->steals, 0);
+  pool->generation = 0;
+
+  for (int i = 0; i < helperCount; i++)
+  {
+    sem_init(&pool->wakeups[i], 0, 0);
+    helperArgs[i] = (FanoutHelper){pool, i + 1};
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    affinityPrepareWorkerThread(&attributes, i);
+    if (pthread_create(&pool->helpers[i], &attributes, helperMain, &helperArgs[i]) != 0)
+    {
+      perror("pthread_create() FAILED");
+      exit(EXIT_FAILURE);
+    }
+    pthread_attr_destroy(&attributes);
+  }
+  pool->helperCount = helperCount;
+}
+
+/*
+ *  Function  : fanoutRun()
+ *  Summary   : This function calls function(context, begin, end) over pieces that together cover [0, count)
+ *              exactly once, on this thread and the helpers, and returns when every piece is done. Calls for
+ *              one pool must not overlap; the server makes them under clients_mutex.
+ *  Params    : FanoutPool* pool
+ *              int count
+ *              FanoutFunction function
+ *              void* context
+ *  Return    : void
+ */
+void fanoutRun(FanoutPool* pool, int count, FanoutFunction function, void* context)
+{
+  if (count <= 0)
+  {
+    return;
+  }
+  if (pool->helperCount == 0 || count < kFanoutParallelMin || count > kFanoutMaxRange)
+  {
+    function(context, 0, count);
+    atomic_fetch_add_explicit(&pool->inlineRounds, 1, memory_order_relaxed);
+    return;
+  }
+
+  /* Publish the work before the shares; a participant reads it only after taking from a share */
+  pool->function = function;
+  pool->context = context;
+  uint64_t generation = ++pool->generation & 0xFFFF;
+  atomic_store_explicit(&pool->remaining, count, memory_order_relaxed);
+  int participants = pool->helperCount + 1;
+  for (int i = 0; i < participants; i++)
+  {
+    uint64_t begin = (uint64_t)count * i / participants;
+    uint64_t end = (uint64_t)count * (i + 1) / participants;
+    atomic_store_explicit(&pool->shares[i].range, packShare(generation, begin, end), memory_order_release);
+  }
+  for (int i = 0; i < pool->helperCount; i++)
+  {
+    sem_post(&pool->wakeups[i]);
+  }
+  atomic_fetch_add_explicit(&pool->rounds, 1, memory_order_relaxed);
+
+  participate(pool, 0, generation);
+
+  /* Nothing is left to take; wait for the pieces still being handled elsewhere */
+  while (atomic_load_explicit(&pool->remaining, memory_order_acquire) > 0)
+  {
+    sched_yield();
+  }
+}
+
+/*
+ *  Function  : fanoutPoolShutdown()
+ *  Summary   : This function stops the helpers and waits for them to exit.
+ *  Params    : FanoutPool* pool
+ *  Return    : void
+ */
+void fanoutPoolShutdown(FanoutPool* pool)
+{
+  atomic_store(&pool->stopping, true);
+  for (int i = 0; i < pool->helperCount; i++)
+  {
+    sem_post(&pool->wakeups[i]);
+  }
+  for (int i = 0; i < pool->helperCount; i++)
+  {
+    pthread_join(pool->helpers[i], NULL);
+    sem_destroy(&pool->wakeups[i]);
+  }
+  pool->helperCount = 0;
+}
+
+/*
+ *  Function  : fanoutDefaultHelpers()
+ *  Summary   : This function picks a helper count: one per worker thread, none on a single core, where the
+ *              helpers could only take turns with the thread they are helping.
+ *  Params    : void
+ *  Return    : int
+ */
+int fanoutDefaultHelpers(void)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int helpers = (cores > 1) ? (int)(cores / 2) : 0;
+  return (helpers > kMaxFanoutThreads) ? kMaxFanoutThreads : helpers;
+}
+
+/*
+ *  Function  : fanoutPrintStats()
+ *  Summary   : This function prints how many fan-outs were shared out and how often work was stolen.
+ *  Params    : FanoutPool* pool
+ *              FILE* stream
+ *  Return    : void
+ */
+void fanoutPrintStats(FanoutPool* pool, FILE* stream)
+{
+  fprintf(stream, "fan-out: %d helper thread(s); %llu parallel, %llu on the sender's thread, %llu steals\n",
+          pool->helperCount, (unsigned long long)atomic_load(&pool->rounds),
+          (unsigned long long)atomic_load(&pool->inlineRounds), (unsigned long long)atomic_load(&pool->steals));
+}
+
+/*
+ *  Function  : helperMain()
+ *  Summary   : This function is the body of each helper thread: sleep until a round starts, then take part.
+ *  Params    : void* arg - the helper's FanoutHelper
+ *  Return    : void*
+ */
+static void* helperMain(void* arg)
+{
+  FanoutHelper* helper = arg;
+  FanoutPool* pool = helper->pool;
+  affinityBindLocalMemory();
+  while (true)
+  {
+    sem_wait(&pool->wakeups[helper->index - 1]);
+    if (atomic_load(&pool->stopping))
+    {
+      break;
+    }
+    uint64_t share = atomic_load_explicit(&pool->shares[helper->index].range, memory_order_acquire);
+    participate(pool, helper->index, share >> 48);
+  }
+  return NULL;
+}
+
+/*
+ *  Function  : participate()
+ *  Summary   : This function handles the participant's own share a chunk at a time from the front, steals
+ *              when it is empty, and returns once there is nothing left anywhere to take.
+ *  Params    : FanoutPool* pool
+ *              int self - 0 for the calling thread, the helper's index otherwise
+ *              uint64_t generation - of the round to take part in
+ *  Return    : void
+ */
+static void participate(FanoutPool* pool, int self, uint64_t generation)
+{
+  atomic_uint_fast64_t* own = &pool->shares[self].range;
+  do
+  {
+    uint64_t share = atomic_load_explicit(own, memory_order_acquire);
+    while ((share >> 48) == generation)
+    {
+      uint64_t begin = (share >> 24) & 0xFFFFFF;
+      uint64_t end = share & 0xFFFFFF;
+      if (begin >= end)
+      {
+        break;
+      }
+      uint64_t next = (end - begin > kFanoutChunk) ? begin + kFanoutChunk : end;
+      if (atomic_compare_exchange_weak_explicit(own, &share, packShare(generation, next, end), memory_order_acq_rel,
+                                                memory_order_acquire))
+      {
+        pool->function(pool->context, (int)begin, (int)next);
+        atomic_fetch_sub_explicit(&pool->remaining, (int)(next - begin), memory_order_release);
+        share = atomic_load_explicit(own, memory_order_acquire);
+      }
+    }
+  } while (stealInto(pool, self, generation));
+}
+
+/*
+ *  Function  : stealInto()
+ *  Summary   : This function takes the back half of the largest share in the round (all of it, when that is
+ *              no more than a chunk) and makes it the thief's own share, which is empty when this is called.
+ *  Params    : FanoutPool* pool
+ *              int self
+ *              uint64_t generation
+ *  Return    : bool - false when every share of the round is empty
+ */
+static bool stealInto(FanoutPool* pool, int self, uint64_t generation)
+{
+  int participants = pool->helperCount + 1;
+  while (true)
+  {
+    int victim = -1;
+    uint64_t victimShare = 0;
+    uint64_t largest = 0;
+    for (int i = 0; i < participants; i++)
+    {
+      uint64_t share = atomic_load_explicit(&pool->shares[i].range, memory_order_acquire);
+      uint64_t begin = (share >> 24) & 0xFFFFFF;
+      uint64_t end = share & 0xFFFFFF;
+      if (i != self && (share >> 48) == generation && end > begin && end - begin > largest)
+      {
+        victim = i;
+        victimShare = share;
+        largest = end - begin;
+      }
+    }
+    if (victim < 0)
+    {
+      return false;
+    }
+
+    uint64_t begin = (victimShare >> 24) & 0xFFFFFF;
+    uint64_t end = victimShare & 0xFFFFFF;
+    uint64_t middle = (end - begin > kFanoutChunk) ? begin + (end - begin) / 2 : begin;
+    if (atomic_compare_exchange_strong_explicit(&pool->shares[victim].range, &victimShare,
+                                                packShare(generation, begin, middle), memory_order_acq_rel,
+                                                memory_order_relaxed))
+    {
+      atomic_store_explicit(&pool->shares[self].range, packShare(generation, middle, end), memory_order_release);
+      atomic_fetch_add_explicit(&pool->steals, 1, memory_order_relaxed);
+      return true;
+    }
+  }
+}
+
+/*
+ *  Function  : packShare()
+ *  Summary   : This function packs a share's generation and bounds into one word.
+ *  Params    : uint64_t generation - only the low 16 bits are kept
+ *              uint64_t begin
+ *              uint64_t end
+ *  Return    : uint64_t
+ */
+static uint64_t packShare(uint64_t generation, uint64_t begin, uint64_t end)
+{
+  return (generation & 0xFFFF) << 48 | begin << 24 | end;
+}
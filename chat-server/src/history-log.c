@@ -0,0 +1,389 @@
+/*
+*   FILE          : history-log.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the on-disk history. Segments are named after the
+*      first sequence they hold and only ever appended to. A new segment is
+*      started when the current one is full or the numbering skips, so the
+*      messages of one segment are always consecutive and a sequence number is
+*      found with a subtraction. Nothing is synced: the history is served from
+*      the page cache and lives as long as the process, like the replay ring,
+*      so a starting server clears whatever segments it finds.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "../inc/history-log.h"
+
+#define kSegmentNameFormat "segment-%020llu.log"
+
+static void writeMessage(HistoryLog* log, uint64_t sequence, const char* lines, size_t length);
+static HistorySegment* openSegment(HistoryLog* log, uint64_t firstSequence);
+static void retireOldestSegment(HistoryLog* log);
+static void segmentPath(const HistoryLog* log, uint64_t firstSequence, char* path, size_t size);
+
+/*
+ *  Function  : historyLogInit()
+ *  Summary   : This function creates the history directory if needed and deletes segments left by an earlier
+ *              run. Files that are not named like segments are left alone. The default directory is in /tmp,
+ *              so one that is already there is only used when it is a real directory (not a link), owned by
+ *              this user and closed to everyone else; otherwise another user could have it write, or
+ *              delete, wherever they like.
+ *  Params    : HistoryLog* log
+ *              const char* directory
+ *  Return    : bool - false when the directory cannot be used; the server then runs without disk history
+ */
+bool historyLogInit(HistoryLog* log, const char* directory)
+{
+  memset(log, 0, sizeof(*log));
+  strncpy(log->directory, directory, sizeof(log->directory) - 1);
+  pthread_mutex_init(&log->lock, NULL);
+  pthread_mutex_init(&log->pendingLock, NULL);
+  if (mkdir(directory, S_IRWXU) < 0 && errno != EEXIST)
+  {
+    perror("history mkdir() FAILED");
+    log->failed = true;
+    return false;
+  }
+  struct stat status;
+  if (lstat(directory, &status) < 0 || !S_ISDIR(status.st_mode) || status.st_uid != geteuid() ||
+      (status.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+  {
+    fprintf(stderr, "history directory %s is not private to this user, disk history is off\n", directory);
+    log->failed = true;
+    return false;
+  }
+
+  DIR* listing = opendir(directory);
+  if (listing == NULL)
+  {
+    perror("history opendir() FAILED");
+    log->failed = true;
+    return false;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(listing)) != NULL)
+  {
+    unsigned long long firstSequence;
+    char check[kHistoryPathLength];
+    if (sscanf(entry->d_name, "segment-%llu.log", &firstSequence) == 1 &&
+        snprintf(check, sizeof(check), kSegmentNameFormat, firstSequence) > 0 && strcmp(check, entry->d_name) == 0)
+    {
+      unlinkat(dirfd(listing), entry->d_name, 0);
+    }
+  }
+  closedir(listing);
+  return true;
+}
+
+/*
+ *  Function  : historyLogAppend()
+ *  Summary   : This function puts one numbered broadcast in line to be written, keeping a reference on it.
+ *              Callers hold clients_mutex, so broadcasts are in line in sequence order; they call
+ *              historyLogFlush() once they have released it. When the line is full the caller writes it
+ *              out first, which is the only time a write happens under clients_mutex.
+ *  Params    : HistoryLog* log
+ *              MessageBuffer* lines
+ *  Return    : void
+ */
+void historyLogAppend(HistoryLog* log, MessageBuffer* lines)
+{
+  if (log->failed)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&log->pendingLock);
+  while (log->pendingCount == kHistoryPendingMax)
+  {
+    pthread_mutex_unlock(&log->pendingLock);
+    historyLogFlush(log);
+    pthread_mutex_lock(&log->pendingLock);
+  }
+  messageBufferRetain(lines);
+  log->pending[(log->pendingHead + log->pendingCount) % kHistoryPendingMax] = lines;
+  log->pendingCount++;
+  pthread_mutex_unlock(&log->pendingLock);
+}
+
+/*
+ *  Function  : historyLogFlush()
+ *  Summary   : This function writes every broadcast in line, oldest first. Only the thread holding the log's
+ *              lock takes from the line, so they reach the disk in the order they were put in it.
+ *  Params    : HistoryLog* log
+ *  Return    : void
+ */
+void historyLogFlush(HistoryLog* log)
+{
+  pthread_mutex_lock(&log->lock);
+  while (true)
+  {
+    pthread_mutex_lock(&log->pendingLock);
+    MessageBuffer* lines = NULL;
+    if (log->pendingCount > 0)
+    {
+      lines = log->pending[log->pendingHead];
+      log->pendingHead = (log->pendingHead + 1) % kHistoryPendingMax;
+      log->pendingCount--;
+    }
+    pthread_mutex_unlock(&log->pendingLock);
+    if (lines == NULL)
+    {
+      break;
+    }
+    writeMessage(log, lines->sequence, lines->data, lines->length);
+    messageBufferRelease(lines);
+  }
+  pthread_mutex_unlock(&log->lock);
+}
+
+/*
+ *  Function  : historyLogOldest()
+ *  Summary   : This function returns the oldest sequence number the log can still send.
+ *  Params    : HistoryLog* log
+ *  Return    : uint64_t - 0 when the log is empty
+ */
+uint64_t historyLogOldest(HistoryLog* log)
+{
+  pthread_mutex_lock(&log->lock);
+  uint64_t oldest = (log->segmentCount > 0) ? log->segments[0]->firstSequence : 0;
+  pthread_mutex_unlock(&log->lock);
+  return oldest;
+}
+
+/*
+ *  Function  : writeMessage()
+ *  Summary   : This function appends one numbered broadcast to the newest segment, starting a new segment
+ *              when that one is full or the message does not follow its last one. On a write error the log
+ *              drops every segment and stops, since a gap would break the sequence-to-offset mapping.
+ *              Caller holds the log's lock.
+ *  Params    : HistoryLog* log
+ *              uint64_t sequence
+ *              const char* lines
+ *              size_t length
+ *  Return    : void
+ */
+static void writeMessage(HistoryLog* log, uint64_t sequence, const char* lines, size_t length)
+{
+  if (log->failed || length == 0 || length > kHistorySegmentSize)
+  {
+    return;
+  }
+
+  HistorySegment* segment = (log->segmentCount > 0) ? log->segments[log->segmentCount - 1] : NULL;
+  if (segment == NULL || segment->length + length > kHistorySegmentSize ||
+      segment->firstSequence + segment->messageCount != sequence)
+  {
+    if ((segment = openSegment(log, sequence)) == NULL)
+    {
+      log->failed = true;
+    }
+  }
+  if (!log->failed && segment->messageCount == segment->offsetCapacity)
+  {
+    uint32_t capacity = segment->offsetCapacity ? segment->offsetCapacity * 2 : 1024;
+    uint32_t* offsets = realloc(segment->offsets, capacity * sizeof(*offsets));
+    if (offsets == NULL)
+    {
+      log->failed = true;
+    }
+    else
+    {
+      segment->offsets = offsets;
+      segment->offsetCapacity = capacity;
+    }
+  }
+
+  /* Page cache only; a short write is finished, anything else ends the log */
+  size_t written = 0;
+  while (!log->failed && written < length)
+  {
+    ssize_t result = pwrite(segment->fd, lines + written, length - written, segment->length + written);
+    if (result < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (result <= 0)
+    {
+      perror("history write FAILED, disk history is off");
+      log->failed = true;
+    }
+    else
+    {
+      written += result;
+    }
+  }
+
+  if (log->failed)
+  {
+    while (log->segmentCount > 0)
+    {
+      retireOldestSegment(log);
+    }
+    return;
+  }
+  segment->offsets[segment->messageCount++] = segment->length;
+  segment->length += length;
+}
+
+/*
+ *  Function  : historyLogRanges()
+ *  Summary   : This function maps the messages first..last (the part written to disk) to byte ranges,
+ *              oldest first, one per segment. Broadcasts still in line are not written here: this runs under
+ *              clients_mutex, so callers flush before taking it, and those in line are the newest ones, at
+ *              most kHistoryPendingMax of them. Each range takes a reference on its segment, dropped with
+ *              historySegmentRelease() once the range is sent or abandoned.
+ *  Params    : HistoryLog* log
+ *              uint64_t first
+ *              uint64_t last
+ *              HistoryRange ranges[]
+ *              int maxRanges - kHistorySegments always suffices
+ *  Return    : int - the number of ranges filled in
+ */
+int historyLogRanges(HistoryLog* log, uint64_t first, uint64_t last, HistoryRange ranges[], int maxRanges)
+{
+  pthread_mutex_lock(&log->lock);
+  int count = 0;
+  for (int i = 0; i < log->segmentCount && count < maxRanges; i++)
+  {
+    HistorySegment* segment = log->segments[i];
+    uint64_t segmentLast = segment->firstSequence + segment->messageCount - 1;
+    if (segment->messageCount == 0 || segmentLast < first || segment->firstSequence > last)
+    {
+      continue;
+    }
+    uint64_t from = (first > segment->firstSequence ? first : segment->firstSequence) - segment->firstSequence;
+    uint64_t to = (last < segmentLast ? last : segmentLast) - segment->firstSequence;
+    uint64_t end = (to + 1 < segment->messageCount) ? segment->offsets[to + 1] : segment->length;
+
+    atomic_fetch_add_explicit(&segment->references, 1, memory_order_relaxed);
+    ranges[count].segment = segment;
+    ranges[count].offset = segment->offsets[from];
+    ranges[count].length = end - segment->offsets[from];
+    ranges[count].lastSequence = segment->firstSequence + to;
+    count++;
+  }
+  pthread_mutex_unlock(&log->lock);
+  return count;
+}
+
+/*
+ *  Function  : historyRangeSend()
+ *  Summary   : This function writes what is left of a range to a non-blocking socket with sendfile(), so the
+ *              bytes go from the page cache to the socket without passing through this process.
+ *  Params    : int socket
+ *              const HistoryRange* range
+ *              uint64_t sent - bytes of the range already written
+ *  Return    : ssize_t - bytes written, or -1 with errno set (EAGAIN when the socket is full)
+ */
+ssize_t historyRangeSend(int socket, const HistoryRange* range, uint64_t sent)
+{
+  off_t offset = (off_t)(range->offset + sent);
+  return sendfile(socket, range->segment->fd, &offset, range->length - sent);
+}
+
+/*
+ *  Function  : historyRangeRead()
+ *  Summary   : This function copies part of a range into memory, for transports that cannot take a file.
+ *  Params    : const HistoryRange* range
+ *              uint64_t offset - within the range
+ *              char* buffer
+ *              size_t capacity
+ *  Return    : size_t - bytes copied, 0 at the end of the range or on a read error
+ */
+size_t historyRangeRead(const HistoryRange* range, uint64_t offset, char* buffer, size_t capacity)
+{
+  size_t wanted = (range->length - offset < capacity) ? range->length - offset : capacity;
+  ssize_t result = pread(range->segment->fd, buffer, wanted, (off_t)(range->offset + offset));
+  return result > 0 ? (size_t)result : 0;
+}
+
+/*
+ *  Function  : historySegmentRelease()
+ *  Summary   : This function drops a reference; the last one closes the segment's file and frees it.
+ *  Params    : HistorySegment* segment
+ *  Return    : void
+ */
+void historySegmentRelease(HistorySegment* segment)
+{
+  if (atomic_fetch_sub_explicit(&segment->references, 1, memory_order_acq_rel) != 1)
+  {
+    return;
+  }
+  close(segment->fd);
+  free(segment->offsets);
+  free(segment);
+}
+
+/*
+ *  Function  : openSegment()
+ *  Summary   : This function creates a new, empty segment after the current ones, deleting the oldest
+ *              segment first when kHistorySegments are already kept. The file must not exist yet: nothing
+ *              this process did not create is ever written to.
+ *  Params    : HistoryLog* log
+ *              uint64_t firstSequence
+ *  Return    : HistorySegment* - NULL when the file cannot be created
+ */
+static HistorySegment* openSegment(HistoryLog* log, uint64_t firstSequence)
+{
+  if (log->segmentCount == kHistorySegments)
+  {
+    retireOldestSegment(log);
+  }
+
+  char path[kHistoryPathLength + 48];
+  segmentPath(log, firstSequence, path, sizeof(path));
+  HistorySegment* segment = calloc(1, sizeof(*segment));
+  if (segment == NULL || (segment->fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+                                                   S_IRUSR | S_IWUSR)) < 0)
+  {
+    perror("history segment open() FAILED, disk history is off");
+    free(segment);
+    return NULL;
+  }
+  atomic_init(&segment->references, 1);
+  segment->firstSequence = firstSequence;
+  log->segments[log->segmentCount++] = segment;
+  return segment;
+}
+
+/*
+ *  Function  : retireOldestSegment()
+ *  Summary   : This function deletes the oldest segment's file and drops the log's reference on it. Ranges
+ *              still queued keep the open file, and with it the data, until they are sent.
+ *  Params    : HistoryLog* log
+ *  Return    : void
+ */
+static void retireOldestSegment(HistoryLog* log)
+{
+  HistorySegment* oldest = log->segments[0];
+  char path[kHistoryPathLength + 48];
+  segmentPath(log, oldest->firstSequence, path, sizeof(path));
+  unlink(path);
+  memmove(log->segments, log->segments + 1, (log->segmentCount - 1) * sizeof(log->segments[0]));
+  log->segmentCount--;
+  historySegmentRelease(oldest);
+}
+
+/*
+ *  Function  : segmentPath()
+ *  Summary   : This function builds the file name of the segment starting at firstSequence.
+ *  Params    : const HistoryLog* log
+ *              uint64_t firstSequence
+ *              char* path
+ *              size_t size
+ *  Return    : void
+ */
+static void segmentPath(const HistoryLog* log, uint64_t firstSequence, char* path, size_t size)
+{
+  snprintf(path, size, "%s/" kSegmentNameFormat, log->directory, (unsigned long long)firstSequence);
+}
@@ -0,0 +1,534 @@
+/*
+*   FILE          : hot-restart.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the socket handoff used for zero-downtime upgrades.
+*      When a new process connects to the upgrade socket, the old process asks
+*      every client thread to finish its in-flight work and park, then sends the
+*      listening sockets and, per session, the client socket (SCM_RIGHTS), the
+*      username, IP and any output still queued for it. The new process rebuilds
+*      the sessions and acknowledges; only then does the old process exit, so no
+*      client sees a disconnect. Bytes a client sent but nobody read yet simply
+*      stay in the kernel's socket buffer and are read by the new process.
+*      Shared-memory sessions cannot be moved and are closed instead.
+*/
+
+#include <assert.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../inc/chat-server.h"
+#include "../inc/hot-restart.h"
+
+static_assert(kHandoffNameLength >= kSessionNameLength, "handoff record must hold a full username");
+
+static atomic_bool handoffFlag = false;
+static pthread_cond_t handoffCond = PTHREAD_COND_INITIALIZER;
+static int parkedSessions = 0;
+
+static bool sendWithFds(int socket, const void* data, size_t length, const int* fds, int fdCount);
+static bool receiveWithFds(int socket, void* data, size_t length, int* fds, int fdCount);
+static bool sendFully(int socket, const void* data, size_t length);
+static bool sendHistoryFully(int socket, const HistoryRange* range, uint64_t sent);
+static bool receiveFully(int socket, void* data, size_t length);
+static void restoreSession(int clientSocket, HandoffSessionRecord* record, MessageBuffer* pendingOutput,
+                           const char* pendingInput);
+
+/*
+ *  Function  : setUpUpgradeSocket()
+ *  Summary   : This function creates the Unix socket a new server binary connects to for a takeover.
+ *  Params    : const char* socketPath
+ *  Return    : int
+ */
+int setUpUpgradeSocket(const char* socketPath)
+{
+  int upgradeSocket;
+  if ((upgradeSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+  {
+    displayFatalError("upgrade socket() FAILED");
+  }
+
+  struct sockaddr_un upgradeAddress = {};
+  upgradeAddress.sun_family = AF_UNIX;
+  strncpy(upgradeAddress.sun_path, socketPath, sizeof(upgradeAddress.sun_path) - 1);
+  unlink(socketPath);
+  if (bind(upgradeSocket, (struct sockaddr*)&upgradeAddress, sizeof(upgradeAddress)) < 0 ||
+      listen(upgradeSocket, 1) < 0)
+  {
+    close(upgradeSocket);
+    displayFatalError("upgrade bind()/listen() FAILED");
+  }
+  return upgradeSocket;
+}
+
+/*
+ *  Function  : handoffRequested()
+ *  Summary   : This function tells client threads that they should park for a handoff.
+ *  Params    : void
+ *  Return    : bool
+ */
+bool handoffRequested(void)
+{
+  return atomic_load(&handoffFlag);
+}
+
+/*
+ *  Function  : parkForHandoff()
+ *  Summary   : This function is called by a client thread when a handoff starts. It completes the client's
+ *              in-flight jobs so their output is queued, then waits. If the handoff fails the thread resumes;
+ *              if it succeeds the process exits while the thread is still parked.
+ *  Params    : ClientInfo* client
+ *  Return    : void
+ */
+void parkForHandoff(ClientInfo* client)
+{
+  waitForCompletions(client);
+
+  pthread_mutex_lock(&clients_mutex);
+  parkedSessions++;
+  pthread_cond_broadcast(&handoffCond);
+  while (atomic_load(&handoffFlag))
+  {
+    pthread_cond_wait(&handoffCond, &clients_mutex);
+  }
+  parkedSessions--;
+  pthread_mutex_unlock(&clients_mutex);
+}
+
+/*
+ *  Function  : handoffSessionEnded()
+ *  Summary   : This function lets a waiting handoff recount sessions after one ended. Caller holds clients_mutex.
+ *  Params    : void
+ *  Return    : void
+ */
+void handoffSessionEnded(void)
+{
+  pthread_cond_broadcast(&handoffCond);
+}
+
+/*
+ *  Function  : performHandoff()
+ *  Summary   : This function runs in the old process when a new one connects to the upgrade socket. On success
+ *              it exits the process without closing any client connection; on failure the server carries on.
+ *  Params    : int upgradeSocket
+ *              int serverSocket
+ *              int localSocket
+ *  Return    : void
+ */
+void performHandoff(int upgradeSocket, int serverSocket, int localSocket)
+{
+  int successor = accept(upgradeSocket, NULL, NULL);
+  if (successor < 0)
+  {
+    return;
+  }
+  fcntl(successor, F_SETFL, fcntl(successor, F_GETFL) & ~O_NONBLOCK);
+  printf("Hot restart: handing sessions to the new process\n");
+
+  /* Phase 1: every client thread finishes its jobs and parks */
+  pthread_mutex_lock(&clients_mutex);
+  atomic_store(&handoffFlag, true);
+  for (ClientInfo* client = allSessions; client != NULL; client = client->nextSession)
+  {
+    uint64_t wakeup = 1;
+    write(client->queue->wakeupFd, &wakeup, sizeof(wakeup));
+  }
+  while (parkedSessions < liveSessionCount)
+  {
+    pthread_cond_wait(&handoffCond, &clients_mutex);
+  }
+
+  /* Phase 2: nothing can queue output now; send the listeners, then one record per session */
+  pthread_mutex_lock(&idleWheel.lock);
+  bool sent = true;
+  HandoffHeader header = {kHandoffMagic, kHandoffVersion, 0, chatReplay.lastSequence, offlineMail.boxCount};
+  for (ClientInfo* client = allSessions; client != NULL; client = client->nextSession)
+  {
+    if (client->shm == NULL)
+    {
+      header.sessionCount++;
+    }
+  }
+  int listeners[2] = {serverSocket, localSocket};
+  sent = sendWithFds(successor, &header, sizeof(header), listeners, 2);
+
+  for (ClientInfo* client = allSessions; sent && client != NULL; client = client->nextSession)
+  {
+    if (client->shm != NULL)
+    {
+      continue;
+    }
+
+    HandoffSessionRecord record = {};
+    bool registered = false;
+    for (int i = 0; i < activeClients.numberOfClients; i++)
+    {
+      registered = registered || (activeClients.sockets[i] == client->clientSocket);
+    }
+    record.flags = (registered ? kHandoffRegistered : 0) | (client->framedInput ? kHandoffFramedInput : 0) |
+                   (client->resumes ? kHandoffResumes : 0) | (client->wantsPresence ? kHandoffPresence : 0);
+    memcpy(record.userName, client->userName, sizeof(client->userName));
+    inet_ntop(AF_INET, &client->ipAddress, record.ipAddress, sizeof(record.ipAddress));
+    struct iovec parts[2];
+    OutboundLane lanes[kLaneCount];
+    int laneCount = outboundWriteOrder(client->queue, lanes);
+    for (int lane = 0; lane < laneCount; lane++)
+    {
+      for (OutboundNode* node = client->queue->head[lanes[lane]]; node != NULL; node = node->next)
+      {
+        for (int i = outboundRemaining(client, node, parts) - 1; i >= 0; i--)
+        {
+          record.pendingBytes += parts[i].iov_len;
+        }
+        if (node->buffer == NULL)
+        {
+          record.pendingBytes += node->history.length - node->offset;
+        }
+      }
+    }
+    record.pendingInputBytes = client->inputLength;
+
+    sent = sendWithFds(successor, &record, sizeof(record), &client->clientSocket, 1);
+    for (int lane = 0; sent && lane < laneCount; lane++)
+    {
+      for (OutboundNode* node = client->queue->head[lanes[lane]]; sent && node != NULL; node = node->next)
+      {
+        int partCount = outboundRemaining(client, node, parts);
+        for (int i = 0; sent && i < partCount; i++)
+        {
+          sent = sendFully(successor, parts[i].iov_base, parts[i].iov_len);
+        }
+        if (node->buffer == NULL)
+        {
+          sent = sent && sendHistoryFully(successor, &node->history, node->offset);
+        }
+      }
+    }
+    sent = sent && sendFully(successor, client->inputBuffer, client->inputLength);
+  }
+
+  /* Then every offline mailbox, as the lines it would deliver */
+  for (int slot = 0; sent && slot < kMaxMailboxes; slot++)
+  {
+    const char* userName;
+    MessageBuffer* mail = mailboxCopy(&offlineMail, slot, &userName);
+    if (mail == NULL)
+    {
+      continue;
+    }
+    HandoffMailboxRecord record = {};
+    strncpy(record.userName, userName, sizeof(record.userName) - 1);
+    record.bytes = (uint32_t)mail->length;
+    sent = sendFully(successor, &record, sizeof(record)) && sendFully(successor, mail->data, mail->length);
+    messageBufferRelease(mail);
+  }
+
+  /* Wait for the new process to confirm it owns everything */
+  char acknowledgement = 0;
+  if (sent && receiveFully(successor, &acknowledgement, 1) && acknowledgement == 'K')
+  {
+    printf("Hot restart: handoff complete, exiting\n");
+    poolPrintStats(stdout);
+    captureClose(stdout);
+    fflush(stdout);
+    _exit(EXIT_SUCCESS);
+  }
+
+  /* Handoff failed: wake the parked threads and keep serving */
+  fprintf(stderr, "Hot restart: handoff failed, continuing\n");
+  pthread_mutex_unlock(&idleWheel.lock);
+  atomic_store(&handoffFlag, false);
+  pthread_cond_broadcast(&handoffCond);
+  pthread_mutex_unlock(&clients_mutex);
+  close(successor);
+}
+
+/*
+ *  Function  : receiveHandoff()
+ *  Summary   : This function runs in the new process started with -takeover. It takes over the listening
+ *              sockets and every session from the running server and starts a thread per session.
+ *  Params    : const char* socketPath
+ *              int* serverSocket
+ *              int* localSocket
+ *  Return    : bool - false if there was no server to take over from
+ */
+bool receiveHandoff(const char* socketPath, int* serverSocket, int* localSocket)
+{
+  int predecessor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  struct sockaddr_un upgradeAddress = {};
+  upgradeAddress.sun_family = AF_UNIX;
+  strncpy(upgradeAddress.sun_path, socketPath, sizeof(upgradeAddress.sun_path) - 1);
+  if (predecessor < 0 || connect(predecessor, (struct sockaddr*)&upgradeAddress, sizeof(upgradeAddress)) < 0)
+  {
+    perror("takeover connect() FAILED");
+    return false;
+  }
+
+  HandoffHeader header;
+  int listeners[2];
+  if (!receiveWithFds(predecessor, &header, sizeof(header), listeners, 2) || header.magic != kHandoffMagic ||
+      header.version != kHandoffVersion)
+  {
+    close(predecessor);
+    return false;
+  }
+  *serverSocket = listeners[0];
+  *localSocket = listeners[1];
+  replayRingInit(&chatReplay, header.lastSequence);
+
+  /* Rebuild every session */
+  for (uint32_t i = 0; i < header.sessionCount; i++)
+  {
+    HandoffSessionRecord record;
+    int clientSocket;
+    if (!receiveWithFds(predecessor, &record, sizeof(record), &clientSocket, 1))
+    {
+      displayFatalError("takeover: session table cut short");
+    }
+    record.userName[kHandoffNameLength - 1] = '\0';
+    record.ipAddress[INET_ADDRSTRLEN - 1] = '\0';
+
+    MessageBuffer* pendingOutput = NULL;
+    if (record.pendingBytes > 0)
+    {
+      pendingOutput = messageBufferAcquire(record.pendingBytes);
+      if (!receiveFully(predecessor, pendingOutput->data, record.pendingBytes))
+      {
+        displayFatalError("takeover: pending output cut short");
+      }
+      pendingOutput->length = record.pendingBytes;
+    }
+    char pendingInput[kInputBufferSize];
+    if (record.pendingInputBytes > sizeof(pendingInput) ||
+        !receiveFully(predecessor, pendingInput, record.pendingInputBytes))
+    {
+      displayFatalError("takeover: pending input cut short");
+    }
+    restoreSession(clientSocket, &record, pendingOutput, pendingInput);
+  }
+
+  /* Refill the offline mailboxes */
+  for (uint32_t i = 0; i < header.mailboxCount; i++)
+  {
+    HandoffMailboxRecord record;
+    char mail[kMailboxUserBytes];
+    if (!receiveFully(predecessor, &record, sizeof(record)) || record.bytes > sizeof(mail) ||
+        !receiveFully(predecessor, mail, record.bytes))
+    {
+      displayFatalError("takeover: mailboxes cut short");
+    }
+    record.userName[kHandoffNameLength - 1] = '\0';
+    mailboxDeposit(&offlineMail, record.userName, mail, record.bytes);
+  }
+
+  char acknowledgement = 'K';
+  sendFully(predecessor, &acknowledgement, 1);
+  close(predecessor);
+  printf("Hot restart: took over %u session(s)\n", header.sessionCount);
+  return true;
+}
+
+/*
+ *  Function  : restoreSession()
+ *  Summary   : This function recreates one handed-over session and starts its thread.
+ *  Params    : int clientSocket
+ *              HandoffSessionRecord* record
+ *              MessageBuffer* pendingOutput - may be NULL
+ *              const char* pendingInput - record->pendingInputBytes of a partial frame
+ *  Return    : void
+ */
+static void restoreSession(int clientSocket, HandoffSessionRecord* record, MessageBuffer* pendingOutput,
+                           const char* pendingInput)
+{
+  ClientInfo* client = createSession(clientSocket);
+  if (client == NULL)
+  {
+    close(clientSocket);
+    messageBufferRelease(pendingOutput);
+    return;
+  }
+
+  memcpy(client->userName, record->userName, kSessionNameLength - 1);
+  inet_pton(AF_INET, record->ipAddress, &client->ipAddress);
+  if (record->pendingInputBytes > 0)
+  {
+    holdInputBuffer(client);
+    memcpy(client->inputBuffer, pendingInput, record->pendingInputBytes);
+    client->inputLength = record->pendingInputBytes;
+  }
+  client->framedInput = (record->flags & kHandoffFramedInput) != 0;
+  client->resumes = (record->flags & kHandoffResumes) != 0;
+  if (record->flags & kHandoffRegistered)
+  {
+    client->linePrefixLength = formatLinePrefix(client->linePrefix, kLinePrefixSize, record->ipAddress,
+                                                client->userName);
+    pthread_mutex_lock(&clients_mutex);
+    if (!registerClient(client))
+    {
+      client->linePrefixLength = 0;
+    }
+    client->wantsPresence = (record->flags & kHandoffPresence) != 0 && client->linePrefixLength > 0;
+    pthread_mutex_unlock(&clients_mutex);
+  }
+  if (pendingOutput != NULL)
+  {
+    enqueueOutbound(client, pendingOutput);
+    messageBufferRelease(pendingOutput);
+  }
+  startSessionThread(client);
+}
+
+/*
+ *  Function  : sendWithFds()
+ *  Summary   : This function sends a block of data with descriptors attached to its first byte.
+ *  Params    : int socket
+ *              const void* data
+ *              size_t length
+ *              const int* fds
+ *              int fdCount
+ *  Return    : bool
+ */
+static bool sendWithFds(int socket, const void* data, size_t length, const int* fds, int fdCount)
+{
+  union
+  {
+    char buffer[CMSG_SPACE(2 * sizeof(int))];
+    struct cmsghdr align;
+  } control = {};
+  struct iovec dataVector = {(void*)data, length};
+  struct msghdr message = {};
+  message.msg_iov = &dataVector;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = CMSG_SPACE(fdCount * sizeof(int));
+  struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
+  memcpy(CMSG_DATA(header), fds, fdCount * sizeof(int));
+
+  ssize_t written = sendmsg(socket, &message, MSG_NOSIGNAL);
+  if (written <= 0)
+  {
+    return false;
+  }
+  return sendFully(socket, (const char*)data + written, length - written);
+}
+
+/*
+ *  Function  : receiveWithFds()
+ *  Summary   : This function receives a block of data sent by sendWithFds() and the descriptors with it.
+ *  Params    : int socket
+ *              void* data
+ *              size_t length
+ *              int* fds
+ *              int fdCount
+ *  Return    : bool
+ */
+static bool receiveWithFds(int socket, void* data, size_t length, int* fds, int fdCount)
+{
+  union
+  {
+    char buffer[CMSG_SPACE(2 * sizeof(int))];
+    struct cmsghdr align;
+  } control = {};
+  struct iovec dataVector = {data, length};
+  struct msghdr message = {};
+  message.msg_iov = &dataVector;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = CMSG_SPACE(fdCount * sizeof(int));
+
+  ssize_t received = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+  struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (received <= 0 || header == NULL || header->cmsg_type != SCM_RIGHTS ||
+      header->cmsg_len != CMSG_LEN(fdCount * sizeof(int)))
+  {
+    return false;
+  }
+  memcpy(fds, CMSG_DATA(header), fdCount * sizeof(int));
+  return receiveFully(socket, (char*)data + received, length - received);
+}
+
+/*
+ *  Function  : sendFully()
+ *  Summary   : This function writes exactly length bytes to a blocking socket.
+ *  Params    : int socket
+ *              const void* data
+ *              size_t length
+ *  Return    : bool
+ */
+static bool sendFully(int socket, const void* data, size_t length)
+{
+  const char* position = data;
+  while (length > 0)
+  {
+    ssize_t written = send(socket, position, length, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written <= 0)
+    {
+      return false;
+    }
+    position += written;
+    length -= written;
+  }
+  return true;
+}
+
+/*
+ *  Function  : sendHistoryFully()
+ *  Summary   : This function writes the rest of a history range to a blocking socket, from the file.
+ *  Params    : int socket
+ *              const HistoryRange* range
+ *              uint64_t sent - bytes of the range already written
+ *  Return    : bool
+ */
+static bool sendHistoryFully(int socket, const HistoryRange* range, uint64_t sent)
+{
+  while (sent < range->length)
+  {
+    ssize_t written = historyRangeSend(socket, range, sent);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written <= 0)
+    {
+      return false;
+    }
+    sent += written;
+  }
+  return true;
+}
+
+/*
+ *  Function  : receiveFully()
+ *  Summary   : This function reads exactly length bytes from a blocking socket.
+ *  Params    : int socket
+ *              void* data
+ *              size_t length
+ *  Return    : bool
+ */
+static bool receiveFully(int socket, void* data, size_t length)
+{
+  char* position = data;
+  while (length > 0)
+  {
+    ssize_t received = recv(socket, position, length, 0);
+    if (received < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (received <= 0)
+    {
+      return false;
+    }
+    position += received;
+    length -= received;
+  }
+  return true;
+}
@@ -0,0 +1,412 @@
+/*
+*   FILE          : mailbox.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the offline mailboxes. Messages are appended to
+*      one arena as records (a small header, then the formatted lines) and
+*      each user's records are chained from the oldest to the newest. Nothing
+*      is freed in place: delivered and dropped records become dead space,
+*      and when the arena runs out at the end the waiting records are copied
+*      to the front of a fresh one. The user table is open addressing with
+*      linear probing, kept at most three quarters full. The store has no lock
+*      of its own; the server uses it under clients_mutex, which also decides
+*      whether a recipient is online, so a message is either queued to the
+*      session or waiting in its mailbox when the session says Hello.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "../inc/mailbox.h"
+
+typedef struct MailRecord
+{
+  uint32_t next;                      // arena offset of the next record for the same user
+  uint32_t length;                    // message bytes following the header
+} MailRecord;
+
+static uint32_t recordSize(size_t length);
+static MailRecord* recordAt(const MailboxStore* store, uint32_t offset);
+static uint32_t hashName(const char* userName);
+static int findMailbox(const MailboxStore* store, const char* userName);
+static int claimMailbox(MailboxStore* store, const char* userName);
+static void freeMailbox(MailboxStore* store, int slot);
+static void dropOldest(MailboxStore* store, Mailbox* box);
+static bool compactArena(MailboxStore* store);
+static MessageBuffer* collectMailbox(const MailboxStore* store, const Mailbox* box);
+
+/*
+ *  Function  : mailboxInit()
+ *  Summary   : This function allocates the arena and empties every mailbox.
+ *  Params    : MailboxStore* store
+ *  Return    : void
+ */
+void mailboxInit(MailboxStore* store)
+{
+  memset(store, 0, sizeof(*store));
+  store->arena = malloc(kMailboxArenaSize);
+}
+
+/*
+ *  Function  : mailboxDeposit()
+ *  Summary   : This function keeps a message for a user who is not connected. If the user's mailbox would
+ *              go over kMailboxUserBytes, its oldest messages are dropped first; a message is refused when
+ *              even that leaves no room in the arena, or when no new mailbox can be opened.
+ *  Params    : MailboxStore* store
+ *              const char* userName
+ *              const char* data - formatted lines, newline-terminated
+ *              size_t length
+ *  Return    : DepositResult
+ */
+DepositResult mailboxDeposit(MailboxStore* store, const char* userName, const char* data, size_t length)
+{
+  if (store->arena == NULL || length == 0 || length > kMailboxUserBytes)
+  {
+    return kDepositRefused;
+  }
+
+  /* Work out what the per-user limit would drop before changing anything */
+  int slot = findMailbox(store, userName);
+  Mailbox* box = (slot >= 0) ? &store->boxes[slot] : NULL;
+  uint32_t dropBytes = 0;
+  uint32_t dropArena = 0;
+  if (box != NULL)
+  {
+    for (uint32_t offset = box->head; offset != kMailboxNone && box->bytes - dropBytes + length > kMailboxUserBytes;
+         offset = recordAt(store, offset)->next)
+    {
+      dropBytes += recordAt(store, offset)->length;
+      dropArena += recordSize(recordAt(store, offset)->length);
+    }
+  }
+  else if (store->boxCount >= kMaxMailboxes / 4 * 3)
+  {
+    return kDepositRefused;
+  }
+
+  uint32_t size = recordSize(length);
+  if (store->liveBytes - dropArena + size > kMailboxArenaSize)
+  {
+    return kDepositRefused;
+  }
+
+  DepositResult result = kDepositKept;
+  if (box == NULL)
+  {
+    box = &store->boxes[claimMailbox(store, userName)];
+  }
+  while (dropBytes > 0)
+  {
+    dropBytes -= recordAt(store, box->head)->length;
+    dropOldest(store, box);
+    result = kDepositTrimmed;
+  }
+  if (store->used + size > kMailboxArenaSize && !compactArena(store))
+  {
+    if (box->head == kMailboxNone)
+    {
+      freeMailbox(store, (int)(box - store->boxes));
+    }
+    return kDepositRefused;
+  }
+
+  /* Append the record and chain it behind the user's newest one */
+  uint32_t offset = store->used;
+  MailRecord* record = recordAt(store, offset);
+  record->next = kMailboxNone;
+  record->length = (uint32_t)length;
+  memcpy(record + 1, data, length);
+  store->used += size;
+  store->liveBytes += size;
+
+  if (box->head == kMailboxNone)
+  {
+    box->head = offset;
+  }
+  else
+  {
+    recordAt(store, box->tail)->next = offset;
+  }
+  box->tail = offset;
+  box->bytes += (uint32_t)length;
+  box->count++;
+  return result;
+}
+
+/*
+ *  Function  : mailboxTake()
+ *  Summary   : This function empties a user's mailbox into one buffer, oldest message first, so it can be
+ *              sent with a single write.
+ *  Params    : MailboxStore* store
+ *              const char* userName
+ *  Return    : MessageBuffer* - holding one reference for the caller; NULL when nothing is waiting
+ */
+MessageBuffer* mailboxTake(MailboxStore* store, const char* userName)
+{
+  int slot = findMailbox(store, userName);
+  if (slot < 0)
+  {
+    return NULL;
+  }
+
+  Mailbox* box = &store->boxes[slot];
+  MessageBuffer* mail = collectMailbox(store, box);
+  if (mail == NULL)
+  {
+    return NULL;
+  }
+  while (box->head != kMailboxNone)
+  {
+    dropOldest(store, box);
+  }
+  freeMailbox(store, slot);
+
+  /* With nothing left waiting the whole arena is free again */
+  if (store->liveBytes == 0)
+  {
+    store->used = 0;
+  }
+  return mail;
+}
+
+/*
+ *  Function  : mailboxCopy()
+ *  Summary   : This function copies the mailbox in one table slot without emptying it, for walking every
+ *              mailbox (as a hot restart does).
+ *  Params    : const MailboxStore* store
+ *              int slot - 0 to kMaxMailboxes - 1
+ *              const char** userName - set to the mailbox's owner
+ *  Return    : MessageBuffer* - holding one reference for the caller; NULL when the slot is free
+ */
+MessageBuffer* mailboxCopy(const MailboxStore* store, int slot, const char** userName)
+{
+  const Mailbox* box = &store->boxes[slot];
+  if (box->userName[0] == '\0')
+  {
+    return NULL;
+  }
+  *userName = box->userName;
+  return collectMailbox(store, box);
+}
+
+/*
+ *  Function  : recordSize()
+ *  Summary   : This function returns the arena bytes a record of length message bytes takes, header and
+ *              padding included, so every record header stays aligned.
+ *  Params    : size_t length
+ *  Return    : uint32_t
+ */
+static uint32_t recordSize(size_t length)
+{
+  return (uint32_t)((sizeof(MailRecord) + length + sizeof(MailRecord) - 1) & ~(sizeof(MailRecord) - 1));
+}
+
+/*
+ *  Function  : recordAt()
+ *  Summary   : This function returns the record at an arena offset.
+ *  Params    : const MailboxStore* store
+ *              uint32_t offset
+ *  Return    : MailRecord*
+ */
+static MailRecord* recordAt(const MailboxStore* store, uint32_t offset)
+{
+  return (MailRecord*)(store->arena + offset);
+}
+
+/*
+ *  Function  : hashName()
+ *  Summary   : This function hashes the part of a user name the mailboxes keep (FNV-1a).
+ *  Params    : const char* userName
+ *  Return    : uint32_t
+ */
+static uint32_t hashName(const char* userName)
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < kMailboxNameLength - 1 && userName[i] != '\0'; i++)
+  {
+    hash = (hash ^ (uint8_t)userName[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/*
+ *  Function  : findMailbox()
+ *  Summary   : This function looks up a user's mailbox.
+ *  Params    : const MailboxStore* store
+ *              const char* userName
+ *  Return    : int - the table slot, -1 when the user has no mail waiting
+ */
+static int findMailbox(const MailboxStore* store, const char* userName)
+{
+  if (userName[0] == '\0')
+  {
+    return -1;
+  }
+  for (uint32_t slot = hashName(userName) & (kMaxMailboxes - 1); store->boxes[slot].userName[0] != '\0';
+       slot = (slot + 1) & (kMaxMailboxes - 1))
+  {
+    if (strncmp(store->boxes[slot].userName, userName, kMailboxNameLength - 1) == 0)
+    {
+      return (int)slot;
+    }
+  }
+  return -1;
+}
+
+/*
+ *  Function  : claimMailbox()
+ *  Summary   : This function opens an empty mailbox for a user who has none. The caller has checked that the
+ *              table has room.
+ *  Params    : MailboxStore* store
+ *              const char* userName
+ *  Return    : int - the table slot
+ */
+static int claimMailbox(MailboxStore* store, const char* userName)
+{
+  uint32_t slot = hashName(userName) & (kMaxMailboxes - 1);
+  while (store->boxes[slot].userName[0] != '\0')
+  {
+    slot = (slot + 1) & (kMaxMailboxes - 1);
+  }
+
+  Mailbox* box = &store->boxes[slot];
+  strncpy(box->userName, userName, kMailboxNameLength - 1);
+  box->userName[kMailboxNameLength - 1] = '\0';
+  box->head = kMailboxNone;
+  box->tail = kMailboxNone;
+  box->bytes = 0;
+  box->count = 0;
+  store->boxCount++;
+  return (int)slot;
+}
+
+/*
+ *  Function  : freeMailbox()
+ *  Summary   : This function closes an empty mailbox, moving later entries of the same probe run back so
+ *              lookups still find them without tombstones.
+ *  Params    : MailboxStore* store
+ *              int slot
+ *  Return    : void
+ */
+static void freeMailbox(MailboxStore* store, int slot)
+{
+  uint32_t hole = (uint32_t)slot;
+  for (uint32_t next = (hole + 1) & (kMaxMailboxes - 1); store->boxes[next].userName[0] != '\0';
+       next = (next + 1) & (kMaxMailboxes - 1))
+  {
+    /* An entry may fill the hole unless its home slot lies cyclically in (hole, next] */
+    uint32_t home = hashName(store->boxes[next].userName) & (kMaxMailboxes - 1);
+    bool reachable = (hole <= next) ? (home > hole && home <= next) : (home > hole || home <= next);
+    if (!reachable)
+    {
+      store->boxes[hole] = store->boxes[next];
+      hole = next;
+    }
+  }
+  memset(&store->boxes[hole], 0, sizeof(Mailbox));
+  store->boxCount--;
+}
+
+/*
+ *  Function  : dropOldest()
+ *  Summary   : This function unlinks a mailbox's oldest record. Its arena space is reclaimed by the next
+ *              compaction.
+ *  Params    : MailboxStore* store
+ *              Mailbox* box - not empty
+ *  Return    : void
+ */
+static void dropOldest(MailboxStore* store, Mailbox* box)
+{
+  MailRecord* record = recordAt(store, box->head);
+  box->head = record->next;
+  if (box->head == kMailboxNone)
+  {
+    box->tail = kMailboxNone;
+  }
+  box->bytes -= record->length;
+  box->count--;
+  store->liveBytes -= recordSize(record->length);
+}
+
+/*
+ *  Function  : compactArena()
+ *  Summary   : This function copies every waiting record, mailbox by mailbox, to the front of a fresh arena
+ *              and frees the old one.
+ *  Params    : MailboxStore* store
+ *  Return    : bool - false when the new arena could not be allocated; the store is unchanged then
+ */
+static bool compactArena(MailboxStore* store)
+{
+  char* arena = malloc(kMailboxArenaSize);
+  if (arena == NULL)
+  {
+    return false;
+  }
+
+  uint32_t used = 0;
+  for (int i = 0; i < kMaxMailboxes; i++)
+  {
+    Mailbox* box = &store->boxes[i];
+    if (box->userName[0] == '\0')
+    {
+      continue;
+    }
+
+    uint32_t previous = kMailboxNone;
+    for (uint32_t offset = box->head; offset != kMailboxNone; offset = recordAt(store, offset)->next)
+    {
+      uint32_t size = recordSize(recordAt(store, offset)->length);
+      memcpy(arena + used, store->arena + offset, size);
+      if (previous == kMailboxNone)
+      {
+        box->head = used;
+      }
+      else
+      {
+        ((MailRecord*)(arena + previous))->next = used;
+      }
+      previous = used;
+      used += size;
+    }
+    if (previous != kMailboxNone)
+    {
+      ((MailRecord*)(arena + previous))->next = kMailboxNone;
+    }
+    box->tail = previous;
+  }
+
+  free(store->arena);
+  store->arena = arena;
+  store->used = used;
+  return true;
+}
+
+/*
+ *  Function  : collectMailbox()
+ *  Summary   : This function concatenates a mailbox's messages, oldest first, into one new buffer.
+ *  Params    : const MailboxStore* store
+ *              const Mailbox* box
+ *  Return    : MessageBuffer* - holding one reference for the caller; NULL when the mailbox is empty or
+ *              the buffer could not be allocated
+ */
+static MessageBuffer* collectMailbox(const MailboxStore* store, const Mailbox* box)
+{
+  if (box->bytes == 0)
+  {
+    return NULL;
+  }
+
+  MessageBuffer* mail = messageBufferAcquire(box->bytes);
+  if (mail == NULL)
+  {
+    return NULL;
+  }
+  for (uint32_t offset = box->head; offset != kMailboxNone; offset = recordAt(store, offset)->next)
+  {
+    MailRecord* record = recordAt(store, offset);
+    memcpy(mail->data + mail->length, record + 1, record->length);
+    mail->length += record->length;
+  }
+  return mail;
+}
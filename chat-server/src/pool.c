@@ -0,0 +1,374 @@
+/*
+*   FILE          : pool.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the slab pools used by the chat server. Each pool hands
+*      out objects of a single size. Objects are taken from a small per-thread cache
+*      first, and only when that cache is empty (or full on free) does the thread
+*      touch the shared free list under the pool lock. Slabs are never freed, so the
+*      resident size of the server stays flat while clients come and go.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include "../inc/pool.h"
+
+typedef struct PoolThreadCache
+{
+  int count;
+  PoolObject* objects[kPoolCacheSize];
+} PoolThreadCache;
+
+static SlabPool* registeredPools[kMaxPools];
+static atomic_int registeredPoolCount = 0;
+static _Thread_local PoolThreadCache threadCaches[kMaxPools];
+static _Thread_local bool threadCacheRegistered = false;
+static pthread_key_t threadCacheKey;
+static pthread_once_t threadCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+// Buffer size classes (payload bytes) and their pools
+static const size_t bufferClassSizes[kMessageBufferClasses] = {128, 512, 2048, 16384, 65536};
+static const char* bufferClassNames[kMessageBufferClasses] = {"buffer-128", "buffer-512", "buffer-2k", "buffer-16k",
+                                                              "buffer-64k"};
+static SlabPool bufferPools[kMessageBufferClasses];
+
+static void flushThreadCaches(void* unused);
+static void createThreadCacheKey(void);
+static void growPool(SlabPool* pool);
+
+/*
+ *  Function  : poolInit()
+ *  Summary   : This function prepares an empty pool for objects of the given size and registers it for stats.
+ *  Params    : SlabPool* pool
+ *              const char* name
+ *              size_t objectSize
+ *  Return    : void
+ */
+void poolInit(SlabPool* pool, const char* name, size_t objectSize)
+{
+  memset(pool, 0, sizeof(*pool));
+  pool->name = name;
+
+  /* Every object must be able to hold the free list link and stay aligned for any type */
+  size_t alignment = alignof(max_align_t);
+  if (objectSize < sizeof(PoolObject))
+  {
+    objectSize = sizeof(PoolObject);
+  }
+  pool->objectSize = (objectSize + alignment - 1) & ~(alignment - 1);
+  pool->objectsPerSlab = (kPoolSlabBytes - alignment) / pool->objectSize;
+  if (pool->objectsPerSlab == 0)
+  {
+    pool->objectsPerSlab = 1;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+
+  pthread_once(&threadCacheKeyOnce, createThreadCacheKey);
+  pool->poolId = atomic_fetch_add(&registeredPoolCount, 1);
+  if (pool->poolId >= kMaxPools)
+  {
+    fprintf(stderr, "poolInit(): too many pools, raise kMaxPools\n");
+    abort();
+  }
+  registeredPools[pool->poolId] = pool;
+}
+
+/*
+ *  Function  : poolAlloc()
+ *  Summary   : This function returns one object from the pool, refilling the calling thread's cache if needed.
+ *  Params    : SlabPool* pool
+ *  Return    : void*
+ */
+void* poolAlloc(SlabPool* pool)
+{
+  PoolThreadCache* cache = &threadCaches[pool->poolId];
+
+  /* Refill the thread cache from the shared free list */
+  if (cache->count == 0)
+  {
+    if (!threadCacheRegistered)
+    {
+      pthread_setspecific(threadCacheKey, (void*)1);
+      threadCacheRegistered = true;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (cache->count < kPoolCacheBatch)
+    {
+      if (pool->freeList == NULL)
+      {
+        growPool(pool);
+      }
+      PoolObject* object = pool->freeList;
+      pool->freeList = object->next;
+      cache->objects[cache->count++] = object;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    atomic_fetch_add_explicit(&pool->cacheRefills, 1, memory_order_relaxed);
+  }
+  else
+  {
+    atomic_fetch_add_explicit(&pool->cacheHits, 1, memory_order_relaxed);
+  }
+
+  /* Track occupancy */
+  size_t inUse = atomic_fetch_add_explicit(&pool->inUse, 1, memory_order_relaxed) + 1;
+  size_t highWater = atomic_load_explicit(&pool->highWater, memory_order_relaxed);
+  while (inUse > highWater &&
+         !atomic_compare_exchange_weak_explicit(&pool->highWater, &highWater, inUse, memory_order_relaxed,
+                                                memory_order_relaxed))
+  {
+  }
+
+  return cache->objects[--cache->count];
+}
+
+/*
+ *  Function  : poolFree()
+ *  Summary   : This function gives an object back to the calling thread's cache, spilling half of a full cache.
+ *  Params    : SlabPool* pool
+ *              void* object
+ *  Return    : void
+ */
+void poolFree(SlabPool* pool, void* object)
+{
+  if (object == NULL)
+  {
+    return;
+  }
+
+  PoolThreadCache* cache = &threadCaches[pool->poolId];
+  if (cache->count == kPoolCacheSize)
+  {
+    pthread_mutex_lock(&pool->lock);
+    while (cache->count > kPoolCacheSize - kPoolCacheBatch)
+    {
+      PoolObject* spilled = cache->objects[--cache->count];
+      spilled->next = pool->freeList;
+      pool->freeList = spilled;
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+  if (!threadCacheRegistered)
+  {
+    pthread_setspecific(threadCacheKey, (void*)1);
+    threadCacheRegistered = true;
+  }
+
+  cache->objects[cache->count++] = object;
+  atomic_fetch_sub_explicit(&pool->inUse, 1, memory_order_relaxed);
+}
+
+/*
+ *  Function  : poolGetStats()
+ *  Summary   : This function copies the occupancy counters of a pool.
+ *  Params    : SlabPool* pool
+ *              PoolStats* stats
+ *  Return    : void
+ */
+void poolGetStats(SlabPool* pool, PoolStats* stats)
+{
+  pthread_mutex_lock(&pool->lock);
+  stats->slabCount = pool->slabCount;
+  pthread_mutex_unlock(&pool->lock);
+
+  stats->name = pool->name;
+  stats->objectSize = pool->objectSize;
+  stats->capacity = stats->slabCount * pool->objectsPerSlab;
+  stats->inUse = atomic_load(&pool->inUse);
+  stats->highWater = atomic_load(&pool->highWater);
+  stats->cacheHits = atomic_load(&pool->cacheHits);
+  stats->cacheRefills = atomic_load(&pool->cacheRefills);
+}
+
+/*
+ *  Function  : poolPrintStats()
+ *  Summary   : This function prints one line of occupancy stats for every registered pool.
+ *  Params    : FILE* stream
+ *  Return    : void
+ */
+void poolPrintStats(FILE* stream)
+{
+  int poolCount = atomic_load(&registeredPoolCount);
+  fprintf(stream, "%-12s %8s %6s %9s %9s %9s %12s %9s\n", "pool", "objsize", "slabs", "capacity", "in-use", "peak",
+          "cache-hits", "refills");
+  for (int i = 0; i < poolCount && i < kMaxPools; i++)
+  {
+    PoolStats stats;
+    poolGetStats(registeredPools[i], &stats);
+    fprintf(stream, "%-12s %8zu %6zu %9zu %9zu %9zu %12zu %9zu\n", stats.name, stats.objectSize, stats.slabCount,
+            stats.capacity, stats.inUse, stats.highWater, stats.cacheHits, stats.cacheRefills);
+  }
+}
+
+/*
+ *  Function  : messageBufferPoolsInit()
+ *  Summary   : This function creates one pool per message buffer size class.
+ *  Params    : void
+ *  Return    : void
+ */
+void messageBufferPoolsInit(void)
+{
+  for (int i = 0; i < kMessageBufferClasses; i++)
+  {
+    poolInit(&bufferPools[i], bufferClassNames[i], sizeof(MessageBuffer) + bufferClassSizes[i]);
+  }
+}
+
+/*
+ *  Function  : messageBufferAcquire()
+ *  Summary   : This function returns an empty buffer with room for at least capacity bytes and one reference.
+ *              Buffers larger than the biggest size class fall back to malloc(). Running out of memory ends
+ *              the process, as growing a pool does, so callers never see NULL.
+ *  Params    : size_t capacity
+ *  Return    : MessageBuffer*
+ */
+MessageBuffer* messageBufferAcquire(size_t capacity)
+{
+  MessageBuffer* buffer = NULL;
+  int sizeClass = -1;
+  for (int i = 0; i < kMessageBufferClasses; i++)
+  {
+    if (capacity <= bufferClassSizes[i])
+    {
+      sizeClass = i;
+      break;
+    }
+  }
+
+  if (sizeClass >= 0)
+  {
+    buffer = poolAlloc(&bufferPools[sizeClass]);
+    buffer->capacity = bufferClassSizes[sizeClass];
+  }
+  else
+  {
+    if ((buffer = malloc(sizeof(MessageBuffer) + capacity)) == NULL)
+    {
+      perror("messageBufferAcquire() FAILED");
+      exit(EXIT_FAILURE);
+    }
+    buffer->capacity = capacity;
+  }
+
+  atomic_init(&buffer->refCount, 1);
+  buffer->sizeClass = sizeClass;
+  buffer->length = 0;
+  buffer->readNs = 0;
+  buffer->traceId = 0;
+  buffer->sequence = 0;
+  buffer->sequenceLineLength = 0;
+  return buffer;
+}
+
+/*
+ *  Function  : messageBufferRetain()
+ *  Summary   : This function adds a reference to a shared buffer.
+ *  Params    : MessageBuffer* buffer
+ *  Return    : void
+ */
+void messageBufferRetain(MessageBuffer* buffer)
+{
+  atomic_fetch_add_explicit(&buffer->refCount, 1, memory_order_relaxed);
+}
+
+/*
+ *  Function  : messageBufferRelease()
+ *  Summary   : This function drops a reference and returns the buffer to its pool when nobody uses it anymore.
+ *  Params    : MessageBuffer* buffer
+ *  Return    : void
+ */
+void messageBufferRelease(MessageBuffer* buffer)
+{
+  if (buffer == NULL || atomic_fetch_sub_explicit(&buffer->refCount, 1, memory_order_acq_rel) != 1)
+  {
+    return;
+  }
+
+  if (buffer->sizeClass >= 0)
+  {
+    poolFree(&bufferPools[buffer->sizeClass], buffer);
+  }
+  else
+  {
+    free(buffer);
+  }
+}
+
+/*
+ *  Function  : growPool()
+ *  Summary   : This function adds one slab worth of objects to the pool's free list. Caller holds the pool lock.
+ *  Params    : SlabPool* pool
+ *  Return    : void
+ */
+static void growPool(SlabPool* pool)
+{
+  size_t alignment = alignof(max_align_t);
+  char* memory = aligned_alloc(alignment, alignment + pool->objectsPerSlab * pool->objectSize);
+  if (memory == NULL)
+  {
+    perror("growPool() FAILED");
+    exit(EXIT_FAILURE);
+  }
+
+  PoolSlab* slab = (PoolSlab*)memory;
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->slabCount++;
+
+  /* Thread every object of the new slab onto the free list */
+  char* object = memory + alignment;
+  for (size_t i = 0; i < pool->objectsPerSlab; i++)
+  {
+    ((PoolObject*)object)->next = pool->freeList;
+    pool->freeList = (PoolObject*)object;
+    object += pool->objectSize;
+  }
+}
+
+/*
+ *  Function  : createThreadCacheKey()
+ *  Summary   : This function creates the thread-specific key whose destructor drains a thread's caches on exit.
+ *  Params    : void
+ *  Return    : void
+ */
+static void createThreadCacheKey(void)
+{
+  pthread_key_create(&threadCacheKey, flushThreadCaches);
+}
+
+/*
+ *  Function  : flushThreadCaches()
+ *  Summary   : This function returns every cached object of an exiting thread to the shared free lists,
+ *              so short lived client threads do not strand memory.
+ *  Params    : void* unused
+ *  Return    : void
+ */
+static void flushThreadCaches(void* unused)
+{
+  (void)unused;
+  int poolCount = atomic_load(&registeredPoolCount);
+  for (int i = 0; i < poolCount && i < kMaxPools; i++)
+  {
+    PoolThreadCache* cache = &threadCaches[i];
+    if (cache->count == 0)
+    {
+      continue;
+    }
+
+    SlabPool* pool = registeredPools[i];
+    pthread_mutex_lock(&pool->lock);
+    while (cache->count > 0)
+    {
+      PoolObject* object = cache->objects[--cache->count];
+      object->next = pool->freeList;
+      pool->freeList = object;
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+  threadCacheRegistered = false;
+}
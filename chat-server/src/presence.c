@@ -0,0 +1,312 @@
+/*
+*   FILE          : presence.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the presence table. Joining, leaving and typing
+*      flip bits under the table's lock and mark it changed; nothing is sent
+*      from here. presenceTakeSummary(), called from the main loop, ends typing
+*      that was not said again in time and turns the bits into a summary line
+*      once the interval since the last one has passed. A summary is built once
+*      and shared by every subscriber, like a broadcast.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../inc/presence.h"
+
+static MessageBuffer* buildSummary(const PresenceTable* table);
+static void clearTyping(PresenceTable* table, int slot);
+static uint64_t clockMs(void);
+
+/*
+ *  Function  : presenceInit()
+ *  Summary   : This function allocates a table with every slot free and builds the first (empty) summary.
+ *  Params    : PresenceTable* table
+ *              int capacity - at least the number of clients that can be registered
+ *  Return    : void
+ */
+void presenceInit(PresenceTable* table, int capacity)
+{
+  memset(table, 0, sizeof(*table));
+  pthread_mutex_init(&table->lock, NULL);
+  table->wordCount = (capacity + 63) / 64;
+  table->online = calloc(table->wordCount, sizeof(*table->online));
+  table->typing = calloc(table->wordCount, sizeof(*table->typing));
+  table->typingUntilMs = calloc(capacity, sizeof(*table->typingUntilMs));
+  table->names = calloc(capacity, sizeof(*table->names));
+  if (table->online == NULL || table->typing == NULL || table->typingUntilMs == NULL || table->names == NULL)
+  {
+    perror("presence calloc() FAILED");
+    exit(EXIT_FAILURE);
+  }
+  table->capacity = capacity;
+  table->current = buildSummary(table);
+}
+
+/*
+ *  Function  : presenceJoin()
+ *  Summary   : This function gives a newly registered session the lowest free slot, marked online.
+ *  Params    : PresenceTable* table
+ *              const char* userName
+ *  Return    : int - the slot, -1 when the table is full (the session then has no presence)
+ */
+int presenceJoin(PresenceTable* table, const char* userName)
+{
+  if (table->capacity == 0)
+  {
+    return -1;
+  }
+
+  int slot = -1;
+  pthread_mutex_lock(&table->lock);
+  for (int word = table->freeHint; word < table->wordCount && slot < 0; word++)
+  {
+    if (~table->online[word] != 0)
+    {
+      slot = word * 64 + __builtin_ctzll(~table->online[word]);
+      table->freeHint = word;
+    }
+  }
+  if (slot >= 0 && slot < table->capacity)
+  {
+    table->online[slot / 64] |= 1ULL << (slot % 64);
+    strncpy(table->names[slot], userName, kPresenceNameLength - 1);
+    table->names[slot][kPresenceNameLength - 1] = '\0';
+    table->onlineCount++;
+    table->changed = true;
+  }
+  else
+  {
+    slot = -1;
+  }
+  pthread_mutex_unlock(&table->lock);
+  return slot;
+}
+
+/*
+ *  Function  : presenceLeave()
+ *  Summary   : This function frees a session's slot, ending its typing too.
+ *  Params    : PresenceTable* table
+ *              int slot - -1 does nothing
+ *  Return    : void
+ */
+void presenceLeave(PresenceTable* table, int slot)
+{
+  if (slot < 0)
+  {
+    return;
+  }
+  pthread_mutex_lock(&table->lock);
+  clearTyping(table, slot);
+  table->online[slot / 64] &= ~(1ULL << (slot % 64));
+  table->onlineCount--;
+  if (slot / 64 < table->freeHint)
+  {
+    table->freeHint = slot / 64;
+  }
+  table->changed = true;
+  pthread_mutex_unlock(&table->lock);
+}
+
+/*
+ *  Function  : presenceSetTyping()
+ *  Summary   : This function records that a session started or stopped typing. Saying it started again
+ *              while typing only pushes back the time it ends by itself.
+ *  Params    : PresenceTable* table
+ *              int slot - -1 does nothing
+ *              bool typing
+ *  Return    : void
+ */
+void presenceSetTyping(PresenceTable* table, int slot, bool typing)
+{
+  if (slot < 0)
+  {
+    return;
+  }
+  uint64_t bit = 1ULL << (slot % 64);
+  pthread_mutex_lock(&table->lock);
+  if (!typing)
+  {
+    clearTyping(table, slot);
+  }
+  else
+  {
+    table->typingUntilMs[slot] = clockMs() + kPresenceTypingMs;
+    if ((table->typing[slot / 64] & bit) == 0)
+    {
+      table->typing[slot / 64] |= bit;
+      table->typingCount++;
+      table->typingChanges++;
+      table->changed = true;
+    }
+  }
+  pthread_mutex_unlock(&table->lock);
+}
+
+/*
+ *  Function  : presenceTakeSummary()
+ *  Summary   : This function returns a new summary for the subscribers, once kPresenceIntervalMs has passed
+ *              since the last one and something they would see has changed. The main loop calls it on every
+ *              timing wheel tick.
+ *  Params    : PresenceTable* table
+ *  Return    : MessageBuffer* - NULL when nothing is to be sent; otherwise the caller releases it
+ */
+MessageBuffer* presenceTakeSummary(PresenceTable* table)
+{
+  if (table->capacity == 0)
+  {
+    return NULL;
+  }
+
+  uint64_t nowMs = clockMs();
+  MessageBuffer* summary = NULL;
+  pthread_mutex_lock(&table->lock);
+  if (nowMs - table->lastSummaryMs >= kPresenceIntervalMs)
+  {
+    /* Typing nobody said again in time has stopped */
+    for (int word = 0; word < table->wordCount && table->typingCount > 0; word++)
+    {
+      for (uint64_t bits = table->typing[word]; bits != 0; bits &= bits - 1)
+      {
+        int slot = word * 64 + __builtin_ctzll(bits);
+        if (table->typingUntilMs[slot] <= nowMs)
+        {
+          clearTyping(table, slot);
+        }
+      }
+    }
+
+    /* Typing that stopped again before anyone was told changes nothing */
+    if (table->changed)
+    {
+      table->changed = false;
+      summary = buildSummary(table);
+      if (summary->length == table->current->length &&
+          memcmp(summary->data, table->current->data, summary->length) == 0)
+      {
+        messageBufferRelease(summary);
+        summary = NULL;
+      }
+      else
+      {
+        messageBufferRelease(table->current);
+        table->current = summary;
+        messageBufferRetain(summary);
+        table->lastSummaryMs = nowMs;
+        table->summariesBuilt++;
+      }
+    }
+  }
+  pthread_mutex_unlock(&table->lock);
+  return summary;
+}
+
+/*
+ *  Function  : presenceCurrent()
+ *  Summary   : This function returns the state as it is now, for a client that just asked for presence:
+ *              the last summary built, or a new one when the table changed since. The others still get that
+ *              change when the next summary is due.
+ *  Params    : PresenceTable* table
+ *  Return    : MessageBuffer* - NULL before presenceInit(); otherwise the caller releases it
+ */
+MessageBuffer* presenceCurrent(PresenceTable* table)
+{
+  if (table->capacity == 0)
+  {
+    return NULL;
+  }
+  pthread_mutex_lock(&table->lock);
+  MessageBuffer* summary = table->current;
+  if (table->changed)
+  {
+    summary = buildSummary(table);
+  }
+  else
+  {
+    messageBufferRetain(summary);
+  }
+  pthread_mutex_unlock(&table->lock);
+  return summary;
+}
+
+/*
+ *  Function  : presencePrintStats()
+ *  Summary   : This function prints how many summaries were built against how often typing changed.
+ *  Params    : PresenceTable* table
+ *              FILE* stream
+ *  Return    : void
+ */
+void presencePrintStats(PresenceTable* table, FILE* stream)
+{
+  if (table->capacity == 0)
+  {
+    return;
+  }
+  pthread_mutex_lock(&table->lock);
+  fprintf(stream, "presence: %d online, %d typing; %llu typing changes sent as %llu summaries\n", table->onlineCount,
+          table->typingCount, (unsigned long long)table->typingChanges, (unsigned long long)table->summariesBuilt);
+  pthread_mutex_unlock(&table->lock);
+}
+
+/*
+ *  Function  : buildSummary()
+ *  Summary   : This function formats the table as a summary line, naming the users typing in the lowest
+ *              slots. Caller holds the table's lock (or is presenceInit()).
+ *  Params    : const PresenceTable* table
+ *  Return    : MessageBuffer*
+ */
+static MessageBuffer* buildSummary(const PresenceTable* table)
+{
+  MessageBuffer* summary = messageBufferAcquire(kPresenceLineSize);
+  size_t length = (size_t)snprintf(summary->data, kPresenceLineSize, "%s|%d|%d|", kPresenceTag,
+                                   table->onlineCount, table->typingCount);
+  int named = 0;
+  for (int word = 0; word < table->wordCount && named < table->typingCount && named < kPresenceShownTypers; word++)
+  {
+    for (uint64_t bits = table->typing[word]; bits != 0 && named < kPresenceShownTypers; bits &= bits - 1)
+    {
+      const char* name = table->names[word * 64 + __builtin_ctzll(bits)];
+      length += (size_t)snprintf(summary->data + length, kPresenceLineSize - length, "%s%s",
+                                 named > 0 ? "," : "", name);
+      named++;
+    }
+  }
+  summary->data[length++] = '\n';
+  summary->length = length;
+  return summary;
+}
+
+/*
+ *  Function  : clearTyping()
+ *  Summary   : This function ends a slot's typing, if it was typing. Caller holds the table's lock.
+ *  Params    : PresenceTable* table
+ *              int slot
+ *  Return    : void
+ */
+static void clearTyping(PresenceTable* table, int slot)
+{
+  uint64_t bit = 1ULL << (slot % 64);
+  if (table->typing[slot / 64] & bit)
+  {
+    table->typing[slot / 64] &= ~bit;
+    table->typingCount--;
+    table->typingChanges++;
+    table->changed = true;
+  }
+}
+
+/*
+ *  Function  : clockMs()
+ *  Summary   : This function reads the monotonic clock in milliseconds.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+static uint64_t clockMs(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000ULL + (uint64_t)now.tv_nsec / 1000000;
+}
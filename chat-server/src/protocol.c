@@ -0,0 +1,322 @@
+/*
+*   FILE          : protocol.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the wire protocol helpers. Every function is bounded
+*      by the sizes it is given: parsing never produces more fields than the
+*      caller has room for, frames, fields and chunks are slices of the original
+*      input, and a line is truncated rather than written past the end of its
+*      buffer. Delimiters are found with the vectorised scanner in scan.c.
+*/
+
+#include <string.h>
+#include <time.h>
+#include "../inc/protocol.h"
+#include "../inc/scan.h"
+
+static size_t formatPrefix(char* prefix, size_t prefixSize, const char* ipAddress, const char* userName,
+                           const char* marker);
+static size_t appendBounded(char* line, size_t used, size_t lineSize, const char* text, size_t textLength);
+
+/*
+ *  Function  : nextFrame()
+ *  Summary   : This function finds the first complete frame in a batch of input. The frame excludes its
+ *              newline (and a '\r' before it, for clients that send CRLF).
+ *  Params    : const char* data
+ *              size_t length
+ *              MessageSlice* frame
+ *  Return    : size_t - bytes the frame used up, including the newline; 0 when no frame is complete yet
+ */
+size_t nextFrame(const char* data, size_t length, MessageSlice* frame)
+{
+  size_t end = scanForByte(data, length, kFrameDelimiter);
+  if (end == length)
+  {
+    return 0;
+  }
+  frame->text = data;
+  frame->length = (end > 0 && data[end - 1] == '\r') ? end - 1 : end;
+  return end + 1;
+}
+
+/*
+ *  Function  : parseMessage()
+ *  Summary   : This function splits a message on the pipe (|) delimiter without modifying it. Once
+ *              maxParts - 1 fields have been split off, the rest of the message (pipes included) becomes the
+ *              last field, so chat text may contain '|'. An empty message has no fields. Unused entries are
+ *              set to {NULL, 0}.
+ *  Params    : const char* message
+ *              size_t length
+ *              MessageSlice messageParts[]
+ *              int maxParts
+ *  Return    : int - the number of fields found
+ */
+int parseMessage(const char* message, size_t length, MessageSlice messageParts[], int maxParts)
+{
+  int partCount = 0;
+  size_t offset = 0;
+  while (length > 0 && partCount < maxParts)
+  {
+    size_t remaining = length - offset;
+    size_t fieldLength = (partCount == maxParts - 1) ? remaining
+                                                     : scanForByte(message + offset, remaining, kMessageDelimiter);
+    messageParts[partCount].text = message + offset;
+    messageParts[partCount].length = fieldLength;
+    partCount++;
+    if (fieldLength == remaining)
+    {
+      break;
+    }
+    offset += fieldLength + 1;
+  }
+
+  for (int i = partCount; i < maxParts; i++)
+  {
+    messageParts[i].text = NULL;
+    messageParts[i].length = 0;
+  }
+  return partCount;
+}
+
+/*
+ *  Function  : chunkMessage()
+ *  Summary   : This function cuts chat text into slices of at most kChunkTextLength characters.
+ *              Text beyond maxChunks slices is dropped.
+ *  Params    : const char* text
+ *              size_t textLength
+ *              MessageSlice chunks[]
+ *              int maxChunks
+ *  Return    : int - the number of chunks
+ */
+int chunkMessage(const char* text, size_t textLength, MessageSlice chunks[], int maxChunks)
+{
+  int chunkCount = 0;
+  size_t offset = 0;
+  while (offset < textLength && chunkCount < maxChunks)
+  {
+    size_t length = textLength - offset;
+    if (length > kChunkTextLength)
+    {
+      length = kChunkTextLength;
+    }
+    chunks[chunkCount].text = text + offset;
+    chunks[chunkCount].length = length;
+    chunkCount++;
+    offset += length;
+  }
+  return chunkCount;
+}
+
+/*
+ *  Function  : sliceEquals()
+ *  Summary   : This function compares a slice with a NUL-terminated string.
+ *  Params    : MessageSlice slice
+ *              const char* text
+ *  Return    : bool
+ */
+bool sliceEquals(MessageSlice slice, const char* text)
+{
+  return slice.text != NULL && strlen(text) == slice.length && memcmp(slice.text, text, slice.length) == 0;
+}
+
+/*
+ *  Function  : sliceCopy()
+ *  Summary   : This function copies a slice into a NUL-terminated string, truncating it to fit.
+ *  Params    : MessageSlice slice
+ *              char* destination
+ *              size_t destinationSize - must be at least 1
+ *  Return    : size_t - characters copied
+ */
+size_t sliceCopy(MessageSlice slice, char* destination, size_t destinationSize)
+{
+  size_t length = slice.length < destinationSize - 1 ? slice.length : destinationSize - 1;
+  if (length > 0)
+  {
+    memcpy(destination, slice.text, length);
+  }
+  destination[length] = '\0';
+  return length;
+}
+
+/*
+ *  Function  : formatLinePrefix()
+ *  Summary   : This function writes the "ip [user] << " that starts every line a sender's messages become,
+ *              keeping at most kLineUserLength characters of the username. It runs once per session, when
+ *              the client says Hello. The prefix is NUL-terminated and truncated if prefixSize is too small.
+ *  Params    : char* prefix
+ *              size_t prefixSize
+ *              const char* ipAddress
+ *              const char* userName
+ *  Return    : size_t - the length of the prefix, excluding the NUL
+ */
+size_t formatLinePrefix(char* prefix, size_t prefixSize, const char* ipAddress, const char* userName)
+{
+  return formatPrefix(prefix, prefixSize, ipAddress, userName, "] << ");
+}
+
+/*
+ *  Function  : formatDirectPrefix()
+ *  Summary   : This function writes the "ip [user] >> " that starts the lines of a direct message, so the
+ *              recipient can tell it from the broadcasts. Otherwise it is the same as formatLinePrefix().
+ *  Params    : char* prefix
+ *              size_t prefixSize
+ *              const char* ipAddress
+ *              const char* userName
+ *  Return    : size_t - the length of the prefix, excluding the NUL
+ */
+size_t formatDirectPrefix(char* prefix, size_t prefixSize, const char* ipAddress, const char* userName)
+{
+  return formatPrefix(prefix, prefixSize, ipAddress, userName, "] >> ");
+}
+
+/*
+ *  Function  : assembleChatLine()
+ *  Summary   : This function joins a sender's prefix, at most kChunkTextLength characters of text and a
+ *              timestamp into line. Nothing is formatted here, only copied. The line is NUL-terminated and
+ *              truncated if lineSize is too small.
+ *  Params    : char* line
+ *              size_t lineSize
+ *              MessageSlice prefix - from formatLinePrefix()
+ *              MessageSlice text
+ *              MessageSlice timestamp - from lineTimestamp(), or empty
+ *  Return    : size_t - the length of the line, excluding the NUL
+ */
+size_t assembleChatLine(char* line, size_t lineSize, MessageSlice prefix, MessageSlice text, MessageSlice timestamp)
+{
+  if (lineSize == 0)
+  {
+    return 0;
+  }
+  if (text.length > kChunkTextLength)
+  {
+    text.length = kChunkTextLength;
+  }
+
+  size_t used = 0;
+  used = appendBounded(line, used, lineSize, prefix.text, prefix.length);
+  used = appendBounded(line, used, lineSize, text.text, text.length);
+  used = appendBounded(line, used, lineSize, timestamp.text, timestamp.length);
+  line[used] = '\0';
+  return used;
+}
+
+/*
+ *  Function  : lineBody()
+ *  Summary   : This function finds the chat text in an output line: what follows the sender's prefix, up to
+ *              the timestamp. Since chunks tile the text, the bodies of a message's lines joined in order give
+ *              back the text the sender wrote.
+ *  Params    : const char* line - without its newline
+ *              size_t length
+ *  Return    : MessageSlice - empty when the line has no prefix
+ */
+MessageSlice lineBody(const char* line, size_t length)
+{
+  MessageSlice body = {line, 0};
+  const char* userStart = memchr(line, '[', length);
+  if (userStart == NULL)
+  {
+    return body;
+  }
+
+  /* The user name is at most kLineUserLength characters, then "] << " or "] >> " */
+  size_t userOffset = (size_t)(userStart - line) + 1;
+  size_t prefixEnd = 0;
+  for (size_t at = userOffset; at + 5 <= length && at <= userOffset + kLineUserLength; at++)
+  {
+    if (memcmp(line + at, "] << ", 5) == 0 || memcmp(line + at, "] >> ", 5) == 0)
+    {
+      prefixEnd = at + 5;
+      break;
+    }
+  }
+  if (prefixEnd == 0)
+  {
+    return body;
+  }
+
+  size_t end = length;
+  if (end >= prefixEnd + kTimestampLength && line[end - kTimestampLength] == ' ' &&
+      line[end - kTimestampLength + 1] == '(' && line[end - 1] == ')')
+  {
+    end -= kTimestampLength;
+  }
+  body.text = line + prefixEnd;
+  body.length = end - prefixEnd;
+  return body;
+}
+
+/*
+ *  Function  : lineTimestamp()
+ *  Summary   : This function returns " (HH:MM:SS)" for the current local time. Each thread keeps its own
+ *              copy and only reformats it when the second changes.
+ *  Params    : void
+ *  Return    : MessageSlice - valid until the calling thread's next call
+ */
+MessageSlice lineTimestamp(void)
+{
+  static _Thread_local time_t cachedSecond = -1;
+  static _Thread_local char cachedStamp[kTimestampLength + 1];
+
+  time_t now = time(NULL);
+  if (now != cachedSecond)
+  {
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(cachedStamp, sizeof(cachedStamp), " (%H:%M:%S)", &local);
+    cachedSecond = now;
+  }
+  return (MessageSlice){cachedStamp, kTimestampLength};
+}
+
+/*
+ *  Function  : formatPrefix()
+ *  Summary   : This function writes "ip [user" followed by the marker that closes the prefix.
+ *  Params    : char* prefix
+ *              size_t prefixSize
+ *              const char* ipAddress
+ *              const char* userName
+ *              const char* marker
+ *  Return    : size_t - the length of the prefix, excluding the NUL
+ */
+static size_t formatPrefix(char* prefix, size_t prefixSize, const char* ipAddress, const char* userName,
+                           const char* marker)
+{
+  if (prefixSize == 0)
+  {
+    return 0;
+  }
+
+  size_t used = 0;
+  used = appendBounded(prefix, used, prefixSize, ipAddress, strlen(ipAddress));
+  used = appendBounded(prefix, used, prefixSize, " [", 2);
+  used = appendBounded(prefix, used, prefixSize, userName, strnlen(userName, kLineUserLength));
+  used = appendBounded(prefix, used, prefixSize, marker, strlen(marker));
+  prefix[used] = '\0';
+  return used;
+}
+
+/*
+ *  Function  : appendBounded()
+ *  Summary   : This function copies as much of text as fits after the used bytes, leaving room for the NUL.
+ *  Params    : char* line
+ *              size_t used
+ *              size_t lineSize
+ *              const char* text
+ *              size_t textLength
+ *  Return    : size_t - the new used length
+ */
+static size_t appendBounded(char* line, size_t used, size_t lineSize, const char* text, size_t textLength)
+{
+  size_t room = lineSize - 1 - used;
+  if (textLength > room)
+  {
+    textLength = room;
+  }
+  if (textLength > 0)
+  {
+    memcpy(line + used, text, textLength);
+  }
+  return used + textLength;
+}
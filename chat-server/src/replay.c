@@ -0,0 +1,98 @@
+/*
+*   FILE          : replay.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the replay ring. Appending a broadcast numbers it,
+*      writes its "Seq|<n>" line once into the shared buffer, and keeps a
+*      reference in the slot for that number, releasing whatever broadcast
+*      was there kReplayCapacity messages ago. The ring has no lock of its
+*      own: the server appends and replays under clients_mutex, which also
+*      orders the broadcasts themselves, so a resuming client never misses or
+*      repeats a message between its replay and the live stream.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "../inc/replay.h"
+
+/*
+ *  Function  : replayRingInit()
+ *  Summary   : This function empties the ring. Numbering continues after lastSequence, so a server that
+ *              takes over from another one keeps counting where it stopped.
+ *  Params    : ReplayRing* ring
+ *              uint64_t lastSequence
+ *  Return    : void
+ */
+void replayRingInit(ReplayRing* ring, uint64_t lastSequence)
+{
+  memset(ring->entries, 0, sizeof(ring->entries));
+  ring->lastSequence = lastSequence;
+}
+
+/*
+ *  Function  : replayRingAppend()
+ *  Summary   : This function gives a broadcast the next sequence number and keeps a reference to it.
+ *  Params    : ReplayRing* ring
+ *              MessageBuffer* lines - not yet queued to anyone
+ *  Return    : uint64_t - the sequence number
+ */
+uint64_t replayRingAppend(ReplayRing* ring, MessageBuffer* lines)
+{
+  uint64_t sequence = ++ring->lastSequence;
+  lines->sequence = sequence;
+  lines->sequenceLineLength = (uint8_t)snprintf(lines->sequenceLine, sizeof(lines->sequenceLine), "%s|%llu\n",
+                                                kSequenceTag, (unsigned long long)sequence);
+
+  MessageBuffer** slot = &ring->entries[sequence & (kReplayCapacity - 1)];
+  if (*slot != NULL)
+  {
+    messageBufferRelease(*slot);
+  }
+  messageBufferRetain(lines);
+  *slot = lines;
+  return sequence;
+}
+
+/*
+ *  Function  : replayRingOldest()
+ *  Summary   : This function returns the oldest sequence number still in the ring.
+ *  Params    : const ReplayRing* ring
+ *  Return    : uint64_t - lastSequence + 1 when the ring holds nothing
+ */
+uint64_t replayRingOldest(const ReplayRing* ring)
+{
+  uint64_t oldest = (ring->lastSequence >= kReplayCapacity) ? ring->lastSequence - kReplayCapacity + 1 : 1;
+  while (oldest <= ring->lastSequence && replayRingGet(ring, oldest) == NULL)
+  {
+    oldest++;
+  }
+  return oldest;
+}
+
+/*
+ *  Function  : replayRingGet()
+ *  Summary   : This function looks up a broadcast by sequence number. The caller retains it if it keeps it.
+ *  Params    : const ReplayRing* ring
+ *              uint64_t sequence
+ *  Return    : MessageBuffer* - NULL when the broadcast has left the ring or never existed
+ */
+MessageBuffer* replayRingGet(const ReplayRing* ring, uint64_t sequence)
+{
+  MessageBuffer* lines = ring->entries[sequence & (kReplayCapacity - 1)];
+  return (lines != NULL && lines->sequence == sequence) ? lines : NULL;
+}
+
+/*
+ *  Function  : makeSequenceLine()
+ *  Summary   : This function builds a stand-alone "Seq|<n>" line, telling a client where the stream is now.
+ *  Params    : uint64_t sequence
+ *  Return    : MessageBuffer* - holding one reference for the caller
+ */
+MessageBuffer* makeSequenceLine(uint64_t sequence)
+{
+  MessageBuffer* line = messageBufferAcquire(sizeof(line->sequenceLine));
+  line->length = (size_t)snprintf(line->data, line->capacity, "%s|%llu\n", kSequenceTag, (unsigned long long)sequence);
+  return line;
+}
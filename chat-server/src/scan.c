@@ -0,0 +1,233 @@
+/*
+*   FILE          : scan.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the byte scanner. Each vector step compares a whole
+*      block against the target byte, turns the result into a bit mask and, if
+*      any bit is set, the lowest one is the first match. Blocks are loaded
+*      unaligned and never read past the end of the data; the last partial
+*      block is finished with the scalar loop. The AVX2 and SSE2 versions are
+*      compiled with per-function target attributes, so the rest of the server
+*      keeps the default instruction set and runs on any x86-64 CPU.
+*/
+
+#include <string.h>
+#include "../inc/scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define kScanHasX86 1
+#else
+#define kScanHasX86 0
+#endif
+
+typedef size_t (*ScanFunction)(const char* data, size_t length, char target);
+
+typedef struct ScanImplementation
+{
+  const char* name;
+  ScanFunction function;
+} ScanImplementation;
+
+static size_t scanScalar(const char* data, size_t length, char target);
+static size_t scanResolve(const char* data, size_t length, char target);
+static bool implementationSupported(const char* name);
+
+#if kScanHasX86
+static size_t scanSse2(const char* data, size_t length, char target);
+static size_t scanAvx2(const char* data, size_t length, char target);
+#endif
+
+// Fastest first; the first supported one is used
+static const ScanImplementation implementations[] = {
+#if kScanHasX86
+  {"avx2", scanAvx2},
+  {"sse2", scanSse2},
+#endif
+  {"scalar", scanScalar},
+};
+#define kScanImplementationCount (sizeof(implementations) / sizeof(implementations[0]))
+
+// Every thread resolves to the same choice, so the unsynchronised first store is harmless
+static ScanFunction activeScan = scanResolve;
+static const char* activeName = NULL;
+
+/*
+ *  Function  : scanForByte()
+ *  Summary   : This function finds the first occurrence of a byte.
+ *  Params    : const char* data
+ *              size_t length
+ *              char target
+ *  Return    : size_t - index of the byte, or length when it does not occur
+ */
+size_t scanForByte(const char* data, size_t length, char target)
+{
+  return activeScan(data, length, target);
+}
+
+/*
+ *  Function  : scanImplementationName()
+ *  Summary   : This function names the implementation in use ("avx2", "sse2" or "scalar").
+ *  Params    : void
+ *  Return    : const char*
+ */
+const char* scanImplementationName(void)
+{
+  if (activeName == NULL)
+  {
+    scanResolve("", 0, 0);
+  }
+  return activeName;
+}
+
+/*
+ *  Function  : scanUseImplementation()
+ *  Summary   : This function forces one implementation, for benchmarks and fuzzing. Call it before any
+ *              other thread scans.
+ *  Params    : const char* name
+ *  Return    : bool - false when the CPU (or the build) does not support it
+ */
+bool scanUseImplementation(const char* name)
+{
+  for (size_t i = 0; i < kScanImplementationCount; i++)
+  {
+    if (strcmp(implementations[i].name, name) == 0 && implementationSupported(name))
+    {
+      activeScan = implementations[i].function;
+      activeName = implementations[i].name;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ *  Function  : scanResolve()
+ *  Summary   : This function is the scanner until the first call: it picks the fastest supported
+ *              implementation, installs it, and scans with it.
+ *  Params    : const char* data
+ *              size_t length
+ *              char target
+ *  Return    : size_t
+ */
+static size_t scanResolve(const char* data, size_t length, char target)
+{
+  for (size_t i = 0; i < kScanImplementationCount; i++)
+  {
+    if (implementationSupported(implementations[i].name))
+    {
+      activeName = implementations[i].name;
+      activeScan = implementations[i].function;
+      break;
+    }
+  }
+  return activeScan(data, length, target);
+}
+
+/*
+ *  Function  : implementationSupported()
+ *  Summary   : This function asks the CPU whether it has the instructions an implementation needs.
+ *  Params    : const char* name
+ *  Return    : bool
+ */
+static bool implementationSupported(const char* name)
+{
+#if kScanHasX86
+  __builtin_cpu_init();
+  if (strcmp(name, "avx2") == 0)
+  {
+    return __builtin_cpu_supports("avx2");
+  }
+  if (strcmp(name, "sse2") == 0)
+  {
+    return __builtin_cpu_supports("sse2");
+  }
+#endif
+  return strcmp(name, "scalar") == 0;
+}
+
+/*
+ *  Function  : scanScalar()
+ *  Summary   : This function compares one byte at a time. Used for tails and on CPUs without vectors.
+ *  Params    : const char* data
+ *              size_t length
+ *              char target
+ *  Return    : size_t
+ */
+static size_t scanScalar(const char* data, size_t length, char target)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    if (data[i] == target)
+    {
+      return i;
+    }
+  }
+  return length;
+}
+
+#if kScanHasX86
+/*
+ *  Function  : scanSse2()
+ *  Summary   : This function compares 16 bytes per step.
+ *  Params    : const char* data
+ *              size_t length
+ *              char target
+ *  Return    : size_t
+ */
+__attribute__((target("sse2")))
+static size_t scanSse2(const char* data, size_t length, char target)
+{
+  __m128i needle = _mm_set1_epi8(target);
+  size_t offset = 0;
+  for (; offset + 16 <= length; offset += 16)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i*)(data + offset));
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (mask != 0)
+    {
+      return offset + __builtin_ctz(mask);
+    }
+  }
+  return offset + scanScalar(data + offset, length - offset, target);
+}
+
+/*
+ *  Function  : scanAvx2()
+ *  Summary   : This function compares 32 bytes per step, then at most one 16-byte step before the tail.
+ *  Params    : const char* data
+ *              size_t length
+ *              char target
+ *  Return    : size_t
+ */
+__attribute__((target("avx2")))
+static size_t scanAvx2(const char* data, size_t length, char target)
+{
+  __m256i needle = _mm256_set1_epi8(target);
+  size_t offset = 0;
+  for (; offset + 32 <= length; offset += 32)
+  {
+    __m256i block = _mm256_loadu_si256((const __m256i*)(data + offset));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+    if (mask != 0)
+    {
+      return offset + __builtin_ctz(mask);
+    }
+  }
+
+  /* Stay in VEX-encoded code: calling scanSse2() here would pay the SSE/AVX transition penalty */
+  if (offset + 16 <= length)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i*)(data + offset));
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm256_castsi256_si128(needle)));
+    if (mask != 0)
+    {
+      return offset + __builtin_ctz(mask);
+    }
+    offset += 16;
+  }
+  return offset + scanScalar(data + offset, length - offset, target);
+}
+#endif
@@ -0,0 +1,734 @@
+/*
+*   FILE          : search.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements chat history search. A message is indexed from
+*      its formatted lines: the line bodies are joined back into the text the
+*      sender wrote, split into lowercase words, and each distinct word gets
+*      one (message delta, count) pair appended to its posting list. Messages
+*      are numbered in the order they are added, so every list is already
+*      sorted and appending never rewrites anything. A search walks the lists
+*      of its words side by side, one message at a time, and keeps the best
+*      hits in a small array; nothing proportional to the number of messages
+*      is allocated per query. Once the hits are full, lists of words too
+*      common to lift a message into them are only probed for the messages
+*      the other lists produce (MaxScore), using skip entries kept every
+*      kSearchSkipInterval postings to jump over the blocks in between.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../inc/search.h"
+
+typedef struct DocumentTerm
+{
+  char name[kSearchTermLength];
+  uint32_t length;
+  uint32_t count;
+} DocumentTerm;
+
+typedef struct PostingCursor
+{
+  const PostingList* list;
+  uint32_t position;
+  uint32_t document;                  // UINT32_MAX once the list is used up
+  uint32_t count;
+  uint32_t skip;                      // next skip entry that may be taken
+  double weight;
+  double maxScore;
+} PostingCursor;
+
+typedef struct SearchHit
+{
+  uint32_t document;
+  double score;
+} SearchHit;
+
+static size_t nextTerm(const char* text, size_t length, size_t* offset, char* term);
+static int collectTerms(const char* text, size_t length, DocumentTerm terms[], int maxTerms);
+static uint32_t hashTerm(const char* name, uint32_t length);
+static SearchTerm* findTerm(const SearchIndex* index, const char* name, uint32_t length, uint32_t hash);
+static SearchTerm* insertTerm(SearchIndex* index, const char* name, uint32_t length, uint32_t hash);
+static bool growTerms(SearchIndex* index);
+static bool appendPosting(SearchIndex* index, PostingList* list, uint32_t document, uint32_t count);
+static size_t writeVarint(uint8_t* data, uint32_t value);
+static uint32_t readVarint(const uint8_t* data, uint32_t* position);
+static void advanceCursor(PostingCursor* cursor);
+static void seekCursor(PostingCursor* cursor, uint32_t target);
+static double termScore(const PostingCursor* cursor);
+static const char* storeLines(SearchIndex* index, const char* lines, size_t length);
+static bool betterHit(SearchHit a, SearchHit b);
+static int compareHits(const void* a, const void* b);
+
+/*
+ *  Function  : searchIndexInit()
+ *  Summary   : This function creates an empty index.
+ *  Params    : SearchIndex* index
+ *  Return    : void
+ */
+void searchIndexInit(SearchIndex* index)
+{
+  memset(index, 0, sizeof(*index));
+  pthread_rwlock_init(&index->lock, NULL);
+}
+
+/*
+ *  Function  : searchIndexAdd()
+ *  Summary   : This function indexes one broadcast and keeps a copy of its lines for showing it as a hit.
+ *              Lines that carry no chat text (no sender prefix) are not indexed.
+ *  Params    : SearchIndex* index
+ *              const char* lines - one or more newline-terminated output lines
+ *              size_t length
+ *  Return    : bool - false when nothing was indexed
+ */
+bool searchIndexAdd(SearchIndex* index, const char* lines, size_t length)
+{
+  /* Join the line bodies back into the sender's text; chunking may have split a word */
+  char text[kSearchTextSize];
+  size_t textLength = 0;
+  for (size_t offset = 0; offset < length;)
+  {
+    const char* newline = memchr(lines + offset, '\n', length - offset);
+    size_t lineLength = (newline != NULL) ? (size_t)(newline - (lines + offset)) : length - offset;
+    MessageSlice body = lineBody(lines + offset, lineLength);
+    if (body.length > sizeof(text) - textLength)
+    {
+      body.length = sizeof(text) - textLength;
+    }
+    memcpy(text + textLength, body.text, body.length);
+    textLength += body.length;
+    offset += lineLength + 1;
+  }
+
+  DocumentTerm terms[kSearchTextSize / (kSearchMinTermLength + 1) + 1];
+  int termCount = collectTerms(text, textLength, terms, sizeof(terms) / sizeof(terms[0]));
+  if (termCount == 0)
+  {
+    return false;
+  }
+
+  pthread_rwlock_wrlock(&index->lock);
+  bool added = false;
+  uint32_t document = index->documentCount + 1;
+  if (document < kSearchMaxDocuments)
+  {
+    if (document >= index->documentCapacity)
+    {
+      uint32_t capacity = (index->documentCapacity == 0) ? 1024 : index->documentCapacity * 2;
+      SearchDocument* documents = realloc(index->documents, capacity * sizeof(SearchDocument));
+      if (documents != NULL)
+      {
+        index->documents = documents;
+        index->documentCapacity = capacity;
+      }
+    }
+    const char* stored = (document < index->documentCapacity) ? storeLines(index, lines, length) : NULL;
+    if (stored != NULL)
+    {
+      index->documents[document].lines = stored;
+      index->documents[document].length = (uint32_t)length;
+      index->documentCount = document;
+      added = true;
+
+      for (int i = 0; i < termCount; i++)
+      {
+        uint32_t hash = hashTerm(terms[i].name, terms[i].length);
+        SearchTerm* term = findTerm(index, terms[i].name, terms[i].length, hash);
+        if (term == NULL)
+        {
+          term = insertTerm(index, terms[i].name, terms[i].length, hash);
+        }
+        if (term != NULL)
+        {
+          appendPosting(index, &term->postings, document, terms[i].count);
+        }
+      }
+    }
+  }
+  pthread_rwlock_unlock(&index->lock);
+  return added;
+}
+
+/*
+ *  Function  : searchIndexQuery()
+ *  Summary   : This function searches the index and formats the reply: a summary line, then the lines of the
+ *              best hits, best first. A message's score adds, for each query word it contains, the word's
+ *              inverse document frequency scaled by how often the message uses it; ties go to newer messages.
+ *  Params    : SearchIndex* index
+ *              MessageSlice query - words separated by anything that is not a letter or digit
+ *  Return    : MessageBuffer* - holding one reference for the caller; NULL when memory ran out
+ */
+MessageBuffer* searchIndexQuery(SearchIndex* index, MessageSlice query)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  DocumentTerm words[kSearchMaxTerms];
+  int wordCount = collectTerms(query.text, query.length, words, kSearchMaxTerms);
+  int queryShown = (int)(query.length < kChunkTextLength ? query.length : kChunkTextLength);
+
+  pthread_rwlock_rdlock(&index->lock);
+  PostingCursor cursors[kSearchMaxTerms];
+  int cursorCount = 0;
+  for (int i = 0; i < wordCount; i++)
+  {
+    SearchTerm* term = findTerm(index, words[i].name, words[i].length, hashTerm(words[i].name, words[i].length));
+    if (term == NULL)
+    {
+      continue;
+    }
+
+    /* Insert in ascending order of the most one message can get from this word */
+    double frequency = term->postings.documentCount;
+    PostingCursor cursor = {&term->postings, 0, 0, 0, 0, 0.0, 0.0};
+    cursor.weight = log(1.0 + (index->documentCount - frequency + 0.5) / (frequency + 0.5));
+    cursor.maxScore = cursor.weight * (term->postings.maxCount * 2.2) / (term->postings.maxCount + 1.2);
+    advanceCursor(&cursor);
+    int at = cursorCount++;
+    while (at > 0 && cursors[at - 1].maxScore > cursor.maxScore)
+    {
+      cursors[at] = cursors[at - 1];
+      at--;
+    }
+    cursors[at] = cursor;
+  }
+  double bound[kSearchMaxTerms];       // the most a message can score from lists 0..i together
+  for (int i = 0; i < cursorCount; i++)
+  {
+    bound[i] = cursors[i].maxScore + (i > 0 ? bound[i - 1] : 0.0);
+  }
+
+  /*
+   * Visit messages in ascending order. Once the hits are full, a message must score at least the worst
+   * hit's score to get in (being newer, it wins a tie). Lists whose bound is below that can no longer
+   * bring in a message on their own: only the remaining "essential" lists pick the next message, and the
+   * others are just checked for it, skipping whole blocks on the way.
+   */
+  SearchHit hits[kSearchMaxHits];
+  int hitCount = 0;
+  int worst = 0;
+  int essential = 0;
+  double threshold = 0.0;
+  while (true)
+  {
+    uint32_t document = UINT32_MAX;
+    for (int i = essential; i < cursorCount; i++)
+    {
+      if (cursors[i].document < document)
+      {
+        document = cursors[i].document;
+      }
+    }
+    if (document == UINT32_MAX)
+    {
+      break;
+    }
+
+    SearchHit hit = {document, 0.0};
+    for (int i = essential; i < cursorCount; i++)
+    {
+      if (cursors[i].document == document)
+      {
+        hit.score += termScore(&cursors[i]);
+        advanceCursor(&cursors[i]);
+      }
+    }
+    for (int i = essential - 1; i >= 0 && hit.score + bound[i] >= threshold; i--)
+    {
+      seekCursor(&cursors[i], document);
+      if (cursors[i].document == document)
+      {
+        hit.score += termScore(&cursors[i]);
+      }
+    }
+
+    if (hitCount < kSearchMaxHits)
+    {
+      hits[hitCount++] = hit;
+    }
+    else if (betterHit(hit, hits[worst]))
+    {
+      hits[worst] = hit;
+    }
+    else
+    {
+      continue;
+    }
+    for (int i = 0; i < hitCount; i++)
+    {
+      worst = betterHit(hits[worst], hits[i]) ? i : worst;
+    }
+    if (hitCount == kSearchMaxHits)
+    {
+      threshold = hits[worst].score;
+      while (essential < cursorCount && bound[essential] < threshold)
+      {
+        essential++;
+      }
+    }
+  }
+  qsort(hits, hitCount, sizeof(SearchHit), compareHits);
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsedMs = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+  char summary[kMaxLineLength + 64];
+  int summaryLength;
+  if (hitCount == 0)
+  {
+    summaryLength = snprintf(summary, sizeof(summary), "(search \"%.*s\": no matches)\n", queryShown, query.text);
+  }
+  else
+  {
+    summaryLength = snprintf(summary, sizeof(summary), "(search \"%.*s\": best %d in %.2f ms)\n", queryShown,
+                             query.text, hitCount, elapsedMs);
+  }
+
+  /* Summary line, then each hit as it was broadcast */
+  size_t replySize = (size_t)summaryLength;
+  for (int i = 0; i < hitCount; i++)
+  {
+    replySize += index->documents[hits[i].document].length;
+  }
+  MessageBuffer* reply = messageBufferAcquire(replySize);
+  if (reply != NULL)
+  {
+    memcpy(reply->data, summary, summaryLength);
+    reply->length = summaryLength;
+    for (int i = 0; i < hitCount; i++)
+    {
+      SearchDocument* hitDocument = &index->documents[hits[i].document];
+      memcpy(reply->data + reply->length, hitDocument->lines, hitDocument->length);
+      reply->length += hitDocument->length;
+    }
+  }
+  pthread_rwlock_unlock(&index->lock);
+  return reply;
+}
+
+/*
+ *  Function  : searchIndexPrintStats()
+ *  Summary   : This function prints the size of the index.
+ *  Params    : SearchIndex* index
+ *              FILE* stream
+ *  Return    : void
+ */
+void searchIndexPrintStats(SearchIndex* index, FILE* stream)
+{
+  pthread_rwlock_rdlock(&index->lock);
+  fprintf(stream, "search: %u message(s), %u word(s), %zu posting bytes, %zu text bytes\n", index->documentCount,
+          index->termCount, index->postingBytes, index->textBytes);
+  pthread_rwlock_unlock(&index->lock);
+}
+
+/*
+ *  Function  : nextTerm()
+ *  Summary   : This function finds the next indexable word from offset on and copies it, lowercased and cut
+ *              to kSearchTermLength bytes, into term. Letters, digits and any byte of a multi-byte character
+ *              make up words; words shorter than kSearchMinTermLength are skipped.
+ *  Params    : const char* text
+ *              size_t length
+ *              size_t* offset - moved past the word
+ *              char* term - kSearchTermLength bytes, not NUL-terminated
+ *  Return    : size_t - the word's length, 0 when there are no more words
+ */
+static size_t nextTerm(const char* text, size_t length, size_t* offset, char* term)
+{
+  while (*offset < length)
+  {
+    size_t termLength = 0;
+    size_t wordLength = 0;
+    for (; *offset < length; (*offset)++)
+    {
+      unsigned char c = (unsigned char)text[*offset];
+      bool wordByte = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+      if (!wordByte)
+      {
+        if (wordLength > 0)
+        {
+          break;
+        }
+        continue;
+      }
+      if (termLength < kSearchTermLength)
+      {
+        term[termLength++] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : (char)c;
+      }
+      wordLength++;
+    }
+    if (termLength >= kSearchMinTermLength)
+    {
+      return termLength;
+    }
+  }
+  return 0;
+}
+
+/*
+ *  Function  : collectTerms()
+ *  Summary   : This function lists the distinct words of a text, in order of first use, with their counts.
+ *  Params    : const char* text
+ *              size_t length
+ *              DocumentTerm terms[]
+ *              int maxTerms - distinct words after this many are ignored
+ *  Return    : int - the number of distinct words
+ */
+static int collectTerms(const char* text, size_t length, DocumentTerm terms[], int maxTerms)
+{
+  int termCount = 0;
+  size_t offset = 0;
+  char name[kSearchTermLength];
+  size_t nameLength;
+  while ((nameLength = nextTerm(text, length, &offset, name)) > 0)
+  {
+    int i = 0;
+    while (i < termCount && (terms[i].length != nameLength || memcmp(terms[i].name, name, nameLength) != 0))
+    {
+      i++;
+    }
+    if (i < termCount)
+    {
+      terms[i].count++;
+    }
+    else if (termCount < maxTerms)
+    {
+      memcpy(terms[termCount].name, name, nameLength);
+      terms[termCount].length = (uint32_t)nameLength;
+      terms[termCount].count = 1;
+      termCount++;
+    }
+  }
+  return termCount;
+}
+
+/*
+ *  Function  : hashTerm()
+ *  Summary   : This function hashes a word (FNV-1a), never returning 0, which marks a free slot.
+ *  Params    : const char* name
+ *              uint32_t length
+ *  Return    : uint32_t
+ */
+static uint32_t hashTerm(const char* name, uint32_t length)
+{
+  uint32_t hash = 2166136261u;
+  for (uint32_t i = 0; i < length; i++)
+  {
+    hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+  }
+  return (hash != 0) ? hash : 1;
+}
+
+/*
+ *  Function  : findTerm()
+ *  Summary   : This function looks a word up in the dictionary.
+ *  Params    : const SearchIndex* index
+ *              const char* name
+ *              uint32_t length
+ *              uint32_t hash
+ *  Return    : SearchTerm* - NULL when the word was never indexed
+ */
+static SearchTerm* findTerm(const SearchIndex* index, const char* name, uint32_t length, uint32_t hash)
+{
+  if (index->termCapacity == 0)
+  {
+    return NULL;
+  }
+  for (uint32_t slot = hash & (index->termCapacity - 1); index->terms[slot].hash != 0;
+       slot = (slot + 1) & (index->termCapacity - 1))
+  {
+    SearchTerm* term = &index->terms[slot];
+    if (term->hash == hash && term->nameLength == length &&
+        memcmp(index->termNames + term->nameOffset, name, length) == 0)
+    {
+      return term;
+    }
+  }
+  return NULL;
+}
+
+/*
+ *  Function  : insertTerm()
+ *  Summary   : This function adds a word with an empty posting list, growing the dictionary first if needed.
+ *  Params    : SearchIndex* index
+ *              const char* name
+ *              uint32_t length
+ *              uint32_t hash
+ *  Return    : SearchTerm* - NULL when memory ran out
+ */
+static SearchTerm* insertTerm(SearchIndex* index, const char* name, uint32_t length, uint32_t hash)
+{
+  if ((index->termCount + 1) * 10 > index->termCapacity * 7 && !growTerms(index))
+  {
+    return NULL;
+  }
+  if (index->termNamesLength + length > index->termNamesCapacity)
+  {
+    size_t capacity = (index->termNamesCapacity == 0) ? 65536 : index->termNamesCapacity * 2;
+    char* names = realloc(index->termNames, capacity);
+    if (names == NULL)
+    {
+      return NULL;
+    }
+    index->termNames = names;
+    index->termNamesCapacity = capacity;
+  }
+
+  uint32_t slot = hash & (index->termCapacity - 1);
+  while (index->terms[slot].hash != 0)
+  {
+    slot = (slot + 1) & (index->termCapacity - 1);
+  }
+  SearchTerm* term = &index->terms[slot];
+  memset(term, 0, sizeof(*term));
+  term->hash = hash;
+  term->nameOffset = (uint32_t)index->termNamesLength;
+  term->nameLength = length;
+  memcpy(index->termNames + index->termNamesLength, name, length);
+  index->termNamesLength += length;
+  index->termCount++;
+  return term;
+}
+
+/*
+ *  Function  : growTerms()
+ *  Summary   : This function doubles the dictionary and re-inserts every word.
+ *  Params    : SearchIndex* index
+ *  Return    : bool - false when memory ran out; the dictionary is unchanged then
+ */
+static bool growTerms(SearchIndex* index)
+{
+  uint32_t capacity = (index->termCapacity == 0) ? 4096 : index->termCapacity * 2;
+  SearchTerm* terms = calloc(capacity, sizeof(SearchTerm));
+  if (terms == NULL)
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < index->termCapacity; i++)
+  {
+    if (index->terms[i].hash != 0)
+    {
+      uint32_t slot = index->terms[i].hash & (capacity - 1);
+      while (terms[slot].hash != 0)
+      {
+        slot = (slot + 1) & (capacity - 1);
+      }
+      terms[slot] = index->terms[i];
+    }
+  }
+  free(index->terms);
+  index->terms = terms;
+  index->termCapacity = capacity;
+  return true;
+}
+
+/*
+ *  Function  : appendPosting()
+ *  Summary   : This function appends a message to a word's posting list as the gap from the previous message
+ *              and the number of times the message uses the word, adding a skip entry at each block boundary.
+ *  Params    : SearchIndex* index
+ *              PostingList* list
+ *              uint32_t document - greater than any already in the list
+ *              uint32_t count
+ *  Return    : bool - false when memory ran out
+ */
+static bool appendPosting(SearchIndex* index, PostingList* list, uint32_t document, uint32_t count)
+{
+  if (list->length + 10 > list->capacity)
+  {
+    uint32_t capacity = (list->capacity == 0) ? 16 : list->capacity * 2;
+    uint8_t* data = realloc(list->data, capacity);
+    if (data == NULL)
+    {
+      return false;
+    }
+    list->data = data;
+    list->capacity = capacity;
+  }
+
+  /* Every kSearchSkipInterval postings, note where decoding can resume */
+  if (list->documentCount > 0 && list->documentCount % kSearchSkipInterval == 0)
+  {
+    if (list->skipCount == list->skipCapacity)
+    {
+      uint32_t capacity = (list->skipCapacity == 0) ? 4 : list->skipCapacity * 2;
+      PostingSkip* skips = realloc(list->skips, capacity * sizeof(PostingSkip));
+      if (skips == NULL)
+      {
+        return false;
+      }
+      list->skips = skips;
+      list->skipCapacity = capacity;
+    }
+    list->skips[list->skipCount++] = (PostingSkip){list->lastDocument, list->length};
+    index->postingBytes += sizeof(PostingSkip);
+  }
+
+  uint32_t before = list->length;
+  list->length += writeVarint(list->data + list->length, document - list->lastDocument);
+  list->length += writeVarint(list->data + list->length, count);
+  list->lastDocument = document;
+  list->documentCount++;
+  list->maxCount = (count > list->maxCount) ? count : list->maxCount;
+  index->postingBytes += list->length - before;
+  return true;
+}
+
+/*
+ *  Function  : writeVarint()
+ *  Summary   : This function writes a value seven bits per byte, low bits first, with the top bit of each
+ *              byte saying another follows.
+ *  Params    : uint8_t* data - room for 5 bytes
+ *              uint32_t value
+ *  Return    : size_t - bytes written
+ */
+static size_t writeVarint(uint8_t* data, uint32_t value)
+{
+  size_t length = 0;
+  while (value >= 0x80)
+  {
+    data[length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  data[length++] = (uint8_t)value;
+  return length;
+}
+
+/*
+ *  Function  : readVarint()
+ *  Summary   : This function reads a value written by writeVarint().
+ *  Params    : const uint8_t* data
+ *              uint32_t* position - moved past the value
+ *  Return    : uint32_t
+ */
+static uint32_t readVarint(const uint8_t* data, uint32_t* position)
+{
+  uint32_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do
+  {
+    byte = data[(*position)++];
+    value |= (uint32_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while ((byte & 0x80) != 0 && shift < 35);
+  return value;
+}
+
+/*
+ *  Function  : advanceCursor()
+ *  Summary   : This function moves a cursor to the next message in its posting list.
+ *  Params    : PostingCursor* cursor
+ *  Return    : void
+ */
+static void advanceCursor(PostingCursor* cursor)
+{
+  if (cursor->position >= cursor->list->length)
+  {
+    cursor->document = UINT32_MAX;
+    return;
+  }
+  cursor->document += readVarint(cursor->list->data, &cursor->position);
+  cursor->count = readVarint(cursor->list->data, &cursor->position);
+}
+
+/*
+ *  Function  : seekCursor()
+ *  Summary   : This function moves a cursor to the first message at or after target, jumping over every
+ *              block of the list that ends before target instead of decoding it.
+ *  Params    : PostingCursor* cursor
+ *              uint32_t target
+ *  Return    : void
+ */
+static void seekCursor(PostingCursor* cursor, uint32_t target)
+{
+  const PostingList* list = cursor->list;
+  if (cursor->document >= target)
+  {
+    return;
+  }
+  while (cursor->skip < list->skipCount && list->skips[cursor->skip].document < target)
+  {
+    if (list->skips[cursor->skip].offset > cursor->position)
+    {
+      cursor->position = list->skips[cursor->skip].offset;
+      cursor->document = list->skips[cursor->skip].document;
+    }
+    cursor->skip++;
+  }
+  while (cursor->document < target)
+  {
+    advanceCursor(cursor);
+  }
+}
+
+/*
+ *  Function  : termScore()
+ *  Summary   : This function scores the cursor's word in the cursor's current message: the word's weight,
+ *              growing with the count but levelling off (as in BM25, without length normalisation).
+ *  Params    : const PostingCursor* cursor
+ *  Return    : double
+ */
+static double termScore(const PostingCursor* cursor)
+{
+  return cursor->weight * (cursor->count * 2.2) / (cursor->count + 1.2);
+}
+
+/*
+ *  Function  : storeLines()
+ *  Summary   : This function copies a message's lines into the current text block, starting a new block when
+ *              it is full. Blocks are never moved or freed, so stored lines stay where they are.
+ *  Params    : SearchIndex* index
+ *              const char* lines
+ *              size_t length
+ *  Return    : const char* - the copy; NULL when memory ran out
+ */
+static const char* storeLines(SearchIndex* index, const char* lines, size_t length)
+{
+  SearchBlock* block = index->blocks;
+  if (block == NULL || block->used + length > block->capacity)
+  {
+    size_t capacity = (length > kSearchBlockSize) ? length : kSearchBlockSize;
+    if ((block = malloc(sizeof(SearchBlock) + capacity)) == NULL)
+    {
+      return NULL;
+    }
+    block->next = index->blocks;
+    block->used = 0;
+    block->capacity = capacity;
+    index->blocks = block;
+  }
+
+  char* stored = block->data + block->used;
+  memcpy(stored, lines, length);
+  block->used += length;
+  index->textBytes += length;
+  return stored;
+}
+
+/*
+ *  Function  : betterHit()
+ *  Summary   : This function tells whether hit a ranks above hit b: higher score, or the same score and newer.
+ *  Params    : SearchHit a
+ *              SearchHit b
+ *  Return    : bool
+ */
+static bool betterHit(SearchHit a, SearchHit b)
+{
+  return a.score > b.score || (a.score == b.score && a.document > b.document);
+}
+
+/*
+ *  Function  : compareHits()
+ *  Summary   : This function orders hits best first, for qsort().
+ *  Params    : const void* a
+ *              const void* b
+ *  Return    : int
+ */
+static int compareHits(const void* a, const void* b)
+{
+  return betterHit(*(const SearchHit*)a, *(const SearchHit*)b) ? -1 : 1;
+}
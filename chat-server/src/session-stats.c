@@ -0,0 +1,188 @@
+/*
+*   FILE          : session-stats.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the session statistics table. A slot is claimed
+*      with a compare-and-swap when a session is created and given back when it
+*      is destroyed. Updates follow the usual sequence lock: make the sequence
+*      odd, write, make it even again. A reader copies the slot between two
+*      reads of the sequence and keeps the copy only when both were the same
+*      even number.
+*/
+
+#include <string.h>
+#include <arpa/inet.h>
+#include "../inc/session-stats.h"
+
+static SessionStats slots[kMaxSessionStats];
+static atomic_int slotsInUse;                 // slots below this index may be claimed
+static atomic_int slotsClaimed;               // so a full table is not searched for every new session
+static atomic_uint_fast64_t unlistedSessions; // sessions that found the table full
+
+static bool readSlot(const SessionStats* slot, SessionSnapshot* copy);
+
+/*
+ *  Function  : sessionStatsClaim()
+ *  Summary   : This function takes a free slot for a new session.
+ *  Params    : int socket
+ *              uint64_t connectedNs
+ *  Return    : SessionStats* - NULL when the table is full; the session then simply is not listed
+ */
+SessionStats* sessionStatsClaim(int socket, uint64_t connectedNs)
+{
+  for (int i = 0; i < kMaxSessionStats && atomic_load(&slotsClaimed) < kMaxSessionStats; i++)
+  {
+    bool expected = false;
+    if (atomic_compare_exchange_strong(&slots[i].claimed, &expected, true))
+    {
+      atomic_fetch_add(&slotsClaimed, 1);
+      int inUse = atomic_load(&slotsInUse);
+      while (inUse <= i && !atomic_compare_exchange_weak(&slotsInUse, &inUse, i + 1))
+      {
+      }
+
+      SessionStats* slot = &slots[i];
+      sessionStatsBeginWrite(slot);
+      memset(&slot->values, 0, sizeof(slot->values));
+      slot->values.live = true;
+      slot->values.socket = socket;
+      slot->values.connectedNs = connectedNs;
+      sessionStatsEndWrite(slot);
+      return slot;
+    }
+  }
+  atomic_fetch_add_explicit(&unlistedSessions, 1, memory_order_relaxed);
+  return NULL;
+}
+
+/*
+ *  Function  : sessionStatsRelease()
+ *  Summary   : This function frees a session's slot. Nothing else may write the slot by then.
+ *  Params    : SessionStats* slot - may be NULL
+ *  Return    : void
+ */
+void sessionStatsRelease(SessionStats* slot)
+{
+  if (slot == NULL)
+  {
+    atomic_fetch_sub_explicit(&unlistedSessions, 1, memory_order_relaxed);
+    return;
+  }
+  sessionStatsBeginWrite(slot);
+  slot->values.live = false;
+  sessionStatsEndWrite(slot);
+  atomic_store_explicit(&slot->claimed, false, memory_order_release);
+  atomic_fetch_sub(&slotsClaimed, 1);
+}
+
+/*
+ *  Function  : sessionStatsBeginWrite()
+ *  Summary   : This function marks a slot as being written. Writers of one slot must not overlap.
+ *  Params    : SessionStats* slot
+ *  Return    : void
+ */
+void sessionStatsBeginWrite(SessionStats* slot)
+{
+  unsigned sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+  atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+/*
+ *  Function  : sessionStatsEndWrite()
+ *  Summary   : This function publishes what was written since sessionStatsBeginWrite().
+ *  Params    : SessionStats* slot
+ *  Return    : void
+ */
+void sessionStatsEndWrite(SessionStats* slot)
+{
+  unsigned sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+  atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_release);
+}
+
+/*
+ *  Function  : sessionStatsPrint()
+ *  Summary   : This function prints one line per live session: its socket, user, address, serving thread,
+ *              traffic, what is queued for it and how long the oldest of that has waited, and how long ago
+ *              it last sent anything.
+ *  Params    : FILE* stream
+ *              uint64_t nowNs - the monotonic clock, ages are measured from it
+ *  Return    : void
+ */
+void sessionStatsPrint(FILE* stream, uint64_t nowNs)
+{
+  fprintf(stream, "%6s %-16s %-15s %8s %10s %12s %12s %10s %11s %11s\n", "fd", "user", "ip", "thread", "up (s)",
+          "bytes in", "bytes out", "queued", "oldest (ms)", "read (ms)");
+
+  int listed = 0;
+  int inUse = atomic_load(&slotsInUse);
+  for (int i = 0; i < inUse; i++)
+  {
+    SessionSnapshot session;
+    if (!readSlot(&slots[i], &session) || !session.live)
+    {
+      continue;
+    }
+
+    char ipAddress[INET_ADDRSTRLEN] = "-";
+    if (session.ipAddress.s_addr != 0)
+    {
+      inet_ntop(AF_INET, &session.ipAddress, ipAddress, sizeof(ipAddress));
+    }
+    char oldest[24] = "-";
+    char lastRead[24] = "-";
+    if (session.oldestQueuedNs != 0)
+    {
+      snprintf(oldest, sizeof(oldest), "%.1f",
+               nowNs > session.oldestQueuedNs ? (nowNs - session.oldestQueuedNs) / 1e6 : 0.0);
+    }
+    if (session.lastReadNs != 0)
+    {
+      snprintf(lastRead, sizeof(lastRead), "%.1f",
+               nowNs > session.lastReadNs ? (nowNs - session.lastReadNs) / 1e6 : 0.0);
+    }
+    fprintf(stream, "%6d %-16s %-15s %8d %10.1f %12llu %12llu %10llu %11s %11s\n", session.socket,
+            session.userName[0] != '\0' ? session.userName : "-",
+            ipAddress, (int)session.thread, nowNs > session.connectedNs ? (nowNs - session.connectedNs) / 1e9 : 0.0,
+            (unsigned long long)session.bytesIn, (unsigned long long)session.bytesOut,
+            (unsigned long long)session.queuedBytes, oldest, lastRead);
+    listed++;
+  }
+
+  uint64_t unlisted = atomic_load_explicit(&unlistedSessions, memory_order_relaxed);
+  fprintf(stream, "%d sessions", listed);
+  if (unlisted > 0)
+  {
+    fprintf(stream, " (%llu more not listed, the table is full)", (unsigned long long)unlisted);
+  }
+  fprintf(stream, "\n");
+}
+
+/*
+ *  Function  : readSlot()
+ *  Summary   : This function copies a slot, retrying while a writer is in the middle of an update.
+ *  Params    : const SessionStats* slot
+ *              SessionSnapshot* copy
+ *  Return    : bool - false when the slot kept changing; it is then left out of this dump
+ */
+static bool readSlot(const SessionStats* slot, SessionSnapshot* copy)
+{
+  for (int attempt = 0; attempt < 1000; attempt++)
+  {
+    unsigned before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if ((before & 1) != 0)
+    {
+      continue;
+    }
+    memcpy(copy, &slot->values, sizeof(*copy));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) == before)
+    {
+      copy->userName[kSessionStatsNameLength - 1] = '\0';
+      return true;
+    }
+  }
+  return false;
+}
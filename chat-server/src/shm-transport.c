@@ -0,0 +1,397 @@
+/*
+*   FILE          : shm-transport.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the shared-memory transport for same-host clients.
+*      Each ring carries length-prefixed records, so one record is one protocol
+*      message just like one read() on a socket. Positions only ever grow and are
+*      masked into the ring. A side that is about to sleep raises a "waiting" flag
+*      and the other side only pays for an eventfd write when that flag is set.
+*      Both the server end (shmTransportCreate) and the client end
+*      (shmTransportAttach) live here so bots can link this file directly.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include "../inc/shm-transport.h"
+
+#define kShmDataOffset ((sizeof(ShmRegion) + 63) & ~(size_t)63)
+#define kShmFdCount 3
+
+static void copyIntoRing(char* ringData, uint64_t position, const void* source, size_t length);
+static void copyFromRing(const char* ringData, uint64_t position, void* destination, size_t length);
+static void signalPeer(ShmTransport* transport);
+static ShmTransport* mapRegion(int memoryFd, int ownEventFd, int peerEventFd, bool isServer);
+
+/*
+ *  Function  : shmTransportCreate()
+ *  Summary   : This function sets up a shared region for a client that asked for it, and passes the
+ *              memfd and eventfds to the client over its Unix socket with SCM_RIGHTS.
+ *  Params    : int unixSocket
+ *  Return    : ShmTransport* - NULL on failure
+ */
+ShmTransport* shmTransportCreate(int unixSocket)
+{
+  size_t regionBytes = kShmDataOffset + 2 * (size_t)kShmRingCapacity;
+  int memoryFd = memfd_create("chat-server-shm", MFD_CLOEXEC);
+  int serverEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  int clientEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (memoryFd < 0 || serverEventFd < 0 || clientEventFd < 0 || ftruncate(memoryFd, regionBytes) < 0)
+  {
+    perror("shmTransportCreate() FAILED");
+    goto failed;
+  }
+
+  ShmTransport* transport = mapRegion(memoryFd, serverEventFd, clientEventFd, true);
+  if (transport == NULL)
+  {
+    goto failed;
+  }
+  transport->region->magic = kShmMagic;
+  transport->region->ringCapacity = kShmRingCapacity;
+
+  /* Hand the region and both eventfds to the client */
+  char reply[] = kShmReply "\n";
+  struct iovec replyData = {reply, sizeof(reply) - 1};
+  union
+  {
+    char buffer[CMSG_SPACE(kShmFdCount * sizeof(int))];
+    struct cmsghdr align;
+  } control = {};
+  struct msghdr message = {};
+  message.msg_iov = &replyData;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = sizeof(control.buffer);
+  struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(kShmFdCount * sizeof(int));
+  int passedFds[kShmFdCount] = {memoryFd, clientEventFd, serverEventFd};
+  memcpy(CMSG_DATA(header), passedFds, sizeof(passedFds));
+  if (sendmsg(unixSocket, &message, MSG_NOSIGNAL) < 0)
+  {
+    perror("shmTransportCreate() sendmsg FAILED");
+    shmTransportDestroy(transport);
+    close(memoryFd);
+    return NULL;
+  }
+
+  close(memoryFd);
+  return transport;
+
+failed:
+  if (memoryFd >= 0)
+  {
+    close(memoryFd);
+  }
+  if (serverEventFd >= 0)
+  {
+    close(serverEventFd);
+  }
+  if (clientEventFd >= 0)
+  {
+    close(clientEventFd);
+  }
+  return NULL;
+}
+
+/*
+ *  Function  : shmTransportAttach()
+ *  Summary   : This function is the client end of the handshake: it asks for a shared region over a
+ *              connected Unix socket and maps what the server sends back. Call it before "Hello", when
+ *              nothing can be on its way to the client yet; asked later, the server refuses while it has output
+ *              queued, and anything already sent would be read here in place of the reply.
+ *  Params    : int unixSocket
+ *  Return    : ShmTransport* - NULL on failure
+ */
+ShmTransport* shmTransportAttach(int unixSocket)
+{
+  if (send(unixSocket, kShmRequest, strlen(kShmRequest), MSG_NOSIGNAL) < 0)
+  {
+    return NULL;
+  }
+
+  char reply[32] = {};
+  struct iovec replyData = {reply, sizeof(reply) - 1};
+  union
+  {
+    char buffer[CMSG_SPACE(kShmFdCount * sizeof(int))];
+    struct cmsghdr align;
+  } control = {};
+  struct msghdr message = {};
+  message.msg_iov = &replyData;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = sizeof(control.buffer);
+  if (recvmsg(unixSocket, &message, MSG_CMSG_CLOEXEC) <= 0 || strncmp(reply, kShmReply, strlen(kShmReply)) != 0)
+  {
+    return NULL;
+  }
+
+  struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (header == NULL || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(kShmFdCount * sizeof(int)))
+  {
+    return NULL;
+  }
+  int passedFds[kShmFdCount];
+  memcpy(passedFds, CMSG_DATA(header), sizeof(passedFds));
+
+  ShmTransport* transport = mapRegion(passedFds[0], passedFds[1], passedFds[2], false);
+  close(passedFds[0]);
+  if (transport == NULL || transport->region->magic != kShmMagic ||
+      transport->region->ringCapacity != kShmRingCapacity)
+  {
+    if (transport != NULL)
+    {
+      shmTransportDestroy(transport);
+    }
+    return NULL;
+  }
+  return transport;
+}
+
+/*
+ *  Function  : shmTransportSend()
+ *  Summary   : This function writes one record to the outbound ring and wakes the reader if it sleeps.
+ *  Params    : ShmTransport* transport
+ *              const void* data
+ *              size_t length
+ *  Return    : ssize_t - length on success, 0 when the ring has no room yet, -1 if the record can never fit
+ */
+ssize_t shmTransportSend(ShmTransport* transport, const void* data, size_t length)
+{
+  uint32_t recordLength = (uint32_t)length;
+  size_t needed = sizeof(recordLength) + length;
+  if (needed > kShmRingCapacity)
+  {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  ShmRing* ring = transport->outbound;
+  uint64_t writePosition = atomic_load_explicit(&ring->writePosition, memory_order_relaxed);
+  uint64_t readPosition = atomic_load(&ring->readPosition);
+  if (kShmRingCapacity - (writePosition - readPosition) < needed)
+  {
+    return 0;
+  }
+
+  copyIntoRing(transport->outboundData, writePosition, &recordLength, sizeof(recordLength));
+  copyIntoRing(transport->outboundData, writePosition + sizeof(recordLength), data, length);
+  atomic_store(&ring->writePosition, writePosition + needed);
+
+  if (atomic_exchange(&ring->readerWaiting, false))
+  {
+    signalPeer(transport);
+  }
+  return (ssize_t)length;
+}
+
+/*
+ *  Function  : shmTransportReceive()
+ *  Summary   : This function takes the next record from the inbound ring. A record longer than capacity is
+ *              cut short, the same way a short read() buffer would cut a message.
+ *  Params    : ShmTransport* transport
+ *              void* data
+ *              size_t capacity
+ *  Return    : ssize_t - bytes copied, 0 when the ring is empty
+ */
+ssize_t shmTransportReceive(ShmTransport* transport, void* data, size_t capacity)
+{
+  ShmRing* ring = transport->inbound;
+  uint64_t readPosition = atomic_load_explicit(&ring->readPosition, memory_order_relaxed);
+  uint64_t writePosition = atomic_load(&ring->writePosition);
+  if (readPosition == writePosition)
+  {
+    return 0;
+  }
+
+  uint32_t recordLength;
+  copyFromRing(transport->inboundData, readPosition, &recordLength, sizeof(recordLength));
+  if (recordLength > writePosition - readPosition - sizeof(recordLength))
+  {
+    errno = EPROTO;
+    return -1;
+  }
+  size_t copied = (recordLength < capacity) ? recordLength : capacity;
+  copyFromRing(transport->inboundData, readPosition + sizeof(recordLength), data, copied);
+  atomic_store(&ring->readPosition, readPosition + sizeof(recordLength) + recordLength);
+
+  if (atomic_exchange(&ring->writerWaiting, false))
+  {
+    signalPeer(transport);
+  }
+  return (ssize_t)copied;
+}
+
+/*
+ *  Function  : shmTransportArmWait()
+ *  Summary   : This function announces that the caller is about to sleep on its eventfd, then checks the
+ *              rings once more so a record published in between is not missed.
+ *  Params    : ShmTransport* transport
+ *              bool wantToWrite - the caller has output that did not fit last time
+ *  Return    : bool - true when there is already something to do and the caller should not sleep
+ */
+bool shmTransportArmWait(ShmTransport* transport, bool wantToWrite)
+{
+  atomic_store(&transport->inbound->readerWaiting, true);
+  if (wantToWrite)
+  {
+    atomic_store(&transport->outbound->writerWaiting, true);
+  }
+
+  if (atomic_load(&transport->inbound->writePosition) != atomic_load(&transport->inbound->readPosition))
+  {
+    return true;
+  }
+  if (wantToWrite &&
+      atomic_load(&transport->outbound->writePosition) == atomic_load(&transport->outbound->readPosition))
+  {
+    return true;
+  }
+  return false;
+}
+
+/*
+ *  Function  : shmTransportClearWakeup()
+ *  Summary   : This function resets the caller's eventfd after it woke up.
+ *  Params    : ShmTransport* transport
+ *  Return    : void
+ */
+void shmTransportClearWakeup(ShmTransport* transport)
+{
+  uint64_t wakeups;
+  if (read(transport->ownEventFd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN)
+  {
+    perror("shmTransportClearWakeup() FAILED");
+  }
+}
+
+/*
+ *  Function  : shmTransportDestroy()
+ *  Summary   : This function unmaps the region and closes the eventfds.
+ *  Params    : ShmTransport* transport
+ *  Return    : void
+ */
+void shmTransportDestroy(ShmTransport* transport)
+{
+  munmap(transport->region, transport->mappedBytes);
+  close(transport->ownEventFd);
+  close(transport->peerEventFd);
+  free(transport);
+}
+
+/*
+ *  Function  : mapRegion()
+ *  Summary   : This function maps the shared region and points each side at the ring it reads and writes.
+ *  Params    : int memoryFd
+ *              int ownEventFd
+ *              int peerEventFd
+ *              bool isServer
+ *  Return    : ShmTransport* - NULL on failure
+ */
+static ShmTransport* mapRegion(int memoryFd, int ownEventFd, int peerEventFd, bool isServer)
+{
+  size_t regionBytes = kShmDataOffset + 2 * (size_t)kShmRingCapacity;
+  void* mapping = mmap(NULL, regionBytes, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+  ShmTransport* transport = malloc(sizeof(ShmTransport));
+  if (mapping == MAP_FAILED || transport == NULL)
+  {
+    perror("mapRegion() FAILED");
+    if (mapping != MAP_FAILED)
+    {
+      munmap(mapping, regionBytes);
+    }
+    free(transport);
+    return NULL;
+  }
+
+  transport->region = mapping;
+  transport->mappedBytes = regionBytes;
+  transport->ownEventFd = ownEventFd;
+  transport->peerEventFd = peerEventFd;
+  char* toServerData = (char*)mapping + kShmDataOffset;
+  char* toClientData = toServerData + kShmRingCapacity;
+  if (isServer)
+  {
+    transport->inbound = &transport->region->toServer;
+    transport->outbound = &transport->region->toClient;
+    transport->inboundData = toServerData;
+    transport->outboundData = toClientData;
+  }
+  else
+  {
+    transport->inbound = &transport->region->toClient;
+    transport->outbound = &transport->region->toServer;
+    transport->inboundData = toClientData;
+    transport->outboundData = toServerData;
+  }
+  return transport;
+}
+
+/*
+ *  Function  : copyIntoRing()
+ *  Summary   : This function copies bytes into a ring at a position, wrapping at the end.
+ *  Params    : char* ringData
+ *              uint64_t position
+ *              const void* source
+ *              size_t length
+ *  Return    : void
+ */
+static void copyIntoRing(char* ringData, uint64_t position, const void* source, size_t length)
+{
+  size_t offset = position & (kShmRingCapacity - 1);
+  size_t firstPart = kShmRingCapacity - offset;
+  if (firstPart > length)
+  {
+    firstPart = length;
+  }
+  memcpy(ringData + offset, source, firstPart);
+  memcpy(ringData, (const char*)source + firstPart, length - firstPart);
+}
+
+/*
+ *  Function  : copyFromRing()
+ *  Summary   : This function copies bytes out of a ring at a position, wrapping at the end.
+ *  Params    : const char* ringData
+ *              uint64_t position
+ *              void* destination
+ *              size_t length
+ *  Return    : void
+ */
+static void copyFromRing(const char* ringData, uint64_t position, void* destination, size_t length)
+{
+  size_t offset = position & (kShmRingCapacity - 1);
+  size_t firstPart = kShmRingCapacity - offset;
+  if (firstPart > length)
+  {
+    firstPart = length;
+  }
+  memcpy(destination, ringData + offset, firstPart);
+  memcpy((char*)destination + firstPart, ringData, length - firstPart);
+}
+
+/*
+ *  Function  : signalPeer()
+ *  Summary   : This function wakes the other side through its eventfd.
+ *  Params    : ShmTransport* transport
+ *  Return    : void
+ */
+static void signalPeer(ShmTransport* transport)
+{
+  uint64_t wakeup = 1;
+  if (write(transport->peerEventFd, &wakeup, sizeof(wakeup)) < 0 && errno != EAGAIN)
+  {
+    perror("signalPeer() FAILED");
+  }
+}
@@ -0,0 +1,180 @@
+/*
+*   FILE          : timing-wheel.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements a hashed timing wheel. An entry due in N ticks goes
+*      into slot (now + N) mod kWheelSlots and remembers its absolute expiry tick,
+*      so deadlines further away than one revolution simply stay in their slot
+*      until the wheel comes round to them at the right tick. Each tick only looks
+*      at one slot, and entries are doubly linked so they can be moved or removed
+*      without searching.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/timerfd.h>
+#include "../inc/timing-wheel.h"
+
+static void unlinkEntry(TimingWheel* wheel, TimerEntry* entry);
+static void insertEntry(TimingWheel* wheel, TimerEntry* entry, uint64_t delayMs);
+
+/*
+ *  Function  : timingWheelInit()
+ *  Summary   : This function empties every slot and starts the periodic timerfd that drives the wheel.
+ *  Params    : TimingWheel* wheel
+ *              TimerCallback onExpiry
+ *  Return    : void
+ */
+void timingWheelInit(TimingWheel* wheel, TimerCallback onExpiry)
+{
+  for (int i = 0; i < kWheelSlots; i++)
+  {
+    wheel->slots[i].next = &wheel->slots[i];
+    wheel->slots[i].prev = &wheel->slots[i];
+  }
+  wheel->currentTick = 0;
+  wheel->armedCount = 0;
+  wheel->onExpiry = onExpiry;
+  pthread_mutex_init(&wheel->lock, NULL);
+
+  if ((wheel->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+  {
+    perror("timerfd_create() FAILED");
+    exit(EXIT_FAILURE);
+  }
+  struct itimerspec period = {};
+  period.it_interval.tv_nsec = kWheelTickMs * 1000000L;
+  period.it_value = period.it_interval;
+  if (timerfd_settime(wheel->timerFd, 0, &period, NULL) < 0)
+  {
+    perror("timerfd_settime() FAILED");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*
+ *  Function  : timingWheelSchedule()
+ *  Summary   : This function arms an entry to expire after delayMs, moving it if it was already armed.
+ *  Params    : TimingWheel* wheel
+ *              TimerEntry* entry
+ *              uint64_t delayMs
+ *  Return    : void
+ */
+void timingWheelSchedule(TimingWheel* wheel, TimerEntry* entry, uint64_t delayMs)
+{
+  pthread_mutex_lock(&wheel->lock);
+  if (entry->armed)
+  {
+    unlinkEntry(wheel, entry);
+  }
+  insertEntry(wheel, entry, delayMs);
+  pthread_mutex_unlock(&wheel->lock);
+}
+
+/*
+ *  Function  : timingWheelCancel()
+ *  Summary   : This function disarms an entry. Once it returns, the expiry callback is not running for it.
+ *  Params    : TimingWheel* wheel
+ *              TimerEntry* entry
+ *  Return    : void
+ */
+void timingWheelCancel(TimingWheel* wheel, TimerEntry* entry)
+{
+  pthread_mutex_lock(&wheel->lock);
+  if (entry->armed)
+  {
+    unlinkEntry(wheel, entry);
+  }
+  pthread_mutex_unlock(&wheel->lock);
+}
+
+/*
+ *  Function  : timingWheelAdvance()
+ *  Summary   : This function consumes the timerfd's expirations and runs the callback for every entry that
+ *              became due. Called by the thread that polls the timerfd.
+ *  Params    : TimingWheel* wheel
+ *  Return    : void
+ */
+void timingWheelAdvance(TimingWheel* wheel)
+{
+  uint64_t elapsedTicks = 0;
+  if (read(wheel->timerFd, &elapsedTicks, sizeof(elapsedTicks)) < 0)
+  {
+    if (errno != EAGAIN)
+    {
+      perror("timingWheelAdvance() FAILED");
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&wheel->lock);
+  while (elapsedTicks-- > 0)
+  {
+    wheel->currentTick++;
+    TimerEntry* slot = &wheel->slots[wheel->currentTick & (kWheelSlots - 1)];
+    TimerEntry* entry = slot->next;
+    while (entry != slot)
+    {
+      TimerEntry* next = entry->next;
+      if (entry->expiryTick <= wheel->currentTick)
+      {
+        unlinkEntry(wheel, entry);
+        uint64_t rearmMs = wheel->onExpiry(entry);
+        if (rearmMs > 0)
+        {
+          insertEntry(wheel, entry, rearmMs);
+        }
+      }
+      entry = next;
+    }
+  }
+  pthread_mutex_unlock(&wheel->lock);
+}
+
+/*
+ *  Function  : unlinkEntry()
+ *  Summary   : This function removes an armed entry from its slot. Caller holds the wheel lock.
+ *  Params    : TimingWheel* wheel
+ *              TimerEntry* entry
+ *  Return    : void
+ */
+static void unlinkEntry(TimingWheel* wheel, TimerEntry* entry)
+{
+  entry->prev->next = entry->next;
+  entry->next->prev = entry->prev;
+  entry->next = NULL;
+  entry->prev = NULL;
+  entry->armed = false;
+  wheel->armedCount--;
+}
+
+/*
+ *  Function  : insertEntry()
+ *  Summary   : This function links an entry into the slot of its expiry tick. Caller holds the wheel lock.
+ *              A re-armed entry always lands at least one tick ahead, so advancing never revisits it.
+ *  Params    : TimingWheel* wheel
+ *              TimerEntry* entry
+ *              uint64_t delayMs
+ *  Return    : void
+ */
+static void insertEntry(TimingWheel* wheel, TimerEntry* entry, uint64_t delayMs)
+{
+  uint64_t delayTicks = (delayMs + kWheelTickMs - 1) / kWheelTickMs;
+  if (delayTicks == 0)
+  {
+    delayTicks = 1;
+  }
+  entry->expiryTick = wheel->currentTick + delayTicks;
+
+  TimerEntry* slot = &wheel->slots[entry->expiryTick & (kWheelSlots - 1)];
+  entry->next = slot;
+  entry->prev = slot->prev;
+  slot->prev->next = entry;
+  slot->prev = entry;
+  entry->armed = true;
+  wheel->armedCount++;
+}
@@ -0,0 +1,310 @@
+/*
+*   FILE          : trace.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the latency histograms and sampled traces. Recording
+*      is a relaxed atomic increment into a power-of-two bucket, so every message
+*      can be measured without a lock. Sampled traces live in a small ring; a
+*      recipient write is attached to a trace only while the trace's slot still
+*      holds the same id, so a slot reused for a newer trace is never mixed up
+*      with an older one.
+*/
+
+#include <time.h>
+#include "../inc/trace.h"
+
+static atomic_uint_fast64_t histograms[kTraceStageCount][kTraceBuckets];
+static atomic_uint_fast64_t stageTotalNs[kTraceStageCount];
+static atomic_uint_fast64_t stageMaxNs[kTraceStageCount];
+static TraceSample samples[kTraceSampleSlots];
+static atomic_uint_fast64_t messagesSeen;
+static atomic_uint_fast64_t lastTraceId;
+static int sampleInterval = kTraceDefaultSampleEvery;
+static _Thread_local uint64_t threadLockWaitNs = 0;
+
+static const char* stageNames[kTraceStageCount] = {"parse", "queue-wait", "format", "lock-wait", "hand-back",
+                                                   "fan-out", "socket-wait", "end-to-end"};
+
+static int bucketFor(uint64_t durationNs);
+static uint64_t percentileNs(TraceStage stage, uint64_t count, double fraction);
+static double sinceReadUs(const MessageStamps* stamps, uint64_t atNs);
+
+/*
+ *  Function  : traceInit()
+ *  Summary   : This function sets how often a message is kept as a full trace.
+ *  Params    : int sampleEvery - keep one message in this many, 0 to keep none
+ *  Return    : void
+ */
+void traceInit(int sampleEvery)
+{
+  sampleInterval = sampleEvery < 0 ? 0 : sampleEvery;
+}
+
+/*
+ *  Function  : traceNow()
+ *  Summary   : This function reads the monotonic clock in nanoseconds.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+uint64_t traceNow(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/*
+ *  Function  : traceRecord()
+ *  Summary   : This function adds one duration to a stage's histogram.
+ *  Params    : TraceStage stage
+ *              uint64_t durationNs
+ *  Return    : void
+ */
+void traceRecord(TraceStage stage, uint64_t durationNs)
+{
+  atomic_fetch_add_explicit(&histograms[stage][bucketFor(durationNs)], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&stageTotalNs[stage], durationNs, memory_order_relaxed);
+
+  uint_fast64_t largest = atomic_load_explicit(&stageMaxNs[stage], memory_order_relaxed);
+  while (durationNs > largest &&
+         !atomic_compare_exchange_weak_explicit(&stageMaxNs[stage], &largest, durationNs, memory_order_relaxed,
+                                                memory_order_relaxed))
+  {
+  }
+}
+
+/*
+ *  Function  : traceLockMutex()
+ *  Summary   : This function locks a mutex and records how long the caller waited for it. An uncontended
+ *              lock is recorded as 0 without reading the clock. The wait also adds up per thread so the
+ *              caller can charge it to the message it is working on.
+ *  Params    : pthread_mutex_t* mutex
+ *  Return    : void
+ */
+void traceLockMutex(pthread_mutex_t* mutex)
+{
+  if (pthread_mutex_trylock(mutex) == 0)
+  {
+    traceRecord(kStageLockWait, 0);
+    return;
+  }
+  uint64_t start = traceNow();
+  pthread_mutex_lock(mutex);
+  uint64_t waited = traceNow() - start;
+  traceRecord(kStageLockWait, waited);
+  threadLockWaitNs += waited;
+}
+
+/*
+ *  Function  : traceTakeLockWait()
+ *  Summary   : This function returns the lock wait the calling thread has built up and resets it.
+ *  Params    : void
+ *  Return    : uint64_t
+ */
+uint64_t traceTakeLockWait(void)
+{
+  uint64_t waited = threadLockWaitNs;
+  threadLockWaitNs = 0;
+  return waited;
+}
+
+/*
+ *  Function  : traceSampleBegin()
+ *  Summary   : This function decides whether the next message becomes a sampled trace.
+ *  Params    : void
+ *  Return    : uint64_t - the trace id, or 0 when the message is not sampled
+ */
+uint64_t traceSampleBegin(void)
+{
+  if (sampleInterval == 0 ||
+      atomic_fetch_add_explicit(&messagesSeen, 1, memory_order_relaxed) % sampleInterval != 0)
+  {
+    return 0;
+  }
+  return atomic_fetch_add_explicit(&lastTraceId, 1, memory_order_relaxed) + 1;
+}
+
+/*
+ *  Function  : traceSampleStore()
+ *  Summary   : This function copies a sampled message's stamps into its slot. It must run before the
+ *              message is queued for anyone, so that every recipient write finds the slot ready.
+ *  Params    : int senderSocket
+ *              const MessageStamps* stamps
+ *  Return    : void
+ */
+void traceSampleStore(int senderSocket, const MessageStamps* stamps)
+{
+  TraceSample* sample = &samples[stamps->traceId % kTraceSampleSlots];
+  atomic_store_explicit(&sample->traceId, 0, memory_order_relaxed);
+  sample->senderSocket = senderSocket;
+  sample->stamps = *stamps;
+  atomic_store_explicit(&sample->writeCount, 0, memory_order_relaxed);
+  atomic_store_explicit(&sample->traceId, stamps->traceId, memory_order_release);
+}
+
+/*
+ *  Function  : traceSampleMark()
+ *  Summary   : This function fills in a stamp of a stored trace that was taken after it was stored.
+ *  Params    : uint64_t traceId
+ *              TraceMark mark
+ *              uint64_t atNs
+ *  Return    : void
+ */
+void traceSampleMark(uint64_t traceId, TraceMark mark, uint64_t atNs)
+{
+  TraceSample* sample = &samples[traceId % kTraceSampleSlots];
+  if (atomic_load_explicit(&sample->traceId, memory_order_acquire) == traceId)
+  {
+    sample->stamps.at[mark] = atNs;
+  }
+}
+
+/*
+ *  Function  : traceSampleLockWait()
+ *  Summary   : This function fills in the lock wait of a stored trace, which is only known once the message
+ *              has been queued for its recipients.
+ *  Params    : uint64_t traceId
+ *              uint64_t waitedNs
+ *  Return    : void
+ */
+void traceSampleLockWait(uint64_t traceId, uint64_t waitedNs)
+{
+  TraceSample* sample = &samples[traceId % kTraceSampleSlots];
+  if (atomic_load_explicit(&sample->traceId, memory_order_acquire) == traceId)
+  {
+    sample->stamps.lockWaitNs = waitedNs;
+  }
+}
+
+/*
+ *  Function  : traceSampleWrite()
+ *  Summary   : This function attaches the moment a recipient received the whole message to its trace.
+ *  Params    : uint64_t traceId
+ *              int recipientSocket
+ *              uint64_t atNs
+ *  Return    : void
+ */
+void traceSampleWrite(uint64_t traceId, int recipientSocket, uint64_t atNs)
+{
+  TraceSample* sample = &samples[traceId % kTraceSampleSlots];
+  if (atomic_load_explicit(&sample->traceId, memory_order_acquire) != traceId)
+  {
+    return;
+  }
+  int index = atomic_fetch_add_explicit(&sample->writeCount, 1, memory_order_relaxed);
+  if (index < kTraceMaxWrites)
+  {
+    sample->writes[index].recipientSocket = recipientSocket;
+    sample->writes[index].atNs = atNs;
+  }
+}
+
+/*
+ *  Function  : tracePrintStats()
+ *  Summary   : This function prints every stage's histogram summary and the most recent sampled traces.
+ *              Percentiles are the upper bound of the bucket they fall in, so they are accurate to 2x.
+ *  Params    : FILE* stream
+ *  Return    : void
+ */
+void tracePrintStats(FILE* stream)
+{
+  fprintf(stream, "%-12s %10s %10s %10s %10s %10s %10s %10s\n", "stage (us)", "count", "mean", "p50", "p90", "p99",
+          "p99.9", "max");
+  for (int stage = 0; stage < kTraceStageCount; stage++)
+  {
+    uint64_t count = 0;
+    for (int bucket = 0; bucket < kTraceBuckets; bucket++)
+    {
+      count += atomic_load_explicit(&histograms[stage][bucket], memory_order_relaxed);
+    }
+    if (count == 0)
+    {
+      fprintf(stream, "%-12s %10d\n", stageNames[stage], 0);
+      continue;
+    }
+    double meanUs = atomic_load_explicit(&stageTotalNs[stage], memory_order_relaxed) / (double)count / 1000.0;
+    fprintf(stream, "%-12s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", stageNames[stage],
+            (unsigned long long)count, meanUs, percentileNs(stage, count, 0.50) / 1000.0,
+            percentileNs(stage, count, 0.90) / 1000.0, percentileNs(stage, count, 0.99) / 1000.0,
+            percentileNs(stage, count, 0.999) / 1000.0,
+            atomic_load_explicit(&stageMaxNs[stage], memory_order_relaxed) / 1000.0);
+  }
+
+  /* Newest sampled traces first, times relative to the read */
+  int printed = 0;
+  for (uint64_t traceId = atomic_load(&lastTraceId); traceId > 0 && printed < kTracePrintedSamples; traceId--)
+  {
+    TraceSample* sample = &samples[traceId % kTraceSampleSlots];
+    if (atomic_load_explicit(&sample->traceId, memory_order_acquire) != traceId)
+    {
+      continue;
+    }
+    const MessageStamps* stamps = &sample->stamps;
+    fprintf(stream, "trace %llu (socket %d) us: parsed +%.1f, format +%.1f..+%.1f, handed back +%.1f, "
+            "queued +%.1f (lock %.1f), writes:", (unsigned long long)traceId, sample->senderSocket,
+            sinceReadUs(stamps, stamps->at[kMarkParsed]), sinceReadUs(stamps, stamps->at[kMarkFormatStart]),
+            sinceReadUs(stamps, stamps->at[kMarkFormatEnd]), sinceReadUs(stamps, stamps->at[kMarkHandedBack]),
+            sinceReadUs(stamps, stamps->at[kMarkEnqueued]), stamps->lockWaitNs / 1000.0);
+    int writeCount = atomic_load_explicit(&sample->writeCount, memory_order_relaxed);
+    for (int i = 0; i < writeCount && i < kTraceMaxWrites; i++)
+    {
+      fprintf(stream, " %d@+%.1f", sample->writes[i].recipientSocket, sinceReadUs(stamps, sample->writes[i].atNs));
+    }
+    fprintf(stream, "%s\n", writeCount > kTraceMaxWrites ? " ..." : "");
+    printed++;
+  }
+  fflush(stream);
+}
+
+/*
+ *  Function  : bucketFor()
+ *  Summary   : This function maps a duration to its histogram bucket: the position of its highest set bit.
+ *  Params    : uint64_t durationNs
+ *  Return    : int
+ */
+static int bucketFor(uint64_t durationNs)
+{
+  if (durationNs == 0)
+  {
+    return 0;
+  }
+  int bucket = 64 - __builtin_clzll(durationNs);
+  return bucket < kTraceBuckets ? bucket : kTraceBuckets - 1;
+}
+
+/*
+ *  Function  : percentileNs()
+ *  Summary   : This function finds the bucket holding the given fraction of a stage's samples.
+ *  Params    : TraceStage stage
+ *              uint64_t count
+ *              double fraction
+ *  Return    : uint64_t - the bucket's upper bound in ns
+ */
+static uint64_t percentileNs(TraceStage stage, uint64_t count, double fraction)
+{
+  uint64_t wanted = (uint64_t)(count * fraction);
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < kTraceBuckets; bucket++)
+  {
+    seen += atomic_load_explicit(&histograms[stage][bucket], memory_order_relaxed);
+    if (seen > wanted)
+    {
+      return bucket == 0 ? 0 : (1ULL << bucket) - 1;
+    }
+  }
+  return UINT64_MAX;
+}
+
+/*
+ *  Function  : sinceReadUs()
+ *  Summary   : This function turns a stamp into microseconds after the message was read.
+ *  Params    : const MessageStamps* stamps
+ *              uint64_t atNs
+ *  Return    : double
+ */
+static double sinceReadUs(const MessageStamps* stamps, uint64_t atNs)
+{
+  return atNs >= stamps->at[kMarkRead] ? (atNs - stamps->at[kMarkRead]) / 1000.0 : 0.0;
+}
@@ -0,0 +1,97 @@
+/*
+*   FILE          : transport.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements the socket transport, the one the server runs on:
+*      each operation is the system call it stands for.
+*/
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "../inc/transport.h"
+
+static bool socketSetNonBlocking(int socket);
+static ssize_t socketReceive(int socket, void* buffer, size_t length);
+static ssize_t socketSend(int socket, const struct msghdr* message, int flags);
+static int socketOpenWakeup(void);
+static void socketWake(int wakeupFd);
+static void socketClose(int fd);
+
+const Transport socketTransport = {"socket", socketSetNonBlocking, socketReceive, socketSend, socketOpenWakeup,
+                                   socketWake, socketClose};
+const Transport* serverTransport = &socketTransport;
+
+/*
+ *  Function  : socketSetNonBlocking()
+ *  Summary   : This function makes writes to a client never block the thread that makes them.
+ *  Params    : int socket
+ *  Return    : bool
+ */
+static bool socketSetNonBlocking(int socket)
+{
+  return fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK) == 0;
+}
+
+/*
+ *  Function  : socketReceive()
+ *  Summary   : This function reads from a socket.
+ *  Params    : int socket
+ *              void* buffer
+ *              size_t length
+ *  Return    : ssize_t - as read()
+ */
+static ssize_t socketReceive(int socket, void* buffer, size_t length)
+{
+  return read(socket, buffer, length);
+}
+
+/*
+ *  Function  : socketSend()
+ *  Summary   : This function writes to a socket.
+ *  Params    : int socket
+ *              const struct msghdr* message
+ *              int flags
+ *  Return    : ssize_t - as sendmsg()
+ */
+static ssize_t socketSend(int socket, const struct msghdr* message, int flags)
+{
+  return sendmsg(socket, message, flags);
+}
+
+/*
+ *  Function  : socketOpenWakeup()
+ *  Summary   : This function creates the eventfd a session's thread sleeps on.
+ *  Params    : void
+ *  Return    : int - the descriptor, -1 on failure
+ */
+static int socketOpenWakeup(void)
+{
+  return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+/*
+ *  Function  : socketWake()
+ *  Summary   : This function signals a session's eventfd.
+ *  Params    : int wakeupFd
+ *  Return    : void
+ */
+static void socketWake(int wakeupFd)
+{
+  uint64_t wakeup = 1;
+  write(wakeupFd, &wakeup, sizeof(wakeup));
+}
+
+/*
+ *  Function  : socketClose()
+ *  Summary   : This function closes a descriptor.
+ *  Params    : int fd
+ *  Return    : void
+ */
+static void socketClose(int fd)
+{
+  close(fd);
+}
@@ -0,0 +1,250 @@
+/*
+*   FILE          : worker-pool.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements a fixed-size pool of worker threads fed by a bounded
+*      multi-producer/multi-consumer ring. Each ring cell carries a sequence number,
+*      so producers and consumers claim cells with a single compare-and-swap and
+*      never take a lock. Idle workers sleep on a semaphore.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+#include "../inc/worker-pool.h"
+#include "../inc/affinity.h"
+
+static void* workerMain(void* arg);
+static WorkItem* takeWork(WorkerPool* pool);
+static void finishWork(WorkItem* item);
+
+/*
+ *  Function  : workerPoolInit()
+ *  Summary   : This function prepares the submission ring and starts the worker threads.
+ *  Params    : WorkerPool* pool
+ *              int threadCount
+ *  Return    : void
+ */
+void workerPoolInit(WorkerPool* pool, int threadCount)
+{
+  for (size_t i = 0; i < kWorkerQueueCapacity; i++)
+  {
+    atomic_init(&pool->cells[i].sequence, i);
+    pool->cells[i].item = NULL;
+  }
+  atomic_init(&pool->enqueuePosition, 0);
+  atomic_init(&pool->dequeuePosition, 0);
+  atomic_init(&pool->stopping, false);
+  sem_init(&pool->itemsAvailable, 0, 0);
+
+  if (threadCount < 1)
+  {
+    threadCount = 1;
+  }
+  if (threadCount > kMaxWorkerThreads)
+  {
+    threadCount = kMaxWorkerThreads;
+  }
+  pool->threadCount = threadCount;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    affinityPrepareWorkerThread(&attributes, i);
+    if (pthread_create(&pool->threads[i], &attributes, workerMain, pool) != 0)
+    {
+      perror("pthread_create() FAILED");
+      exit(EXIT_FAILURE);
+    }
+    pthread_attr_destroy(&attributes);
+  }
+}
+
+/*
+ *  Function  : workerPoolSubmit()
+ *  Summary   : This function places an item on the submission ring without locking. A pool that was never
+ *              started (the simulator's) takes nothing, so every item runs inline, in order.
+ *  Params    : WorkerPool* pool
+ *              WorkItem* item
+ *  Return    : bool - false when the ring is full and the caller has to handle the item itself
+ */
+bool workerPoolSubmit(WorkerPool* pool, WorkItem* item)
+{
+  atomic_init(&item->done, false);
+  if (pool->threadCount == 0)
+  {
+    return false;
+  }
+
+  size_t position = atomic_load_explicit(&pool->enqueuePosition, memory_order_relaxed);
+  while (true)
+  {
+    WorkQueueCell* cell = &pool->cells[position & (kWorkerQueueCapacity - 1)];
+    size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+    if (difference == 0)
+    {
+      /* Cell is free for this position; try to claim it */
+      if (atomic_compare_exchange_weak_explicit(&pool->enqueuePosition, &position, position + 1,
+                                                memory_order_relaxed, memory_order_relaxed))
+      {
+        cell->item = item;
+        atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+        sem_post(&pool->itemsAvailable);
+        return true;
+      }
+    }
+    else if (difference < 0)
+    {
+      return false;
+    }
+    else
+    {
+      position = atomic_load_explicit(&pool->enqueuePosition, memory_order_relaxed);
+    }
+  }
+}
+
+/*
+ *  Function  : workerPoolRunInline()
+ *  Summary   : This function runs an item on the calling thread when the ring is full, and marks it done
+ *              so it completes in the same order as items that went through the pool.
+ *  Params    : WorkItem* item
+ *  Return    : void
+ */
+void workerPoolRunInline(WorkItem* item)
+{
+  atomic_init(&item->done, false);
+  item->run(item);
+  atomic_store_explicit(&item->done, true, memory_order_release);
+}
+
+/*
+ *  Function  : workerPoolShutdown()
+ *  Summary   : This function stops the workers once the ring is empty and waits for them to exit.
+ *  Params    : WorkerPool* pool
+ *  Return    : void
+ */
+void workerPoolShutdown(WorkerPool* pool)
+{
+  atomic_store(&pool->stopping, true);
+  for (int i = 0; i < pool->threadCount; i++)
+  {
+    sem_post(&pool->itemsAvailable);
+  }
+  for (int i = 0; i < pool->threadCount; i++)
+  {
+    pthread_join(pool->threads[i], NULL);
+  }
+  sem_destroy(&pool->itemsAvailable);
+}
+
+/*
+ *  Function  : workerPoolDefaultThreads()
+ *  Summary   : This function picks a worker count that leaves half of the cores for client threads.
+ *  Params    : void
+ *  Return    : int
+ */
+int workerPoolDefaultThreads(void)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int threads = (cores > 1) ? (int)(cores / 2) : 1;
+  return (threads > kMaxWorkerThreads) ? kMaxWorkerThreads : threads;
+}
+
+/*
+ *  Function  : workerMain()
+ *  Summary   : This function is the body of each worker thread: sleep until work arrives, run it, post it back.
+ *              A wakeup stands for one item, but that item's cell may be claimed and not yet filled; the
+ *              worker keeps the wakeup and retries rather than waiting again, or the item would sit on the
+ *              ring with no wakeup left for it.
+ *  Params    : void* arg
+ *  Return    : void*
+ */
+static void* workerMain(void* arg)
+{
+  WorkerPool* pool = arg;
+  affinityBindLocalMemory();
+  while (true)
+  {
+    sem_wait(&pool->itemsAvailable);
+    WorkItem* item;
+    while ((item = takeWork(pool)) == NULL && !atomic_load(&pool->stopping))
+    {
+      sched_yield();
+    }
+    if (item == NULL)
+    {
+      break;
+    }
+
+    item->run(item);
+    finishWork(item);
+  }
+  return NULL;
+}
+
+/*
+ *  Function  : takeWork()
+ *  Summary   : This function claims the oldest item on the ring without locking.
+ *  Params    : WorkerPool* pool
+ *  Return    : WorkItem* - NULL when the ring is empty
+ */
+static WorkItem* takeWork(WorkerPool* pool)
+{
+  size_t position = atomic_load_explicit(&pool->dequeuePosition, memory_order_relaxed);
+  while (true)
+  {
+    WorkQueueCell* cell = &pool->cells[position & (kWorkerQueueCapacity - 1)];
+    size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+    if (difference == 0)
+    {
+      if (atomic_compare_exchange_weak_explicit(&pool->dequeuePosition, &position, position + 1,
+                                                memory_order_relaxed, memory_order_relaxed))
+      {
+        WorkItem* item = cell->item;
+        atomic_store_explicit(&cell->sequence, position + kWorkerQueueCapacity, memory_order_release);
+        return item;
+      }
+    }
+    else if (difference < 0)
+    {
+      return NULL;
+    }
+    else
+    {
+      position = atomic_load_explicit(&pool->dequeuePosition, memory_order_relaxed);
+    }
+  }
+}
+
+/*
+ *  Function  : finishWork()
+ *  Summary   : This function publishes a finished item and wakes the thread that owns it.
+ *  Params    : WorkItem* item
+ *  Return    : void
+ */
+static void finishWork(WorkItem* item)
+{
+  int wakeupFd = item->ownerWakeupFd;
+  atomic_int* signalsInFlight = item->ownerSignalsInFlight;
+
+  /* Once done is set the owner may recycle the item, so only the copies above are used afterwards */
+  atomic_fetch_add(signalsInFlight, 1);
+  atomic_store_explicit(&item->done, true, memory_order_release);
+
+  uint64_t wakeup = 1;
+  if (write(wakeupFd, &wakeup, sizeof(wakeup)) < 0)
+  {
+    perror("finishWork() wakeup FAILED");
+  }
+  atomic_fetch_sub(signalsInFlight, 1);
+}
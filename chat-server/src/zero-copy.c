@@ -0,0 +1,215 @@
+/*
+*   FILE          : zero-copy.c
+*   PROJECT       : Can We Talk System - A04
+*   PROGRAMMER    : Ahmed, Valentyn, Juan Jose, Warren
+*   FIRST VERSION : 03/23/2025
+*   DESCRIPTION   :
+*      This file implements zero-copy sends and their completions. The kernel
+*      numbers every successful MSG_ZEROCOPY send on a socket and later queues
+*      a notification for a range of those numbers; the buffers of the sends in
+*      the range are then released. When a notification says the kernel copied
+*      the data anyway (loopback, or a device that cannot send from user
+*      pages), the socket goes back to ordinary sends, as the kernel's own
+*      documentation advises.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include "../inc/zero-copy.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+static atomic_uint_fast64_t completedSends;   // zero-copy sends the kernel has finished with
+static atomic_uint_fast64_t copiedSends;      // of those, the ones it copied after all
+static atomic_uint_fast64_t abandonedSends;   // still unfinished when their session closed
+
+static void completeRange(ZeroCopyState* state, uint32_t first, uint32_t last, bool copied);
+
+/*
+ *  Function  : zeroCopyCreate()
+ *  Summary   : This function turns zero-copy sends on for a socket and sets up the tracking of its sends.
+ *  Params    : int socket
+ *  Return    : ZeroCopyState* - NULL when the kernel does not support them; the socket then always copies
+ */
+ZeroCopyState* zeroCopyCreate(int socket)
+{
+  int on = 1;
+  if (setsockopt(socket, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0)
+  {
+    return NULL;
+  }
+  ZeroCopyState* state = calloc(1, sizeof(*state));
+  if (state != NULL)
+  {
+    state->enabled = true;
+  }
+  return state;
+}
+
+/*
+ *  Function  : zeroCopySend()
+ *  Summary   : This function sends a message with MSG_ZEROCOPY and keeps a reference on the buffer it points
+ *              into until the kernel is done with it. When zero-copy is off for the socket, too many sends
+ *              are unfinished, or the kernel has no room to pin more pages, the message is copied instead.
+ *  Params    : ZeroCopyState* state
+ *              int socket - non-blocking
+ *              const struct msghdr* message
+ *              MessageBuffer* buffer - holds every byte the message points to
+ *  Return    : ssize_t - as sendmsg()
+ */
+ssize_t zeroCopySend(ZeroCopyState* state, int socket, const struct msghdr* message, MessageBuffer* buffer)
+{
+  if (!state->enabled || state->pendingCount == kZeroCopyMaxPending)
+  {
+    return sendmsg(socket, message, MSG_NOSIGNAL);
+  }
+
+  ssize_t written = sendmsg(socket, message, MSG_ZEROCOPY | MSG_NOSIGNAL);
+  if (written < 0 && errno == ENOBUFS)
+  {
+    return sendmsg(socket, message, MSG_NOSIGNAL);
+  }
+  if (written > 0)
+  {
+    messageBufferRetain(buffer);
+    int slot = (state->pendingHead + state->pendingCount) % kZeroCopyMaxPending;
+    state->pending[slot] = (ZeroCopyPending){state->nextId++, buffer};
+    state->pendingCount++;
+  }
+  return written;
+}
+
+/*
+ *  Function  : zeroCopyReap()
+ *  Summary   : This function reads every completion waiting on the socket's error queue and releases the
+ *              buffers of the sends they cover. It is cheap to call when nothing is waiting.
+ *  Params    : ZeroCopyState* state - NULL to read and drop completions (left on a socket taken over from
+ *                                     an earlier process)
+ *              int socket
+ *  Return    : void
+ */
+void zeroCopyReap(ZeroCopyState* state, int socket)
+{
+  while (true)
+  {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+    struct msghdr message = {.msg_control = control, .msg_controllen = sizeof(control)};
+    if (recvmsg(socket, &message, MSG_ERRQUEUE) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      break;
+    }
+
+    for (struct cmsghdr* header = CMSG_FIRSTHDR(&message); header != NULL; header = CMSG_NXTHDR(&message, header))
+    {
+      if (!((header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR) ||
+            (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR)))
+      {
+        continue;
+      }
+      struct sock_extended_err error;
+      memcpy(&error, CMSG_DATA(header), sizeof(error));
+      if (state != NULL && error.ee_errno == 0 && error.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+      {
+        completeRange(state, error.ee_info, error.ee_data, (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0);
+      }
+    }
+  }
+}
+
+/*
+ *  Function  : zeroCopyDestroy()
+ *  Summary   : This function waits up to kZeroCopyDrainMs for a closing session's unfinished sends, then frees
+ *              the tracking. Buffers the kernel still holds after that are never released: a buffer reused
+ *              while it is being sent would send the new contents in place of the old.
+ *  Params    : ZeroCopyState* state
+ *              int socket - not yet closed
+ *  Return    : void
+ */
+void zeroCopyDestroy(ZeroCopyState* state, int socket)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  zeroCopyReap(state, socket);
+  while (state->pendingCount > 0)
+  {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsedMs = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+    if (elapsedMs >= kZeroCopyDrainMs)
+    {
+      atomic_fetch_add_explicit(&abandonedSends, state->pendingCount, memory_order_relaxed);
+      break;
+    }
+
+    /* Completions raise POLLERR, which poll() reports without being asked */
+    struct pollfd errorPoll = {socket, 0, 0};
+    poll(&errorPoll, 1, (int)(kZeroCopyDrainMs - elapsedMs));
+    zeroCopyReap(state, socket);
+  }
+  free(state);
+}
+
+/*
+ *  Function  : zeroCopyPrintStats()
+ *  Summary   : This function prints how many zero-copy sends completed, were copied, or were abandoned.
+ *  Params    : FILE* stream
+ *  Return    : void
+ */
+void zeroCopyPrintStats(FILE* stream)
+{
+  fprintf(stream, "zero-copy sends: %llu completed, %llu copied by the kernel, %llu abandoned at close\n",
+          (unsigned long long)atomic_load(&completedSends), (unsigned long long)atomic_load(&copiedSends),
+          (unsigned long long)atomic_load(&abandonedSends));
+}
+
+/*
+ *  Function  : completeRange()
+ *  Summary   : This function releases the buffers of the sends numbered first..last. Ranges normally arrive
+ *              in order, covering the oldest sends, but every pending send is checked, so one that arrives
+ *              early is not lost; the head then skips past finished sends.
+ *  Params    : ZeroCopyState* state
+ *              uint32_t first
+ *              uint32_t last
+ *              bool copied - the kernel copied these sends
+ *  Return    : void
+ */
+static void completeRange(ZeroCopyState* state, uint32_t first, uint32_t last, bool copied)
+{
+  uint32_t span = last - first;
+  for (int i = 0; i < state->pendingCount; i++)
+  {
+    ZeroCopyPending* pending = &state->pending[(state->pendingHead + i) % kZeroCopyMaxPending];
+    if (pending->buffer != NULL && pending->id - first <= span)
+    {
+      messageBufferRelease(pending->buffer);
+      pending->buffer = NULL;
+    }
+  }
+  while (state->pendingCount > 0 && state->pending[state->pendingHead].buffer == NULL)
+  {
+    state->pendingHead = (state->pendingHead + 1) % kZeroCopyMaxPending;
+    state->pendingCount--;
+  }
+
+  atomic_fetch_add_explicit(&completedSends, span + 1, memory_order_relaxed);
+  if (copied)
+  {
+    atomic_fetch_add_explicit(&copiedSends, span + 1, memory_order_relaxed);
+    state->enabled = false;
+  }
+}